@@ -125,9 +125,16 @@ public:
                     auto y = std::sin(angle) * radius + radius;
                     prev_time = now;
 
-                    // Raise value change event for the X axis and the Y axis
-                    fsmapper_raiseEvent(this->mapper, this->device_handle, unit_x, static_cast<int>(std::round(x)));
-                    fsmapper_raiseEvent(this->mapper, this->device_handle, unit_y, static_cast<int>(std::round(y)));
+                    // Raise value change events for the X axis and the Y axis at once,
+                    // fsmapper handles these events in a row as a single frame
+                    FSMDEVUNITVALUE values[2];
+                    values[0].index = unit_x;
+                    values[0].type = FSMDU_VALUE_DOUBLE;
+                    values[0].value.doubleValue = x;
+                    values[1].index = unit_y;
+                    values[1].type = FSMDU_VALUE_DOUBLE;
+                    values[1].value.doubleValue = y;
+                    fsmapper_raiseEvents(this->mapper, this->device_handle, values, 2);
                 }
             }
         }));
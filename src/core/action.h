@@ -7,6 +7,7 @@
 
 #include <functional>
 #include <optional>
+#include <atomic>
 #include <map>
 #include <string>
 #include <memory>
@@ -14,11 +15,25 @@
 #include "event.h"
 
 class MapperEngine;
+struct FilterNode;
+
+struct ActionStats{
+    uint64_t count;
+    uint64_t total_time;    // nanoseconds
+    uint64_t max_time;      // nanoseconds
+};
 
 class Action{
 protected:
     std::optional<sol::object> lua_object;
 
+    // counters are updated only by the event-action mapping loop, and they may be read from any thread
+    struct {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> total_time{0};
+        std::atomic<uint64_t> max_time{0};
+    }stats;
+
 public:
     Action(const Action&) = delete;
     Action(Action&&) = delete;
@@ -28,6 +43,23 @@ public:
 
     virtual const char* getName() = 0;
     virtual void invoke(Event& event, sol::state& lua) = 0;
+    virtual bool isLuaAction() const{return false;};
+
+    void recordInvocation(uint64_t nanosec){
+        stats.count.store(stats.count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        stats.total_time.store(stats.total_time.load(std::memory_order_relaxed) + nanosec, std::memory_order_relaxed);
+        if (nanosec > stats.max_time.load(std::memory_order_relaxed)){
+            stats.max_time.store(nanosec, std::memory_order_relaxed);
+        }
+    }
+
+    ActionStats getStats() const{
+        return {
+            stats.count.load(std::memory_order_relaxed),
+            stats.total_time.load(std::memory_order_relaxed),
+            stats.max_time.load(std::memory_order_relaxed),
+        };
+    }
 };
 
 class NativeAction: public Action{
@@ -38,13 +70,18 @@ public:
     protected:
         std::string name;
         ACTION_FUNCTION action;
+        std::shared_ptr<FilterNode> filter_node;
     public:
         Function() = delete;
         Function(const Function&) = delete;
         Function(Function&&) =delete;
         Function(const char* name, ACTION_FUNCTION& action): name(name), action(action){};
+        Function(const char* name, ACTION_FUNCTION& action, std::shared_ptr<FilterNode> node):
+            name(name), action(action), filter_node(std::move(node)){};
         ~Function() = default;
         const char* getName(){return name.c_str();};
+        // filter graph descriptor, this is available only when this function is a native filter
+        const std::shared_ptr<FilterNode>& getFilterNode() const{return filter_node;};
         void invoke(Event& event, sol::state& lua){action(event, lua);};
     };
 
@@ -74,8 +111,10 @@ public:
     virtual ~LuaAction() = default;
     virtual const char* getName();
     virtual void invoke(Event& event, sol::state& lua);
+    virtual bool isLuaAction() const{return true;};
 };
 
 using EventActionMap = std::map<uint64_t, std::unique_ptr<Action>>;
+using EventActionEnumerator = std::function<void (uint64_t evid, Action* action)>;
 std::unique_ptr<EventActionMap> createEventActionMap(const MapperEngine& engine, const sol::object &def);
 void addEventActionMap(const MapperEngine& engine, const std::unique_ptr<EventActionMap>& map, const sol::object &def);
@@ -9,13 +9,18 @@
 
 #include <unistd.h>
 
+#include <cstring>
+#include <cstdint>
 #include <memory>
 #include <sstream>
 #include "posixserial.h"
 
 static const auto COMMSPEED = B115200;
 
-PosixSerial::PosixSerial(const char *path) : should_be_stop(false), written_len(0){
+static constexpr size_t WRITE_BUF_COMPACTION_THRESHOLD = 4096;
+
+PosixSerial::PosixSerial(SerialReactor& reactor, const char *path) :
+    reactor(reactor), is_registered(false), written_len(0){
     // cofigure serial port
     fd_serial = open(path, O_RDWR | O_NONBLOCK);
     if (fd_serial < 0){
@@ -33,82 +38,104 @@ PosixSerial::PosixSerial(const char *path) : should_be_stop(false), written_len(
     tio.c_cc[VMIN] = 1;
     tcflush(fd_serial, TCIFLUSH);
     tcsetattr(fd_serial, TCSANOW, &tio);
-
-    // prepare pipe to transmit system event
-    int pfds[2];
-    if (pipe(pfds) != 0){
-        throw SimHIDConnection::Exception("An error occurred during initializing serial port");
-    }
-    fd_pipe_in = pfds[0];
-    fd_pipe_out = pfds[1];
-
-    // configure descriptors for poll(2)
-    bzero(pollfds, sizeof(pollfds));
-    pollfds[0].fd = fd_serial;
-    pollfds[1].fd = fd_pipe_in;
-    pollfds[1].events = POLLIN;
 }
 
 PosixSerial::~PosixSerial(){
-    stop();
+    // owner must wait until the close handler is called if the serial port has been started
 }
-int PosixSerial::read(void* buf, int len){
-    while (true){
-        {
-            std::lock_guard lock(mutex);
-            pollfds[0].events = write_buf.size() == 0 ? POLLIN : POLLIN | POLLOUT;
-            pollfds[0].revents = 0;
-        }
-        if (::poll(pollfds, 2, -1) < -1){
-            // may reach here by only EINTR
-            continue;
-        }
-        if (pollfds[1].revents & POLLIN){
-            pollfds[1].revents = 0;
-            ::read(fd_pipe_in, pipebuf, sizeof(pipebuf));
-            std::lock_guard lock(mutex);
-            if (should_be_stop){
-                // got message to stop serial communication
-                return -1;
-            }
+
+void PosixSerial::start(ReceiveHandler&& receive, CloseHandler&& close){
+    std::lock_guard lock(mutex);
+    receive_handler = std::move(receive);
+    close_handler = std::move(close);
+    reactor.add(this, hasPendingData());
+    is_registered = true;
+}
+
+void PosixSerial::onEvents(uint32_t events, char* buf, size_t len){
+    if (events & SerialReactor::EVENT_WRITABLE){
+        // can send data via serial port
+        std::lock_guard lock(mutex);
+        if (written_len == write_buf.size()){
+            flushPendingUnitValues();
         }
-        if (pollfds[0].revents & POLLOUT){
-            // can send data via serial port
-            std::lock_guard lock(mutex);
-            auto& data = write_buf.front();
-            auto result = ::write(fd_serial, data.data() + written_len, data.size() - written_len);
-            if (result < 0){
+        if (written_len < write_buf.size()){
+            auto result = ::write(fd_serial, write_buf.data() + written_len, write_buf.size() - written_len);
+            if (result < 0 && errno != EAGAIN && errno != EINTR){
                 throw SimHIDConnection::Exception("Cannot send data to serial port");
             }
-            written_len += result;
-            if (data.size() == written_len){
+            written_len += result > 0 ? result : 0;
+            if (written_len == write_buf.size()){
+                write_buf.clear();
+                written_len = 0;
+            }else if (written_len >= WRITE_BUF_COMPACTION_THRESHOLD && written_len * 2 >= write_buf.size()){
+                write_buf.erase(0, written_len);
                 written_len = 0;
-                write_buf.pop();
             }
         }
-        if (pollfds[0].revents & POLLIN){
-            // any data can be read from serial port
-            auto result = ::read(fd_serial, buf, len);
-            if (result < 0){
-                throw SimHIDConnection::Exception("An error occurred when receiving data from seriral port");
-            }
-            return result;
+        if (!hasPendingData()){
+            reactor.setWritable(this, false);
+        }
+    }
+    if (events & (SerialReactor::EVENT_READABLE | SerialReactor::EVENT_ERROR)){
+        // any data can be read from serial port
+        auto result = ::read(fd_serial, buf, len);
+        if (result < 0 && errno != EAGAIN && errno != EINTR){
+            throw SimHIDConnection::Exception("An error occurred when receiving data from seriral port");
+        }else if (result == 0 && (events & SerialReactor::EVENT_ERROR)){
+            throw SimHIDConnection::Exception("Serial port has been disconnected");
+        }else if (result > 0){
+            receive_handler(buf, static_cast<int>(result));
         }
     }
 }
 
+void PosixSerial::onClosed(std::exception_ptr error){
+    close_handler(error);
+}
+
 void PosixSerial::write(std::string &&data){
     std::lock_guard lock(mutex);
-    static char buf[1] = {1};
-    write_buf.push(std::move(data));
-    ::write(fd_pipe_out, buf, 1);
+    // the reactor needs to watch the serial port for writing only if there was no pending data
+    auto was_empty = !hasPendingData();
+    // unit values requested before this data must be sent before it
+    flushPendingUnitValues();
+    write_buf.append(data);
+    if (was_empty && is_registered){
+        reactor.setWritable(this, true);
+    }
 }
 
-void PosixSerial::stop(){
+void PosixSerial::writeUnitValue(size_t index, int value){
     std::lock_guard lock(mutex);
-    if (!should_be_stop){
-        should_be_stop = true;
-        static char buf[1] = {2};
-        ::write(fd_pipe_out, buf, 1);
+    auto was_empty = !hasPendingData();
+    if (index >= is_pending.size()){
+        is_pending.resize(index + 1, false);
+        pending_values.resize(index + 1, 0);
+    }
+    pending_values[index] = value;
+    if (!is_pending[index]){
+        is_pending[index] = true;
+        pending_units.push_back({static_cast<int>(index), 0});
+    }
+    if (was_empty && is_registered){
+        reactor.setWritable(this, true);
     }
 }
+
+void PosixSerial::flushPendingUnitValues(){
+    // must be called with holding the lock
+    if (pending_units.size() == 0){
+        return;
+    }
+    for (auto& unit : pending_units){
+        unit.value = pending_values[unit.index];
+        is_pending[unit.index] = false;
+    }
+    encoder(pending_units.data(), pending_units.size(), write_buf);
+    pending_units.clear();
+}
+
+void PosixSerial::stop(){
+    reactor.remove(this);
+}
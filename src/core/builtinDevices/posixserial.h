@@ -4,12 +4,12 @@
 //
 
 #pragma once
-#include <poll.h>
 #include <unistd.h>
 #include <mutex>
-#include <queue>
 #include <string>
+#include <vector>
 #include "simhidconnection.h"
+#include "serialreactor.h"
 
 class PosixSerial : public SimHIDConnection::SerialComm{
 protected:
@@ -35,23 +35,42 @@ protected:
         operator int()const {return fd;};
     };
 
+    SerialReactor& reactor;
     std::mutex mutex;
     FD fd_serial;
-    FD fd_pipe_in;
-    FD fd_pipe_out;
-    bool should_be_stop;
-    std::queue<std::string> write_buf;
+    bool is_registered;
+    ReceiveHandler receive_handler;
+    CloseHandler close_handler;
+
+    // outbound data is stored contiguously and written as many as possible by a write(2)
+    // the range [written_len, write_buf.size()) is not written yet
+    std::string write_buf;
     size_t written_len;
-    pollfd pollfds[2];
-    char pipebuf[64];
+
+    // unit values which are not encoded yet
+    // superseded values are dropped, then the rest are encoded when write_buf is drained or
+    // before any other data is appended to write_buf
+    std::vector<int> pending_values;
+    std::vector<bool> is_pending;
+    std::vector<SimhidUnitValue> pending_units;
 
 public:
     PosixSerial() = delete;
     PosixSerial(PosixSerial&) = delete;
     PosixSerial(PosixSerial&&) = delete;
-    PosixSerial(const char* path);
+    PosixSerial(SerialReactor& reactor, const char* path);
     virtual ~PosixSerial();
-    virtual int read(void* buf, int len);
+    virtual void start(ReceiveHandler&& receive, CloseHandler&& close);
     virtual void write(std::string&& data);
     virtual void stop();
+    virtual void writeUnitValue(size_t index, int value);
+
+    // interfaces for SerialReactor, these are called on the reactor thread
+    int getFd() const{return fd_serial;};
+    void onEvents(uint32_t events, char* buf, size_t len);
+    void onClosed(std::exception_ptr error);
+
+protected:
+    bool hasPendingData() const{return written_len < write_buf.size() || pending_units.size() > 0;};
+    void flushPendingUnitValues();
 };
@@ -0,0 +1,234 @@
+//
+// serialreactor.cpp
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+
+#include <unistd.h>
+#include <fcntl.h>
+#if defined(__linux__)
+#   include <sys/epoll.h>
+#   include <sys/eventfd.h>
+#else
+#   include <poll.h>
+#endif
+#include "serialreactor.h"
+#include "posixserial.h"
+
+static constexpr int MAX_EVENTS = 16;
+
+//============================================================================================
+// Reactor thread management
+//============================================================================================
+SerialReactor::SerialReactor(){
+    auto succeeded = true;
+#if defined(__linux__)
+    fd_poller = epoll_create1(EPOLL_CLOEXEC);
+    fd_wakeup_in = fd_wakeup_out = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    succeeded = fd_poller >= 0 && fd_wakeup_in >= 0 && epoll_ctl(fd_poller, EPOLL_CTL_ADD, fd_wakeup_in, &event) == 0;
+#else
+    int pfds[2];
+    succeeded = pipe(pfds) == 0;
+    if (succeeded){
+        fd_wakeup_in = pfds[0];
+        fd_wakeup_out = pfds[1];
+        fcntl(fd_wakeup_in, F_SETFL, O_NONBLOCK);
+    }
+#endif
+    if (!succeeded){
+        if (fd_poller >= 0){
+            close(fd_poller);
+        }
+        if (fd_wakeup_in >= 0){
+            close(fd_wakeup_in);
+        }
+        if (fd_wakeup_out >= 0 && fd_wakeup_out != fd_wakeup_in){
+            close(fd_wakeup_out);
+        }
+        throw SimHIDConnection::Exception("An error occurred during initializing I/O reactor for serial ports");
+    }
+    reactor = std::thread([this]{run();});
+}
+
+SerialReactor::~SerialReactor(){
+    {
+        std::lock_guard lock(mutex);
+        should_be_stop = true;
+        wakeup();
+    }
+    reactor.join();
+    if (fd_poller >= 0){
+        close(fd_poller);
+    }
+    close(fd_wakeup_in);
+    if (fd_wakeup_out != fd_wakeup_in){
+        close(fd_wakeup_out);
+    }
+}
+
+void SerialReactor::wakeup(){
+    // must be called with holding the lock
+    if (!is_wakeup_signaled){
+        is_wakeup_signaled = true;
+#if defined(__linux__)
+        uint64_t value = 1;
+        [[maybe_unused]] auto rc = ::write(fd_wakeup_out, &value, sizeof(value));
+#else
+        static char buf[1] = {1};
+        [[maybe_unused]] auto rc = ::write(fd_wakeup_out, buf, 1);
+#endif
+    }
+}
+
+void SerialReactor::clearWakeup(){
+#if defined(__linux__)
+    uint64_t value;
+    [[maybe_unused]] auto rc = ::read(fd_wakeup_in, &value, sizeof(value));
+#else
+    char buf[64];
+    [[maybe_unused]] auto rc = ::read(fd_wakeup_in, buf, sizeof(buf));
+#endif
+    std::lock_guard lock(mutex);
+    is_wakeup_signaled = false;
+}
+
+#if defined(__linux__)
+void SerialReactor::run(){
+    epoll_event events[MAX_EVENTS];
+    while (true){
+        auto num = epoll_wait(fd_poller, events, MAX_EVENTS, -1);
+        for (auto i = 0; i < num; i++){
+            auto serial = static_cast<PosixSerial*>(events[i].data.ptr);
+            if (!serial){
+                clearWakeup();
+                continue;
+            }
+            uint32_t flags = 0;
+            flags |= events[i].events & EPOLLIN ? EVENT_READABLE : 0;
+            flags |= events[i].events & EPOLLOUT ? EVENT_WRITABLE : 0;
+            flags |= events[i].events & (EPOLLERR | EPOLLHUP) ? EVENT_ERROR : 0;
+            dispatch(serial, flags);
+        }
+        notifyClosedSerials();
+        std::lock_guard lock(mutex);
+        if (should_be_stop){
+            return;
+        }
+    }
+}
+#else
+void SerialReactor::run(){
+    std::vector<pollfd> pollfds;
+    std::vector<PosixSerial*> targets;
+    while (true){
+        pollfds.clear();
+        targets.clear();
+        pollfds.push_back({fd_wakeup_in, POLLIN, 0});
+        {
+            std::lock_guard lock(mutex);
+            for (auto& [serial, writable] : serials){
+                pollfds.push_back({serial->getFd(), static_cast<short>(writable ? POLLIN | POLLOUT : POLLIN), 0});
+                targets.push_back(serial);
+            }
+        }
+        if (::poll(pollfds.data(), pollfds.size(), -1) > 0){
+            if (pollfds[0].revents & POLLIN){
+                clearWakeup();
+            }
+            for (size_t i = 0; i < targets.size(); i++){
+                auto revents = pollfds[i + 1].revents;
+                uint32_t flags = 0;
+                flags |= revents & POLLIN ? EVENT_READABLE : 0;
+                flags |= revents & POLLOUT ? EVENT_WRITABLE : 0;
+                flags |= revents & (POLLERR | POLLHUP) ? EVENT_ERROR : 0;
+                if (flags){
+                    dispatch(targets[i], flags);
+                }
+            }
+        }
+        notifyClosedSerials();
+        std::lock_guard lock(mutex);
+        if (should_be_stop){
+            return;
+        }
+    }
+}
+#endif
+
+void SerialReactor::dispatch(PosixSerial* serial, uint32_t events){
+    {
+        // unregistered serial ports are alive until they are notified at the end of a batch
+        std::lock_guard lock(mutex);
+        if (serials.count(serial) == 0){
+            return;
+        }
+    }
+    try{
+        serial->onEvents(events, read_buf, sizeof(read_buf));
+    }catch (...){
+        remove(serial, std::current_exception());
+    }
+}
+
+void SerialReactor::notifyClosedSerials(){
+    std::vector<ClosedSerial> closed;
+    {
+        std::lock_guard lock(mutex);
+        closed.swap(closed_serials);
+    }
+    for (auto& entry : closed){
+        entry.serial->onClosed(entry.error);
+    }
+}
+
+//============================================================================================
+// Serial port registration
+//============================================================================================
+void SerialReactor::add(PosixSerial* serial, bool writable){
+    std::lock_guard lock(mutex);
+#if defined(__linux__)
+    epoll_event event{};
+    event.events = writable ? EPOLLIN | EPOLLOUT : EPOLLIN;
+    event.data.ptr = serial;
+    if (epoll_ctl(fd_poller, EPOLL_CTL_ADD, serial->getFd(), &event) != 0){
+        throw SimHIDConnection::Exception("Failed to register a serial port to I/O reactor");
+    }
+#else
+    wakeup();
+#endif
+    serials[serial] = writable;
+}
+
+void SerialReactor::remove(PosixSerial* serial, std::exception_ptr error){
+    std::lock_guard lock(mutex);
+    if (serials.erase(serial) > 0){
+#if defined(__linux__)
+        epoll_ctl(fd_poller, EPOLL_CTL_DEL, serial->getFd(), nullptr);
+#endif
+        closed_serials.push_back({serial, error});
+        wakeup();
+    }
+}
+
+void SerialReactor::setWritable(PosixSerial* serial, bool writable){
+    // the lock serializes this with remove(), so the file descriptor is never modified after
+    // it is unregistered, then closed and reused by another serial port
+    // this is called with holding the lock of the serial port, and the reactor never takes that
+    // lock with holding its own lock
+    std::lock_guard lock(mutex);
+    auto entry = serials.find(serial);
+    if (entry == serials.end() || entry->second == writable){
+        return;
+    }
+    entry->second = writable;
+#if defined(__linux__)
+    epoll_event event{};
+    event.events = writable ? EPOLLIN | EPOLLOUT : EPOLLIN;
+    event.data.ptr = serial;
+    epoll_ctl(fd_poller, EPOLL_CTL_MOD, serial->getFd(), &event);
+#else
+    wakeup();
+#endif
+}
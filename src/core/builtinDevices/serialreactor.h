@@ -0,0 +1,61 @@
+//
+// serialreactor.h
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+
+#pragma once
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unordered_map>
+#include <exception>
+#include <cstdint>
+
+class PosixSerial;
+
+//============================================================================================
+// I/O reactor shared by all serial ports
+//    A single thread waits for events of every registered serial port, then dispatches them
+//    to the serial port object. epoll(7) is used on Linux, poll(2) is used on other systems.
+//    Unregistration is completed asynchronously. The serial port object is notified by
+//    PosixSerial::onClosed() on the reactor thread, after that the reactor never touches it.
+//============================================================================================
+class SerialReactor{
+public:
+    static constexpr uint32_t EVENT_READABLE = 1;
+    static constexpr uint32_t EVENT_WRITABLE = 2;
+    static constexpr uint32_t EVENT_ERROR = 4;
+
+protected:
+    std::mutex mutex;
+    std::thread reactor;
+    int fd_poller = -1;
+    int fd_wakeup_in = -1;
+    int fd_wakeup_out = -1;
+    bool should_be_stop = false;
+    bool is_wakeup_signaled = false;
+    std::unordered_map<PosixSerial*, bool> serials;
+    struct ClosedSerial{
+        PosixSerial* serial;
+        std::exception_ptr error;
+    };
+    std::vector<ClosedSerial> closed_serials;
+    char read_buf[4096];
+
+public:
+    SerialReactor();
+    SerialReactor(const SerialReactor&) = delete;
+    SerialReactor(SerialReactor&&) = delete;
+    ~SerialReactor();
+
+    void add(PosixSerial* serial, bool writable);
+    void remove(PosixSerial* serial, std::exception_ptr error = nullptr);
+    void setWritable(PosixSerial* serial, bool writable);
+
+protected:
+    void run();
+    void wakeup();
+    void clearWakeup();
+    void dispatch(PosixSerial* serial, uint32_t events);
+    void notifyClosedSerials();
+};
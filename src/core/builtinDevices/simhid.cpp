@@ -10,6 +10,13 @@
 #include "simhidconnection.h"
 #include "simhid.h"
 
+#if defined(_WIN64) || defined(_WIN32)
+#   include "winserial.h"
+#else
+#   include "posixserial.h"
+#   include "serialreactor.h"
+#endif
+
 //============================================================================================
 // SimHID connection holder object definition
 //============================================================================================
@@ -17,6 +24,11 @@ class SimHID{
 protected: 
     std::mutex mutex;
     FSMAPPER_HANDLE mapper;
+#if !defined(_WIN64) && !defined(_WIN32)
+    // all serial ports are handled by a reactor thread
+    // this must be destroyed after all connections are closed
+    SerialReactor reactor;
+#endif
     std::map<std::string, std::unique_ptr<SimHIDConnection> > connections;
     std::map<SimHIDConnection::Device*, SimHIDConnection::Device*> devices;
 
@@ -30,7 +42,7 @@ public:
     SimHIDConnection::Device* openDevice(FSMDEVICE dev_handle, std::string& devicePath){
         std::lock_guard lock(mutex);
         if (connections.count(devicePath) == 0){
-            auto connection = std::make_unique<SimHIDConnection>(mapper, *this, devicePath.c_str());
+            auto connection = std::make_unique<SimHIDConnection>(mapper, *this, devicePath.c_str(), createSerial(devicePath));
             connection->start();
             connections.insert(std::make_pair(devicePath, std::move(connection)));
         }
@@ -48,6 +60,15 @@ public:
             connections.erase(connection.getDevicePath());
         }
     };
+
+protected:
+    std::unique_ptr<SimHIDConnection::SerialComm> createSerial(const std::string& devicePath){
+#if defined(_WIN64) || defined(_WIN32)
+        return std::make_unique<WinSerial>(devicePath.c_str());
+#else
+        return std::make_unique<PosixSerial>(reactor, devicePath.c_str());
+#endif
+    };
 };
 
 //============================================================================================
@@ -6,18 +6,25 @@
 #include <chrono>
 #include <sstream>
 #include <format>
+#include <algorithm>
+#include <charconv>
+#include <utility>
+#include <thread>
 #include "simhidconnection.h"
 
-#if defined(_WIN64) || defined(_WIN32)
-#   include "winserial.h"
-    using SerialImp = WinSerial;
-#else
-#   include "posixserial.h"
-    using SerialImp = PosixSerial;
-#endif
-
 static constexpr auto INIT_TIMEOUT = std::chrono::milliseconds(600);
 
+//============================================================================================
+// Binary mode negotiation
+//    A device which supports binary mode reports "binary" in the "Protocols:" item of the
+//    I command response. Mapper requests to switch to binary mode by sending a B command
+//    after the D command response is completed, then the device acknowledges by a B line.
+//    Data sent by mapper after the B command and data sent by the device after the
+//    acknowledgement are binary frames defined in simhidparser.h.
+//============================================================================================
+static constexpr auto PROTOCOLS_KEY = "Protocols:";
+static constexpr auto BINARY_PROTOCOL = "binary";
+
 //============================================================================================
 //  Recognize device identifier then identify device path
 //============================================================================================
@@ -34,60 +41,33 @@ std::string SimHIDConnection::identifyDevicePath (LUAVALUE identifier){
 }
 
 //============================================================================================
-// Commnunication thread imprementation
+// Commnunication imprementation
 //============================================================================================
-SimHIDConnection::SimHIDConnection(FSMAPPER_HANDLE mapper, SimHID &simhid, const char *devicePath) : 
-    mapper(mapper), simhid(simhid), devicePath(devicePath), status(Status::init){
-    serial = std::move(std::make_unique<SerialImp>(devicePath));
+SimHIDConnection::SimHIDConnection(FSMAPPER_HANDLE mapper, SimHID &simhid, const char *devicePath, std::unique_ptr<SerialComm>&& serial) : 
+    mapper(mapper), simhid(simhid), devicePath(devicePath), status(Status::init), serial(std::move(serial)),
+    device_snapshot(new DeviceSnapshot){
     simhid_parser_init(&parser, parsedLineBuf, sizeof(parsedLineBuf));
+    simhid_frame_parser_init(&frame_parser);
+    this->serial->setUnitValueEncoder([this](const SimhidUnitValue* values, size_t num, std::string& buf){
+        encodeUnitValues(values, num, buf);
+    });
 }
 
 void SimHIDConnection::start(){
     //-----------------------------------------------------------------------------
-    // create a thread to communicate with SimHID devices
+    // start communication with SimHID devices
     //-----------------------------------------------------------------------------
-    communicator = std::move(std::thread([this] {
-        try{
-            // send a D command to retrieve device definitions at first
-            serial->write("\r\nI\r\nD\r\n");
-
-            char buf[256];
-            int readlen;
-            while((readlen = serial->read(buf, sizeof(buf))) >= 0){
-                for (int i = 0; i < readlen; i++){
-                    if (simhid_parser_parse(&parser, buf[i])){
-                        auto cmd = parser.command;
-                        if (parser.err){
-                            std::string msg = "An error occured during parse data received from SimHID device [";
-                            std::ostringstream mout(msg, std::ios_base::app);
-                            mout << this->devicePath << "]: " << parser.err;
-                            fsmapper_putLog(this->mapper, FSMLOG_WARNING, mout.str().c_str());
-                        }else if (cmd == 'I' || cmd == 'i'){
-                            processReceivedData_I();
-                        }else if (cmd == 'D' || cmd == 'd'){
-                            processReceivedData_D();
-                        }else if (cmd == 'S' || cmd == 's'){
-                            processReceivedData_S();
-                        }else if (cmd > 0){
-                            std::string msg = "Unexpected data was received from SimHID device [";
-                            std::ostringstream mout(msg, std::ios_base::app);
-                            mout << this->devicePath << "]";
-                            fsmapper_putLog(this->mapper, FSMLOG_WARNING, mout.str().c_str());
-                        }
-                    }
-                }
-            }
-        }catch (Exception& e){
-            fsmapper_putLog(this->mapper, FSMLOG_ERROR, e.getMessage().c_str());
-            fsmapper_abort(this->mapper);
-        }
-        std::lock_guard lock(mutex);
-        status = Status::stop;
-        cv.notify_all();
-    }));
+    serial->start(
+        [this](const char* data, int len){processReceivedData(data, len);},
+        [this](std::exception_ptr error){processClosed(error);}
+    );
+    is_started = true;
+
+    // send a D command to retrieve device definitions at first
+    serial->write("\r\nI\r\nD\r\n");
 
     //-----------------------------------------------------------------------------
-    // wait until communication thread is initializing
+    // wait until device definitions are received
     //-----------------------------------------------------------------------------
     std::unique_lock<std::mutex> lock(mutex);
     if (!cv.wait_for(lock, INIT_TIMEOUT, [this]{return status != Status::init;})){
@@ -100,6 +80,87 @@ void SimHIDConnection::start(){
     }
 }
 
+void SimHIDConnection::processReceivedData(const char* data, int len){
+    // remaining data is parsed as binary frames once a text parser handles a B line
+    received_values.clear();
+    for (int offset = 0; offset < len;){
+        if (binary_inbound){
+            offset += simhid_frame_parse_bulk(
+                &frame_parser, data + offset, len - offset, &SimHIDConnection::processReceivedFrame, this);
+        }else{
+            offset += simhid_parser_parse_bulk(
+                &parser, data + offset, len - offset, &SimHIDConnection::processParsedLine, this);
+        }
+        if (parser_exception){
+            std::rethrow_exception(std::exchange(parser_exception, nullptr));
+        }
+    }
+    raiseReceivedValues();
+}
+
+void SimHIDConnection::raiseReceivedValues(){
+    // unit values received in one read are raised at once for each device
+    if (received_values.empty()){
+        return;
+    }
+    is_reading_snapshot = true;
+    auto snapshot = device_snapshot.load();
+    for (auto device : *snapshot){
+        fsmapper_raiseEvents(mapper, device, received_values.data(), received_values.size());
+    }
+    snapshot_read_count++;
+    is_reading_snapshot = false;
+}
+
+void SimHIDConnection::processClosed(std::exception_ptr error){
+    if (error){
+        try{
+            std::rethrow_exception(error);
+        }catch (Exception& e){
+            fsmapper_putLog(mapper, FSMLOG_ERROR, e.getMessage().c_str());
+            fsmapper_abort(mapper);
+        }catch (std::exception& e){
+            fsmapper_putLog(mapper, FSMLOG_ERROR, e.what());
+            fsmapper_abort(mapper);
+        }
+    }
+    std::lock_guard lock(mutex);
+    status = Status::stop;
+    cv.notify_all();
+}
+
+bool SimHIDConnection::processParsedLine(SimhidParserCtx* ctx, void* context){
+    // exceptions must not be propagated across the C parser
+    auto self = reinterpret_cast<SimHIDConnection*>(context);
+    try{
+        auto cmd = ctx->command;
+        if (ctx->err){
+            std::string msg = "An error occured during parse data received from SimHID device [";
+            std::ostringstream mout(msg, std::ios_base::app);
+            mout << self->devicePath << "]: " << ctx->err;
+            fsmapper_putLog(self->mapper, FSMLOG_WARNING, mout.str().c_str());
+        }else if (cmd == 'I' || cmd == 'i'){
+            self->processReceivedData_I();
+        }else if (cmd == 'D' || cmd == 'd'){
+            self->processReceivedData_D();
+        }else if (cmd == 'S' || cmd == 's'){
+            self->processReceivedData_S();
+        }else if (cmd == 'B' || cmd == 'b'){
+            self->processReceivedData_B();
+            return !self->binary_inbound;
+        }else if (cmd > 0){
+            std::string msg = "Unexpected data was received from SimHID device [";
+            std::ostringstream mout(msg, std::ios_base::app);
+            mout << self->devicePath << "]";
+            fsmapper_putLog(self->mapper, FSMLOG_WARNING, mout.str().c_str());
+        }
+        return true;
+    }catch (...){
+        self->parser_exception = std::current_exception();
+        return false;
+    }
+}
+
 void SimHIDConnection::processReceivedData_I(){
     std::lock_guard lock(mutex);
 
@@ -145,6 +206,11 @@ void SimHIDConnection::processReceivedData_D(){
         msg << "Unexpected data was received from SimHID device[" << devicePath << "]";
         fsmapper_putLog(mapper, FSMLOG_WARNING, msg.str().c_str());
     }else if (parser.paramnum == 0){
+        defindex.build(defs);
+        if (isBinaryModeSupported()){
+            serial->write("B\r\n");
+            binary_outbound = true;
+        }
         status = Status::running;
         cv.notify_all();
         std::ostringstream msg;
@@ -185,33 +251,207 @@ void SimHIDConnection::processReceivedData_D(){
             if (def.maxval - def.minval == 1){
                 def.valtype = FSMDU_TYPE_BINARY;
             }
-            defindex[def.name] = def.index;
             defs.push_back(std::move(def));
         }
     }
 }
 
 void SimHIDConnection::processReceivedData_S(){
+    // this function is called for each unit value update, so memory should not be allocated
+    // except error reporting
     if (parser.paramnum != 2 || !parser.params[1].isNumber){
         std::ostringstream msg;
         msg << "Unit value update nortification format from SimHID device [" << devicePath;
         msg << "] cannot be recognized";
         fsmapper_putLog(mapper, FSMLOG_WARNING, msg.str().c_str());
+        return;
+    }
+    auto index = defindex.find({parser.params[0].strvalue, static_cast<size_t>(parser.params[0].len)});
+    if (!index){
+        auto msg = std::format("Unit value update nortification on unknown unit has been received.: [{}]", parser.params[0].strvalue);
+        fsmapper_putLog(mapper, FSMLOG_WARNING, msg.c_str());
+        return;
+    }
+    addReceivedValue(static_cast<int>(*index), parser.params[1].numvalue);
+}
+
+void SimHIDConnection::processReceivedData_B(){
+    // Process acknowledgement of B command
+    //     syntax: B
+    if (!binary_outbound || binary_inbound || parser.paramnum != 0){
+        std::ostringstream msg;
+        msg << "Unexpected data was received from SimHID device[" << devicePath << "]";
+        fsmapper_putLog(mapper, FSMLOG_WARNING, msg.str().c_str());
+        return;
     }
+    binary_inbound = true;
+    std::ostringstream msg;
+    msg << "SimHID device [" << devicePath << "] is communicating in binary mode";
+    fsmapper_putLog(mapper, FSMLOG_DEBUG, msg.str().c_str());
+}
+
+bool SimHIDConnection::processReceivedFrame(SimhidFrameParserCtx* ctx, const SimhidUnitValue* values, int num, void* context){
+    // exceptions must not be propagated across the C parser
+    auto self = reinterpret_cast<SimHIDConnection*>(context);
     try{
-        std::unique_lock lock(mutex);
-        auto index = defindex.at(parser.params[0].strvalue);
-        auto &def = defs[index];
-        auto value = parser.params[1].numvalue;
-        if (def.index >= 0){
-            for (const auto& device : devices){
-                fsmapper_raiseEvent(mapper, device.second->getDevice(), def.index, value);
+        if (ctx->err){
+            std::string msg = "An error occured during parse data received from SimHID device [";
+            std::ostringstream mout(msg, std::ios_base::app);
+            mout << self->devicePath << "]: " << ctx->err;
+            fsmapper_putLog(self->mapper, FSMLOG_WARNING, mout.str().c_str());
+            return true;
+        }
+        for (int i = 0; i < num; i++){
+            if (values[i].index < 0 || static_cast<size_t>(values[i].index) >= self->defs.size()){
+                auto msg = std::format("Unit value update nortification on unknown unit has been received.: [#{}]", values[i].index);
+                fsmapper_putLog(self->mapper, FSMLOG_WARNING, msg.c_str());
+                continue;
             }
+            self->addReceivedValue(values[i].index, values[i].value);
         }
-    }catch(std::out_of_range&){
-        auto msg = std::format("Unit value update nortification on unknown unit has been received.: [{}]", parser.params[0].strvalue);
-        fsmapper_putLog(mapper, FSMLOG_WARNING, msg.c_str());
+        return true;
+    }catch (...){
+        self->parser_exception = std::current_exception();
+        return false;
+    }
+}
+
+bool SimHIDConnection::isBinaryModeSupported(){
+    for (const auto& id : deviceid){
+        if (id.key == PROTOCOLS_KEY){
+            std::istringstream protocols(id.value);
+            std::string protocol;
+            while (protocols >> protocol){
+                if (protocol == BINARY_PROTOCOL){
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+//============================================================================================
+// Perfect hash table to resolve unit index from unit name
+//============================================================================================
+uint64_t SimHIDConnection::UnitNameTable::hash(std::string_view name){
+    // FNV-1a followed by finalizer of MurmurHash3 to spread entropy to all bits
+    uint64_t value = 0xcbf29ce484222325ull;
+    for (auto c : name){
+        value ^= static_cast<uint8_t>(c);
+        value *= 0x100000001b3ull;
+    }
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdull;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ull;
+    value ^= value >> 33;
+    return value;
+}
+
+void SimHIDConnection::UnitNameTable::build(const std::vector<UnitDef>& defs){
+    static constexpr uint32_t MAX_DISPLACEMENT = 1 << 16;
+
+    // same as std::map, the last definition is effective if there are duplicated names
+    std::map<std::string_view, size_t> keys;
+    for (const auto& def : defs){
+        keys[def.name] = def.index;
+    }
+    struct Key{
+        uint64_t hash;
+        std::string_view name;
+        size_t index;
+    };
+    size_t bucket_num = 1;
+    while (bucket_num * 2 < keys.size()){
+        bucket_num *= 2;
+    }
+    size_t slot_num = 1;
+    while (slot_num < keys.size() + keys.size() / 4){
+        slot_num *= 2;
+    }
+    std::vector<std::vector<Key>> buckets(bucket_num);
+    for (const auto& [name, index] : keys){
+        auto value = hash(name);
+        buckets[bucket_position(value) & (bucket_num - 1)].push_back({value, name, index});
+    }
+    std::vector<size_t> order(bucket_num);
+    for (size_t i = 0; i < bucket_num; i++){
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&buckets](size_t a, size_t b){
+        return buckets[a].size() > buckets[b].size();
+    });
+
+    // place larger buckets first, then grow the table if no displacement is found for a bucket
+    while (true){
+        std::vector<uint32_t> new_displacements(bucket_num, 0);
+        std::vector<bool> occupied(slot_num, false);
+        std::vector<uint64_t> positions;
+        auto succeeded = true;
+        for (auto bucket_index : order){
+            auto& bucket = buckets[bucket_index];
+            if (bucket.empty()){
+                break;
+            }
+            uint32_t displacement = 0;
+            for (; displacement < MAX_DISPLACEMENT; displacement++){
+                positions.clear();
+                for (const auto& key : bucket){
+                    auto position = slot_position(key.hash, displacement) & (slot_num - 1);
+                    if (occupied[position] || std::find(positions.begin(), positions.end(), position) != positions.end()){
+                        break;
+                    }
+                    positions.push_back(position);
+                }
+                if (positions.size() == bucket.size()){
+                    break;
+                }
+            }
+            if (displacement == MAX_DISPLACEMENT){
+                succeeded = false;
+                break;
+            }
+            new_displacements[bucket_index] = displacement;
+            for (auto position : positions){
+                occupied[position] = true;
+            }
+        }
+        if (succeeded){
+            displacements = std::move(new_displacements);
+            break;
+        }
+        if (slot_num > keys.size() * 64){
+            throw Exception("Failed to build unit name table for SimHID device");
+        }
+        slot_num *= 2;
+    }
+
+    slots.clear();
+    slots.resize(slot_num);
+    for (const auto& bucket : buckets){
+        for (const auto& key : bucket){
+            auto position = slot_position(key.hash, displacements[bucket_position(key.hash) & (bucket_num - 1)]) & (slot_num - 1);
+            auto& slot = slots[position];
+            slot.name = key.name;
+            slot.index = key.index;
+            slot.used = true;
+        }
+    }
+    bucket_mask = bucket_num - 1;
+    slot_mask = slot_num - 1;
+}
+
+std::optional<size_t> SimHIDConnection::UnitNameTable::find(std::string_view name) const{
+    if (slots.empty()){
+        return std::nullopt;
     }
+    auto value = hash(name);
+    auto& slot = slots[slot_position(value, displacements[bucket_position(value) & bucket_mask]) & slot_mask];
+    if (slot.used && slot.name == name){
+        return slot.index;
+    }
+    return std::nullopt;
 }
 
 //============================================================================================
@@ -219,23 +459,19 @@ void SimHIDConnection::processReceivedData_S(){
 //============================================================================================
 SimHIDConnection::~SimHIDConnection(){
     stop();
+    delete device_snapshot.load();
     std::ostringstream os;
     os << "SimHID deivice [" << devicePath << "] has been closed";
     fsmapper_putLog(mapper, FSMLOG_DEBUG, os.str().c_str());
 }
 
 void SimHIDConnection::stop(){
-    {
-        std::unique_lock<std::mutex> lock(mutex);
-        serial->stop();
-        cv.wait(lock, [this]{return status == Status::stop || status == Status::joined;});
-        if (status == Status::joined){
-            // unnecessory to join a commnunicator thrad
-            return;
-        }
-        status = Status::joined;
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!is_started){
+        return;
     }
-    communicator.join();
+    serial->stop();
+    cv.wait(lock, [this]{return status == Status::stop;});
 }
 
 //============================================================================================
@@ -256,26 +492,88 @@ void SimHIDConnection::getUnitDef(size_t index, FSMDEVUNITDEF *def){
 }
 
 void SimHIDConnection::sendUnitValue(size_t index, int value){
-    auto &unitdef = defs[index];
-    std::ostringstream cmd;
-    cmd << "S " << unitdef.name << " " << value << "\r\n";
-    serial->write(std::move(cmd.str()));
+    serial->writeUnitValue(index, value);
+}
+
+void SimHIDConnection::encodeUnitValues(const SimhidUnitValue* values, size_t num, std::string& buf){
+    // binary_outbound is never changed after the connection starts running
+    if (binary_outbound){
+        for (size_t i = 0; i < num; i += SIMHID_FRAME_MAX_PAIRS){
+            auto pairs = num - i < SIMHID_FRAME_MAX_PAIRS ? num - i : SIMHID_FRAME_MAX_PAIRS;
+            auto offset = buf.size();
+            buf.resize(offset + SIMHID_FRAME_MAX_LEN);
+            auto length = simhid_frame_encode(buf.data() + offset, SIMHID_FRAME_MAX_LEN, values + i, static_cast<int>(pairs));
+            buf.resize(offset + length);
+        }
+    }else{
+        for (size_t i = 0; i < num; i++){
+            char number[16];
+            auto result = std::to_chars(number, number + sizeof(number), values[i].value);
+            buf.append("S ").append(defs[values[i].index].name).append(" ").append(number, result.ptr).append("\r\n");
+        }
+    }
+}
+
+void SimHIDConnection::SerialComm::writeUnitValue(size_t index, int value){
+    SimhidUnitValue unit_value{static_cast<int>(index), value};
+    std::string data;
+    encoder(&unit_value, 1, data);
+    write(std::move(data));
 }
 
 //============================================================================================
 // Device associated connection operations
 //============================================================================================
 SimHIDConnection::Device *SimHIDConnection::addDevice(FSMDEVICE device){
-    std::lock_guard lock(mutex);
-    auto newdev = std::make_unique<Device>(*this, device);
-    auto key = newdev.get();
-    devices[key] = std::move(newdev);
+    Device* key;
+    std::unique_ptr<const DeviceSnapshot> old_snapshot;
+    {
+        std::lock_guard lock(mutex);
+        auto newdev = std::make_unique<Device>(*this, device);
+        key = newdev.get();
+        devices[key] = std::move(newdev);
+        old_snapshot.reset(publishDeviceSnapshot());
+    }
+    waitForSnapshotReaders();
     return key;
 }
 
 void SimHIDConnection::removeDevice(Device *device){
-    std::lock_guard lock(mutex);
-    devices.erase(device);
+    std::unique_ptr<Device> removed;
+    std::unique_ptr<const DeviceSnapshot> old_snapshot;
+    {
+        std::lock_guard lock(mutex);
+        auto item = devices.find(device);
+        if (item == devices.end()){
+            return;
+        }
+        removed = std::move(item->second);
+        devices.erase(item);
+        old_snapshot.reset(publishDeviceSnapshot());
+    }
+    waitForSnapshotReaders();
+}
+
+const SimHIDConnection::DeviceSnapshot* SimHIDConnection::publishDeviceSnapshot(){
+    // this function must be called with holding the mutex
+    auto snapshot = std::make_unique<DeviceSnapshot>();
+    snapshot->reserve(devices.size());
+    for (const auto& device : devices){
+        snapshot->push_back(device.second->getDevice());
+    }
+    return device_snapshot.exchange(snapshot.release());
+}
+
+void SimHIDConnection::waitForSnapshotReaders(){
+    // a reader which starts after publishing a new snapshot never refers the old one,
+    // so it's enough to wait for completion of the reader running at this moment
+    if (!is_reading_snapshot){
+        return;
+    }
+    auto count = snapshot_read_count.load();
+    while (is_reading_snapshot && snapshot_read_count == count){
+        std::this_thread::yield();
+    }
 }
 
 size_t SimHIDConnection::deviceNum(){
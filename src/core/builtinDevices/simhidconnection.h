@@ -7,9 +7,15 @@
 #include <string>
 #include <vector>
 #include <map>
-#include <thread>
+#include <memory>
 #include <mutex>
 #include <condition_variable>
+#include <functional>
+#include <optional>
+#include <string_view>
+#include <exception>
+#include <cstdint>
+#include <atomic>
 #include "mapperplugin.h"
 #include "simhidparser.h"
 
@@ -52,17 +58,32 @@ public:
     };
 
     class SerialComm{
+    public:
+        // append wire representation of unit values to the buffer
+        using UnitValueEncoder = std::function<void(const SimhidUnitValue* values, size_t num, std::string& buf)>;
+        // received data is passed to the receive handler, and the close handler is called once
+        // communication is stopped or fails
+        using ReceiveHandler = std::function<void(const char* data, int len)>;
+        using CloseHandler = std::function<void(std::exception_ptr error)>;
+
+    protected:
+        UnitValueEncoder encoder;
+
     public:
         virtual ~SerialComm() = default;
-        virtual int read(void* buf, int len) = 0;
+        virtual void start(ReceiveHandler&& receive, CloseHandler&& close) = 0;
         virtual void write(std::string&& data) = 0;
         virtual void stop() = 0;
+
+        // send a unit value which is encoded by the encoder
+        // implementation may drop superseded values of same unit and send the rest at once
+        virtual void writeUnitValue(size_t index, int value);
+        void setUnitValueEncoder(UnitValueEncoder&& encoder){this->encoder = std::move(encoder);};
     };
 
 protected:
     std::mutex mutex;
     std::condition_variable cv;
-    std::thread communicator;
     FSMAPPER_HANDLE mapper;
     SimHID& simhid;
     std::string devicePath;
@@ -70,8 +91,8 @@ protected:
         init,
         running,
         stop,
-        joined,
     } status;
+    bool is_started = false;
     std::unique_ptr<SerialComm> serial;
     struct DeviceId{
         std::string key;
@@ -93,15 +114,66 @@ protected:
         int maxval;
     };
     std::vector<UnitDef> defs;
-    std::map<std::string, size_t> defindex;
+
+    //----------------------------------------------------------------------------------------
+    // Perfect hash table to resolve unit index from unit name
+    //    Keys are hashed into buckets first, then each bucket has a displacement value which
+    //    is chosen so that every key is placed in a distinct slot. Lookup needs only one hash
+    //    calculation and one string comparison without memory allocation.
+    //----------------------------------------------------------------------------------------
+    class UnitNameTable{
+    protected:
+        struct Slot{
+            std::string name;
+            size_t index = 0;
+            bool used = false;
+        };
+        std::vector<uint32_t> displacements;
+        std::vector<Slot> slots;
+        uint64_t bucket_mask = 0;
+        uint64_t slot_mask = 0;
+
+    public:
+        void build(const std::vector<UnitDef>& defs);
+        std::optional<size_t> find(std::string_view name) const;
+
+    protected:
+        static uint64_t hash(std::string_view name);
+        static uint64_t bucket_position(uint64_t hash){
+            return (hash * 0x9e3779b97f4a7c15ull) >> 32;
+        }
+        static uint64_t slot_position(uint64_t hash, uint32_t displacement){
+            auto h1 = static_cast<uint32_t>(hash);
+            auto h2 = static_cast<uint32_t>(hash >> 32) | 1;
+            return static_cast<uint64_t>(h1 + displacement * h2);
+        }
+    };
+    UnitNameTable defindex;
+
     std::map<Device*, std::unique_ptr<Device> > devices;
+
+    //----------------------------------------------------------------------------------------
+    // Immutable snapshot of device handles to fan out unit values
+    //    The communication thread reads the snapshot without locking. Writers publish a new
+    //    snapshot under the mutex, then wait until no reader can refer the old one before
+    //    deleting it.
+    //----------------------------------------------------------------------------------------
+    using DeviceSnapshot = std::vector<FSMDEVICE>;
+    std::atomic<const DeviceSnapshot*> device_snapshot;
+    std::atomic<bool> is_reading_snapshot{false};
+    std::atomic<uint64_t> snapshot_read_count{0};
+    std::vector<FSMDEVUNITVALUE> received_values;
     SimhidParserCtx parser;
     char parsedLineBuf[256];
+    SimhidFrameParserCtx frame_parser;
+    bool binary_outbound = false;
+    bool binary_inbound = false;
+    std::exception_ptr parser_exception;
 
 public:
     static std::string identifyDevicePath(LUAVALUE identifier);
 
-    SimHIDConnection(FSMAPPER_HANDLE mapper, SimHID& simhid, const char* devicePath);
+    SimHIDConnection(FSMAPPER_HANDLE mapper, SimHID& simhid, const char* devicePath, std::unique_ptr<SerialComm>&& serial);
     SimHIDConnection() = delete;
     SimHIDConnection(const SimHIDConnection&) = delete;
     SimHIDConnection(SimHIDConnection&&) = delete;
@@ -123,7 +195,23 @@ public:
     size_t deviceNum();
 
 protected:
+    void processReceivedData(const char* data, int len);
+    void raiseReceivedValues();
+    void addReceivedValue(int index, int value){
+        auto& item = received_values.emplace_back();
+        item.index = index;
+        item.type = FSMDU_VALUE_INT;
+        item.value.intValue = value;
+    }
+    const DeviceSnapshot* publishDeviceSnapshot();
+    void waitForSnapshotReaders();
+    void processClosed(std::exception_ptr error);
+    static bool processParsedLine(SimhidParserCtx* ctx, void* context);
+    static bool processReceivedFrame(SimhidFrameParserCtx* ctx, const SimhidUnitValue* values, int num, void* context);
+    bool isBinaryModeSupported();
     void processReceivedData_I();
     void processReceivedData_D();
     void processReceivedData_S();
+    void processReceivedData_B();
+    void encodeUnitValues(const SimhidUnitValue* values, size_t num, std::string& buf);
 };
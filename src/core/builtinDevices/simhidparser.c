@@ -19,6 +19,8 @@ static const char* ERR_NOOPT = "unknown option name";
 static const char *ERR_INVBOOLOPT = "option value must be 0 or 1";
 static const char *ERR_INVINTOPT = "option value must be integer";
 static const char *ERR_TOOLONGOPT = "too long option value";
+static const char *ERR_FRAMELEN = "invalid length of binary frame";
+static const char *ERR_CHECKSUM = "checksum of binary frame mismatched";
 
 /*========================================================
  Command parser implementation
@@ -61,11 +63,12 @@ bool simhid_parser_parse(SimhidParserCtx *ctx, int c)
         ctx->err = NULL;
     }
 
-    if (ctx->parsedlen == ctx->linebuflen && ctx->phase != SIMHID_PARSE_SKIP){
+    /* characters are not stored while skipping a line or waiting LF, so the buffer never overflows */
+    if (ctx->parsedlen == ctx->linebuflen && ctx->phase != SIMHID_PARSE_SKIP && ctx->phase != SIMHID_PARSE_EOL){
         ctx->phase = SIMHID_PARSE_SKIP;
         ctx->err = ERR_TOOLONG;
     }
-    if (ctx->phase != SIMHID_PARSE_SKIP || ctx->phase != SIMHID_PARSE_EOL){
+    if (ctx->phase != SIMHID_PARSE_SKIP && ctx->phase != SIMHID_PARSE_EOL){
         ctx->linebuf[ctx->parsedlen++] = c;
     }
 
@@ -150,7 +153,7 @@ bool simhid_parser_parse(SimhidParserCtx *ctx, int c)
             param->len++;
             if (isNumeric(c)){
                 param->numvalue *= 10;
-                param->numvalue += param->numvalue > 0 ? 
+                param->numvalue += param->strvalue[0] != '-' ?
                                    c - '0' : -(c - '0');
             }else{
                 ctx->phase = SIMHID_PARSE_STRING;
@@ -195,3 +198,258 @@ bool simhid_parser_parse(SimhidParserCtx *ctx, int c)
 
     return rc;
 }
+
+/*========================================================
+ Bulk command parser implementation
+========================================================*/
+static void reset_context(SimhidParserCtx *ctx)
+{
+    ctx->phase = SIMHID_PARSE_INIT;
+    ctx->parsedlen = 0;
+    ctx->paramnum = 0;
+    ctx->command = -1;
+    ctx->err = NULL;
+}
+
+static void tokenize_line(SimhidParserCtx *ctx)
+{
+    char *ptr = ctx->linebuf;
+    char *end = ctx->linebuf + ctx->parsedlen;
+
+    /* line must be terminated by CR LF, and CR must not appear in the line */
+    if (end == ptr || end[-1] != '\r'){
+        ctx->err = ERR_SYNTAX;
+        return;
+    }
+    *--end = '\0';
+
+    while (ptr < end && isSeparator(*ptr)){
+        ptr++;
+    }
+    if (ptr == end){
+        /* empty line */
+        return;
+    }
+    if (!isCommand(*ptr)){
+        ctx->err = ERR_SYNTAX;
+        return;
+    }
+    ctx->command = *ptr++;
+    if (ptr < end && !isSeparator(*ptr)){
+        ctx->err = ERR_SYNTAX;
+        return;
+    }
+
+    while (true){
+        while (ptr < end && isSeparator(*ptr)){
+            ptr++;
+        }
+        if (ptr == end){
+            break;
+        }
+        if (ctx->paramnum >= COMMAND_MAX_PARAM){
+            ctx->err = ERR_TOOMANYPARAM;
+            return;
+        }
+        SimhidCommandParam *param = ctx->params + ctx->paramnum++;
+        param->strvalue = ptr;
+
+        /* numeric value is evaluated while scanning the token */
+        bool negative = *ptr == '-';
+        ptr += negative;
+        const char *digits = ptr;
+        int value = 0;
+        for (; ptr < end && isNumeric(*ptr); ptr++){
+            value = value * 10 + (*ptr - '0');
+        }
+        param->isNumber = ptr > digits;
+        param->numvalue = negative ? -value : value;
+        for (; ptr < end && !isSeparator(*ptr); ptr++){
+            if (*ptr == '\r'){
+                ctx->err = ERR_SYNTAX;
+                return;
+            }
+            param->isNumber = false;
+        }
+
+        param->len = (int)(ptr - param->strvalue);
+        if (ptr < end){
+            *ptr++ = '\0';
+        }
+    }
+}
+
+int simhid_parser_parse_bulk(SimhidParserCtx *ctx, const char *data, int len,
+                             SimhidLineHandler handler, void *context)
+{
+    const char *ptr = data;
+    const char *end = data + len;
+
+    if (ctx->phase == SIMHID_PARSE_END){
+        reset_context(ctx);
+    }
+
+    while (ptr < end){
+        const char *eol = (const char *)memchr(ptr, '\n', end - ptr);
+        int chunklen = (int)((eol ? eol : end) - ptr);
+
+        /* accumulate a fragment of line until LF is found */
+        if (ctx->phase != SIMHID_PARSE_SKIP){
+            if (chunklen > ctx->linebuflen - ctx->parsedlen){
+                ctx->phase = SIMHID_PARSE_SKIP;
+                ctx->err = ERR_TOOLONG;
+            }else{
+                memcpy(ctx->linebuf + ctx->parsedlen, ptr, chunklen);
+                ctx->parsedlen += chunklen;
+            }
+        }
+        if (!eol){
+            ptr = end;
+            break;
+        }
+        ptr = eol + 1;
+
+        if (ctx->phase != SIMHID_PARSE_SKIP){
+            tokenize_line(ctx);
+        }
+        ctx->phase = SIMHID_PARSE_END;
+        if (!handler(ctx, context)){
+            break;
+        }
+        reset_context(ctx);
+    }
+
+    return (int)(ptr - data);
+}
+
+/*========================================================
+ Binary frame implementation
+========================================================*/
+void simhid_frame_parser_init(SimhidFrameParserCtx *ctx)
+{
+    ctx->phase = SIMHID_FRAME_SOF_WAIT;
+    ctx->payloadlen = 0;
+    ctx->receivedlen = 0;
+    ctx->sum = 0;
+    ctx->err = NULL;
+}
+
+static int decode_payload(SimhidFrameParserCtx *ctx)
+{
+    const unsigned char *ptr = ctx->payload;
+    int num = ctx->payloadlen / SIMHID_FRAME_PAIR_LEN;
+    for (int i = 0; i < num; i++, ptr += SIMHID_FRAME_PAIR_LEN){
+        ctx->values[i].index = ptr[0] | (ptr[1] << 8);
+        ctx->values[i].value = (int)((unsigned int)ptr[2] | ((unsigned int)ptr[3] << 8) |
+                                     ((unsigned int)ptr[4] << 16) | ((unsigned int)ptr[5] << 24));
+    }
+    return num;
+}
+
+int simhid_frame_parse_bulk(SimhidFrameParserCtx *ctx, const char *data, int len,
+                            SimhidFrameHandler handler, void *context)
+{
+    const unsigned char *ptr = (const unsigned char *)data;
+    const unsigned char *end = ptr + len;
+
+    while (ptr < end){
+        switch (ctx->phase){
+        case SIMHID_FRAME_SOF_WAIT:{
+            const unsigned char *sof = (const unsigned char *)memchr(ptr, SIMHID_FRAME_SOF, end - ptr);
+            if (!sof){
+                ptr = end;
+                break;
+            }
+            ptr = sof + 1;
+            ctx->phase = SIMHID_FRAME_LENGTH_LOW;
+            break;
+        }
+        case SIMHID_FRAME_LENGTH_LOW:{
+            ctx->payloadlen = *ptr;
+            ctx->sum = *ptr++;
+            ctx->phase = SIMHID_FRAME_LENGTH_HIGH;
+            break;
+        }
+        case SIMHID_FRAME_LENGTH_HIGH:{
+            ctx->payloadlen |= *ptr << 8;
+            ctx->sum += *ptr++;
+            ctx->receivedlen = 0;
+            if (ctx->payloadlen > SIMHID_FRAME_MAX_PAYLOAD || ctx->payloadlen % SIMHID_FRAME_PAIR_LEN != 0){
+                ctx->err = ERR_FRAMELEN;
+                ctx->phase = SIMHID_FRAME_SOF_WAIT;
+                bool rc = handler(ctx, ctx->values, 0, context);
+                ctx->err = NULL;
+                if (!rc){
+                    return (int)(ptr - (const unsigned char *)data);
+                }
+            }else{
+                ctx->phase = ctx->payloadlen > 0 ? SIMHID_FRAME_PAYLOAD : SIMHID_FRAME_CHECKSUM;
+            }
+            break;
+        }
+        case SIMHID_FRAME_PAYLOAD:{
+            int chunklen = ctx->payloadlen - ctx->receivedlen;
+            if (chunklen > end - ptr){
+                chunklen = (int)(end - ptr);
+            }
+            memcpy(ctx->payload + ctx->receivedlen, ptr, chunklen);
+            for (int i = 0; i < chunklen; i++){
+                ctx->sum += ptr[i];
+            }
+            ctx->receivedlen += chunklen;
+            ptr += chunklen;
+            if (ctx->receivedlen == ctx->payloadlen){
+                ctx->phase = SIMHID_FRAME_CHECKSUM;
+            }
+            break;
+        }
+        case SIMHID_FRAME_CHECKSUM:{
+            unsigned char sum = ctx->sum + *ptr++;
+            int num = 0;
+            ctx->phase = SIMHID_FRAME_SOF_WAIT;
+            if (sum != 0){
+                ctx->err = ERR_CHECKSUM;
+            }else{
+                num = decode_payload(ctx);
+            }
+            bool rc = handler(ctx, ctx->values, num, context);
+            ctx->err = NULL;
+            if (!rc){
+                return (int)(ptr - (const unsigned char *)data);
+            }
+            break;
+        }
+        }
+    }
+
+    return len;
+}
+
+int simhid_frame_encode(char *buf, int len, const SimhidUnitValue *values, int num)
+{
+    unsigned char *ptr = (unsigned char *)buf;
+    int payloadlen = num * SIMHID_FRAME_PAIR_LEN;
+    unsigned char sum = 0;
+
+    if (num > SIMHID_FRAME_MAX_PAIRS || len < SIMHID_FRAME_HEADER_LEN + payloadlen + SIMHID_FRAME_TRAILER_LEN){
+        return -1;
+    }
+    *ptr++ = SIMHID_FRAME_SOF;
+    *ptr++ = (unsigned char)payloadlen;
+    *ptr++ = (unsigned char)(payloadlen >> 8);
+    for (int i = 0; i < num; i++){
+        unsigned int index = (unsigned int)values[i].index;
+        unsigned int value = (unsigned int)values[i].value;
+        *ptr++ = (unsigned char)index;
+        *ptr++ = (unsigned char)(index >> 8);
+        *ptr++ = (unsigned char)value;
+        *ptr++ = (unsigned char)(value >> 8);
+        *ptr++ = (unsigned char)(value >> 16);
+        *ptr++ = (unsigned char)(value >> 24);
+    }
+    for (unsigned char *p = (unsigned char *)buf + 1; p < ptr; p++){
+        sum += *p;
+    }
+    *ptr++ = (unsigned char)(0x100 - sum);
+    return (int)(ptr - (unsigned char *)buf);
+}
@@ -50,6 +50,68 @@ typedef struct{
 void simhid_parser_init(SimhidParserCtx* ctx, char* buf, int len);
 bool simhid_parser_parse(SimhidParserCtx* ctx, int c);
 
+/*========================================================
+ Bulk command parser
+   Whole received data is split into lines by memchr(),
+   then each line is tokenized at once. The handler is
+   called each time a line is parsed with same context
+   as simhid_parser_parse() returns true. Parsing stops
+   if the handler returns false.
+   The return value is the number of consumed bytes.
+   A context must not be shared with simhid_parser_parse().
+========================================================*/
+typedef bool (*SimhidLineHandler)(SimhidParserCtx* ctx, void* context);
+int simhid_parser_parse_bulk(SimhidParserCtx* ctx, const char* data, int len,
+                             SimhidLineHandler handler, void* context);
+
+/*========================================================
+ Binary frame
+   frame:    SOF (0xA5) | payload length (u16) | payload |
+             checksum (u8)
+   payload:  array of unit index (u16) and value (i32)
+   checksum: two's complement of sum of payload length
+             and payload bytes
+   Multibyte integers are represented in little endian.
+========================================================*/
+#define SIMHID_FRAME_SOF 0xa5
+#define SIMHID_FRAME_HEADER_LEN 3
+#define SIMHID_FRAME_TRAILER_LEN 1
+#define SIMHID_FRAME_PAIR_LEN 6
+#define SIMHID_FRAME_MAX_PAIRS 64
+#define SIMHID_FRAME_MAX_PAYLOAD (SIMHID_FRAME_PAIR_LEN * SIMHID_FRAME_MAX_PAIRS)
+#define SIMHID_FRAME_MAX_LEN (SIMHID_FRAME_HEADER_LEN + SIMHID_FRAME_MAX_PAYLOAD + SIMHID_FRAME_TRAILER_LEN)
+
+typedef struct{
+    int index;
+    int value;
+} SimhidUnitValue;
+
+typedef enum{
+    SIMHID_FRAME_SOF_WAIT = 0,
+    SIMHID_FRAME_LENGTH_LOW,
+    SIMHID_FRAME_LENGTH_HIGH,
+    SIMHID_FRAME_PAYLOAD,
+    SIMHID_FRAME_CHECKSUM,
+} SIMHID_FRAMEPARSE_PHASE;
+
+typedef struct{
+    SIMHID_FRAMEPARSE_PHASE phase;
+    int payloadlen;
+    int receivedlen;
+    unsigned char sum;
+    unsigned char payload[SIMHID_FRAME_MAX_PAYLOAD];
+    SimhidUnitValue values[SIMHID_FRAME_MAX_PAIRS];
+    const char* err;
+} SimhidFrameParserCtx;
+
+/* the handler is called with num = 0 and err if a broken frame is received */
+typedef bool (*SimhidFrameHandler)(SimhidFrameParserCtx* ctx, const SimhidUnitValue* values, int num, void* context);
+
+void simhid_frame_parser_init(SimhidFrameParserCtx* ctx);
+int simhid_frame_parse_bulk(SimhidFrameParserCtx* ctx, const char* data, int len,
+                            SimhidFrameHandler handler, void* context);
+int simhid_frame_encode(char* buf, int len, const SimhidUnitValue* values, int num);
+
 #ifdef __cplusplus
 }
 #endif
@@ -54,8 +54,28 @@ WinSerial::WinSerial(const char* path): path(path), should_be_stop(false), is_wr
 
 WinSerial::~WinSerial(){
     stop();
+    if (communicator.joinable()){
+        communicator.join();
+    }
 };
 
+void WinSerial::start(ReceiveHandler&& receive, CloseHandler&& close){
+    // each COM port has a dedicated thread since overlapped I/O is waited by WaitForMultipleObjects()
+    communicator = std::thread([this, receive = std::move(receive), close = std::move(close)]{
+        std::exception_ptr error;
+        try{
+            char buf[1024];
+            int readlen;
+            while ((readlen = read(buf, sizeof(buf))) >= 0){
+                receive(buf, readlen);
+            }
+        }catch (...){
+            error = std::current_exception();
+        }
+        close(error);
+    });
+}
+
 int WinSerial::read(void* buf, int len){
     OVERLAPPED ov_read = {0};
     ov_read.hEvent = event_read;
@@ -67,7 +87,7 @@ int WinSerial::read(void* buf, int len){
             throw SimHIDConnection::Exception(os.str());
         }
     }else{
-        return read_size;
+        return read_size + readQueuedData(static_cast<char*>(buf) + read_size, len - read_size);
     }
 
     std::unique_lock lock(mutex);
@@ -110,7 +130,7 @@ int WinSerial::read(void* buf, int len){
                 os << "An error occurred when receiving data from COM port: " << path;
                 throw SimHIDConnection::Exception(os.str());
             }
-            return read_size;
+            return read_size + readQueuedData(static_cast<char*>(buf) + read_size, len - read_size);
         }else if (signaled_event == EVIX_WRITE){
             ::ResetEvent(event_write);
             DWORD written;
@@ -133,6 +153,29 @@ int WinSerial::read(void* buf, int len){
     }
 }
 
+int WinSerial::readQueuedData(char* buf, int len){
+    // ReadFile() for the first byte is used to wait until data arrives,
+    // then data remaining in the input queue is read at once
+    DWORD errors;
+    COMSTAT stat;
+    if (len <= 0 || !::ClearCommError(serial, &errors, &stat) || stat.cbInQue == 0){
+        return 0;
+    }
+    OVERLAPPED ov_queued = {0};
+    ov_queued.hEvent = event_read;
+    DWORD read_size = 0;
+    auto size = stat.cbInQue < static_cast<DWORD>(len) ? stat.cbInQue : static_cast<DWORD>(len);
+    if (!::ReadFile(serial, buf, size, &read_size, &ov_queued)){
+        if (::GetLastError() != ERROR_IO_PENDING || !::GetOverlappedResult(serial, &ov_queued, &read_size, true)){
+            std::ostringstream os;
+            os << "An error occurred when receiving data from COM port: " << path;
+            throw SimHIDConnection::Exception(os.str());
+        }
+        ::ResetEvent(event_read);
+    }
+    return read_size;
+}
+
 void WinSerial::write(std::string&& data){
     std::lock_guard lock(mutex);
     write_buf.push(std::move(data));
@@ -6,6 +6,7 @@
 #pragma once
 #include <windows.h>
 #include <queue>
+#include <thread>
 #include "simhidconnection.h"
 #include "tools.h"
 
@@ -13,6 +14,7 @@ class WinSerial : public SimHIDConnection::SerialComm{
 protected:
     std::string path;
     std::mutex mutex;
+    std::thread communicator;
     bool should_be_stop;
     bool is_writing;
     std::queue<std::string>write_buf;
@@ -29,7 +31,11 @@ public:
     WinSerial(WinSerial&&) = delete;
     WinSerial(const char* path);
     virtual ~WinSerial();
-    virtual int read(void* buf, int len);
+    virtual void start(ReceiveHandler&& receive, CloseHandler&& close);
     virtual void write(std::string&& data);
     virtual void stop();
+
+protected:
+    int read(void* buf, int len);
+    int readQueuedData(char* buf, int len);
 };
@@ -25,6 +25,7 @@
 //      V: notify DCS World version
 //      A: change aircraft event
 //      O: change observed data value event
+//      B: change observed data values event in bulk
 //
 
 #include <WinSock2.h>
@@ -35,12 +36,13 @@
 #include <algorithm>
 #include <stdlib.h>
 #include "dcs.h"
+#include "dcsprotocol.h"
+#include "dcsconnection.h"
+#include "dcswintransport.h"
 #include "engine.h"
 #include "tools.h"
 #include "lua51checker.hpp"
 
-static constexpr auto connecting_interval = 1000; // in milli second
-
 //============================================================================================
 // Exporter configuration loader
 //============================================================================================
@@ -88,299 +90,13 @@ struct ExporterConfig{
     }
 };
 
-//============================================================================================
-// Client socket abstraction
-//============================================================================================
-class client_socket{
-    SOCKET sock{INVALID_SOCKET};
-    sockaddr_in server_addr;
-    WSAEVENT event{WSA_INVALID_EVENT};
-
-public:
-    client_socket() = delete;
-    client_socket(const client_socket&) = delete;
-    client_socket(client_socket&&) = delete;
-    client_socket(u_short port){
-        event = ::WSACreateEvent();
-
-        addrinfo hint;
-        ZeroMemory(&hint, sizeof(hint));
-        hint.ai_family =AF_INET;
-        hint.ai_socktype = SOCK_DGRAM;
-        hint.ai_protocol = IPPROTO_TCP;
-        std::ostringstream os;
-        os << port;
-        addrinfo *addrs;
-        if (getaddrinfo("localhost", os.str().c_str(), &hint, &addrs) == 0 && addrs[0].ai_family == AF_INET){
-            server_addr = *reinterpret_cast<sockaddr_in*>(addrs[0].ai_addr);
-        }else{
-            server_addr.sin_family = AF_INET;
-            server_addr.sin_addr.S_un.S_un_b.s_b1 = 127;
-            server_addr.sin_addr.S_un.S_un_b.s_b2 = 0;
-            server_addr.sin_addr.S_un.S_un_b.s_b3 = 0;
-            server_addr.sin_addr.S_un.S_un_b.s_b4 = 1;
-            server_addr.sin_port = htons(port);
-        }
-
-        open();
-    }
-    ~client_socket(){
-        close();
-        WSACloseEvent(event);
-    }
-
-    void open(){
-        sock = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-        u_long nonblocking = 1;
-        ::ioctlsocket(sock, FIONBIO, &nonblocking);
-        WSAEventSelect(sock, event, FD_CONNECT);
-    }
-
-    void close(){
-        if (sock != INVALID_SOCKET){
-            closesocket(sock);
-            sock = INVALID_SOCKET;
-        }
-    }
-
-    void reopen(){
-        close();
-        open();
-    }
-
-    WSAEVENT get_event()const {return event;}
-    DWORD get_socket_error() const {
-        DWORD error{0};
-        int error_len = sizeof(error);
-        getsockopt(sock, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &error_len);
-        return error;
-    }
-
-    int connect(){
-        WSAEventSelect(sock, event, FD_CONNECT);
-        return ::connect(sock, reinterpret_cast<sockaddr*>(&server_addr), sizeof(server_addr));
-    }
-
-    void event_select(long event_flags){
-        WSAEventSelect(sock, event, event_flags);
-    }
-
-    DWORD get_network_event(){
-        WSANETWORKEVENTS nevent;
-        WSAEnumNetworkEvents(sock, event, &nevent);
-        return nevent.lNetworkEvents;
-    }
-
-    int receive(void* buf, int len){
-        return ::recv(sock, reinterpret_cast<char*>(buf), len, 0);
-    }
-
-    int send(const void* buf, int len){
-        return ::send(sock, reinterpret_cast<const char*>(buf), len, 0);
-    }
-};
-
-//============================================================================================
-// Transmit buffer
-//============================================================================================
-class DCSWorldSendBuffer{
-    static constexpr auto block_size = 32 * 1024;
-    static constexpr auto initial_num_of_blocks = 2;
-
-    struct buff_block {
-        std::vector<char> buff;
-        size_t used{0};
-        buff_block(){
-            buff.resize(block_size);
-        }
-        operator char* () {
-            return &buff.at(0);
-        }
-        size_t remain() {
-            return buff.size() - used;
-        }
-    };
-
-    using buff_blocks_type = std::list<std::shared_ptr<buff_block>>;
-    using buff_block_ptr = std::shared_ptr<buff_block>;
-
-    std::mutex mutex;
-    bool is_enable{false};
-    buff_blocks_type buff_blocks;
-    buff_blocks_type::iterator current;
-    buff_block_ptr writing{nullptr};
-    size_t written{0};
-
-public:
-    DCSWorldSendBuffer(){
-        for (auto i = 0; i < initial_num_of_blocks; i++){
-            buff_blocks.emplace_back(std::make_shared<buff_block>());
-        }
-        current = buff_blocks.begin();
-    }
-
-    bool is_empty(){
-        std::lock_guard lock{mutex};
-        return !writing && buff_blocks.begin()->operator*().used == 0;
-    }
-
-    void reset(bool mode){
-        std::lock_guard lock{mutex};
-        is_enable = mode;
-        if (is_enable){
-            if (writing){
-                buff_blocks.push_back(writing);
-                writing = nullptr;
-            }
-            for (auto& block : buff_blocks){
-                block->used = 0;
-            }
-            current = buff_blocks.begin();
-            written = 0;
-        }
-    }
-
-    struct data_block{
-        char* buff{nullptr};
-        size_t size{0};
-    };
-    data_block get_writable_data(){
-        std::lock_guard lock(mutex);
-        if (!writing){
-            if (buff_blocks.begin()->operator*().used == 0){
-                return {};
-            }
-            if (current == buff_blocks.begin()){
-                current++;
-            }
-            writing = *buff_blocks.begin();
-            written = 0;
-            buff_blocks.pop_front();
-        }
-        return {&writing->buff.at(0) + written, writing->used - written};
-    }
-
-    void trim(size_t size){
-        std::lock_guard lock(mutex);
-        if (!writing || size > writing->used - written){
-            abort();
-        }
-        written += size;
-        if (written >= writing->used){
-            writing->used = 0;
-            buff_blocks.push_back(writing);
-            writing = nullptr;
-        }
-    }
-
-    bool insert_data(const void* data, size_t size){
-        std::lock_guard lock(mutex);
-        if (!is_enable){
-            return false;
-        }
-        return insert_data_without_lock(data, size);
-    }
-
-    bool insert_data_without_lock(const void* data, size_t size){
-        auto rc = !writing && buff_blocks.begin()->operator*().used == 0;
-        while (size){
-            if (current->operator*().remain() == 0){
-                current++;
-                if (current == buff_blocks.end()){
-                    buff_blocks.emplace_back(std::make_shared<buff_block>());
-                    current--;
-                }
-            }
-            auto current_buf = current->operator->();
-            auto write_size = std::min(size, current_buf->remain());
-            memcpy(*current_buf + current_buf->used, data, write_size);
-            current_buf->used += write_size;
-            size -= write_size;
-        }
-        return rc;
-    }
-
-    std::unique_lock<std::mutex> get_lock(){
-        return std::unique_lock(mutex);
-    }
-};
-
-using command_header = int32_t;
-constexpr int32_t make_command_header(uint8_t command, int32_t length){
-    return length << 8 | command;
-}
-
-//============================================================================================
-// Received packet
-//============================================================================================
-class DCSPacket{
-    char holding_buf[4];
-    size_t holding_size{0};
-    char cmd{'\0'};
-    size_t data_length{0};
-    std::vector<char> data_buf;
-    size_t effective_length{0};
-public:
-    static constexpr auto command_length = 4;
-    DCSPacket(){
-        data_buf.resize(256);
-    }
-    
-    char get_command()const{return cmd;}
-    size_t get_data_length()const{return data_length;}
-    size_t get_effective_length()const{return effective_length;}
-    const char* get_data()const{return &data_buf.at(0);}
-    operator const char* ()const{return get_data();}
-    operator bool ()const{return holding_size == sizeof(holding_buf) && data_length == effective_length;}
-
-    size_t append_data(const char* in, size_t length){
-        auto skip_len{0};
-        if (holding_size < sizeof(holding_buf)){
-            skip_len = std::min(sizeof(holding_buf) - holding_size, length);
-            memcpy(holding_buf + holding_size, in, skip_len);
-            holding_size += skip_len;
-            if (holding_size < sizeof(holding_buf)){
-                return skip_len;
-            }
-            set_command();
-            length -= skip_len;
-        }
-        length = std::min(length, data_length - effective_length);
-        memcpy(&data_buf.at(0), in + skip_len, length);
-        effective_length += length;
-        return length + skip_len;
-    }
-
-    void clear(){
-        holding_size = 0;
-        cmd = '\0';
-        data_length = 0;
-        effective_length = 0;
-    }
-    
-protected:
-    void set_command(){
-        cmd = holding_buf[0];
-        union {int32_t i; char c[4];} length;
-        length.i = 0;
-        length.c[0] = holding_buf[1];
-        length.c[1] = holding_buf[2];
-        length.c[2] = holding_buf[3];
-        data_length = length.i;
-        effective_length = 0;
-        if (data_length > data_buf.size()){
-            data_buf.resize((data_length / 512 + 1) * 512);
-        }
-    }
-};
-
 //============================================================================================
 // Communicator with DCS World exportor
 //============================================================================================
 static DCSWorld* the_manager {nullptr};
 DCSWorld::DCSWorld(SimHostManager &manager, int id): SimHostManager::Simulator(manager, id){
-    schedule_event = ::WSACreateEvent();
     tx_buf = std::make_unique<DCSWorldSendBuffer>();
+    connection = std::make_unique<DCSConnection>(mutex, std::make_unique<DCSWinTransport>(), *tx_buf);
 
     scheduler = std::thread([this]{
         ExporterConfig config;
@@ -397,97 +113,23 @@ DCSWorld::DCSWorld(SimHostManager &manager, int id): SimHostManager::Simulator(m
         }
 
         std::unique_lock lock{mutex};
-        client_socket client(config.tcp_port);
-        DCSPacket rx_packet;
-        WSAEVENT events[] {schedule_event, client.get_event()};
-        auto event_num{1};
-        auto timeout{0};
-        auto write_is_blocked{false};
-        auto on_close = [&]{
-            status = STATUS::connecting;
-            is_active = false;
-            aircraft_name.clear();
-            rx_packet.clear();
-            client.reopen();
-            tx_buf->reset(false);
-            lock.unlock();
-            reportConnectivity(false, MAPPER_SIM_NONE, nullptr, nullptr);
-            lock.lock();
-        };
-
-        while (true){
-            if (status == STATUS::connected){
-                if (!tx_buf->is_empty() && !write_is_blocked){
-                    auto data = tx_buf->get_writable_data();
-                    client.event_select(FD_READ | FD_CLOSE | FD_WRITE);
-                    auto written = client.send(data.buff, data.size);
-                    if (written == SOCKET_ERROR){
-                        if (WSAGetLastError() == EWOULDBLOCK){
-                            write_is_blocked = true;
-                        }else{
-                            mapper_EngineInstance()->putLog(MCONSOLE_DEBUG, "dcs: An error occurred while communicating with DCS World: send()");
-                            on_close();
-                        }
-                    }else{
-                        tx_buf->trim(written);
-                        client.event_select(FD_READ | FD_CLOSE);
-                    }
-                    continue;
-                }
-                event_num = 2;
-                timeout = WSA_INFINITE;
-            }else if (status == STATUS::connecting){
-                client.connect();
-                event_num = 2;
-                timeout = WSA_INFINITE;
-            }else if (status == STATUS::retrying){
-                event_num =1;
-                timeout = connecting_interval;
+        connection->run(lock, config.tcp_port, [this](auto& lock, auto& packet){
+            dispatch_received_command(lock, packet);
+        }, [this](auto& lock, bool connected){
+            if (!connected){
+                is_active = false;
+                aircraft_name.clear();
             }
             lock.unlock();
-            auto index = ::WSAWaitForMultipleEvents(event_num, events, false, timeout, false);
-            lock.lock();
-            if (should_stop){
-                break;
-            }
-            if (index == WSA_WAIT_TIMEOUT){
-                status = STATUS::connecting;
-            }else if (index >= WSA_WAIT_EVENT_0 && index < WSA_WAIT_EVENT_0 + event_num){
-                if (index == 0){
-                    // process requests
-                    ::ResetEvent(events[index - WSA_WAIT_EVENT_0]);
-                }else if (status == STATUS::connected){
-                    auto nevent = client.get_network_event();
-                    if (nevent & FD_WRITE){
-                        write_is_blocked = false;
-                    }
-                    if (nevent & (FD_READ | FD_CLOSE)){
-                        auto received = client.receive(rx_buf, sizeof(rx_buf));
-                        if (received > 0){
-                            process_received_data(lock, rx_buf, received, rx_packet);
-                        }else if (received == 0){
-                            mapper_EngineInstance()->putLog(MCONSOLE_DEBUG, "dcs: connection with DCS World exporter has been closed");
-                            on_close();
-                        }else{
-                            mapper_EngineInstance()->putLog(MCONSOLE_DEBUG, "dcs: An error occurred while communicating with DCS World: recv()");
-                            on_close();
-                        }
-                    }
-                }else if (status == STATUS::connecting){
-                    if (client.get_socket_error() == 0){
-                        status = STATUS::connected;
-                        tx_buf->reset(true);
-                        client.event_select(FD_READ | FD_CLOSE);
-                        mapper_EngineInstance()->putLog(MCONSOLE_DEBUG, "dcs: connection with DCS World exporter has been established");
-                        lock.unlock();
-                        reportConnectivity(true, MAPPER_SIM_DCS, "dcs", nullptr);
-                        lock.lock();
-                    }else{
-                        status = STATUS::retrying;
-                    }
-                }
+            if (connected){
+                reportConnectivity(true, MAPPER_SIM_DCS, "dcs", nullptr);
+            }else{
+                reportConnectivity(false, MAPPER_SIM_NONE, nullptr, nullptr);
             }
-        }
+            lock.lock();
+        }, [](const char* msg){
+            mapper_EngineInstance()->putLog(MCONSOLE_DEBUG, msg);
+        });
     });
     
     the_manager = this;
@@ -496,29 +138,15 @@ DCSWorld::DCSWorld(SimHostManager &manager, int id): SimHostManager::Simulator(m
 DCSWorld::~DCSWorld(){
     {
         std::lock_guard lock{mutex};
-        should_stop = true;
-        ::SetEvent(schedule_event);
+        connection->stop();
     }
     scheduler.join();
-    WSACloseEvent(schedule_event);
     the_manager = nullptr;
 }
 
 //============================================================================================
 // Processing received data from DCS exporter
 //============================================================================================
-size_t DCSWorld::process_received_data(std::unique_lock<std::mutex>& lock, char *buf, size_t len, DCSPacket& packet){
-    int from = 0;
-    while (from < len){
-        from += packet.append_data(buf + from, len - from);
-        if (packet){
-            dispatch_received_command(lock, packet);
-            packet.clear();
-        }
-    }
-    return from;
-}
-
 void DCSWorld::dispatch_received_command(std::unique_lock<std::mutex> &lock, const DCSPacket& packet){
     auto cmd = packet.get_command();
     if (cmd == 'O'){
@@ -527,23 +155,29 @@ void DCSWorld::dispatch_received_command(std::unique_lock<std::mutex> &lock, con
         A_command(lock, packet);
     }else if (cmd == 'V'){
         V_command(lock, packet);
+    }else if (cmd == 'B'){
+        B_command(lock, packet);
     }
 }
 
 void DCSWorld::V_command(std::unique_lock<std::mutex> &lock, const DCSPacket &packet){
         // Version nortification
-        const struct DATA{
+        struct DATA{
             uint32_t version[4];
             uint32_t produce_name_len;
             //char product_name[...];
         };
-        auto data {reinterpret_cast<const DATA*>(packet.get_data())};
-        std::string name{reinterpret_cast<const char*>(data + 1), data->produce_name_len};
+        if (!packet.contains(0, sizeof(DATA))){
+            return;
+        }
+        auto data = packet.read<DATA>(0);
+        auto name_len = std::min<size_t>(data.produce_name_len, packet.get_data_length() - sizeof(DATA));
+        std::string name{packet.get_data() + sizeof(DATA), name_len};
         auto&& msg = std::format(
             "dcs: Product version information has been received:\n"
             "    Product Name    : {}\n"
             "    Product Version : {}.{}.{}.{}",
-            name, data->version[0], data->version[1], data->version[2], data->version[3]);
+            name, data.version[0], data.version[1], data.version[2], data.version[3]);
         mapper_EngineInstance()->putLog(MCONSOLE_DEBUG, msg);
 }
 
@@ -561,15 +195,28 @@ void DCSWorld::A_command(std::unique_lock<std::mutex> &lock, const DCSPacket &pa
 
 void DCSWorld::O_command(std::unique_lock<std::mutex> &lock, const DCSPacket &packet){
         // Observed value nortification
-        auto data = packet.get_data();
-        auto type = data[0];
-        union {uint32_t i; char c[4];} index;
-        index.i = 0;
-        index.c[0] = data[1];
-        index.c[1] = data[2];
-        index.c[2] = data[3];
-        if (index.i >= 0 && index.i < observed_data_defs.size()){
-            triger_observed_data_event(index.i, type, data + 4, packet.get_data_length() - 4);
+        if (!packet.contains(0, command_header_size)){
+            return;
+        }
+        auto entry = DCSCommandHeader::decode(packet.get_data());
+        if (entry.data_length < observed_data_defs.size()){
+            triger_observed_data_event(entry.data_length, entry.command, packet.get_data() + 4, packet.get_data_length() - 4);
+        }
+}
+
+void DCSWorld::B_command(std::unique_lock<std::mutex> &lock, const DCSPacket &packet){
+        // Bulk observed value nortification
+        //   Events are enqueued to the engine at once after decoding whole of the packet.
+        DCSBulkFrameHeader header{};
+        MapperEngine::EventBatch batch(*mapper_EngineInstance());
+        auto status = parse_bulk_frame(packet, header, [this](char type, uint32_t index, const char* value, size_t length){
+            if (index < observed_data_defs.size()){
+                triger_observed_data_event(index, type, value, length);
+            }
+        });
+        if (status == DCSBulkFrameStatus::malformed){
+            mapper_EngineInstance()->putLog(MCONSOLE_DEBUG, std::format(
+                "dcs: a malformed bulk observed data packet has been received: frame={}", header.frame_number));
         }
 }
 
@@ -673,7 +320,10 @@ public:
     virtual void triger_event(int type, const char* value, size_t length){
         if (type == 'N'){
             if (length == sizeof(float)){
-                mapper_EngineInstance()->sendEvent(std::move(Event(event_id, *reinterpret_cast<const float*>(value))));
+                // values in a bulk packet are not aligned
+                float fvalue;
+                memcpy(&fvalue, value, sizeof(fvalue));
+                mapper_EngineInstance()->sendEvent(std::move(Event(event_id, fvalue)));
             }
         }else if (type == 'S'){
             mapper_EngineInstance()->sendEvent(std::move(Event(event_id, std::string(value, length))));
@@ -773,7 +423,7 @@ void DCSWorld::sync_observed_data_definitions(std::unique_lock<std::mutex>& lock
         need_to_set_event = tx_buf->insert_data(cmd.c_str(), cmd.length()) || need_to_set_event;
     }
     if (need_to_set_event){
-        ::SetEvent(schedule_event);
+        connection->notify();
     }
 }
 
@@ -805,7 +455,7 @@ void DCSWorld::sync_chunks(std::unique_lock<std::mutex>& lock){
         need_to_set_event = send_register_chunk_command_without_lock(i) || need_to_set_event;
     }
     if (need_to_set_event){
-        ::SetEvent(schedule_event);
+        connection->notify();
     }
 }
 
@@ -815,8 +465,24 @@ void DCSWorld::send_clear_chunk_command(){
     }cmd{
         make_command_header('S', sizeof(CMD) - 4),
     };
+    // chunk IDs which are queued before this command are no longer valid
+    tx_buf->clear_coalescing_keys();
     if (tx_buf->insert_data(&cmd, sizeof(cmd))){
-        ::SetEvent(schedule_event);
+        connection->notify();
+    }
+}
+
+bool DCSWorld::is_coalescing_chunk(uint32_t chunk_id){
+    std::lock_guard lock(mutex);
+    return chunk_id < coalescing_chunks.size() && coalescing_chunks[chunk_id];
+}
+
+bool DCSWorld::insert_invoke_chunk_command(uint32_t chunk_id, const void* cmd, size_t size){
+    if (is_coalescing_chunk(chunk_id)){
+        // only the latest invocation is sent if previous one is still queued
+        return tx_buf->insert_data(cmd, size, chunk_id);
+    }else{
+        return tx_buf->insert_data(cmd, size);
     }
 }
 
@@ -828,8 +494,8 @@ void DCSWorld::send_invoke_chunk(uint32_t chunk_id){
         make_command_header('T', sizeof(CMD) - 4),
         chunk_id,
     };
-    if (tx_buf->insert_data(&cmd, sizeof(cmd))){
-        ::SetEvent(schedule_event);
+    if (insert_invoke_chunk_command(chunk_id, &cmd, sizeof(cmd))){
+        connection->notify();
     }
 }
 
@@ -843,8 +509,8 @@ void DCSWorld::send_invoke_chunk(uint32_t chunk_id, float argument){
         chunk_id,
         argument,
     };
-    if (tx_buf->insert_data(&cmd, sizeof(cmd))){
-        ::SetEvent(schedule_event);
+    if (insert_invoke_chunk_command(chunk_id, &cmd, sizeof(cmd))){
+        connection->notify();
     }
 }
 
@@ -856,11 +522,20 @@ void DCSWorld::send_invoke_chunk(uint32_t chunk_id, const char* argument, size_t
         make_command_header('V', sizeof(CMD) + length - 4),
         chunk_id,
     };
+    if (is_coalescing_chunk(chunk_id)){
+        std::string buffer;
+        buffer.append(reinterpret_cast<char*>(&cmd), sizeof(cmd));
+        buffer.append(argument, length);
+        if (tx_buf->insert_data(buffer.c_str(), buffer.length(), chunk_id)){
+            connection->notify();
+        }
+        return;
+    }
     auto lock = std::move(tx_buf->get_lock());
     bool need_to_set_event = tx_buf->insert_data_without_lock(&cmd, sizeof(cmd));
     tx_buf->insert_data_without_lock(argument, length);
     if (need_to_set_event){
-        ::SetEvent(schedule_event);
+        connection->notify();
     }
 }
 
@@ -958,7 +633,7 @@ void DCSWorld::lua_perform_clickable_action(sol::variadic_args args){
         }
     }
     if (need_to_set_event){
-        ::SetEvent(schedule_event);
+        connection->notify();
     }
 }
 
@@ -993,7 +668,7 @@ std::shared_ptr<NativeAction::Function> DCSWorld::lua_clickable_action_performer
         os << ")";
         func = [this, cmd = std::move(cmd)](auto& event, auto&){
             if (tx_buf->insert_data(&cmd[0], cmd.size())){
-                ::SetEvent(schedule_event);
+                connection->notify();
             }
         };
     }else{
@@ -1002,7 +677,7 @@ std::shared_ptr<NativeAction::Function> DCSWorld::lua_clickable_action_performer
             auto buf = const_cast<P_CMD*>(reinterpret_cast<const P_CMD*>(&cmd[0]) + 1);
             *reinterpret_cast<float *>(buf) = static_cast<float>(static_cast<double>(event));
             if (tx_buf->insert_data(&cmd[0], cmd.size())){
-                ::SetEvent(schedule_event);
+                connection->notify();
             }
         };
     }
@@ -1010,7 +685,7 @@ std::shared_ptr<NativeAction::Function> DCSWorld::lua_clickable_action_performer
     return std::make_shared<NativeAction::Function>(os.str().c_str(), func);
 }
 
-uint32_t DCSWorld::lua_register_chunk(sol::object arg0){
+uint32_t DCSWorld::lua_register_chunk(sol::object arg0, sol::object arg1){
     auto&& chunk = lua_safestring(arg0);
     if (chunk.length() > 0){
         lua51::checker checker;
@@ -1020,10 +695,11 @@ uint32_t DCSWorld::lua_register_chunk(sol::object arg0){
         std::lock_guard lock{mutex};
         auto chunk_id = chunks.size();
         chunks.push_back(chunk);
+        coalescing_chunks.push_back(arg1.get_type() == sol::type::boolean && arg1.as<bool>());
         if (is_active){
             auto&& lock2 = tx_buf->get_lock();
             if (send_register_chunk_command_without_lock(chunk_id)){
-                ::SetEvent(schedule_event);
+                connection->notify();
             }
         }
         return chunk_id;
@@ -1035,6 +711,7 @@ uint32_t DCSWorld::lua_register_chunk(sol::object arg0){
 void DCSWorld::lua_clear_chunks(){
     std::lock_guard lock(mutex);
     chunks.clear();
+    coalescing_chunks.clear();
     send_clear_chunk_command();
 }
 
@@ -1141,7 +818,7 @@ void DCSWorld::lua_add_observed_data(sol::object arg0){
         }
     }
     if (need_to_set_event){
-        ::SetEvent(schedule_event);
+        connection->notify();
     }
 }
 
@@ -1154,7 +831,7 @@ void DCSWorld::lua_clear_observed_data(){
         make_command_header('C', sizeof(C_CMD) - 4),
     };
     if (tx_buf->insert_data(reinterpret_cast<char*>(&cmd), sizeof(cmd))){
-        ::SetEvent(schedule_event);
+        connection->notify();
     }
 }
 
@@ -1184,9 +861,9 @@ void DCSWorld::initLuaEnv(sol::state &lua){
             lua_clear_observed_data();
         });
     };
-    dcs["register_chunk"] = [this](sol::object arg0){
-        return lua_c_interface(*mapper_EngineInstance(), "dcs.register_chunk", [this, arg0](){
-            return lua_register_chunk(arg0);
+    dcs["register_chunk"] = [this](sol::object arg0, sol::object arg1){
+        return lua_c_interface(*mapper_EngineInstance(), "dcs.register_chunk", [this, arg0, arg1](){
+            return lua_register_chunk(arg0, arg1);
         });
     };
     dcs["clear_chunks"] = [this](){
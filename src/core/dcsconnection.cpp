@@ -0,0 +1,96 @@
+//
+// dcsconnection.cpp
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+
+#include "dcsconnection.h"
+
+//============================================================================================
+// Connection management
+//============================================================================================
+void DCSConnection::run(std::unique_lock<std::mutex>& lock, uint16_t port,
+                        PacketHandler&& packet_handler, ConnectivityHandler&& connectivity_handler, LogHandler&& log_handler){
+    transport->open(port);
+    auto watch_network{false};
+    auto timeout{0};
+    auto write_is_blocked{false};
+    auto on_close = [&]{
+        status = Status::connecting;
+        write_is_blocked = false;
+        rx_ring.clear();
+        transport->reopen();
+        tx_buf.reset(false);
+        connectivity_handler(lock, false);
+    };
+
+    while (true){
+        if (status == Status::connected){
+            if (!write_is_blocked && tx_buf.get_writable_data(tx_blocks) > 0){
+                auto written = transport->send(tx_blocks.data(), static_cast<int>(tx_blocks.size()));
+                if (written < 0){
+                    if (transport->is_would_block()){
+                        write_is_blocked = true;
+                    }else{
+                        log_handler("dcs: An error occurred while communicating with DCS World: send()");
+                        on_close();
+                    }
+                }else{
+                    tx_buf.trim(written);
+                }
+                continue;
+            }
+            watch_network = true;
+            timeout = -1;
+        }else if (status == Status::connecting){
+            transport->connect();
+            watch_network = true;
+            timeout = -1;
+        }else if (status == Status::retrying){
+            watch_network = false;
+            timeout = connecting_interval;
+        }
+        lock.unlock();
+        auto result = transport->wait(watch_network, timeout);
+        lock.lock();
+        if (should_stop){
+            break;
+        }
+        if (result == Transport::WaitResult::timeout){
+            status = Status::connecting;
+        }else if (result == Transport::WaitResult::network){
+            if (status == Status::connected){
+                auto nevent = transport->get_network_event();
+                if (nevent & Transport::EV_WRITE){
+                    write_is_blocked = false;
+                }
+                if (nevent & (Transport::EV_READ | Transport::EV_CLOSE)){
+                    auto region = rx_ring.get_writable_region();
+                    auto received = transport->receive(region.buff, static_cast<int>(region.size));
+                    if (received > 0){
+                        rx_ring.commit(received);
+                        rx_ring.dispatch([&](const DCSPacket& packet){
+                            packet_handler(lock, packet);
+                        });
+                    }else if (received == 0){
+                        log_handler("dcs: connection with DCS World exporter has been closed");
+                        on_close();
+                    }else{
+                        log_handler("dcs: An error occurred while communicating with DCS World: recv()");
+                        on_close();
+                    }
+                }
+            }else if (status == Status::connecting){
+                if (transport->get_socket_error() == 0){
+                    status = Status::connected;
+                    tx_buf.reset(true);
+                    // EV_WRITE is reported only when the socket becomes writable after blocking
+                    transport->select(Transport::EV_READ | Transport::EV_CLOSE | Transport::EV_WRITE);
+                    log_handler("dcs: connection with DCS World exporter has been established");
+                    connectivity_handler(lock, true);
+                }else{
+                    status = Status::retrying;
+                }
+            }
+        }
+    }
+}
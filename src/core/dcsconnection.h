@@ -0,0 +1,299 @@
+//
+// dcsconnection.h
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+//  Note:
+//    Connection management with the DCS World exporter. Platform dependent socket handling
+//    is separated as DCSConnection::Transport, so that the connection logic can be
+//    examined on any platform.
+//
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include "dcsprotocol.h"
+
+//============================================================================================
+// Transmit buffer
+//    Commands are appended to fixed size blocks. Blocks are never released but recycled
+//    through a free list, and all pending blocks are handed to the transport at once as a
+//    gather list.
+//    A command inserted with a coalescing key overwrites the previous command with the same
+//    key in place while that command has not been handed to the transport yet. This is
+//    used to send only the latest invocation of a chunk when invocations burst. Note that
+//    the latest command is sent at the position of the overwritten command, so it may
+//    precede commands inserted after the overwritten one.
+//============================================================================================
+class DCSWorldSendBuffer{
+public:
+    static constexpr size_t block_size = 32 * 1024;
+    static constexpr auto initial_num_of_blocks = 2;
+    static constexpr auto max_gather_blocks = 16;
+
+    struct data_block{
+        char* buff{nullptr};
+        size_t size{0};
+    };
+
+protected:
+    struct buff_block {
+        char buff[block_size];
+        size_t used{0};
+        size_t remain() const {
+            return block_size - used;
+        }
+    };
+
+    struct coalescing_entry{
+        buff_block* block;
+        size_t offset;
+        size_t size;
+    };
+
+    std::mutex mutex;
+    bool is_enable{false};
+    std::vector<std::unique_ptr<buff_block>> pool;
+    std::vector<buff_block*> free_blocks;
+    std::deque<buff_block*> pending;
+    size_t written{0};
+    std::unordered_map<uint32_t, coalescing_entry> coalescing_entries;
+
+public:
+    DCSWorldSendBuffer(){
+        for (auto i = 0; i < initial_num_of_blocks; i++){
+            free_blocks.push_back(allocate_block());
+        }
+    }
+
+    bool is_empty(){
+        std::lock_guard lock{mutex};
+        return pending.empty();
+    }
+
+    void reset(bool mode){
+        std::lock_guard lock{mutex};
+        is_enable = mode;
+        if (is_enable){
+            for (auto block : pending){
+                release_block(block);
+            }
+            pending.clear();
+            written = 0;
+            coalescing_entries.clear();
+        }
+    }
+
+    // returns the number of data blocks stored in the gather list
+    // data in the gather list is regarded as being sent, it's never overwritten by coalescing
+    size_t get_writable_data(std::vector<data_block>& blocks){
+        std::lock_guard lock(mutex);
+        blocks.clear();
+        auto offset = written;
+        for (auto block : pending){
+            if (blocks.size() >= max_gather_blocks){
+                break;
+            }
+            blocks.push_back({block->buff + offset, block->used - offset});
+            offset = 0;
+        }
+        coalescing_entries.clear();
+        return blocks.size();
+    }
+
+    void trim(size_t size){
+        std::lock_guard lock(mutex);
+        while (size){
+            if (pending.empty()){
+                abort();
+            }
+            auto block = pending.front();
+            auto trim_size = std::min(size, block->used - written);
+            written += trim_size;
+            size -= trim_size;
+            if (written >= block->used){
+                pending.pop_front();
+                release_block(block);
+                written = 0;
+            }
+        }
+    }
+
+    bool insert_data(const void* data, size_t size){
+        std::lock_guard lock(mutex);
+        if (!is_enable){
+            return false;
+        }
+        return insert_data_without_lock(data, size);
+    }
+
+    bool insert_data(const void* data, size_t size, uint32_t coalescing_key){
+        std::lock_guard lock(mutex);
+        if (!is_enable){
+            return false;
+        }
+        return insert_data_without_lock(data, size, coalescing_key);
+    }
+
+    // returned value indicates whether the buffer was empty before inserting
+    bool insert_data_without_lock(const void* data, size_t size){
+        auto rc = pending.empty();
+        auto src = static_cast<const char*>(data);
+        while (size){
+            if (pending.empty() || pending.back()->remain() == 0){
+                pending.push_back(acquire_block());
+            }
+            auto current_buf = pending.back();
+            auto write_size = std::min(size, current_buf->remain());
+            memcpy(current_buf->buff + current_buf->used, src, write_size);
+            current_buf->used += write_size;
+            src += write_size;
+            size -= write_size;
+        }
+        return rc;
+    }
+
+    bool insert_data_without_lock(const void* data, size_t size, uint32_t coalescing_key){
+        auto entry = coalescing_entries.find(coalescing_key);
+        if (entry != coalescing_entries.end() && entry->second.size == size){
+            memcpy(entry->second.block->buff + entry->second.offset, data, size);
+            return false;
+        }
+        if (size > block_size){
+            coalescing_entries.erase(coalescing_key);
+            return insert_data_without_lock(data, size);
+        }
+
+        // a command which can be overwritten must be placed in a block contiguously
+        auto rc = pending.empty();
+        if (pending.empty() || pending.back()->remain() < size){
+            pending.push_back(acquire_block());
+        }
+        auto current_buf = pending.back();
+        coalescing_entries[coalescing_key] = {current_buf, current_buf->used, size};
+        memcpy(current_buf->buff + current_buf->used, data, size);
+        current_buf->used += size;
+        return rc;
+    }
+
+    // commands which were inserted with a coalescing key are never overwritten after this
+    void clear_coalescing_keys(){
+        std::lock_guard lock(mutex);
+        coalescing_entries.clear();
+    }
+
+    std::unique_lock<std::mutex> get_lock(){
+        return std::unique_lock(mutex);
+    }
+
+protected:
+    buff_block* allocate_block(){
+        pool.emplace_back(std::make_unique<buff_block>());
+        return pool.back().get();
+    }
+
+    buff_block* acquire_block(){
+        if (free_blocks.empty()){
+            return allocate_block();
+        }
+        auto block = free_blocks.back();
+        free_blocks.pop_back();
+        return block;
+    }
+
+    void release_block(buff_block* block){
+        block->used = 0;
+        free_blocks.push_back(block);
+    }
+};
+
+//============================================================================================
+// Connection with the DCS World exporter
+//    The exporter behaves as a TCP server on localhost. run() keeps connecting to the
+//    exporter, sends data queued in the transmit buffer, and dispatches received packets
+//    until stop() is called. It retries connecting in every connecting_interval when the
+//    exporter is not running.
+//    All states are guarded by the mutex specified by the owner. run() releases the lock
+//    only while it waits for events.
+//============================================================================================
+class DCSConnection{
+public:
+    static constexpr int connecting_interval = 1000; // in milli second
+
+    enum class Status{connecting, retrying, connected};
+
+    //----------------------------------------------------------------------------------------
+    // Platform dependent socket handling
+    //    A transport holds a non-blocking TCP socket and a notification object which wakes
+    //    up wait() from other threads.
+    //----------------------------------------------------------------------------------------
+    class Transport{
+    public:
+        static constexpr uint32_t EV_CONNECT = 1 << 0;
+        static constexpr uint32_t EV_READ = 1 << 1;
+        static constexpr uint32_t EV_WRITE = 1 << 2;
+        static constexpr uint32_t EV_CLOSE = 1 << 3;
+
+        enum class WaitResult{timeout, notified, network};
+
+        virtual ~Transport() = default;
+        virtual void open(uint16_t port) = 0;
+        virtual void reopen() = 0;
+        virtual void connect() = 0;
+        virtual int get_socket_error() = 0;
+        virtual void select(uint32_t events) = 0;
+        virtual uint32_t get_network_event() = 0;
+        // negative value is returned if an error occurs
+        virtual int receive(void* buf, int len) = 0;
+        // data blocks are sent as a gather list, EV_WRITE is reported only after a send
+        // operation is failed due to would-block as same as WinSock
+        virtual int send(const DCSWorldSendBuffer::data_block* blocks, int count) = 0;
+        virtual bool is_would_block() = 0;
+        // negative timeout means infinite
+        virtual WaitResult wait(bool watch_network, int timeout) = 0;
+        virtual void notify() = 0;
+    };
+
+    using PacketHandler = std::function<void(std::unique_lock<std::mutex>& lock, const DCSPacket& packet)>;
+    using ConnectivityHandler = std::function<void(std::unique_lock<std::mutex>& lock, bool connected)>;
+    using LogHandler = std::function<void(const char* msg)>;
+
+protected:
+    std::mutex& mutex;
+    std::unique_ptr<Transport> transport;
+    DCSWorldSendBuffer& tx_buf;
+    DCSReceiveRing rx_ring;
+    std::vector<DCSWorldSendBuffer::data_block> tx_blocks;
+    Status status{Status::connecting};
+    bool should_stop{false};
+
+public:
+    DCSConnection() = delete;
+    DCSConnection(const DCSConnection&) = delete;
+    DCSConnection(DCSConnection&&) = delete;
+    DCSConnection(std::mutex& mutex, std::unique_ptr<Transport>&& transport, DCSWorldSendBuffer& tx_buf) :
+        mutex(mutex), transport(std::move(transport)), tx_buf(tx_buf){}
+    ~DCSConnection() = default;
+
+    // lock must hold the mutex specified at construction
+    void run(std::unique_lock<std::mutex>& lock, uint16_t port,
+             PacketHandler&& packet_handler, ConnectivityHandler&& connectivity_handler, LogHandler&& log_handler);
+
+    // following functions must be called while holding the mutex
+    void stop(){
+        should_stop = true;
+        transport->notify();
+    }
+    Status get_status() const{return status;}
+
+    // this function can be called without holding the mutex
+    void notify(){transport->notify();}
+};
@@ -0,0 +1,199 @@
+//
+// dcsposixtransport.cpp
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <system_error>
+#include <algorithm>
+#include <cstring>
+#include "dcsposixtransport.h"
+
+#if !defined(MSG_NOSIGNAL)
+#   define MSG_NOSIGNAL 0
+#endif
+
+static void set_nonblocking(int fd){
+    auto flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+}
+
+//============================================================================================
+// POSIX socket transport for DCS World connection
+//    Waiting for events is implemented by poll(2). Notifications from other threads are
+//    delivered through a self-pipe.
+//    Unlike WinSock, a socket which failed to connect cannot be reused, so connect() opens
+//    a new socket in that case.
+//============================================================================================
+DCSPosixTransport::DCSPosixTransport(){
+    if (pipe(notification_pipe) != 0){
+        throw std::system_error(errno, std::generic_category(), "dcs: failed to create a pipe");
+    }
+    set_nonblocking(notification_pipe[0]);
+    set_nonblocking(notification_pipe[1]);
+    memset(&server_addr, 0, sizeof(server_addr));
+}
+
+DCSPosixTransport::~DCSPosixTransport(){
+    close_socket();
+    close(notification_pipe[0]);
+    close(notification_pipe[1]);
+}
+
+void DCSPosixTransport::open(uint16_t port){
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    server_addr.sin_port = htons(port);
+    open_socket();
+}
+
+void DCSPosixTransport::open_socket(){
+    sock = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0){
+        throw std::system_error(errno, std::generic_category(), "dcs: failed to create a socket");
+    }
+    set_nonblocking(sock);
+#if defined(SO_NOSIGPIPE)
+    int on = 1;
+    setsockopt(sock, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+    socket_status = SocketStatus::idle;
+    connect_error = 0;
+    write_is_blocked = false;
+    selected_events = EV_CONNECT;
+    network_events = 0;
+}
+
+void DCSPosixTransport::close_socket(){
+    if (sock >= 0){
+        close(sock);
+        sock = -1;
+    }
+}
+
+void DCSPosixTransport::reopen(){
+    close_socket();
+    open_socket();
+}
+
+void DCSPosixTransport::connect(){
+    if (socket_status == SocketStatus::connecting || socket_status == SocketStatus::connected){
+        return;
+    }else if (socket_status == SocketStatus::failed){
+        reopen();
+    }
+    selected_events = EV_CONNECT;
+    socket_status = SocketStatus::connecting;
+    if (::connect(sock, reinterpret_cast<sockaddr*>(&server_addr), sizeof(server_addr)) == 0){
+        // connection with localhost may be established immediately
+        network_events = EV_CONNECT;
+    }else if (errno != EINPROGRESS){
+        connect_error = errno;
+        network_events = EV_CONNECT;
+    }
+}
+
+int DCSPosixTransport::get_socket_error(){
+    auto error = connect_error;
+    if (!error){
+        socklen_t error_len = sizeof(error);
+        getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &error_len);
+    }
+    if (socket_status == SocketStatus::connecting){
+        socket_status = error ? SocketStatus::failed : SocketStatus::connected;
+    }
+    return error;
+}
+
+void DCSPosixTransport::select(uint32_t events){
+    selected_events = events;
+}
+
+uint32_t DCSPosixTransport::get_network_event(){
+    auto events = network_events;
+    network_events = 0;
+    return events;
+}
+
+int DCSPosixTransport::receive(void* buf, int len){
+    auto rc = ::recv(sock, buf, len, 0);
+    last_error = rc < 0 ? errno : 0;
+    return static_cast<int>(rc);
+}
+
+int DCSPosixTransport::send(const DCSWorldSendBuffer::data_block* blocks, int count){
+    iovec iov[DCSWorldSendBuffer::max_gather_blocks];
+    count = std::min(count, DCSWorldSendBuffer::max_gather_blocks);
+    for (auto i = 0; i < count; i++){
+        iov[i].iov_base = blocks[i].buff;
+        iov[i].iov_len = blocks[i].size;
+    }
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+    auto rc = ::sendmsg(sock, &msg, MSG_NOSIGNAL);
+    last_error = rc < 0 ? errno : 0;
+    write_is_blocked = is_would_block();
+    return static_cast<int>(rc);
+}
+
+bool DCSPosixTransport::is_would_block(){
+    return last_error == EAGAIN || last_error == EWOULDBLOCK;
+}
+
+DCSConnection::Transport::WaitResult DCSPosixTransport::wait(bool watch_network, int timeout){
+    if (watch_network && network_events){
+        return WaitResult::network;
+    }
+
+    pollfd fds[2];
+    fds[0] = {notification_pipe[0], POLLIN, 0};
+    fds[1] = {sock, 0, 0};
+    if (socket_status == SocketStatus::connecting){
+        fds[1].events = POLLOUT;
+    }else{
+        fds[1].events |= selected_events & (EV_READ | EV_CLOSE) ? POLLIN : 0;
+        // poll(2) is level triggered, writability is watched only while sending is blocked
+        fds[1].events |= (selected_events & EV_WRITE) && write_is_blocked ? POLLOUT : 0;
+    }
+    auto rc = poll(fds, watch_network ? 2 : 1, timeout);
+    if (rc == 0){
+        return WaitResult::timeout;
+    }else if (rc < 0){
+        // interrupted by a signal
+        return WaitResult::notified;
+    }
+
+    if (fds[0].revents){
+        char buf[64];
+        while (read(notification_pipe[0], buf, sizeof(buf)) > 0);
+        return WaitResult::notified;
+    }
+    auto revents = fds[1].revents;
+    if (socket_status == SocketStatus::connecting){
+        network_events |= EV_CONNECT;
+    }else{
+        network_events |= revents & POLLIN ? EV_READ : 0;
+        if (revents & POLLOUT){
+            network_events |= EV_WRITE;
+            write_is_blocked = false;
+        }
+        network_events |= revents & (POLLHUP | POLLERR) ? EV_CLOSE : 0;
+    }
+    return WaitResult::network;
+}
+
+void DCSPosixTransport::notify(){
+    char c = 0;
+    auto rc = write(notification_pipe[1], &c, 1);
+    (void)rc;
+}
@@ -0,0 +1,46 @@
+//
+// dcsposixtransport.h
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+
+#pragma once
+
+#include <netinet/in.h>
+#include "dcsconnection.h"
+
+class DCSPosixTransport : public DCSConnection::Transport{
+protected:
+    enum class SocketStatus{idle, connecting, connected, failed};
+
+    int sock{-1};
+    int notification_pipe[2]{-1, -1};
+    sockaddr_in server_addr;
+    SocketStatus socket_status{SocketStatus::idle};
+    int connect_error{0};
+    uint32_t selected_events{0};
+    uint32_t network_events{0};
+    int last_error{0};
+    bool write_is_blocked{false};
+
+public:
+    DCSPosixTransport();
+    DCSPosixTransport(const DCSPosixTransport&) = delete;
+    DCSPosixTransport(DCSPosixTransport&&) = delete;
+    virtual ~DCSPosixTransport();
+
+    virtual void open(uint16_t port);
+    virtual void reopen();
+    virtual void connect();
+    virtual int get_socket_error();
+    virtual void select(uint32_t events);
+    virtual uint32_t get_network_event();
+    virtual int receive(void* buf, int len);
+    virtual int send(const DCSWorldSendBuffer::data_block* blocks, int count);
+    virtual bool is_would_block();
+    virtual WaitResult wait(bool watch_network, int timeout);
+    virtual void notify();
+
+protected:
+    void open_socket();
+    void close_socket();
+};
@@ -0,0 +1,265 @@
+//
+// dcsprotocol.h
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+//  Note:
+//    Encoding and decoding of the protocol between fsmapper and the DCS World exporter.
+//    This file depends on neither WinSock nor Lua, so that it can be examined on any
+//    platform.
+//
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+//============================================================================================
+// Command header
+//    Each command begins with a 32 bit little endian header. The lowest byte is a command
+//    character, and the upper 24 bits are the length of data which follows the header.
+//============================================================================================
+using command_header = int32_t;
+constexpr size_t command_header_size = sizeof(command_header);
+constexpr size_t max_command_data_length = 0xffffff;
+
+constexpr int32_t make_command_header(uint8_t command, int32_t length){
+    return length << 8 | command;
+}
+
+inline void encode_command_header(char* out, char command, size_t length){
+    out[0] = command;
+    out[1] = static_cast<char>(length & 0xff);
+    out[2] = static_cast<char>(length >> 8 & 0xff);
+    out[3] = static_cast<char>(length >> 16 & 0xff);
+}
+
+inline void append_command_header(std::string& buffer, char command, size_t length){
+    char header[command_header_size];
+    encode_command_header(header, command, length);
+    buffer.append(header, sizeof(header));
+}
+
+struct DCSCommandHeader{
+    char command;
+    size_t data_length;
+
+    static DCSCommandHeader decode(const char* in){
+        return {
+            in[0],
+            static_cast<size_t>(static_cast<uint8_t>(in[1])) |
+            static_cast<size_t>(static_cast<uint8_t>(in[2])) << 8 |
+            static_cast<size_t>(static_cast<uint8_t>(in[3])) << 16,
+        };
+    }
+};
+
+//============================================================================================
+// Received packet
+//    A packet refers data placed in a receive buffer and it's valid until the handler which
+//    the packet is passed returns. Data is not aligned, so values must be read via read().
+//============================================================================================
+class DCSPacket{
+    char cmd{'\0'};
+    const char* data{nullptr};
+    size_t data_length{0};
+
+public:
+    DCSPacket() = default;
+    DCSPacket(char cmd, const char* data, size_t data_length) : cmd(cmd), data(data), data_length(data_length){}
+
+    char get_command()const{return cmd;}
+    size_t get_data_length()const{return data_length;}
+    const char* get_data()const{return data;}
+    operator const char* ()const{return get_data();}
+
+    bool contains(size_t offset, size_t length)const{
+        return offset <= data_length && length <= data_length - offset;
+    }
+
+    template <typename T>
+    T read(size_t offset)const{
+        T value;
+        memcpy(&value, data + offset, sizeof(T));
+        return value;
+    }
+};
+
+//============================================================================================
+// Receive ring
+//    Received bytes are written directly into a contiguous region of the ring, and complete
+//    packets are parsed in place. Only a packet which straddles the wrap point is copied to a
+//    scratch buffer. The ring grows when a packet larger than its capacity arrives.
+//    This class is not thread safe. Owner must serialize accesses.
+//============================================================================================
+class DCSReceiveRing{
+    std::vector<char> ring;
+    size_t read_pos{0};
+    size_t write_pos{0};
+    std::vector<char> straddling;
+
+public:
+    static constexpr size_t default_capacity = 64 * 1024;
+
+    struct region{
+        char* buff{nullptr};
+        size_t size{0};
+    };
+
+    explicit DCSReceiveRing(size_t capacity = default_capacity){
+        ring.resize(round_up_capacity(capacity));
+    }
+
+    size_t capacity()const{return ring.size();}
+    size_t size()const{return write_pos - read_pos;}
+
+    void clear(){
+        read_pos = 0;
+        write_pos = 0;
+    }
+
+    // contiguous free space to receive data, the size is 0 if the ring is full
+    region get_writable_region(){
+        auto start = write_pos & (ring.size() - 1);
+        auto free_size = ring.size() - size();
+        return {&ring[start], std::min(free_size, ring.size() - start)};
+    }
+
+    void commit(size_t length){
+        write_pos += length;
+    }
+
+    // handler is called with each complete packet, returns the number of dispatched packets
+    template <typename HANDLER>
+    size_t dispatch(HANDLER&& handler){
+        size_t count{0};
+        while (size() >= command_header_size){
+            char header_data[command_header_size];
+            copy_out(read_pos, header_data, sizeof(header_data));
+            auto header = DCSCommandHeader::decode(header_data);
+            auto packet_size = command_header_size + header.data_length;
+            if (packet_size > ring.size()){
+                grow(packet_size);
+            }
+            if (size() < packet_size){
+                break;
+            }
+            auto data_pos = (read_pos + command_header_size) & (ring.size() - 1);
+            if (data_pos + header.data_length <= ring.size()){
+                handler(DCSPacket{header.command, &ring[data_pos], header.data_length});
+            }else{
+                straddling.resize(header.data_length);
+                copy_out(read_pos + command_header_size, straddling.data(), header.data_length);
+                handler(DCSPacket{header.command, straddling.data(), header.data_length});
+            }
+            read_pos += packet_size;
+            count++;
+        }
+        if (read_pos == write_pos){
+            // rewind to maximize the contiguous writable region
+            clear();
+        }
+        return count;
+    }
+
+protected:
+    static size_t round_up_capacity(size_t capacity){
+        size_t result = 1024;
+        while (result < capacity){
+            result <<= 1;
+        }
+        return result;
+    }
+
+    void copy_out(size_t pos, char* out, size_t length)const{
+        auto start = pos & (ring.size() - 1);
+        auto first = std::min(length, ring.size() - start);
+        memcpy(out, &ring[start], first);
+        memcpy(out + first, &ring[0], length - first);
+    }
+
+    void grow(size_t capacity){
+        std::vector<char> new_ring(round_up_capacity(capacity));
+        auto length = size();
+        copy_out(read_pos, new_ring.data(), length);
+        ring = std::move(new_ring);
+        read_pos = 0;
+        write_pos = length;
+    }
+};
+
+//============================================================================================
+// Bulk observed value frame ('B' command)
+//    All values changed in a DCS frame are packed in a packet as following layout.
+//      uint32_t frame_number;
+//      uint32_t entry_num;
+//      entries: char type, uint24_t observer_id, value
+//               value is float for 'N', or uint16_t length and string body for 'S'
+//============================================================================================
+struct DCSBulkFrameHeader{
+    uint32_t frame_number;
+    uint32_t entry_num;
+};
+
+inline void append_bulk_frame_entry(std::string& buffer, uint32_t observer_id, float value){
+    char entry[4 + sizeof(float)];
+    encode_command_header(entry, 'N', observer_id);
+    memcpy(entry + 4, &value, sizeof(value));
+    buffer.append(entry, sizeof(entry));
+}
+
+inline void append_bulk_frame_entry(std::string& buffer, uint32_t observer_id, std::string_view value){
+    char entry[4 + sizeof(uint16_t)];
+    auto length = static_cast<uint16_t>(std::min<size_t>(value.length(), UINT16_MAX));
+    encode_command_header(entry, 'S', observer_id);
+    memcpy(entry + 4, &length, sizeof(length));
+    buffer.append(entry, sizeof(entry));
+    buffer.append(value.data(), length);
+}
+
+enum class DCSBulkFrameStatus{
+    complete,
+    truncated,
+    malformed,
+};
+
+// handler is called with each entry as handler(type, observer_id, value, value_length)
+template <typename HANDLER>
+DCSBulkFrameStatus parse_bulk_frame(const DCSPacket& packet, DCSBulkFrameHeader& header, HANDLER&& handler){
+    if (!packet.contains(0, sizeof(header))){
+        return DCSBulkFrameStatus::truncated;
+    }
+    header = packet.read<DCSBulkFrameHeader>(0);
+    auto data = packet.get_data();
+    size_t offset = sizeof(header);
+    for (uint32_t i = 0; i < header.entry_num; i++){
+        if (!packet.contains(offset, 4)){
+            return DCSBulkFrameStatus::truncated;
+        }
+        auto entry = DCSCommandHeader::decode(data + offset);
+        offset += 4;
+        size_t value_length = 0;
+        if (entry.command == 'N'){
+            value_length = sizeof(float);
+        }else if (entry.command == 'S'){
+            if (!packet.contains(offset, sizeof(uint16_t))){
+                return DCSBulkFrameStatus::truncated;
+            }
+            value_length = packet.read<uint16_t>(offset);
+            offset += sizeof(uint16_t);
+        }else{
+            // the rest of the packet cannot be decoded since the length of the value is unknown
+            return DCSBulkFrameStatus::malformed;
+        }
+        if (!packet.contains(offset, value_length)){
+            return DCSBulkFrameStatus::truncated;
+        }
+        handler(entry.command, static_cast<uint32_t>(entry.data_length), data + offset, value_length);
+        offset += value_length;
+    }
+    return DCSBulkFrameStatus::complete;
+}
@@ -0,0 +1,136 @@
+//
+// dcswintransport.cpp
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+
+#include <sstream>
+#include <algorithm>
+#include "dcswintransport.h"
+
+//============================================================================================
+// WinSock transport for DCS World connection
+//============================================================================================
+DCSWinTransport::DCSWinTransport(){
+    event = ::WSACreateEvent();
+    notification_event = ::WSACreateEvent();
+    ZeroMemory(&server_addr, sizeof(server_addr));
+}
+
+DCSWinTransport::~DCSWinTransport(){
+    close_socket();
+    WSACloseEvent(event);
+    WSACloseEvent(notification_event);
+}
+
+void DCSWinTransport::open(uint16_t port){
+    addrinfo hint;
+    ZeroMemory(&hint, sizeof(hint));
+    hint.ai_family =AF_INET;
+    hint.ai_socktype = SOCK_DGRAM;
+    hint.ai_protocol = IPPROTO_TCP;
+    std::ostringstream os;
+    os << port;
+    addrinfo *addrs;
+    if (getaddrinfo("localhost", os.str().c_str(), &hint, &addrs) == 0 && addrs[0].ai_family == AF_INET){
+        server_addr = *reinterpret_cast<sockaddr_in*>(addrs[0].ai_addr);
+    }else{
+        server_addr.sin_family = AF_INET;
+        server_addr.sin_addr.S_un.S_un_b.s_b1 = 127;
+        server_addr.sin_addr.S_un.S_un_b.s_b2 = 0;
+        server_addr.sin_addr.S_un.S_un_b.s_b3 = 0;
+        server_addr.sin_addr.S_un.S_un_b.s_b4 = 1;
+        server_addr.sin_port = htons(port);
+    }
+
+    open_socket();
+}
+
+void DCSWinTransport::open_socket(){
+    sock = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    u_long nonblocking = 1;
+    ::ioctlsocket(sock, FIONBIO, &nonblocking);
+    WSAEventSelect(sock, event, FD_CONNECT);
+}
+
+void DCSWinTransport::close_socket(){
+    if (sock != INVALID_SOCKET){
+        closesocket(sock);
+        sock = INVALID_SOCKET;
+    }
+}
+
+void DCSWinTransport::reopen(){
+    close_socket();
+    open_socket();
+}
+
+void DCSWinTransport::connect(){
+    WSAEventSelect(sock, event, FD_CONNECT);
+    ::connect(sock, reinterpret_cast<sockaddr*>(&server_addr), sizeof(server_addr));
+}
+
+int DCSWinTransport::get_socket_error(){
+    DWORD error{0};
+    int error_len = sizeof(error);
+    getsockopt(sock, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &error_len);
+    return static_cast<int>(error);
+}
+
+void DCSWinTransport::select(uint32_t events){
+    long event_flags{0};
+    event_flags |= events & EV_CONNECT ? FD_CONNECT : 0;
+    event_flags |= events & EV_READ ? FD_READ : 0;
+    event_flags |= events & EV_WRITE ? FD_WRITE : 0;
+    event_flags |= events & EV_CLOSE ? FD_CLOSE : 0;
+    WSAEventSelect(sock, event, event_flags);
+}
+
+uint32_t DCSWinTransport::get_network_event(){
+    WSANETWORKEVENTS nevent;
+    WSAEnumNetworkEvents(sock, event, &nevent);
+    uint32_t events{0};
+    events |= nevent.lNetworkEvents & FD_CONNECT ? EV_CONNECT : 0;
+    events |= nevent.lNetworkEvents & FD_READ ? EV_READ : 0;
+    events |= nevent.lNetworkEvents & FD_WRITE ? EV_WRITE : 0;
+    events |= nevent.lNetworkEvents & FD_CLOSE ? EV_CLOSE : 0;
+    return events;
+}
+
+int DCSWinTransport::receive(void* buf, int len){
+    auto rc = ::recv(sock, reinterpret_cast<char*>(buf), len, 0);
+    last_error = rc == SOCKET_ERROR ? WSAGetLastError() : 0;
+    return rc;
+}
+
+int DCSWinTransport::send(const DCSWorldSendBuffer::data_block* blocks, int count){
+    WSABUF bufs[DCSWorldSendBuffer::max_gather_blocks];
+    count = std::min(count, DCSWorldSendBuffer::max_gather_blocks);
+    for (auto i = 0; i < count; i++){
+        bufs[i].buf = blocks[i].buff;
+        bufs[i].len = static_cast<ULONG>(blocks[i].size);
+    }
+    DWORD sent{0};
+    auto rc = ::WSASend(sock, bufs, count, &sent, 0, nullptr, nullptr);
+    last_error = rc == SOCKET_ERROR ? WSAGetLastError() : 0;
+    return rc == SOCKET_ERROR ? SOCKET_ERROR : static_cast<int>(sent);
+}
+
+DCSConnection::Transport::WaitResult DCSWinTransport::wait(bool watch_network, int timeout){
+    WSAEVENT events[] {notification_event, event};
+    auto index = ::WSAWaitForMultipleEvents(watch_network ? 2 : 1, events, false, timeout < 0 ? WSA_INFINITE : timeout, false);
+    if (index == WSA_WAIT_EVENT_0){
+        // process requests
+        ::WSAResetEvent(notification_event);
+        return WaitResult::notified;
+    }else if (index == WSA_WAIT_EVENT_0 + 1){
+        return WaitResult::network;
+    }else if (index == WSA_WAIT_TIMEOUT){
+        return WaitResult::timeout;
+    }else{
+        return WaitResult::notified;
+    }
+}
+
+void DCSWinTransport::notify(){
+    ::WSASetEvent(notification_event);
+}
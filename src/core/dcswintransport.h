@@ -0,0 +1,41 @@
+//
+// dcswintransport.h
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+
+#pragma once
+
+#include <WinSock2.h>
+#include <WS2tcpip.h>
+#include "dcsconnection.h"
+
+class DCSWinTransport : public DCSConnection::Transport{
+protected:
+    SOCKET sock{INVALID_SOCKET};
+    sockaddr_in server_addr;
+    WSAEVENT event{WSA_INVALID_EVENT};
+    WSAEVENT notification_event{WSA_INVALID_EVENT};
+    int last_error{0};
+
+public:
+    DCSWinTransport();
+    DCSWinTransport(const DCSWinTransport&) = delete;
+    DCSWinTransport(DCSWinTransport&&) = delete;
+    virtual ~DCSWinTransport();
+
+    virtual void open(uint16_t port);
+    virtual void reopen();
+    virtual void connect();
+    virtual int get_socket_error();
+    virtual void select(uint32_t events);
+    virtual uint32_t get_network_event();
+    virtual int receive(void* buf, int len);
+    virtual int send(const DCSWorldSendBuffer::data_block* blocks, int count);
+    virtual bool is_would_block(){return last_error == WSAEWOULDBLOCK;}
+    virtual WaitResult wait(bool watch_network, int timeout);
+    virtual void notify();
+
+protected:
+    void open_socket();
+    void close_socket();
+};
@@ -5,6 +5,9 @@
 
 #include <sstream>
 #include <stdexcept>
+#include <algorithm>
+#include <climits>
+#include <cmath>
 #include "engine.h"
 #include "device.h"
 #include "simhid.h"
@@ -40,16 +43,31 @@ Device::Device(MapperEngine& engine, DeviceClass &deviceClass, std::string &name
         throw MapperException(os.str());
     }
     auto unitnum = deviceClass.plugin().getUnitNum(deviceClass, *this);
+    unitDefs.reserve(unitnum);
+    modifiers.reserve(unitnum);
+    DeviceModifierEventRegistry registry(engine);
     for (int i = 0; i < unitnum; i++){
         FSMDEVUNITDEF def;
         deviceClass.plugin().getUnitDef(deviceClass, *this, i, &def);
         unitDefs.push_back(def);
         if (def.direction == FSMDU_DIR_INPUT){
-            modifiers.push_back(rule.modifierForUnit(this->name.c_str(), def));
+            modifiers.push_back(rule.modifierForUnit(this->name.c_str(), def, registry));
         }else{
             modifiers.push_back(nullptr);
         }
     }
+    if (!rule.combinations.empty()){
+        observers.resize(unitnum);
+        for (const auto& combination : rule.combinations){
+            auto instance = combination->makeInstanceFitsToDevice(this->name.c_str(), unitDefs, registry);
+            const auto& units = instance->getObservedUnits();
+            for (size_t slot = 0; slot < units.size(); slot++){
+                observers[units[slot]].push_back({instance.get(), slot});
+            }
+            combinations.push_back(std::move(instance));
+        }
+    }
+    registry.commit();
     if (!deviceClass.plugin().start(deviceClass, *this)){
         std::ostringstream os;
         os << "failed to start a device: [name: " << name << "] [type: " << deviceClass.plugin().name << "]";
@@ -73,14 +91,55 @@ void Device::close(){
 }
 
 void Device::issueEvent(size_t unitIndex, int value){
-    if (is_available){
+    // events for output units and for units out of range are ignored
+    if (is_available && unitIndex < modifiers.size() && modifiers[unitIndex]){
         modifiers[unitIndex]->processUnitValueChangeEvent(value);
+        notifyObservers(unitIndex, value);
     }
 }
 
+static int observed_value(double value){
+    // observers receive int, so the value notified to them is clamped and rounded
+    return static_cast<int>(std::round(std::clamp<double>(value, INT_MIN, INT_MAX)));
+}
+
 void Device::issueEvent(size_t unitIndex, double value){
-    if (is_available){
+    // NaN reported by a plugin carries no value, it's ignored
+    if (is_available && !std::isnan(value) && unitIndex < modifiers.size() && modifiers[unitIndex]){
         modifiers[unitIndex]->processUnitValueChangeEvent(value);
+        notifyObservers(unitIndex, observed_value(value));
+    }
+}
+
+void Device::issueEvents(const FSMDEVUNITVALUE* values, size_t num){
+    // events generated by modifiers are enqueued at once as a frame
+    if (is_available){
+        MapperEngine::EventBatch batch(engine);
+        for (size_t i = 0; i < num; i++){
+            if (values[i].index >= 0 && static_cast<size_t>(values[i].index) < modifiers.size() &&
+                modifiers[values[i].index]){
+                auto& modifier = modifiers[values[i].index];
+                int value;
+                if (values[i].type == FSMDU_VALUE_DOUBLE){
+                    if (std::isnan(values[i].value.doubleValue)){
+                        continue;
+                    }
+                    modifier->processUnitValueChangeEvent(values[i].value.doubleValue);
+                    value = observed_value(values[i].value.doubleValue);
+                }else if (values[i].type == FSMDU_VALUE_INT64){
+                    // observers receive int, so only the value notified to them is clamped
+                    modifier->processUnitValueChangeEvent(values[i].value.int64Value);
+                    value = static_cast<int>(std::clamp<int64_t>(values[i].value.int64Value, INT_MIN, INT_MAX));
+                }else if (values[i].type == FSMDU_VALUE_BOOL){
+                    value = values[i].value.boolValue ? 1 : 0;
+                    modifier->processUnitValueChangeEvent(value);
+                }else{
+                    value = values[i].value.intValue;
+                    modifier->processUnitValueChangeEvent(value);
+                }
+                notifyObservers(values[i].index, value);
+            }
+        }
     }
 }
 
@@ -91,7 +150,24 @@ void Device::sendUnitValue(size_t unitIndex, sol::object value){
                 throw MapperException("invalid upstream id");
             }
             EventValue rval{value};
-            if (rval.getType() == EventValue::Type::int_value){
+            if (deviceClass.plugin().version >= MAPPER_PLUGIN_DEVICE_OPS_VERSION_2){
+                // version 2 plugins receive the value without losing precision
+                FSMDEVUNITVALUE unit_value;
+                unit_value.index = static_cast<int>(unitIndex);
+                if (rval.getType() == EventValue::Type::int_value){
+                    unit_value.type = FSMDU_VALUE_INT64;
+                    unit_value.value.int64Value = rval.getAs<int64_t>();
+                }else if (rval.getType() == EventValue::Type::double_value){
+                    unit_value.type = FSMDU_VALUE_DOUBLE;
+                    unit_value.value.doubleValue = rval.getAs<double>();
+                }else if (rval.getType() == EventValue::Type::bool_value){
+                    unit_value.type = FSMDU_VALUE_BOOL;
+                    unit_value.value.boolValue = rval.getAs<bool>();
+                }else{
+                    return;
+                }
+                deviceClass.plugin().sendUnitValueV2(deviceClass, *this, &unit_value);
+            }else if (rval.getType() == EventValue::Type::int_value){
                 auto value = rval.getAs<int64_t>();
                 deviceClass.plugin().sendUnitValue(deviceClass, *this, unitIndex, value);
             }else if (rval.getType() == EventValue::Type::double_value){
@@ -121,6 +197,14 @@ sol::object Device::create_event_table(sol::this_state s){
                 out[unit.name] = unit_table;
             }
         }
+        for (const auto& combination : combinations){
+            auto combination_table = lua.create_table();
+            for (auto ix_event = 0; ix_event < combination->getEventNum(); ix_event++){
+                auto event = combination->getEvent(ix_event);
+                combination_table[event.name] = event.id;
+            }
+            out[combination->getName()] = combination_table;
+        }
     }
     return out;
 }
@@ -141,17 +225,17 @@ sol::object Device::create_upstream_id_table(sol::this_state s){
 // Device plugin coupsulized object
 //    This object is created correspoinding to each plugin befor running lua script once.
 //============================================================================================
-DeviceClass::DeviceClass(MapperEngine& engine, DeviceManager& manager, const MAPPER_PLUGIN_DEVICE_OPS* pluginOps): 
-    manager(manager), pluginOps(pluginOps), contextForPlugin(engine, pluginOps->name){
-    if (!pluginOps->init(*this)){
+DeviceClass::DeviceClass(MapperEngine& engine, DeviceManager& manager, const PluginDeviceOps& pluginOps): 
+    manager(manager), pluginOps(pluginOps), contextForPlugin(engine, pluginOps.name){
+    if (!pluginOps.init(*this)){
         std::ostringstream os;
-        os << "failed to initalize device plugin: [plugin name: " << pluginOps->name << "]" << std::endl;
+        os << "failed to initalize device plugin: [plugin name: " << pluginOps.name << "]" << std::endl;
         throw MapperException(os.str());
     }
 }
 
 DeviceClass::~DeviceClass(){
-    pluginOps->term(*this);
+    pluginOps.term(*this);
 }
 
 //============================================================================================
@@ -159,15 +243,15 @@ DeviceClass::~DeviceClass(){
 //============================================================================================
 DeviceManager::DeviceManager(MapperEngine& engine): engine(engine), modifierManager(engine){
     for (int i = 0; i < sizeof(builtin_plugins) / sizeof(builtin_plugins[0]); i++){
-        auto plugin = builtin_plugins[i];
+        PluginDeviceOps plugin{*builtin_plugins[i]};
         auto device_class = std::make_unique<DeviceClass>(engine, *this, plugin);
-        classes.emplace(plugin->name, std::move(device_class));
+        classes.emplace(plugin.name, std::move(device_class));
     }
     for (int i = 0; i < pluginManager.get_plugin_num(); i++){
-        auto plugin = pluginManager.get_ops_at(i);
-        if (classes.count(plugin->name) == 0){
+        auto& plugin = pluginManager.get_ops_at(i);
+        if (classes.count(plugin.name) == 0){
             auto device_class = std::make_unique<DeviceClass>(engine, *this, plugin);
-            classes.emplace(plugin->name, std::move(device_class));
+            classes.emplace(plugin.name, std::move(device_class));
         }else{
             std::ostringstream os;
             os << "device name of the plugin module \"" << pluginManager.get_file_name_at(i)
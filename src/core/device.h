@@ -25,6 +25,12 @@ class Device{
     FSMDEVICECTX contextForPlugin;
     std::vector<FSMDEVUNITDEF> unitDefs;
     std::vector< std::shared_ptr<DeviceModifier> > modifiers;
+    struct Observer{
+        DeviceCombinationModifier* modifier;
+        size_t slot;
+    };
+    std::vector< std::shared_ptr<DeviceCombinationModifier> > combinations;
+    std::vector< std::vector<Observer> > observers;
 
 public:
     Device() = delete;
@@ -42,27 +48,37 @@ public:
 
     void issueEvent(size_t unitIndex, int value);
     void issueEvent(size_t unitIndex, double value);
+    void issueEvents(const FSMDEVUNITVALUE* values, size_t num);
     void sendUnitValue(size_t unitIndex, sol::object value);
 
     sol::object create_event_table(sol::this_state s);
     sol::object create_upstream_id_table(sol::this_state s);
+
+protected:
+    void notifyObservers(size_t unitIndex, int value){
+        if (!observers.empty()){
+            for (auto& observer : observers[unitIndex]){
+                observer.modifier->notifyUnitValueChange(observer.slot, value);
+            }
+        }
+    }
 };
 
 class DeviceClass{
 protected:
     DeviceManager& manager;
-    const MAPPER_PLUGIN_DEVICE_OPS* pluginOps;
+    PluginDeviceOps pluginOps;
     FSMAPPERCTX contextForPlugin;
 
 public:
     DeviceClass() = delete;
     DeviceClass(const DeviceClass&) = delete;
     DeviceClass(DeviceClass&&) = delete;
-    DeviceClass(MapperEngine& engine, DeviceManager& manager, const MAPPER_PLUGIN_DEVICE_OPS* pluginOps);
+    DeviceClass(MapperEngine& engine, DeviceManager& manager, const PluginDeviceOps& pluginOps);
     ~DeviceClass();
 
     operator FSMAPPERCTX* (){return &contextForPlugin;};
-    const MAPPER_PLUGIN_DEVICE_OPS& plugin(){return *pluginOps;};
+    const PluginDeviceOps& plugin(){return pluginOps;};
     DeviceManager& get_manager(){return manager;}
 };
 
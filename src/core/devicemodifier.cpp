@@ -7,10 +7,26 @@
 #include <optional>
 #include <vector>
 #include <cmath>
+#include <algorithm>
 #include "engine.h"
 #include "tools.h"
 #include "devicemodifier.h"
 
+//============================================================================================
+// Event registration for all units of a device
+//============================================================================================
+void DeviceModifierEventRegistry::commit(){
+    if (names.empty()){
+        return;
+    }
+    auto first = engine.registerEvents(std::move(names));
+    for (size_t i = 0; i < ids.size(); i++){
+        *ids[i] = first + i;
+    }
+    names.clear();
+    ids.clear();
+}
+
 //============================================================================================
 // raw modifier implementation
 //============================================================================================
@@ -56,11 +72,10 @@ public:
         return {evid, "change"};
     }
 
-    virtual std::shared_ptr<DeviceModifier> makeInstanceFitsToUnit(const char *devname, const FSMDEVUNITDEF& unit) const{
+    virtual std::shared_ptr<DeviceModifier> makeInstanceFitsToUnit(
+        const char *devname, const FSMDEVUNITDEF& unit, DeviceModifierEventRegistry& registry) const{
         auto instanse = std::make_shared<RawModifier>(*this);
-        std::ostringstream os;
-        os << devname << ":" << unit.name << ":change";
-        instanse->evid = manager.getEngine().registerEvent(os.str());
+        registry.reserve(devname, unit.name, "change", instanse->evid);
         instanse->unit_max = unit.maxValue;
         instanse->unit_min = unit.minValue;
         instanse->unit_maxf = unit.maxValue;
@@ -99,81 +114,104 @@ public:
     }
 };
 
+//============================================================================================
+// common implementation of modifiers driven by a state machine
+//    A modifier instance works as the context of its state machine. It holds the event IDs
+//    and the timer handles of a unit. DEVICEMOD_INVALID_TIMER is held while the timer of a
+//    kind is not running.
+//============================================================================================
+template <size_t EVENT_NUM, size_t TIMER_NUM>
+class StateMachineModifier : public DeviceModifier{
+protected:
+    uint64_t evids[EVENT_NUM] = {};
+    DEVICEMOD_TIMER timers[TIMER_NUM] = {};
+
+public:
+    StateMachineModifier(DeviceModifierManager& manager) : DeviceModifier(manager){};
+    StateMachineModifier(const StateMachineModifier&) = default;
+    virtual ~StateMachineModifier(){
+        for (auto timer : timers){
+            if (timer != DEVICEMOD_INVALID_TIMER){
+                manager.cancelTimer(timer);
+            }
+        }
+        for (auto evid : evids){
+            if (evid){
+                manager.getEngine().unregisterEvent(evid);
+            }
+        }
+    }
+
+    // context of the state machine
+    void sendEvent(size_t kind){
+        manager.getEngine().sendEvent(std::move(::Event(evids[kind])));
+    }
+    void sendEvent(size_t kind, int64_t value){
+        manager.getEngine().sendEvent(std::move(::Event(evids[kind], value)));
+    }
+    void startTimer(size_t kind, DEVICEMOD_TIME at){
+        if (timers[kind] != DEVICEMOD_INVALID_TIMER){
+            manager.cancelTimer(timers[kind]);
+        }
+        timers[kind] = manager.addTimer(*this, at);
+    }
+    void cancelTimer(size_t kind){
+        if (timers[kind] != DEVICEMOD_INVALID_TIMER){
+            manager.cancelTimer(timers[kind]);
+            timers[kind] = DEVICEMOD_INVALID_TIMER;
+        }
+    }
+    bool isTimerRunning(size_t kind) const{
+        return timers[kind] != DEVICEMOD_INVALID_TIMER;
+    }
+
+protected:
+    // returns the kind of an expired timer, then the timer is regarded as not running
+    // TIMER_NUM is returned for a timer which has already been canceled or replaced
+    size_t expireTimer(DEVICEMOD_TIMER timer){
+        for (size_t kind = 0; kind < TIMER_NUM; kind++){
+            if (timers[kind] == timer){
+                timers[kind] = DEVICEMOD_INVALID_TIMER;
+                return kind;
+            }
+        }
+        return TIMER_NUM;
+    }
+};
+
 //============================================================================================
 // button modifier implementation
 //============================================================================================
-class ButtonModifier : public DeviceModifier{
+class ButtonModifier : public StateMachineModifier<ButtonStateMachine::EVENT_KIND_NUM, ButtonStateMachine::TIMER_KIND_NUM>{
 protected:
-    enum class Status{
-        off,
-        on,
-        maybedouble_up_off,
-        maybedouble_up_on,
-        maybedouble_down_on,
-        maybedouble_down_off,
-    };
-    Status status;
-    int lastvalue;
-    bool negative_polarity;
-    std::optional<int> threshold_max;
-    std::optional<int> threshold_min;
-    std::optional<int> longpress;
-    std::optional<int> doubleclick;
-    std::optional<int> repeat_interval;
-    std::optional<int> repeat_delay;
-    std::optional<int> follow_down;
-    std::optional<int> follow_up;
-    bool need_timer = false;
-
-    bool click_on_up;
-    DEVICEMOD_TIME starttime;
-    std::optional<DEVICEMOD_TIME> longpress_timer;
-    std::optional<DEVICEMOD_TIME> doubleclick_timer;
-    std::optional<DEVICEMOD_TIME> repeat_timer;
-    std::optional<DEVICEMOD_TIME> following_down_timer;
-    std::optional<DEVICEMOD_TIME> following_up_timer;
-    std::vector<Event> events;
-    struct {
-        size_t down;
-        size_t up;
-        size_t singleclick;
-        size_t doubleclick;
-        size_t longpressed;
-        size_t following_down;
-        size_t following_up;
-    }eventix;
+    using FSM = ButtonStateMachine;
+    std::shared_ptr<const FSM::Definition> definition;
+    FSM fsm;
 
 public:
     ButtonModifier(const ButtonModifier &) = default;
     ButtonModifier(DeviceModifierManager& manager, sol::object &param);
-    ~ButtonModifier();
+    ~ButtonModifier() = default;
 
-    virtual std::shared_ptr<DeviceModifier> makeInstanceFitsToUnit(const char *devname, const FSMDEVUNITDEF &unit) const;
+    virtual std::shared_ptr<DeviceModifier> makeInstanceFitsToUnit(
+        const char *devname, const FSMDEVUNITDEF &unit, DeviceModifierEventRegistry& registry) const;
     virtual size_t getEventNum() const;
     virtual Event getEvent(size_t index) const;
 
     virtual void processUnitValueChangeEvent(int value);
     virtual void processUnitValueChangeEvent(int value, DEVICEMOD_TIME now);
-    virtual void processTimerEvent(DEVICEMOD_TIME timer_time);
-
-protected:
-    enum class CoockedEvent{
-        none,
-        down,
-        up,
-    };
-    CoockedEvent coockEvent(int value);
+    virtual void processTimerEvent(DEVICEMOD_TIMER timer, DEVICEMOD_TIME timer_time);
 };
 
-ButtonModifier::ButtonModifier(DeviceModifierManager& manager, sol::object &param) : 
-    DeviceModifier(manager), status(Status::off), lastvalue(0), negative_polarity(false), click_on_up(true){
+ButtonModifier::ButtonModifier(DeviceModifierManager& manager, sol::object &param) : StateMachineModifier(manager){
+    auto definition = std::make_shared<FSM::Definition>();
     if (param.get_type() == sol::type::table){
         auto table = param.as<sol::table>();
         sol::object polarity = table["polarity"];
         if (polarity.get_type() != sol::type::lua_nil){
             auto val = polarity.as<std::string>();
             if (val == "negative"){
-                negative_polarity = true;
+                definition->negative_polarity = true;
             }else if (val != "positive"){
                 throw MapperException("Value of \"polarity\" parameter for button modifier is invalid. "
                                       "Only \"positive\" or \"negative\" can be specified.");
@@ -191,6 +229,8 @@ ButtonModifier::ButtonModifier(DeviceModifierManager& manager, sol::object &para
             }
             return std::optional<int>();
         };
+        auto& threshold_max = definition->threshold_max;
+        auto& threshold_min = definition->threshold_min;
         threshold_max = get_number("max_threshold");
         threshold_min = get_number("min_threshold");
         if ((threshold_max.has_value() && !threshold_min.has_value()) ||
@@ -202,6 +242,8 @@ ButtonModifier::ButtonModifier(DeviceModifierManager& manager, sol::object &para
             throw MapperException("Value of \"max_threshold\" parameter for button modifier "
                                   "must be grater than value of \"min_threshold\" parammeter");
         }
+        auto& longpress = definition->longpress;
+        auto& doubleclick = definition->doubleclick;
         longpress = get_number("longpress");
         doubleclick = get_number("doubleclick");
         if (longpress.has_value() && doubleclick.has_value() && longpress <= doubleclick){
@@ -212,388 +254,158 @@ ButtonModifier::ButtonModifier(DeviceModifierManager& manager, sol::object &para
         if (click_timing.get_type() != sol::type::lua_nil){
             auto val = click_timing.as<std::string>();
             if (val == "down"){
-                click_on_up = false;
+                definition->click_on_up = false;
             }else if (val != "up"){
                 throw MapperException("Value of \"click_timing\" parameter for button modifier is invalid. "
                                       "Only \"up\" or \"down\" can be specified.");
             }
         }
-        repeat_interval = get_number("repeat_interval");
-        repeat_delay = get_number("repeat_delay");
-        follow_down = get_number("follow_down");
-        follow_up = get_number("follow_up");
+        definition->repeat_interval = get_number("repeat_interval");
+        definition->repeat_delay = get_number("repeat_delay");
+        definition->follow_down = get_number("follow_down");
+        definition->follow_up = get_number("follow_up");
 
-        if (doubleclick || longpress || repeat_interval || follow_down || follow_up){
-            need_timer = true;
+        if (doubleclick || longpress || definition->repeat_interval || definition->follow_down || definition->follow_up){
+            definition->need_timer = true;
         }
     }
+    definition->compile();
+    this->definition = std::move(definition);
 }
 
-ButtonModifier::~ButtonModifier(){
-    if (doubleclick_timer){
-        manager.cancelTimer(*this, *doubleclick_timer);
-    }
-    if (longpress_timer){
-        manager.cancelTimer(*this, *longpress_timer);
-    }
-    if (repeat_timer){
-        manager.cancelTimer(*this, *repeat_timer);
-    }
-    if (following_down_timer){
-        manager.cancelTimer(*this, *following_down_timer);
-    }
-    if (following_up_timer){
-        manager.cancelTimer(*this, *following_up_timer);
-    }
-    for (auto iterator = events.begin(); iterator != events.end(); iterator++){
-        manager.getEngine().unregisterEvent(iterator->id);
-    }
-}
-
-std::shared_ptr<DeviceModifier> ButtonModifier::makeInstanceFitsToUnit(const char *devname, const FSMDEVUNITDEF &unit) const{
+std::shared_ptr<DeviceModifier> ButtonModifier::makeInstanceFitsToUnit(
+    const char *devname, const FSMDEVUNITDEF &unit, DeviceModifierEventRegistry& registry) const{
     auto instance = std::make_shared<ButtonModifier>(*this);
-    if (!instance->threshold_max.has_value()){
-        instance->threshold_min = unit.minValue + (unit.maxValue - unit.minValue) / 2;
-        instance->threshold_max = instance->threshold_min.value() + 1;
-    }else if (instance->threshold_max.value() > unit.maxValue || instance->threshold_min < unit.minValue){
+    if (!definition->threshold_max.has_value()){
+        auto threshold_min = unit.minValue + (unit.maxValue - unit.minValue) / 2;
+        instance->fsm.setThresholds(threshold_min + 1, threshold_min);
+    }else if (definition->threshold_max.value() > unit.maxValue || definition->threshold_min < unit.minValue){
         std::ostringstream os;
         os << "\"max_threshold\" or \"min_threshold\" parameter value of the modifier applied to the unit is out of range. [device: ";
         os << devname << "] [unit: " << unit.name;
         throw MapperException(std::move(os.str()));
+    }else{
+        instance->fsm.setThresholds(*definition->threshold_max, *definition->threshold_min);
     }
-
-    auto register_event = [&instance, devname, &unit](const char* evname){
-        std::ostringstream os;
-        os << devname << ":" << unit.name << ":" << evname;
-        instance->events.push_back(Event{
-            instance->manager.getEngine().registerEvent(os.str()),
-            evname,
-        });
-    };
-    instance->eventix.down = instance->events.size();
-    register_event("down");
-    instance->eventix.up = instance->events.size();
-    register_event("up");
-    if (doubleclick.has_value()){
-        instance->eventix.singleclick = instance->events.size();
-        register_event("singleclick");
-        instance->eventix.doubleclick = instance->events.size();
-        register_event("doubleclick");
-    }
-    if (longpress.has_value()){
-        instance->eventix.longpressed = instance->events.size();
-        register_event("longpressed");
-    }
-    if (follow_down){
-        instance->eventix.following_down = instance->events.size();
-        register_event("following_down");
-    }
-    if (follow_up){
-        instance->eventix.following_up = instance->events.size();
-        register_event("following_up");
+    for (size_t i = 0; i < definition->event_num; i++){
+        auto kind = definition->event_kinds[i];
+        registry.reserve(devname, unit.name, FSM::event_names[kind], instance->evids[kind]);
     }
-
     return instance;
 }
 
 size_t ButtonModifier::getEventNum() const{
-    return events.size();
+    return definition->event_num;
 }
 
 ButtonModifier::Event ButtonModifier::getEvent(size_t index) const{
-    return events.at(index);
-}
-
-ButtonModifier::CoockedEvent ButtonModifier::coockEvent(int value){
-    auto lastvalue = this->lastvalue;
-    this->lastvalue = value;
-    if (lastvalue < threshold_max && value >= threshold_max){
-        return negative_polarity ? CoockedEvent::up : CoockedEvent::down;
-    }else if (lastvalue > threshold_min && value <= threshold_min){
-        return negative_polarity ? CoockedEvent::down : CoockedEvent::up;
-    }else{
-        return CoockedEvent::none;
+    if (index >= definition->event_num){
+        throw std::out_of_range("invalid event index for button modifier");
     }
+    auto kind = definition->event_kinds[index];
+    return {evids[kind], FSM::event_names[kind]};
 }
 
 void ButtonModifier::processUnitValueChangeEvent(int value){
-    if (need_timer){
+    if (definition->need_timer){
         manager.delegateEventProcessing(*this, value);
     }else{
-        auto event = coockEvent(value);
-        uint64_t evid;
-        if (event == CoockedEvent::down){
-            evid = events[eventix.down].id;
-        }else if (event == CoockedEvent::up){
-            evid = events[eventix.up].id;
-        }else{
-            return;
-        }
-        manager.getEngine().sendEvent(std::move(::Event(evid)));
+        fsm.processValue(*definition, *this, value);
     }
 }
 
 void ButtonModifier::processUnitValueChangeEvent(int value, DEVICEMOD_TIME now){
-    auto event = coockEvent(value);
-    if (event == CoockedEvent::none){
-        return;
-    }
-    if (repeat_interval.has_value()){
-        if (event == CoockedEvent::down){
-            auto delay = repeat_delay ? *repeat_delay : 500;
-            repeat_timer = manager.addTimer(*this, now + DEVICEMOD_MILLISEC(delay));
-        }else if (repeat_timer.has_value()){
-            manager.cancelTimer(*this, repeat_timer.value());
-        }
-    }
-    if (follow_down && event == CoockedEvent::down && !following_down_timer){
-        following_down_timer = manager.addTimer(*this, now + DEVICEMOD_MILLISEC(*follow_down));
-    }
-    if (follow_up && event == CoockedEvent::up && !following_up_timer){
-        following_up_timer = manager.addTimer(*this, now + DEVICEMOD_MILLISEC(*follow_up));
-    }
-    
-    if (status == Status::off && event == CoockedEvent::down){
-        starttime = now;
-        manager.getEngine().sendEvent(std::move(::Event(events[eventix.down].id)));
-        if (longpress.has_value()){
-            longpress_timer = manager.addTimer(*this, starttime + DEVICEMOD_MILLISEC(longpress.value()));
-        }
-        if (doubleclick.has_value() && !click_on_up){
-            status = Status::maybedouble_down_on;
-            doubleclick_timer = manager.addTimer(*this, starttime + DEVICEMOD_MILLISEC(doubleclick.value()));
-        }else{
-            status = Status::on;
-        }
-    }else if (status == Status::on && event == CoockedEvent::up){
-        manager.getEngine().sendEvent(std::move(::Event(events[eventix.up].id)));
-        if (longpress_timer.has_value()){
-            manager.cancelTimer(*this, longpress_timer.value());
-            longpress_timer = std::nullopt;
-        }
-        if (doubleclick.has_value() && click_on_up){
-            if (now < starttime + DEVICEMOD_MILLISEC(doubleclick.value())){
-                status = Status::maybedouble_up_off;
-                doubleclick_timer = manager.addTimer(*this, starttime + DEVICEMOD_MILLISEC(doubleclick.value()));
-            }else{
-                manager.getEngine().sendEvent(std::move(::Event(events[eventix.singleclick].id)));
-                status = Status::off;
-            }
-        }else{
-            status = Status::off;
-        }
-    }else if (status == Status::maybedouble_up_off && event == CoockedEvent::down){
-        manager.getEngine().sendEvent(std::move(::Event(events[eventix.down].id)));
-        if (longpress.has_value()){
-            longpress_timer = manager.addTimer(*this, starttime + DEVICEMOD_MILLISEC(longpress.value()));
-        }
-        status = Status::maybedouble_up_on;
-    }else if (status == Status::maybedouble_up_on && event == CoockedEvent::up){
-        manager.getEngine().sendEvent(std::move(::Event(events[eventix.up].id)));
-        manager.getEngine().sendEvent(std::move(::Event(events[eventix.doubleclick].id)));
-        if (doubleclick_timer.has_value()){
-            manager.cancelTimer(*this, doubleclick_timer.value());
-            doubleclick_timer = std::nullopt;
-        }
-        if (longpress_timer.has_value()){
-            manager.cancelTimer(*this, longpress_timer.value());
-            longpress_timer = std::nullopt;
-        }
-        status = Status::off;
-    }
-    else if (status == Status::maybedouble_down_on && event == CoockedEvent::up){
-        manager.getEngine().sendEvent(std::move(::Event(events[eventix.up].id)));
-        if (longpress_timer.has_value()){
-            manager.cancelTimer(*this, longpress_timer.value());
-            longpress_timer = std::nullopt;
-        }
-        status = Status::maybedouble_down_off;
-    }else if (status == Status::maybedouble_down_off && event == CoockedEvent::down){
-        manager.getEngine().sendEvent(std::move(::Event(events[eventix.down].id)));
-        manager.getEngine().sendEvent(std::move(::Event(events[eventix.doubleclick].id)));
-        if (doubleclick_timer.has_value()){
-            manager.cancelTimer(*this, doubleclick_timer.value());
-            doubleclick_timer = std::nullopt;
-        }
-        starttime = now;
-        status = Status::on;
-        if (longpress.has_value()){
-            manager.addTimer(*this, starttime + DEVICEMOD_MILLISEC(longpress.value()));
-        }
-    }
-};
+    fsm.processValue(*definition, *this, value, now);
+}
 
-void ButtonModifier::processTimerEvent(DEVICEMOD_TIME timer_time){
-    if (doubleclick_timer.has_value() && timer_time == doubleclick_timer.value()){
-        manager.getEngine().sendEvent(std::move(::Event(events[eventix.singleclick].id)));
-        doubleclick_timer = std::nullopt;
-        if (status == Status::maybedouble_down_off || status == Status::maybedouble_up_off){
-            status = Status::off;
-        }else if (status == Status::maybedouble_down_on || status == Status::maybedouble_up_on){
-            status = Status::on;
-        }
-    }else if (longpress_timer.has_value() && timer_time == longpress_timer.value()){
-        manager.getEngine().sendEvent(std::move(::Event(events[eventix.longpressed].id)));
-        longpress_timer = std::nullopt;
-        status = Status::off;
-    }else if (repeat_timer.has_value() && timer_time == repeat_timer.value()){
-        manager.getEngine().sendEvent(std::move(::Event(events[eventix.down].id)));
-        repeat_timer = manager.addTimer(*this, timer_time + DEVICEMOD_MILLISEC(repeat_interval.value()));
-    }else if (follow_down && timer_time == *following_down_timer){
-        manager.getEngine().sendEvent(std::move(::Event(events[eventix.following_down].id)));
-        following_down_timer = std::nullopt;
-    }else if (follow_up && timer_time == *following_up_timer){
-        manager.getEngine().sendEvent(std::move(::Event(events[eventix.following_up].id)));
-        following_up_timer = std::nullopt;
+void ButtonModifier::processTimerEvent(DEVICEMOD_TIMER timer, DEVICEMOD_TIME timer_time){
+    auto kind = expireTimer(timer);
+    if (kind < FSM::TIMER_KIND_NUM){
+        fsm.processTimer(*definition, *this, static_cast<FSM::TimerKind>(kind), timer_time);
     }
-};
+}
 
 //============================================================================================
 // increment/decrement modifier implementation
 //============================================================================================
-class IncDecModifier : public DeviceModifier{
+class IncDecModifier : public StateMachineModifier<IncDecStateMachine::EVENT_KIND_NUM, IncDecStateMachine::TIMER_KIND_NUM>{
 protected:
-    bool pulse_mode{false};
-    int pulse_duration{30};
-    int pulse_interval{30};
-    bool is_absolute;
-    int last_value;
-    uint64_t evid_increment;
-    uint64_t evid_decrement;
-
-    enum class Status{
-        init,
-        down,
-        up,
-    };
-    Status status{Status::init};
-    std::optional<DEVICEMOD_TIME> hold_timer;
-    DEVICEMOD_TIME last_event_time{DEVICEMOD_CLOCK::now()};
-    int max_hold_num{4};
-    int hold_top = 0;
-    int hold_bottom = 0;
-    static constexpr auto hold_buffer_len{16};
-    static constexpr auto hold_buffer_mask{0xf};
-    bool hold_buffer[hold_buffer_len];
+    using FSM = IncDecStateMachine;
+    std::shared_ptr<const FSM::Definition> definition;
+    FSM fsm;
 
 public:
     IncDecModifier(const IncDecModifier&) = default;
-    IncDecModifier(DeviceModifierManager& manager, sol::object &param) : DeviceModifier(manager), evid_increment(0), evid_decrement(0){
+    IncDecModifier(DeviceModifierManager& manager, sol::object &param) : StateMachineModifier(manager){
+        auto definition = std::make_shared<FSM::Definition>();
         if (param.get_type() == sol::type::table){
             auto table = param.as<sol::table>();
             sol::object pulse_mode = table["pulse_mode"];
             if (pulse_mode.get_type() == sol::type::boolean){
-                this->pulse_mode = pulse_mode.as<bool>();
+                definition->pulse_mode = pulse_mode.as<bool>();
             }else if (pulse_mode.get_type() != sol::type::lua_nil){
                 throw MapperException("value of pusle_mode parameter for incdec modifier must be boolean");
             }
 
             auto pulse_duration = lua_safevalue<double>(table["pulse_duration"]);
-            this->pulse_duration = pulse_duration ? round(*pulse_duration) : this->pulse_duration;
+            definition->pulse_duration = pulse_duration ? round(*pulse_duration) : definition->pulse_duration;
             auto pulse_interval = lua_safevalue<double>(table["pulse_interval"]);
-            this->pulse_interval = pulse_interval ? round(*pulse_interval) : this->pulse_interval;
+            definition->pulse_interval = pulse_interval ? round(*pulse_interval) : definition->pulse_interval;
             auto max_hold_num = lua_safevalue<double>(table["max_hold_num"]);
-            this->max_hold_num = max_hold_num ? round(*max_hold_num) : this->max_hold_num;
-            if (this->max_hold_num < 1 || this->max_hold_num > hold_buffer_len){
+            definition->max_hold_num = max_hold_num ? round(*max_hold_num) : definition->max_hold_num;
+            if (definition->max_hold_num < 1 || definition->max_hold_num > static_cast<int>(FSM::HOLD_BUFFER_LEN)){
                 std::ostringstream os;
-                os << "value of max_hold_num for incdec modifier must be between 1 and " << hold_buffer_len;
+                os << "value of max_hold_num for incdec modifier must be between 1 and " << FSM::HOLD_BUFFER_LEN;
                 throw MapperException(os.str());
             }
         }
+        this->definition = std::move(definition);
     };
-    virtual ~IncDecModifier(){
-        if (evid_increment != 0){
-            manager.getEngine().unregisterEvent(evid_increment);
-        }
-        if (evid_decrement != 0){
-            manager.getEngine().unregisterEvent(evid_decrement);
-        }
-        if (hold_timer){
-            manager.cancelTimer(*this, *hold_timer);
-        }
-    }
+    virtual ~IncDecModifier() = default;
 
-    virtual std::shared_ptr<DeviceModifier> makeInstanceFitsToUnit(const char *devname, const FSMDEVUNITDEF& unit) const{
+    virtual std::shared_ptr<DeviceModifier> makeInstanceFitsToUnit(
+        const char *devname, const FSMDEVUNITDEF& unit, DeviceModifierEventRegistry& registry) const{
         auto instanse = std::make_shared<IncDecModifier>(*this);
-        instanse->is_absolute = unit.type == FSMDU_TYPE_ABSOLUTE;
-        instanse->last_value = unit.minValue + (unit.maxValue - unit.minValue) / 2;
+        instanse->fsm.fitToUnit(unit.type == FSMDU_TYPE_ABSOLUTE, unit.minValue + (unit.maxValue - unit.minValue) / 2);
 
-        auto new_event_id = [this, devname, &unit](const char* evname){
-            std::ostringstream os;
-            os << devname << ":" << unit.name << ":" << evname;
-            return this->manager.getEngine().registerEvent(os.str());
-        };
-        instanse->evid_increment = new_event_id(pulse_mode ? "increment_pulse" : "increment");
-        instanse->evid_decrement = new_event_id(pulse_mode ? "decrement_pulse" : "decrement");
+        registry.reserve(devname, unit.name, eventName(FSM::EVENT_INCREMENT), instanse->evids[FSM::EVENT_INCREMENT]);
+        registry.reserve(devname, unit.name, eventName(FSM::EVENT_DECREMENT), instanse->evids[FSM::EVENT_DECREMENT]);
 
         return instanse;
     }
 
     virtual size_t getEventNum() const{
-        return 2;
+        return FSM::EVENT_KIND_NUM;
     }
     virtual Event getEvent(size_t index) const{
-        if (index == 0){
-            return {evid_increment, pulse_mode ? "increment_pulse" : "increment"};
-        }else{
-            return {evid_decrement, pulse_mode ? "decrement_pulse" : "decrement"};
-        }
+        auto kind = index == 0 ? FSM::EVENT_INCREMENT : FSM::EVENT_DECREMENT;
+        return {evids[kind], eventName(kind)};
     }
 
     virtual void processUnitValueChangeEvent(int value){
-        if (pulse_mode){
+        if (definition->pulse_mode){
             manager.delegateEventProcessing(*this, value);
         }else{
-            auto delta = is_absolute ? value - last_value : value;
-            last_value = value;
-            if (delta > 0){
-                manager.getEngine().sendEvent(std::move(::Event(evid_increment, static_cast<int64_t>(delta))));
-            }else if (delta < 0){
-                manager.getEngine().sendEvent(std::move(::Event(evid_decrement, static_cast<int64_t>(-delta))));
-            }
+            fsm.processValue(*definition, *this, value);
         }
     }
 
     virtual void processUnitValueChangeEvent(int value, DEVICEMOD_TIME now){
-        auto delta = is_absolute ? value - last_value : value;
-        last_value = value;
-        if (hold_bottom - hold_top < max_hold_num){
-            hold_buffer[hold_bottom & hold_buffer_mask] = delta > 0;
-            hold_bottom++;
-            if (status == Status::init){
-                if (now >= last_event_time + DEVICEMOD_MILLISEC(pulse_interval)){
-                    manager.getEngine().sendEvent(std::move(::Event(delta > 0 ? evid_increment : evid_decrement, 1LL)));
-                    status = Status::down;
-                    hold_timer = manager.addTimer(*this, now + DEVICEMOD_MILLISEC(pulse_duration));
-                }else{
-                    status = Status::up;
-                    hold_timer = manager.addTimer(*this, last_event_time + DEVICEMOD_MILLISEC(pulse_interval));
-                }
-            }
+        fsm.processValue(*definition, *this, value, now);
+    }
+
+    virtual void processTimerEvent(DEVICEMOD_TIMER timer, DEVICEMOD_TIME timer_time){
+        if (expireTimer(timer) == FSM::TIMER_HOLD){
+            fsm.processTimer(*definition, *this, timer_time);
         }
     }
 
-    virtual void processTimerEvent(DEVICEMOD_TIME timer_time){
-        hold_timer = std::nullopt;
-        last_event_time = timer_time;
-        if (status == Status::down){
-            manager.getEngine().sendEvent(std::move(::Event(hold_buffer[hold_top & hold_buffer_mask] ? evid_increment : evid_decrement, 0LL)));
-            hold_top++;
-            if (hold_bottom - hold_top == 0){
-                status = Status::init;
-            }else{
-                status = Status::up;
-                hold_timer = manager.addTimer(*this, last_event_time + DEVICEMOD_MILLISEC(pulse_interval));
-            }
-        }else if (status == Status::up){
-            if (hold_bottom - hold_top > 0){
-                manager.getEngine().sendEvent(std::move(::Event(hold_buffer[hold_top & hold_buffer_mask] ? evid_increment : evid_decrement, 1LL)));
-                status = Status::down;
-                hold_timer = manager.addTimer(*this, last_event_time + DEVICEMOD_MILLISEC(pulse_duration));
-            }else{
-                // This case must be impossible
-                status = Status::init;
-            }
+protected:
+    const char* eventName(FSM::EventKind kind) const{
+        if (kind == FSM::EVENT_INCREMENT){
+            return definition->pulse_mode ? "increment_pulse" : "increment";
+        }else{
+            return definition->pulse_mode ? "decrement_pulse" : "decrement";
         }
     }
 };
@@ -601,46 +413,32 @@ public:
 //============================================================================================
 // QuantizedStickModifier modifier implementation
 //============================================================================================
-class QuantizedStickModifier : public DeviceModifier {
+class QuantizedStickModifier : public StateMachineModifier<QuantizedStickStateMachine::EVENT_KIND_NUM, QuantizedStickStateMachine::TIMER_KIND_NUM> {
 protected:
-    enum class Status {
-        center,
-        positive,
-        negative,
-    };
-    Status status{ Status::center };
-    int threshold_center_to_positive{ 30000 };
-    int threshold_positive_to_center{ 20000 };
-    int threshold_center_to_negative{ -30000 };
-    int threshold_negative_to_center{ -20000 };
-
-    bool repeat_mode{ true };
-    int repeat_delay{ 500 };
-    int repeat_interval{ 500 };
-    DEVICEMOD_TIME starttime;
-    std::optional<DEVICEMOD_TIME> repeat_timer;
-
-    size_t evid_positive;
-    size_t evid_negative;
+    using FSM = QuantizedStickStateMachine;
+    static constexpr const char* event_names[FSM::EVENT_KIND_NUM] = {"positive", "negative"};
+    std::shared_ptr<const FSM::Definition> definition;
+    FSM fsm;
 
 public:
     QuantizedStickModifier(const QuantizedStickModifier&) = default;
-    QuantizedStickModifier(DeviceModifierManager& manager, sol::object& param) : DeviceModifier(manager) {
+    QuantizedStickModifier(DeviceModifierManager& manager, sol::object& param) : StateMachineModifier(manager) {
+        auto definition = std::make_shared<FSM::Definition>();
         if (param.get_type() == sol::type::table) {
             // Find out if the signal should repeat
             auto table = param.as<sol::table>();
             sol::object repeat_mode = table["repeat_mode"];
             if (repeat_mode.get_type() == sol::type::boolean) {
-                this->repeat_mode = repeat_mode.as<bool>();
+                definition->repeat_mode = repeat_mode.as<bool>();
             }
             else if (repeat_mode.get_type() != sol::type::lua_nil) {
                 throw MapperException("value of \"repeat_mode\" parameter for quantized_stick modifier must be boolean");
             }
             // Get the details of the repeat delay and interval
             auto repeat_delay = lua_safevalue<double>(table["repeat_delay"]);
-            this->repeat_delay = repeat_delay ? round(*repeat_delay) : this->repeat_delay;
+            definition->repeat_delay = repeat_delay ? round(*repeat_delay) : definition->repeat_delay;
             auto repeat_interval = lua_safevalue<double>(table["repeat_interval"]);
-            this->repeat_interval = repeat_interval ? round(*repeat_interval) : this->repeat_interval;
+            definition->repeat_interval = repeat_interval ? round(*repeat_interval) : definition->repeat_interval;
             // Get the thresholds of when the stick axis is pressed or released
             auto activate_threshold = lua_safevalue<double>(table["activate_threshold"]);
             if (activate_threshold) {
@@ -648,8 +446,8 @@ public:
                 if (activate < 0 || activate > 50000) {
                     throw MapperException("value of \"activate_threshold\" for quantized_stick modifier must be between 0 and 50000");
                 }
-                this->threshold_center_to_positive = activate;
-                this->threshold_center_to_negative = activate * -1;
+                definition->threshold_center_to_positive = activate;
+                definition->threshold_center_to_negative = activate * -1;
             }
             auto release_threshold = lua_safevalue<double>(table["release_threshold"]);
             if (release_threshold) {
@@ -657,122 +455,252 @@ public:
                 if (release < 0 || release > 50000) {
                     throw MapperException("value of \"release_threshold\" for thubmstick modifier must be between 0 and 50000");
                 }
-                this->threshold_positive_to_center = release;
-                this->threshold_negative_to_center = release * -1;
+                definition->threshold_positive_to_center = release;
+                definition->threshold_negative_to_center = release * -1;
             }
         }
+        definition->compile();
+        this->definition = std::move(definition);
     }
 
-    virtual ~QuantizedStickModifier() {
-        if (repeat_timer) {
-            manager.cancelTimer(*this, *repeat_timer);
-            repeat_timer = std::nullopt;
-        }
-        manager.getEngine().unregisterEvent(this->evid_positive);
-        manager.getEngine().unregisterEvent(this->evid_negative);
-    }
+    virtual ~QuantizedStickModifier() = default;
 
-    virtual std::shared_ptr<DeviceModifier> makeInstanceFitsToUnit(const char* devname, const FSMDEVUNITDEF& unit) const {
+    virtual std::shared_ptr<DeviceModifier> makeInstanceFitsToUnit(
+        const char* devname, const FSMDEVUNITDEF& unit, DeviceModifierEventRegistry& registry) const {
         auto instance = std::make_shared<QuantizedStickModifier>(*this);
-        auto new_event_id = [this, devname, &unit](const char* evname) {
-            std::ostringstream os;
-            os << devname << ":" << unit.name << ":" << evname;
-            return this->manager.getEngine().registerEvent(os.str());
-        };
-        instance->evid_positive = new_event_id("positive");
-        instance->evid_negative = new_event_id("negative");
+        for (size_t kind = 0; kind < FSM::EVENT_KIND_NUM; kind++) {
+            registry.reserve(devname, unit.name, event_names[kind], instance->evids[kind]);
+        }
         return instance;
     }
 
-    virtual size_t getEventNum() const { return 2; }
+    virtual size_t getEventNum() const { return FSM::EVENT_KIND_NUM; }
 
     virtual Event getEvent(size_t index) const {
-        if (index == 0) {
-            return { evid_positive, "positive" };
-        }
-        else {
-            return { evid_negative, "negative" };
-        }
+        auto kind = index == 0 ? FSM::EVENT_POSITIVE : FSM::EVENT_NEGATIVE;
+        return { evids[kind], event_names[kind] };
     }
 
     virtual void processUnitValueChangeEvent(int value) {
-        if (repeat_mode) { manager.delegateEventProcessing(*this, value); }
-        else {
-            switch (status) {
-                case Status::center:
-                    if (value >= threshold_center_to_positive) {
-                        status = Status::positive;
-                        manager.getEngine().sendEvent(std::move(::Event(evid_positive)));
-                    }
-                    else if (value <= threshold_center_to_negative) {
-                        status = Status::negative;
-                        manager.getEngine().sendEvent(std::move(::Event(evid_negative)));
-                    }
-                    break;
-                case Status::negative:
-                    if (value > threshold_negative_to_center) {
-                        status = Status::center;
-                    }
-                    break;
-                case Status::positive:
-                    if (value < threshold_positive_to_center) {
-                        status = Status::center;
-                    }
+        if (definition->repeat_mode) { manager.delegateEventProcessing(*this, value); }
+        else { fsm.processValue(*definition, *this, value); }
+    }
+
+    virtual void processUnitValueChangeEvent(int value, DEVICEMOD_TIME now) {
+        fsm.processValue(*definition, *this, value, now);
+    }
+
+    virtual void processTimerEvent(DEVICEMOD_TIMER timer, DEVICEMOD_TIME timer_time) {
+        if (expireTimer(timer) == FSM::TIMER_REPEAT) {
+            fsm.processTimer(*definition, *this, timer_time);
+        }
+    }
+};
+
+//============================================================================================
+// common implementation of combination modifiers
+//============================================================================================
+DeviceCombinationModifier::~DeviceCombinationModifier(){
+    if (evid != 0){
+        manager.getEngine().unregisterEvent(evid);
+    }
+}
+
+std::vector<std::string> DeviceCombinationModifier::parseUnitList(sol::object& param, const char* modtype){
+    std::vector<std::string> list;
+    if (param.get_type() == sol::type::table){
+        sol::object units = param.as<sol::table>()["units"];
+        if (units.get_type() == sol::type::table){
+            auto table = units.as<sol::table>();
+            for (int i = 1; i <= table.size(); i++){
+                auto unit_name = lua_safestring(table[i]);
+                if (unit_name == ""){
+                    list.clear();
                     break;
+                }
+                list.push_back(std::move(unit_name));
             }
         }
     }
+    if (list.size() < 2){
+        std::ostringstream os;
+        os << "\"units\" parameter for " << modtype << " modifier must be an array of two or more unit names.";
+        throw MapperException(os.str());
+    }
+    return list;
+}
 
-    virtual void processUnitValueChangeEvent(int value, DEVICEMOD_TIME now) {
-        switch (status) {
-            case Status::center:
-                if (value >= threshold_center_to_positive) {
-                    status = Status::positive;
-                    manager.getEngine().sendEvent(std::move(::Event(evid_positive)));
-                    repeat_timer = manager.addTimer(*this, now + DEVICEMOD_MILLISEC(repeat_delay));
-                }
-                else if (value <= threshold_center_to_negative) {
-                    status = Status::negative;
-                    manager.getEngine().sendEvent(std::move(::Event(evid_negative)));
-                    repeat_timer = manager.addTimer(*this, now + DEVICEMOD_MILLISEC(repeat_delay));
-                }
-                break;
-            case Status::negative:
-                if (value > threshold_negative_to_center) {
-                    status = Status::center;
-                    if (repeat_timer.has_value()) {
-                        manager.cancelTimer(*this, repeat_timer.value());
-                        repeat_timer = std::nullopt;
-                    }
-                }
-                break;
-            case Status::positive:
-                if (value < threshold_positive_to_center) {
-                    status = Status::center;
-                    if (repeat_timer.has_value()) {
-                        manager.cancelTimer(*this, repeat_timer.value());
-                        repeat_timer = std::nullopt;
-                    }
-                }
-                break;
+size_t DeviceCombinationModifier::addUnit(const std::string& unit_name){
+    auto found = std::find(unit_names.begin(), unit_names.end(), unit_name);
+    if (found != unit_names.end()){
+        return found - unit_names.begin();
+    }
+    unit_names.push_back(unit_name);
+    return unit_names.size() - 1;
+}
+
+void DeviceCombinationModifier::fitToDevice(DeviceCombinationModifier& instance, const char* devname,
+                                            const std::vector<FSMDEVUNITDEF>& unitDefs, DeviceModifierEventRegistry& registry) const{
+    for (const auto& unit : unitDefs){
+        if (name == unit.name){
+            std::ostringstream os;
+            os << "The name of the combination modifier conflicts with a unit name. [device: " << devname << "] [name: " << name << "]";
+            throw MapperException(os.str());
+        }
+    }
+    instance.units.clear();
+    instance.thresholds.clear();
+    for (const auto& unit_name : unit_names){
+        auto unit = std::find_if(unitDefs.begin(), unitDefs.end(), [&unit_name](const FSMDEVUNITDEF& def){
+            return unit_name == def.name;
+        });
+        if (unit == unitDefs.end() || unit->direction != FSMDU_DIR_INPUT){
+            std::ostringstream os;
+            os << "The unit observed by the combination modifier is not an input unit of the device. [device: ";
+            os << devname << "] [name: " << name << "] [unit: " << unit_name << "]";
+            throw MapperException(os.str());
         }
+        instance.units.push_back(unit - unitDefs.begin());
+        instance.thresholds.push_back(unit->minValue + (unit->maxValue - unit->minValue) / 2);
     }
+    instance.unit_status.assign(unit_names.size(), 0);
+    registry.reserve(devname, name.c_str(), "detected", instance.evid);
+}
 
-    virtual void processTimerEvent(DEVICEMOD_TIME timer_time) {
-        if (repeat_timer.has_value() && timer_time == repeat_timer.value()) {
-            switch (status) {
-                case Status::center:
-                    repeat_timer = std::nullopt;
-                    break;
-                case Status::positive:
-                    manager.getEngine().sendEvent(std::move(::Event(evid_positive)));
-                    repeat_timer = manager.addTimer(*this, timer_time + DEVICEMOD_MILLISEC(repeat_interval));
-                    break;
-                case Status::negative:
-                    manager.getEngine().sendEvent(std::move(::Event(evid_negative)));
-                    repeat_timer = manager.addTimer(*this, timer_time + DEVICEMOD_MILLISEC(repeat_interval));
-                    break;
+void DeviceCombinationModifier::notifyUnitValueChange(size_t slot, int value){
+    manager.delegateObservedEventProcessing(*this, slot, value);
+}
+
+//============================================================================================
+// chord modifier implementation
+//    The event is triggered when all units are turned on. Once triggered, the modifier is
+//    not triggered again until any of the units is turned off.
+//============================================================================================
+class ChordModifier : public DeviceCombinationModifier{
+protected:
+    std::optional<int> window;
+    bool ordered{false};
+    bool armed{true};
+    std::vector<DEVICEMOD_TIME> down_times;
+
+public:
+    ChordModifier(const ChordModifier&) = default;
+    ChordModifier(DeviceModifierManager& manager, const std::string& name, sol::object& param) :
+        DeviceCombinationModifier(manager, name){
+        for (const auto& unit_name : parseUnitList(param, "chord")){
+            auto slot_num = unit_names.size();
+            if (addUnit(unit_name) != slot_num){
+                throw MapperException("\"units\" parameter for chord modifier must not contain a same unit twice.");
+            }
+        }
+        auto table = param.as<sol::table>();
+        auto window = lua_safevalue<double>(table["window"]);
+        if (window){
+            this->window = static_cast<int>(std::round(*window));
+        }
+        sol::object ordered = table["ordered"];
+        if (ordered.get_type() == sol::type::boolean){
+            this->ordered = ordered.as<bool>();
+        }else if (ordered.get_type() != sol::type::lua_nil){
+            throw MapperException("value of \"ordered\" parameter for chord modifier must be boolean");
+        }
+    }
+
+    virtual std::shared_ptr<DeviceCombinationModifier> makeInstanceFitsToDevice(
+        const char* devname, const std::vector<FSMDEVUNITDEF>& unitDefs, DeviceModifierEventRegistry& registry) const{
+        auto instance = std::make_shared<ChordModifier>(*this);
+        fitToDevice(*instance, devname, unitDefs, registry);
+        instance->down_times.resize(unit_names.size());
+        return instance;
+    }
+
+    virtual void processObservedUnitValueChangeEvent(size_t slot, int value, DEVICEMOD_TIME now){
+        auto edge = detectEdge(slot, value);
+        if (edge < 0){
+            armed = true;
+            return;
+        }else if (edge == 0){
+            return;
+        }
+        down_times[slot] = now;
+        if (!armed){
+            return;
+        }
+        for (auto status : unit_status){
+            if (!status){
+                return;
+            }
+        }
+        if (window && now - *std::min_element(down_times.begin(), down_times.end()) > DEVICEMOD_MILLISEC(*window)){
+            return;
+        }
+        if (ordered && !std::is_sorted(down_times.begin(), down_times.end())){
+            return;
+        }
+        armed = false;
+        manager.getEngine().sendEvent(std::move(::Event(evid)));
+    }
+};
+
+//============================================================================================
+// sequence modifier implementation
+//    The event is triggered when units are turned on in the order of the list. Since a unit
+//    can appear more than once in the list, the progress falls back to the longest prefix
+//    which is also a suffix of the operations so far when an unexpected unit is turned on.
+//============================================================================================
+class SequenceModifier : public DeviceCombinationModifier{
+protected:
+    int interval{500};
+    std::vector<size_t> steps;
+    std::vector<size_t> fallbacks;
+    size_t position{0};
+    DEVICEMOD_TIME last_time;
+
+public:
+    SequenceModifier(const SequenceModifier&) = default;
+    SequenceModifier(DeviceModifierManager& manager, const std::string& name, sol::object& param) :
+        DeviceCombinationModifier(manager, name){
+        for (const auto& unit_name : parseUnitList(param, "sequence")){
+            steps.push_back(addUnit(unit_name));
+        }
+        fallbacks.resize(steps.size(), 0);
+        for (size_t i = 1, length = 0; i < steps.size(); i++){
+            while (length > 0 && steps[i] != steps[length]){
+                length = fallbacks[length - 1];
             }
+            if (steps[i] == steps[length]){
+                length++;
+            }
+            fallbacks[i] = length;
+        }
+        auto interval = lua_safevalue<double>(param.as<sol::table>()["interval"]);
+        this->interval = interval ? static_cast<int>(std::round(*interval)) : this->interval;
+    }
+
+    virtual std::shared_ptr<DeviceCombinationModifier> makeInstanceFitsToDevice(
+        const char* devname, const std::vector<FSMDEVUNITDEF>& unitDefs, DeviceModifierEventRegistry& registry) const{
+        auto instance = std::make_shared<SequenceModifier>(*this);
+        fitToDevice(*instance, devname, unitDefs, registry);
+        return instance;
+    }
+
+    virtual void processObservedUnitValueChangeEvent(size_t slot, int value, DEVICEMOD_TIME now){
+        if (detectEdge(slot, value) <= 0){
+            return;
+        }
+        if (position > 0 && now - last_time > DEVICEMOD_MILLISEC(interval)){
+            position = 0;
+        }
+        while (position > 0 && steps[position] != slot){
+            position = fallbacks[position - 1];
+        }
+        if (steps[position] == slot){
+            position++;
+        }
+        last_time = now;
+        if (position == steps.size()){
+            position = 0;
+            manager.getEngine().sendEvent(std::move(::Event(evid)));
         }
     }
 };
@@ -790,6 +718,24 @@ void DeviceModifierManager::makeRule(sol::object &def, DeviceModifierRule& rule)
                 auto itemdef = item.as<sol::table>();
                 std::string modtype = lua_safestring(itemdef["modtype"]);
                 sol::object modparam = itemdef["modparam"];
+                if (modtype == "chord" || modtype == "sequence"){
+                    // combination modifiers are applied to a device, "name" is used as the name of the combination
+                    std::string name = lua_safestring(itemdef["name"]);
+                    if (name == ""){
+                        throw MapperException("\"name\" parameter must be specified for chord or sequence modifier.");
+                    }
+                    for (const auto& combination : rule.combinations){
+                        if (combination->getName() == name){
+                            throw MapperException("The same name is used by more than one chord or sequence modifier.");
+                        }
+                    }
+                    if (modtype == "chord"){
+                        rule.combinations.push_back(std::make_shared<ChordModifier>(*this, name, modparam));
+                    }else{
+                        rule.combinations.push_back(std::make_shared<SequenceModifier>(*this, name, modparam));
+                    }
+                    continue;
+                }
                 std::shared_ptr<DeviceModifier> modifier;
                 if (modtype == "raw"){
                     modifier = std::make_shared<RawModifier>(*this, modparam);
@@ -830,55 +776,73 @@ void DeviceModifierManager::makeRule(sol::object &def, DeviceModifierRule& rule)
 //============================================================================================
 // Deferred event processing mechanism
 //============================================================================================
-DeviceModifierManager::DeviceModifierManager(MapperEngine &engine) : engine(engine), status(Status::running){
-    scheduler = std::thread([this](){
-        std::unique_lock lock(mutex);
-        while (true){
-            auto now = DEVICEMOD_CLOCK::now();
-            if (event_queue.size() > 0){
-                auto item = event_queue.front();
-                event_queue.pop();
-                lock.unlock();
-                item.modifier.processUnitValueChangeEvent(item.value, now);
-                lock.lock();
-            }else if (timers.size() > 0 && timers.begin()->first <= now){
-                auto most_recent = timers.begin();
-                auto target_time = most_recent->first;
-                auto& modifier = most_recent->second;
-                timers.erase(most_recent);
-                lock.unlock();
-                modifier.processTimerEvent(target_time);
-                lock.lock();
-            }else{
-                auto timer_num = timers.size();
-                auto condition = [this, timer_num](){
-                    return event_queue.size() > 0 || timers.size() > timer_num || status != Status::running;
-                };
-                if (timer_num > 0){
-                    auto now = DEVICEMOD_CLOCK::now();
-                    auto target = timers.begin()->first;
-                    if (now < target){
-                        cv.wait_until(lock, target, condition);
-                    }
-                }else{
-                    cv.wait(lock, condition);
-                }
-                if (status != Status::running){
-                    status = Status::stop;
-                    cv.notify_all();
-                    break;
-                }
-            }
-        }
-    });
+DeviceModifierManager::DeviceModifierManager(MapperEngine &engine) : engine(engine){
+    auto worker_num = static_cast<size_t>(std::clamp<int64_t>(engine.getOptions().modifier_worker_num, 0, static_cast<int64_t>(MAX_WORKER_NUM)));
+    if (worker_num == 0){
+        worker_num = std::clamp<size_t>(std::thread::hardware_concurrency() / 2, 1, MAX_AUTO_WORKER_NUM);
+    }
+    for (size_t i = 0; i < worker_num; i++){
+        workers.push_back(std::make_unique<Worker>(i));
+    }
 }
 
 DeviceModifierManager::~DeviceModifierManager(){
     stop();
-    scheduler.join();
 }
 
 void DeviceModifierManager::stop(){
+    for (auto& worker : workers){
+        worker->stop();
+    }
+}
+
+DeviceModifierManager::Worker::Worker(size_t index) : index(index), status(Status::running){
+    thread = std::thread([this](){run();});
+}
+
+DeviceModifierManager::Worker::~Worker(){
+    stop();
+    thread.join();
+}
+
+void DeviceModifierManager::Worker::run(){
+    std::unique_lock lock(mutex);
+    while (true){
+        auto now = event_queue.size() > 0 ? event_queue.front().time : DEVICEMOD_CLOCK::now();
+        if (auto timer = timers.pop_expired(now)){
+            lock.unlock();
+            timer->payload->processTimerEvent((timer->handle << WORKER_INDEX_BITS) | index, timer->deadline);
+            lock.lock();
+        }else if (event_queue.size() > 0){
+            auto item = event_queue.front();
+            event_queue.pop();
+            lock.unlock();
+            if (item.slot == NO_SLOT){
+                item.modifier.processUnitValueChangeEvent(item.value, item.time);
+            }else{
+                item.modifier.processObservedUnitValueChangeEvent(item.slot, item.value, item.time);
+            }
+            lock.lock();
+        }else{
+            auto next_deadline = timers.next_deadline();
+            auto condition = [this, next_deadline](){
+                return event_queue.size() > 0 || timers.next_deadline() != next_deadline || status != Status::running;
+            };
+            if (next_deadline){
+                cv.wait_until(lock, *next_deadline, condition);
+            }else{
+                cv.wait(lock, condition);
+            }
+            if (status != Status::running){
+                status = Status::stop;
+                cv.notify_all();
+                break;
+            }
+        }
+    }
+}
+
+void DeviceModifierManager::Worker::stop(){
     std::lock_guard lock(mutex);
     if (status == Status::running){
         status = Status::stopping;
@@ -886,24 +850,22 @@ void DeviceModifierManager::stop(){
     }
 }
 
-void DeviceModifierManager::delegateEventProcessing(DeviceModifier &modifier, int value){
+void DeviceModifierManager::Worker::delegateEventProcessing(DeviceModifier &modifier, int value, size_t slot){
+    auto now = DEVICEMOD_CLOCK::now();
     std::lock_guard lock(mutex);
-    event_queue.push({modifier, value});
+    event_queue.push({modifier, value, slot, now});
     cv.notify_all();
 }
 
-DEVICEMOD_TIME DeviceModifierManager::addTimer(DeviceModifier &modifier, DEVICEMOD_TIME at){
+DEVICEMOD_TIMER DeviceModifierManager::Worker::addTimer(DeviceModifier &modifier, DEVICEMOD_TIME at){
     std::lock_guard lock(mutex);
-    while (timers.count(at)){
-        at += DEVICEMOD_MILLISEC(1);
-    }
-    timers.emplace(at, modifier);
+    auto timer = timers.add(at, &modifier);
     cv.notify_all();
-    return at;
+    return (timer << WORKER_INDEX_BITS) | index;
 }
 
-void DeviceModifierManager::cancelTimer(DeviceModifier &modifier, DEVICEMOD_TIME at){
+void DeviceModifierManager::Worker::cancelTimer(DEVICEMOD_TIMER timer){
     std::lock_guard lock(mutex);
-    timers.erase(at);
+    timers.cancel(timer >> WORKER_INDEX_BITS);
     cv.notify_all();
 }
@@ -12,16 +12,27 @@
 #include <mutex>
 #include <condition_variable>
 #include <queue>
+#include <vector>
 #include <chrono>
 #include <cmath>
+#include <climits>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
 #include <sol/sol.hpp>
 #include "mapperplugin.h"
+#include "timerqueue.h"
+#include "devicemodifierfsm.h"
 
 class MapperEngine;
 
 using DEVICEMOD_CLOCK = std::chrono::steady_clock;
 using DEVICEMOD_TIME = DEVICEMOD_CLOCK::time_point;
 using DEVICEMOD_MILLISEC = std::chrono::milliseconds;
+using DEVICEMOD_TIMER = uint64_t;
+
+// timer handles issued by DeviceModifierManager are never 0
+static constexpr DEVICEMOD_TIMER DEVICEMOD_INVALID_TIMER = 0;
 
 enum class DeviceEvent {
     change,
@@ -36,6 +47,33 @@ enum class DeviceEvent {
 
 class DeviceModifierManager;
 
+//============================================================================================
+// Event registration for all units of a device
+//    Modifiers reserve their event names while they are fitted to units, then events of
+//    all units are registered at once by commit(). Reserved IDs are 0 until commit().
+//============================================================================================
+class DeviceModifierEventRegistry{
+protected:
+    MapperEngine& engine;
+    std::vector<std::string> names;
+    std::vector<uint64_t*> ids;
+
+public:
+    DeviceModifierEventRegistry() = delete;
+    DeviceModifierEventRegistry(const DeviceModifierEventRegistry&) = delete;
+    DeviceModifierEventRegistry(DeviceModifierEventRegistry&&) = delete;
+    explicit DeviceModifierEventRegistry(MapperEngine& engine) : engine(engine){}
+
+    void reserve(const char* devname, const char* unitname, const char* evname, uint64_t& id){
+        auto& name = names.emplace_back();
+        name.reserve(std::strlen(devname) + std::strlen(unitname) + std::strlen(evname) + 2);
+        name.append(devname).append(1, ':').append(unitname).append(1, ':').append(evname);
+        id = 0;
+        ids.push_back(&id);
+    }
+    void commit();
+};
+
 class DeviceModifier {
 protected:
     DeviceModifierManager& manager;
@@ -50,20 +88,84 @@ public:
     DeviceModifier(const DeviceModifier&) = default;
 
     virtual ~DeviceModifier() = default;
-    virtual std::shared_ptr<DeviceModifier> makeInstanceFitsToUnit(const char* devname, const FSMDEVUNITDEF& unit) const = 0;
+    virtual std::shared_ptr<DeviceModifier> makeInstanceFitsToUnit(
+        const char* devname, const FSMDEVUNITDEF& unit, DeviceModifierEventRegistry& registry) const = 0;
     virtual size_t getEventNum() const = 0;
     virtual Event getEvent(size_t index) const = 0;
     virtual void processUnitValueChangeEvent(int value) = 0;
     virtual void processUnitValueChangeEvent(double value){
-        processUnitValueChangeEvent(static_cast<int>(std::round(value)));
+        if (!std::isnan(value)){
+            processUnitValueChangeEvent(static_cast<int>(std::round(std::clamp<double>(value, INT_MIN, INT_MAX))));
+        }
+    }
+    virtual void processUnitValueChangeEvent(int64_t value){
+        // a value out of int range is carried as double instead of being clamped
+        if (value >= INT_MIN && value <= INT_MAX){
+            processUnitValueChangeEvent(static_cast<int>(value));
+        }else{
+            processUnitValueChangeEvent(static_cast<double>(value));
+        }
     }
     virtual void processUnitValueChangeEvent(int value, DEVICEMOD_TIME now){};
-    virtual void processTimerEvent(DEVICEMOD_TIME timer_time){};
+    virtual void processObservedUnitValueChangeEvent(size_t slot, int value, DEVICEMOD_TIME now){};
+    virtual void processTimerEvent(DEVICEMOD_TIMER timer, DEVICEMOD_TIME timer_time){};
+};
+
+//============================================================================================
+// Modifier which detects a combination of operations across units of a device
+//    Unlike other modifiers, this modifier is instanciated for each device, and it observes
+//    value changes of the units listed in its definition in addition to unit modifiers.
+//    Observed units are identified by slot, the position in the list of distinct units.
+//    The detection is performed by the modifier worker thread.
+//============================================================================================
+class DeviceCombinationModifier : public DeviceModifier{
+protected:
+    std::string name;
+    std::vector<std::string> unit_names;
+    std::vector<size_t> units;
+    std::vector<int> thresholds;
+    std::vector<uint8_t> unit_status;
+    uint64_t evid = 0;
+
+public:
+    DeviceCombinationModifier(DeviceModifierManager& manager, const std::string& name) : DeviceModifier(manager), name(name){};
+    DeviceCombinationModifier(const DeviceCombinationModifier&) = default;
+    virtual ~DeviceCombinationModifier();
+
+    virtual std::shared_ptr<DeviceCombinationModifier> makeInstanceFitsToDevice(
+        const char* devname, const std::vector<FSMDEVUNITDEF>& unitDefs, DeviceModifierEventRegistry& registry) const = 0;
+    const std::string& getName() const{return name;};
+    const std::vector<size_t>& getObservedUnits() const{return units;};
+    void notifyUnitValueChange(size_t slot, int value);
+    virtual size_t getEventNum() const{return 1;};
+    virtual Event getEvent(size_t index) const{return {evid, "detected"};};
+
+    // per unit interfaces are not used for this type of modifiers
+    virtual std::shared_ptr<DeviceModifier> makeInstanceFitsToUnit(
+        const char* devname, const FSMDEVUNITDEF& unit, DeviceModifierEventRegistry& registry) const{return nullptr;};
+    virtual void processUnitValueChangeEvent(int value){};
+
+protected:
+    std::vector<std::string> parseUnitList(sol::object& param, const char* modtype);
+    size_t addUnit(const std::string& unit_name);
+    void fitToDevice(DeviceCombinationModifier& instance, const char* devname,
+                     const std::vector<FSMDEVUNITDEF>& unitDefs, DeviceModifierEventRegistry& registry) const;
+
+    // returns 1 if the unit turns on, -1 if the unit turns off, otherwise 0
+    int detectEdge(size_t slot, int value){
+        auto status = value > thresholds[slot];
+        if (status == static_cast<bool>(unit_status[slot])){
+            return 0;
+        }
+        unit_status[slot] = status;
+        return status ? 1 : -1;
+    }
 };
 
 struct DeviceModifierRule {
     std::map<FSMDEVUNIT_VALTYPE, std::shared_ptr<DeviceModifier>> classRule;
     std::map<std::string, std::shared_ptr<DeviceModifier>> unitRule;
+    std::vector<std::shared_ptr<DeviceCombinationModifier>> combinations;
     std::shared_ptr<DeviceModifier> raw;
 
     DeviceModifierRule() = default;
@@ -71,13 +173,14 @@ struct DeviceModifierRule {
     DeviceModifierRule(DeviceModifierRule&&) = default;
     ~DeviceModifierRule() = default;
 
-    std::shared_ptr<DeviceModifier> modifierForUnit(const char* devname, const FSMDEVUNITDEF& unit) const{
-        if (unitRule.count(unit.name) > 0){
-            return unitRule.at(unit.name)->makeInstanceFitsToUnit(devname, unit);
-        }else if (classRule.count(unit.type) > 0){
-            return classRule.at(unit.type)->makeInstanceFitsToUnit(devname, unit);
+    std::shared_ptr<DeviceModifier> modifierForUnit(
+        const char* devname, const FSMDEVUNITDEF& unit, DeviceModifierEventRegistry& registry) const{
+        if (auto unit_rule = unitRule.find(unit.name); unit_rule != unitRule.end()){
+            return unit_rule->second->makeInstanceFitsToUnit(devname, unit, registry);
+        }else if (auto class_rule = classRule.find(unit.type); class_rule != classRule.end()){
+            return class_rule->second->makeInstanceFitsToUnit(devname, unit, registry);
         }else{
-            return raw->makeInstanceFitsToUnit(devname, unit);
+            return raw->makeInstanceFitsToUnit(devname, unit, registry);
         }
     };
 };
@@ -89,18 +192,54 @@ protected:
         stopping,
         stop
     };
+    static constexpr size_t NO_SLOT = SIZE_MAX;
     struct QueueItem{
         DeviceModifier &modifier;
         int value;
+        size_t slot;
+        DEVICEMOD_TIME time;
+    };
+
+    //----------------------------------------------------------------------------------------
+    // Worker to process delegated events and timers of modifiers
+    //    Each modifier is assigned to a worker by hash of its address, so that events and
+    //    timers of a modifier are processed in order by a same thread, and a burst of events
+    //    of a modifier never delays timers of modifiers assigned to other workers.
+    //    Events are processed as of the time they are queued, and timers which expire by
+    //    then are fired before them, so that a backlog of events never reorders them.
+    //    The worker index is embedded in the lower bits of timer handles.
+    //----------------------------------------------------------------------------------------
+    class Worker{
+    protected:
+        size_t index;
+        std::mutex mutex;
+        Status status;
+        std::condition_variable cv;
+        std::queue<QueueItem> event_queue;
+        TimerQueue<DEVICEMOD_TIME, DeviceModifier*> timers;
+        std::thread thread;
+
+    public:
+        Worker() = delete;
+        Worker(const Worker&) = delete;
+        Worker(Worker&&) = delete;
+        explicit Worker(size_t index);
+        ~Worker();
+
+        void stop();
+        void delegateEventProcessing(DeviceModifier& modifier, int value, size_t slot);
+        DEVICEMOD_TIMER addTimer(DeviceModifier& modifier, DEVICEMOD_TIME at);
+        void cancelTimer(DEVICEMOD_TIMER timer);
+
+    protected:
+        void run();
     };
+    static constexpr int WORKER_INDEX_BITS = 4;
+    static constexpr size_t MAX_WORKER_NUM = 1 << WORKER_INDEX_BITS;
+    static constexpr size_t MAX_AUTO_WORKER_NUM = 4;
 
     MapperEngine& engine;
-    std::mutex mutex;
-    Status status;
-    std::condition_variable cv;
-    std::queue<QueueItem> event_queue;
-    std::map<DEVICEMOD_TIME, DeviceModifier&> timers;
-    std::thread scheduler;
+    std::vector<std::unique_ptr<Worker>> workers;
 
 public:
     DeviceModifierManager() = delete;
@@ -114,7 +253,23 @@ public:
     void stop();
 
     MapperEngine& getEngine(){return engine;};
-    void delegateEventProcessing(DeviceModifier& modifier, int value);
-    DEVICEMOD_TIME addTimer(DeviceModifier& modifier, DEVICEMOD_TIME at);
-    void cancelTimer(DeviceModifier &modifier, DEVICEMOD_TIME at);
+    void delegateEventProcessing(DeviceModifier& modifier, int value){
+        workerFor(modifier).delegateEventProcessing(modifier, value, NO_SLOT);
+    }
+    void delegateObservedEventProcessing(DeviceModifier& modifier, size_t slot, int value){
+        workerFor(modifier).delegateEventProcessing(modifier, value, slot);
+    }
+    DEVICEMOD_TIMER addTimer(DeviceModifier& modifier, DEVICEMOD_TIME at){
+        return workerFor(modifier).addTimer(modifier, at);
+    }
+    void cancelTimer(DEVICEMOD_TIMER timer){
+        workers[timer & (MAX_WORKER_NUM - 1)]->cancelTimer(timer);
+    }
+
+protected:
+    Worker& workerFor(const DeviceModifier& modifier){
+        auto key = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(&modifier));
+        auto hash = (key >> 4) * 0x9e3779b97f4a7c15ull;
+        return *workers[(hash >> 32) % workers.size()];
+    }
 };
@@ -0,0 +1,599 @@
+//
+// devicemodifierfsm.h
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <cstddef>
+#include <cstdint>
+
+//============================================================================================
+// State machines of device modifiers
+//    Transitions of button, incdec and quantized_stick modifiers are compiled into tables
+//    when a modifier definition is interpreted. A definition including its tables is shared
+//    by all units which the modifier is applied to, so each unit holds only a compact state.
+//
+//    State machines handle unit values, time and kinds of events and timers only. Events
+//    and timers are requested through a context given to each call, so that they can be
+//    replayed with a simulated clock without the modifier manager. A context provides:
+//        void sendEvent(size_t kind);
+//        void sendEvent(size_t kind, int64_t value);
+//        void startTimer(size_t kind, TIME at);        // replaces the timer of the kind
+//        void cancelTimer(size_t kind);
+//        bool isTimerRunning(size_t kind);
+//    A context must regard the timer of a kind as not running before processTimer() is
+//    called for it.
+//============================================================================================
+namespace devicemodifier_fsm{
+    using CLOCK = std::chrono::steady_clock;
+    using TIME = CLOCK::time_point;
+    using MILLISEC = std::chrono::milliseconds;
+}
+
+//============================================================================================
+// button
+//============================================================================================
+class ButtonStateMachine{
+public:
+    using TIME = devicemodifier_fsm::TIME;
+    using MILLISEC = devicemodifier_fsm::MILLISEC;
+
+    enum class Status : uint8_t{
+        off,
+        on,
+        maybedouble_up_off,
+        maybedouble_up_on,
+        maybedouble_down_on,
+        maybedouble_down_off,
+    };
+    static constexpr size_t STATUS_NUM = 6;
+
+    enum class CoockedEvent{
+        none,
+        down,
+        up,
+    };
+
+    enum EventKind{
+        EVENT_DOWN,
+        EVENT_UP,
+        EVENT_SINGLECLICK,
+        EVENT_DOUBLECLICK,
+        EVENT_LONGPRESSED,
+        EVENT_FOLLOWING_DOWN,
+        EVENT_FOLLOWING_UP,
+        EVENT_KIND_NUM,
+    };
+    static constexpr const char* event_names[EVENT_KIND_NUM] = {
+        "down", "up", "singleclick", "doubleclick", "longpressed", "following_down", "following_up",
+    };
+
+    enum TimerKind{
+        TIMER_LONGPRESS,
+        TIMER_DOUBLECLICK,
+        TIMER_REPEAT,
+        TIMER_FOLLOWING_DOWN,
+        TIMER_FOLLOWING_UP,
+        TIMER_KIND_NUM,
+    };
+
+    // actions are performed in order of bit position
+    enum Action : uint16_t{
+        ACTION_SET_STARTTIME = 1 << 0,
+        ACTION_SEND_DOWN = 1 << 1,
+        ACTION_SEND_UP = 1 << 2,
+        ACTION_SEND_SINGLECLICK = 1 << 3,
+        ACTION_SEND_DOUBLECLICK = 1 << 4,
+        ACTION_CANCEL_LONGPRESS = 1 << 5,
+        ACTION_CANCEL_DOUBLECLICK = 1 << 6,
+        ACTION_START_LONGPRESS = 1 << 7,
+        ACTION_START_DOUBLECLICK = 1 << 8,
+        // the out_of_window transition is taken instead if the double click period has passed
+        ACTION_CHECK_DOUBLECLICK_WINDOW = 1 << 9,
+    };
+
+    struct Transition{
+        Status next;
+        uint16_t actions;
+    };
+
+    struct Definition{
+        bool negative_polarity = false;
+        std::optional<int> threshold_max;
+        std::optional<int> threshold_min;
+        std::optional<int> longpress;
+        std::optional<int> doubleclick;
+        std::optional<int> repeat_interval;
+        std::optional<int> repeat_delay;
+        std::optional<int> follow_down;
+        std::optional<int> follow_up;
+        bool click_on_up = true;
+        bool need_timer = false;
+
+        Transition transitions[STATUS_NUM][2];
+        Transition out_of_window;
+        Status doubleclick_timeout[STATUS_NUM];
+        EventKind event_kinds[EVENT_KIND_NUM];
+        size_t event_num = 0;
+
+        void compile(){
+            auto index = [](Status status){return static_cast<size_t>(status);};
+            for (size_t i = 0; i < STATUS_NUM; i++){
+                transitions[i][0] = {static_cast<Status>(i), 0};
+                transitions[i][1] = {static_cast<Status>(i), 0};
+                doubleclick_timeout[i] = static_cast<Status>(i);
+            }
+            constexpr auto DOWN = 0;
+            constexpr auto UP = 1;
+            uint16_t start_longpress = longpress ? ACTION_START_LONGPRESS : 0;
+
+            if (doubleclick && !click_on_up){
+                transitions[index(Status::off)][DOWN] = {
+                    Status::maybedouble_down_on,
+                    static_cast<uint16_t>(ACTION_SET_STARTTIME | ACTION_SEND_DOWN | start_longpress | ACTION_START_DOUBLECLICK)};
+            }else{
+                transitions[index(Status::off)][DOWN] = {
+                    Status::on,
+                    static_cast<uint16_t>(ACTION_SET_STARTTIME | ACTION_SEND_DOWN | start_longpress)};
+            }
+            if (doubleclick && click_on_up){
+                transitions[index(Status::on)][UP] = {
+                    Status::maybedouble_up_off,
+                    ACTION_SEND_UP | ACTION_CANCEL_LONGPRESS | ACTION_START_DOUBLECLICK | ACTION_CHECK_DOUBLECLICK_WINDOW};
+                out_of_window = {Status::off, ACTION_SEND_UP | ACTION_CANCEL_LONGPRESS | ACTION_SEND_SINGLECLICK};
+            }else{
+                transitions[index(Status::on)][UP] = {Status::off, ACTION_SEND_UP | ACTION_CANCEL_LONGPRESS};
+                out_of_window = transitions[index(Status::on)][UP];
+            }
+            transitions[index(Status::maybedouble_up_off)][DOWN] = {
+                Status::maybedouble_up_on, static_cast<uint16_t>(ACTION_SEND_DOWN | start_longpress)};
+            transitions[index(Status::maybedouble_up_on)][UP] = {
+                Status::off, ACTION_SEND_UP | ACTION_SEND_DOUBLECLICK | ACTION_CANCEL_DOUBLECLICK | ACTION_CANCEL_LONGPRESS};
+            transitions[index(Status::maybedouble_down_on)][UP] = {
+                Status::maybedouble_down_off, ACTION_SEND_UP | ACTION_CANCEL_LONGPRESS};
+            transitions[index(Status::maybedouble_down_off)][DOWN] = {
+                Status::on,
+                static_cast<uint16_t>(ACTION_SET_STARTTIME | ACTION_SEND_DOWN | ACTION_SEND_DOUBLECLICK | ACTION_CANCEL_DOUBLECLICK | start_longpress)};
+
+            doubleclick_timeout[index(Status::maybedouble_up_off)] = Status::off;
+            doubleclick_timeout[index(Status::maybedouble_down_off)] = Status::off;
+            doubleclick_timeout[index(Status::maybedouble_up_on)] = Status::on;
+            doubleclick_timeout[index(Status::maybedouble_down_on)] = Status::on;
+
+            event_num = 0;
+            event_kinds[event_num++] = EVENT_DOWN;
+            event_kinds[event_num++] = EVENT_UP;
+            if (doubleclick){
+                event_kinds[event_num++] = EVENT_SINGLECLICK;
+                event_kinds[event_num++] = EVENT_DOUBLECLICK;
+            }
+            if (longpress){
+                event_kinds[event_num++] = EVENT_LONGPRESSED;
+            }
+            if (follow_down){
+                event_kinds[event_num++] = EVENT_FOLLOWING_DOWN;
+            }
+            if (follow_up){
+                event_kinds[event_num++] = EVENT_FOLLOWING_UP;
+            }
+        }
+    };
+
+protected:
+    Status status = Status::off;
+    int lastvalue = 0;
+    int threshold_max = 0;
+    int threshold_min = 0;
+    TIME starttime;
+
+public:
+    void setThresholds(int max, int min){
+        threshold_max = max;
+        threshold_min = min;
+    }
+
+    CoockedEvent coockEvent(const Definition& def, int value){
+        auto lastvalue = this->lastvalue;
+        this->lastvalue = value;
+        if (lastvalue < threshold_max && value >= threshold_max){
+            return def.negative_polarity ? CoockedEvent::up : CoockedEvent::down;
+        }else if (lastvalue > threshold_min && value <= threshold_min){
+            return def.negative_polarity ? CoockedEvent::down : CoockedEvent::up;
+        }else{
+            return CoockedEvent::none;
+        }
+    }
+
+    // for a definition which needs no timer, down and up are the only events
+    template <typename CONTEXT>
+    void processValue(const Definition& def, CONTEXT& context, int value){
+        auto event = coockEvent(def, value);
+        if (event == CoockedEvent::down){
+            context.sendEvent(EVENT_DOWN);
+        }else if (event == CoockedEvent::up){
+            context.sendEvent(EVENT_UP);
+        }
+    }
+
+    template <typename CONTEXT>
+    void processValue(const Definition& def, CONTEXT& context, int value, TIME now){
+        auto event = coockEvent(def, value);
+        if (event == CoockedEvent::none){
+            return;
+        }
+        if (def.repeat_interval.has_value()){
+            if (event == CoockedEvent::down){
+                auto delay = def.repeat_delay ? *def.repeat_delay : 500;
+                context.startTimer(TIMER_REPEAT, now + MILLISEC(delay));
+            }else{
+                context.cancelTimer(TIMER_REPEAT);
+            }
+        }
+        if (def.follow_down && event == CoockedEvent::down && !context.isTimerRunning(TIMER_FOLLOWING_DOWN)){
+            context.startTimer(TIMER_FOLLOWING_DOWN, now + MILLISEC(*def.follow_down));
+        }
+        if (def.follow_up && event == CoockedEvent::up && !context.isTimerRunning(TIMER_FOLLOWING_UP)){
+            context.startTimer(TIMER_FOLLOWING_UP, now + MILLISEC(*def.follow_up));
+        }
+
+        auto transition = &def.transitions[static_cast<size_t>(status)][event == CoockedEvent::down ? 0 : 1];
+        if (transition->actions & ACTION_CHECK_DOUBLECLICK_WINDOW && now >= starttime + MILLISEC(*def.doubleclick)){
+            transition = &def.out_of_window;
+        }
+        auto actions = transition->actions;
+        if (actions & ACTION_SET_STARTTIME){
+            starttime = now;
+        }
+        if (actions & ACTION_SEND_DOWN){
+            context.sendEvent(EVENT_DOWN);
+        }
+        if (actions & ACTION_SEND_UP){
+            context.sendEvent(EVENT_UP);
+        }
+        if (actions & ACTION_SEND_SINGLECLICK){
+            context.sendEvent(EVENT_SINGLECLICK);
+        }
+        if (actions & ACTION_SEND_DOUBLECLICK){
+            context.sendEvent(EVENT_DOUBLECLICK);
+        }
+        if (actions & ACTION_CANCEL_LONGPRESS){
+            context.cancelTimer(TIMER_LONGPRESS);
+        }
+        if (actions & ACTION_CANCEL_DOUBLECLICK){
+            context.cancelTimer(TIMER_DOUBLECLICK);
+        }
+        if (actions & ACTION_START_LONGPRESS){
+            context.startTimer(TIMER_LONGPRESS, starttime + MILLISEC(*def.longpress));
+        }
+        if (actions & ACTION_START_DOUBLECLICK){
+            context.startTimer(TIMER_DOUBLECLICK, starttime + MILLISEC(*def.doubleclick));
+        }
+        status = transition->next;
+    }
+
+    template <typename CONTEXT>
+    void processTimer(const Definition& def, CONTEXT& context, TimerKind kind, TIME timer_time){
+        if (kind == TIMER_DOUBLECLICK){
+            context.sendEvent(EVENT_SINGLECLICK);
+            status = def.doubleclick_timeout[static_cast<size_t>(status)];
+        }else if (kind == TIMER_LONGPRESS){
+            context.sendEvent(EVENT_LONGPRESSED);
+            status = Status::off;
+        }else if (kind == TIMER_REPEAT){
+            context.sendEvent(EVENT_DOWN);
+            context.startTimer(TIMER_REPEAT, timer_time + MILLISEC(*def.repeat_interval));
+        }else if (kind == TIMER_FOLLOWING_DOWN){
+            context.sendEvent(EVENT_FOLLOWING_DOWN);
+        }else if (kind == TIMER_FOLLOWING_UP){
+            context.sendEvent(EVENT_FOLLOWING_UP);
+        }
+    }
+};
+
+//============================================================================================
+// increment / decrement
+//    In pulse mode, each value change is queued as a direction, then it's emitted as a pulse
+//    which is a pair of an event with value 1 and an event with value 0. Pulses are spaced
+//    by pulse_interval, and the width of a pulse is pulse_duration.
+//    Transitions don't depend on parameters of a definition, so a single table is shared
+//    by all definitions.
+//============================================================================================
+class IncDecStateMachine{
+public:
+    using CLOCK = devicemodifier_fsm::CLOCK;
+    using TIME = devicemodifier_fsm::TIME;
+    using MILLISEC = devicemodifier_fsm::MILLISEC;
+
+    enum class Status : uint8_t{
+        init,
+        down,
+        up,
+    };
+    static constexpr size_t STATUS_NUM = 3;
+
+    enum Input{
+        INPUT_VALUE_READY,      // a value is queued and pulse_interval has passed since the last pulse
+        INPUT_VALUE_WAIT,       // a value is queued within pulse_interval since the last pulse
+        INPUT_TIMER_EMPTY,      // the timer expired with no queued value
+        INPUT_TIMER_LAST,       // the timer expired with one queued value
+        INPUT_TIMER_MORE,       // the timer expired with two or more queued values
+        INPUT_NUM,
+    };
+
+    enum EventKind{
+        EVENT_INCREMENT,
+        EVENT_DECREMENT,
+        EVENT_KIND_NUM,
+    };
+
+    enum TimerKind{
+        TIMER_HOLD,
+        TIMER_KIND_NUM,
+    };
+
+    // actions are performed in order of bit position
+    enum Action : uint8_t{
+        ACTION_PRESS = 1 << 0,              // send 1 for the direction at the head of the queue
+        ACTION_RELEASE = 1 << 1,            // send 0 for the direction at the head of the queue, then dequeue it
+        ACTION_START_DURATION = 1 << 2,     // start the timer to release the pulse
+        ACTION_START_INTERVAL = 1 << 3,     // start the timer to press the next pulse
+    };
+
+    struct Transition{
+        Status next;
+        uint8_t actions;
+    };
+
+    static constexpr size_t HOLD_BUFFER_LEN = 16;
+
+    struct Definition{
+        bool pulse_mode = false;
+        int pulse_duration = 30;
+        int pulse_interval = 30;
+        int max_hold_num = 4;
+    };
+
+protected:
+    static constexpr Transition transitions[STATUS_NUM][INPUT_NUM] = {
+        // init
+        {
+            {Status::down, ACTION_PRESS | ACTION_START_DURATION},
+            {Status::up, ACTION_START_INTERVAL},
+            {Status::init, 0},
+            {Status::init, 0},
+            {Status::init, 0},
+        },
+        // down
+        {
+            {Status::down, 0},
+            {Status::down, 0},
+            {Status::init, 0},
+            {Status::init, ACTION_RELEASE},
+            {Status::up, ACTION_RELEASE | ACTION_START_INTERVAL},
+        },
+        // up
+        {
+            {Status::up, 0},
+            {Status::up, 0},
+            {Status::init, 0},
+            {Status::down, ACTION_PRESS | ACTION_START_DURATION},
+            {Status::down, ACTION_PRESS | ACTION_START_DURATION},
+        },
+    };
+    static constexpr size_t HOLD_BUFFER_MASK = HOLD_BUFFER_LEN - 1;
+
+    Status status = Status::init;
+    bool is_absolute = false;
+    uint8_t hold_top = 0;
+    uint8_t hold_bottom = 0;
+    uint16_t hold_buffer = 0;     // a bit is set for increment
+    int last_value = 0;
+    TIME last_event_time{CLOCK::now()};
+
+public:
+    void fitToUnit(bool is_absolute, int initial_value){
+        this->is_absolute = is_absolute;
+        last_value = initial_value;
+    }
+
+    // for a definition without pulse mode, a delta of value is sent as the value of an event
+    template <typename CONTEXT>
+    void processValue(const Definition&, CONTEXT& context, int value){
+        auto delta = takeDelta(value);
+        if (delta > 0){
+            context.sendEvent(EVENT_INCREMENT, static_cast<int64_t>(delta));
+        }else if (delta < 0){
+            context.sendEvent(EVENT_DECREMENT, static_cast<int64_t>(-delta));
+        }
+    }
+
+    template <typename CONTEXT>
+    void processValue(const Definition& def, CONTEXT& context, int value, TIME now){
+        auto delta = takeDelta(value);
+        if (queued() < def.max_hold_num){
+            auto bit = static_cast<uint16_t>(1 << (hold_bottom & HOLD_BUFFER_MASK));
+            hold_buffer = delta > 0 ? hold_buffer | bit : hold_buffer & ~bit;
+            hold_bottom++;
+            auto input = now >= last_event_time + MILLISEC(def.pulse_interval) ? INPUT_VALUE_READY : INPUT_VALUE_WAIT;
+            perform(def, context, transitions[static_cast<size_t>(status)][input], now);
+        }
+    }
+
+    template <typename CONTEXT>
+    void processTimer(const Definition& def, CONTEXT& context, TIME timer_time){
+        last_event_time = timer_time;
+        auto num = queued();
+        auto input = num == 0 ? INPUT_TIMER_EMPTY : num == 1 ? INPUT_TIMER_LAST : INPUT_TIMER_MORE;
+        perform(def, context, transitions[static_cast<size_t>(status)][input], timer_time);
+    }
+
+protected:
+    int takeDelta(int value){
+        auto delta = is_absolute ? value - last_value : value;
+        last_value = value;
+        return delta;
+    }
+
+    int queued() const{
+        return static_cast<uint8_t>(hold_bottom - hold_top);
+    }
+
+    EventKind headDirection() const{
+        return hold_buffer & (1 << (hold_top & HOLD_BUFFER_MASK)) ? EVENT_INCREMENT : EVENT_DECREMENT;
+    }
+
+    template <typename CONTEXT>
+    void perform(const Definition& def, CONTEXT& context, const Transition& transition, TIME now){
+        auto actions = transition.actions;
+        if (actions & ACTION_PRESS){
+            context.sendEvent(headDirection(), 1LL);
+        }
+        if (actions & ACTION_RELEASE){
+            context.sendEvent(headDirection(), 0LL);
+            hold_top++;
+        }
+        if (actions & ACTION_START_DURATION){
+            context.startTimer(TIMER_HOLD, now + MILLISEC(def.pulse_duration));
+        }
+        if (actions & ACTION_START_INTERVAL){
+            context.startTimer(TIMER_HOLD, last_event_time + MILLISEC(def.pulse_interval));
+        }
+        status = transition.next;
+    }
+};
+
+//============================================================================================
+// quantized stick
+//    A value is classified into a zone by the four thresholds, and transitions are indexed
+//    by status and zone. Thresholds are parameters of a definition, so arbitrary relations
+//    between the activate threshold and the release threshold result in same transitions
+//    as the thresholds are compared one by one.
+//============================================================================================
+class QuantizedStickStateMachine{
+public:
+    using TIME = devicemodifier_fsm::TIME;
+    using MILLISEC = devicemodifier_fsm::MILLISEC;
+
+    enum class Status : uint8_t{
+        center,
+        positive,
+        negative,
+    };
+    static constexpr size_t STATUS_NUM = 3;
+
+    enum Zone : uint8_t{
+        ZONE_ACTIVATE_POSITIVE = 1 << 0,    // value >= threshold_center_to_positive
+        ZONE_ACTIVATE_NEGATIVE = 1 << 1,    // value <= threshold_center_to_negative
+        ZONE_RELEASE_POSITIVE = 1 << 2,     // value < threshold_positive_to_center
+        ZONE_RELEASE_NEGATIVE = 1 << 3,     // value > threshold_negative_to_center
+    };
+    static constexpr size_t ZONE_NUM = 16;
+
+    enum EventKind{
+        EVENT_POSITIVE,
+        EVENT_NEGATIVE,
+        EVENT_KIND_NUM,
+    };
+
+    enum TimerKind{
+        TIMER_REPEAT,
+        TIMER_KIND_NUM,
+    };
+
+    // actions are performed in order of bit position
+    enum Action : uint8_t{
+        ACTION_SEND_POSITIVE = 1 << 0,
+        ACTION_SEND_NEGATIVE = 1 << 1,
+        ACTION_CANCEL_REPEAT = 1 << 2,
+        ACTION_START_DELAY = 1 << 3,
+        ACTION_START_INTERVAL = 1 << 4,
+    };
+
+    struct Transition{
+        Status next;
+        uint8_t actions;
+    };
+
+    struct Definition{
+        int threshold_center_to_positive = 30000;
+        int threshold_positive_to_center = 20000;
+        int threshold_center_to_negative = -30000;
+        int threshold_negative_to_center = -20000;
+        bool repeat_mode = true;
+        int repeat_delay = 500;
+        int repeat_interval = 500;
+
+        Transition transitions[STATUS_NUM][ZONE_NUM];
+        Transition repeat_transitions[STATUS_NUM];
+
+        Zone zoneOf(int value) const{
+            return static_cast<Zone>(
+                (value >= threshold_center_to_positive ? ZONE_ACTIVATE_POSITIVE : 0) |
+                (value <= threshold_center_to_negative ? ZONE_ACTIVATE_NEGATIVE : 0) |
+                (value < threshold_positive_to_center ? ZONE_RELEASE_POSITIVE : 0) |
+                (value > threshold_negative_to_center ? ZONE_RELEASE_NEGATIVE : 0));
+        }
+
+        void compile(){
+            uint8_t start_delay = repeat_mode ? ACTION_START_DELAY : 0;
+            uint8_t cancel_repeat = repeat_mode ? ACTION_CANCEL_REPEAT : 0;
+            for (size_t zone = 0; zone < ZONE_NUM; zone++){
+                auto& center = transitions[static_cast<size_t>(Status::center)][zone];
+                if (zone & ZONE_ACTIVATE_POSITIVE){
+                    center = {Status::positive, static_cast<uint8_t>(ACTION_SEND_POSITIVE | start_delay)};
+                }else if (zone & ZONE_ACTIVATE_NEGATIVE){
+                    center = {Status::negative, static_cast<uint8_t>(ACTION_SEND_NEGATIVE | start_delay)};
+                }else{
+                    center = {Status::center, 0};
+                }
+                auto& positive = transitions[static_cast<size_t>(Status::positive)][zone];
+                positive = zone & ZONE_RELEASE_POSITIVE ? Transition{Status::center, cancel_repeat} : Transition{Status::positive, 0};
+                auto& negative = transitions[static_cast<size_t>(Status::negative)][zone];
+                negative = zone & ZONE_RELEASE_NEGATIVE ? Transition{Status::center, cancel_repeat} : Transition{Status::negative, 0};
+            }
+            repeat_transitions[static_cast<size_t>(Status::center)] = {Status::center, 0};
+            repeat_transitions[static_cast<size_t>(Status::positive)] = {Status::positive, ACTION_SEND_POSITIVE | ACTION_START_INTERVAL};
+            repeat_transitions[static_cast<size_t>(Status::negative)] = {Status::negative, ACTION_SEND_NEGATIVE | ACTION_START_INTERVAL};
+        }
+    };
+
+protected:
+    Status status = Status::center;
+
+public:
+    // without repeat mode, the definition has no transition which uses time
+    template <typename CONTEXT>
+    void processValue(const Definition& def, CONTEXT& context, int value, TIME now = TIME()){
+        perform(def, context, def.transitions[static_cast<size_t>(status)][def.zoneOf(value)], now);
+    }
+
+    template <typename CONTEXT>
+    void processTimer(const Definition& def, CONTEXT& context, TIME timer_time){
+        perform(def, context, def.repeat_transitions[static_cast<size_t>(status)], timer_time);
+    }
+
+protected:
+    template <typename CONTEXT>
+    void perform(const Definition& def, CONTEXT& context, const Transition& transition, TIME now){
+        auto actions = transition.actions;
+        if (actions & ACTION_SEND_POSITIVE){
+            context.sendEvent(EVENT_POSITIVE);
+        }
+        if (actions & ACTION_SEND_NEGATIVE){
+            context.sendEvent(EVENT_NEGATIVE);
+        }
+        if (actions & ACTION_CANCEL_REPEAT){
+            context.cancelTimer(TIMER_REPEAT);
+        }
+        if (actions & ACTION_START_DELAY){
+            context.startTimer(TIMER_REPEAT, now + MILLISEC(def.repeat_delay));
+        }
+        if (actions & ACTION_START_INTERVAL){
+            context.startTimer(TIMER_REPEAT, now + MILLISEC(def.repeat_interval));
+        }
+        status = transition.next;
+    }
+};
@@ -4,7 +4,9 @@
 //
 
 #include <sstream>
+#include <algorithm>
 #include <filesystem>
+#include <thread>
 #include "hookdll.h"
 #include "engine.h"
 #include "device.h"
@@ -73,6 +75,7 @@ void MapperEngine::initScriptingEnv(){
     //      mapper.unregister_event():       unregister event id
     //      mapper.get_event_name():         get name associated with event id
     //      mapper.raise_event():            raise an event
+    //      mapper.stats():                  get invocation statistics of actions
     //      mapper.set_primary_mappings():   set primary mappings
     //      mapper.add_primary_mappings();   add primary mappings
     //      mapper.set_secondary_mappings(): set secondary mappings
@@ -140,6 +143,40 @@ void MapperEngine::initScriptingEnv(){
             }
         });
     };
+    mapper["stats"] = [this](sol::this_state s){
+        sol::state_view lua(s);
+        ActionStats lua_total{0, 0, 0};
+        ActionStats native_total{0, 0, 0};
+        auto actions = lua.create_table();
+        int index = 1;
+        for (auto& stat : collectActionStats()){
+            auto item = lua.create_table();
+            item["event"] = stat.event_name;
+            item["action"] = stat.action_name;
+            item["type"] = stat.is_lua_function ? "lua" : "native";
+            item["count"] = stat.stats.count;
+            item["total_time"] = stat.stats.total_time;
+            item["max_time"] = stat.stats.max_time;
+            actions[index++] = item;
+
+            auto& total = stat.is_lua_function ? lua_total : native_total;
+            total.count += stat.stats.count;
+            total.total_time += stat.stats.total_time;
+            total.max_time = std::max(total.max_time, stat.stats.max_time);
+        }
+        auto summary = [&lua](const ActionStats& total){
+            auto table = lua.create_table();
+            table["count"] = total.count;
+            table["total_time"] = total.total_time;
+            table["max_time"] = total.max_time;
+            return table;
+        };
+        auto stats = lua.create_table();
+        stats["lua"] = summary(lua_total);
+        stats["native"] = summary(native_total);
+        stats["actions"] = actions;
+        return stats;
+    };
     mapper["raise_event"] = [this](const sol::variadic_args va){
         lua_c_interface(*this, "mapper::raise_event", [this, &va]{
             auto&& evid = lua_safevalue<int64_t>(va[0]);
@@ -242,6 +279,9 @@ void MapperEngine::clearScriptingEnv(){
     // since action may be lua function
     mapping[0] = nullptr;
     mapping[1] = nullptr;
+    dispatcher.table.clear();
+    dispatcher.sparse_table.clear();
+    invalidateDispatchTable();
     event.deferred_actions.clear();
     if (scripting.viewportManager){
         scripting.viewportManager->reset_viewports();
@@ -250,6 +290,9 @@ void MapperEngine::clearScriptingEnv(){
     // cleanup lua cmodule async event sources
     luac_mod::cleanup_async_sources();
 
+    // finish recording events
+    stopEventTrace();
+
     // dtop & destroy the Lua VM
     scripting.lua_ptr = nullptr;
 }
@@ -297,6 +340,7 @@ bool MapperEngine::run(std::string&& scriptPath){
         hookdll_setLogMode(options.log_mode);
         dev_logger = devlog::make_logger(options.log_mode);
         putLog(MCONSOLE_INFO, "mapper-core: start event-action mapping");
+        startEventTrace();
         initScriptingEnv();
 
         //-------------------------------------------------------------------------------
@@ -335,6 +379,9 @@ bool MapperEngine::run(std::string&& scriptPath){
         lock.lock();
 
         event.view_updated_time = CLOCK::now();
+        auto batch_size = static_cast<size_t>(std::max<int64_t>(options.event_batch_size, 1));
+        std::vector<Event> batch;
+        batch.reserve(batch_size);
 
         //-------------------------------------------------------------------------------
         // Event-Action mapping loop
@@ -351,95 +398,118 @@ bool MapperEngine::run(std::string&& scriptPath){
             }
 
             //-------------------------------------------------------------------------------
-            // check event queue and deferred action queue then invoke action
+            // take out pending events as a batch, then invoke actions for them without holding the lock
             //-------------------------------------------------------------------------------
             now = CLOCK::now();
             bool queue_empty = true;
-            if (event.queue.size() > 0){
-                //-------------------------------------------------------------------------------
-                // process an event
-                //-------------------------------------------------------------------------------
-                queue_empty = false;
-                auto ev = std::move(event.queue.front());
-                event.queue.pop();
-                auto action = findAction(ev->getId());
-
-                if (ev->getId() == static_cast<int64_t>(EventID::STOP)){
-                    status = Status::stop;
-                    lock.unlock();
-                    putLog(MCONSOLE_INFO, "mapper-core: a request to stopp event-action mapping has been received");
-                    lock.lock();
+            bool stop_requested = false;
+            batch.clear();
+            while (batch.size() < batch_size || (batch.size() > 0 && batch.back().isContinuedInFrame())){
+                // a frame becomes visible as a whole, so the rest of a frame is always available
+                auto ev = event.queue.pop();
+                if (!ev){
                     break;
-                }else if (ev->getId() == static_cast<int64_t>(EventID::API_REQUEST)){
-                    ApiContext* context = *ev;
-                    const char* msg = nullptr;
-                    try{
-                        if (context->type == ApiContext::Type::start_viewports){
-                            msg = "failed to enable viewports:\n";
-                            scripting.viewportManager->enable_viewports();
-                        }else if (context->type == ApiContext::Type::stop_viewports){
-                            msg = "failed to disable viewports\n";
-                            scripting.viewportManager->disable_viewports();
-                        }else{
-                            abort();
-                        }
-                        context->done = true;
-                        context->result = true;
-                        event.cv_for_client.notify_all();
-                    }catch (MapperException& e){
-                        std::ostringstream os;
-                        os << "mapper-core: " << msg << e.what();
-                        context->done = true;
-                        context->result = false;
-                        event.cv_for_client.notify_all();
+                }
+                batch.push_back(std::move(*ev));
+            }
+            if (batch.size() > 0){
+                queue_empty = false;
+                event.batch_stat.num_batches++;
+                event.batch_stat.num_events += batch.size();
+                event.batch_stat.max_size = std::max<uint64_t>(event.batch_stat.max_size, batch.size());
+                auto logmode = this->logmode;
+                lock.unlock();
+                for (auto& ev : batch){
+                    if (ev.getId() == static_cast<int64_t>(EventID::STOP)){
+                        lock.lock();
+                        status = Status::stop;
                         lock.unlock();
-                        putLog(MCONSOLE_WARNING, os.str());
+                        putLog(MCONSOLE_INFO, "mapper-core: a request to stopp event-action mapping has been received");
+                        stop_requested = true;
+                        break;
+                    }else if (ev.getId() == static_cast<int64_t>(EventID::API_REQUEST)){
+                        ApiContext* context = ev;
+                        const char* msg = nullptr;
                         lock.lock();
-                    }
-                }else{
-                    if (logmode & MAPPER_LOG_EVENT && ev->getId() >= static_cast<int64_t>(EventID::DINAMIC_EVENT) &&
-                        event.names.count(ev->getId()) > 0){
-                        auto &name = event.names.at(ev->getId());
-                        std::ostringstream os;
-                        os << name;
-                        if (ev->getType() == Event::Type::int_value){
-                            os << "(" << ev->getAs<int64_t>() << ")";
-                        }else if (ev->getType() == Event::Type::double_value){
-                            os << "(" << ev->getAs<double>() << ")";
+                        try{
+                            if (context->type == ApiContext::Type::start_viewports){
+                                msg = "failed to enable viewports:\n";
+                                scripting.viewportManager->enable_viewports();
+                            }else if (context->type == ApiContext::Type::stop_viewports){
+                                msg = "failed to disable viewports\n";
+                                scripting.viewportManager->disable_viewports();
+                            }else if (context->type == ApiContext::Type::sync){
+                                // nothing to do, this request just tells that preceding events have been processed
+                            }else if (context->type == ApiContext::Type::procedure){
+                                context->procedure();
+                            }else{
+                                abort();
+                            }
+                            context->done = true;
+                            context->result = true;
+                            event.cv_for_client.notify_all();
+                            lock.unlock();
+                        }catch (MapperException& e){
+                            std::ostringstream os;
+                            os << "mapper-core: " << msg << e.what();
+                            context->done = true;
+                            context->result = false;
+                            event.cv_for_client.notify_all();
+                            lock.unlock();
+                            putLog(MCONSOLE_WARNING, os.str());
+                        }
+                    }else{
+                        // the action must be resolved just before invoking it
+                        // since the previous action in the batch may change mappings
+                        auto action = findAction(ev.getId());
+                        if (logmode & MAPPER_LOG_EVENT && ev.getId() >= static_cast<int64_t>(EventID::DINAMIC_EVENT) &&
+                            event.names.count(ev.getId()) > 0){
+                            auto &name = event.names.at(ev.getId());
+                            std::ostringstream os;
+                            os << name;
+                            if (ev.getType() == Event::Type::int_value){
+                                os << "(" << ev.getAs<int64_t>() << ")";
+                            }else if (ev.getType() == Event::Type::double_value){
+                                os << "(" << ev.getAs<double>() << ")";
+                            }
+                            if (action){
+                                os << " -> " << action->getName();
+                            }
+                            putLog(MCONSOLE_EVENT, os.str());
                         }
+
                         if (action){
-                            os << " -> " << action->getName();
+                            invokeAction(action, ev);
                         }
-                        lock.unlock();
-                        putLog(MCONSOLE_EVENT, os.str());
-                        lock.lock();
                     }
+                }
+                lock.lock();
+                if (stop_requested){
+                    break;
+                }
+            }
 
-                    if (action){
-                        lock.unlock();
-                        action->invoke(*ev, scripting.lua());
-                        lock.lock();
-                    }
+            //-------------------------------------------------------------------------------
+            // process deferred actions which have come due
+            //-------------------------------------------------------------------------------
+            // actions deferred by these deferred actions will be processed in the next iteration
+            for (auto budget = event.deferred_actions.size(); budget > 0; budget--){
+                auto deferred = event.deferred_actions.pop_expired(now);
+                if (!deferred){
+                    break;
                 }
-            }else if (event.deferred_actions.size() > 0 && event.deferred_actions.begin()->first < now){
-                //-------------------------------------------------------------------------------
-                // process a deferred action
-                //-------------------------------------------------------------------------------
                 queue_empty = false;
-                auto& act_ev = event.deferred_actions.begin()->second;
-                auto action = act_ev.get_action();
-                auto& ev = act_ev.get_event();
-                if (logmode & MAPPER_LOG_EVENT){
+                auto action = deferred->payload.get_action();
+                auto& ev = deferred->payload.get_event();
+                auto should_log = logmode & MAPPER_LOG_EVENT;
+                lock.unlock();
+                if (should_log){
                     std::ostringstream os;
                     os << "Deferred action execution: " << action->getName();
-                    lock.unlock();
                     putLog(MCONSOLE_EVENT, os.str());
-                    lock.lock();
                 }
-                lock.unlock();
-                action->invoke(ev, scripting.lua());
+                invokeAction(action.get(), ev);
                 lock.lock();
-                event.deferred_actions.erase(event.deferred_actions.begin());
             }
 
             //-------------------------------------------------------------------------------
@@ -455,7 +525,7 @@ bool MapperEngine::run(std::string&& scriptPath){
             //-------------------------------------------------------------------------------
             // Prioritize event-action mapping processing over view update processes or host notifications
             //-------------------------------------------------------------------------------
-            if (event.queue.size() > 0 && now - event.view_updated_time < std::chrono::milliseconds(50)){
+            if (!event.queue.empty() && now - event.view_updated_time < std::chrono::milliseconds(50)){
                 continue;
             }
             event.view_updated_time = now;
@@ -514,26 +584,31 @@ bool MapperEngine::run(std::string&& scriptPath){
             //-------------------------------------------------------------------------------
             if (queue_empty){
                 auto deferred_num = event.deferred_actions.size();
+                auto next_deadline = event.deferred_actions.next_deadline();
                 auto condition = [this, deferred_num]{
-                    return event.queue.size() > 0 || event.deferred_actions.size() > deferred_num || 
+                    return !event.queue.empty() || event.deferred_actions.size() > deferred_num || 
                            status != Status::running || scripting.updated_flags || 
                            event.need_update_viewports || event.touch_event_occurred ||
                            scripting.luacmod_events;
                 };
 
+                // let producers know that this thread may sleep, then re-check the queue
+                event.loop_is_waiting.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+
                 if (options.async_message_pumping){
-                    if (deferred_num > 0){
-                        event.cv_for_client.wait_until(lock, event.deferred_actions.begin()->first, condition);
+                    if (next_deadline){
+                        event.cv_for_client.wait_until(lock, *next_deadline, condition);
                     }else{
                         event.cv_for_client.wait(lock, condition);
                     }
-                }else{
+                }else if (!condition()){
                     while (true){
                         HANDLE ev = event.event_as_cv;
                         DWORD wait_result;
-                        if (deferred_num > 0){
+                        if (next_deadline){
                             auto now = CLOCK::now();
-                            auto duration = event.deferred_actions.begin()->first - now;
+                            auto duration = *next_deadline - now;
                             auto millisec = std::chrono::duration_cast<MILLISEC>(duration).count();
                             if (millisec > 0){
                                 lock.unlock();
@@ -563,6 +638,7 @@ bool MapperEngine::run(std::string&& scriptPath){
                         }
                     }
                 }
+                event.loop_is_waiting.store(false, std::memory_order_relaxed);
 
                 if (status != Status::running){
                     break;
@@ -574,6 +650,7 @@ bool MapperEngine::run(std::string&& scriptPath){
                 }
             }
         }
+        batch.clear();
         auto rc = status == Status::stop;
         event.cv_for_client.notify_all();
         lock.unlock();
@@ -612,10 +689,34 @@ bool MapperEngine::abort(){
 //============================================================================================
 uint64_t MapperEngine::registerEvent(std::string &&name){
     auto newid = event.idCounter++;
+    if (trace.is_recording.load(std::memory_order_relaxed)){
+        std::lock_guard lock(trace.writer_mutex);
+        if (trace.writer){
+            trace.writer->define_name(newid, name);
+        }
+    }
     event.names.insert(std::make_pair(newid, std::move(name)));
     return newid;
 }
 
+uint64_t MapperEngine::registerEvents(std::vector<std::string>&& names){
+    // IDs are assigned consecutively, the return value is the ID for the first name
+    auto first = event.idCounter;
+    event.idCounter += names.size();
+    if (trace.is_recording.load(std::memory_order_relaxed)){
+        std::lock_guard lock(trace.writer_mutex);
+        if (trace.writer){
+            for (size_t i = 0; i < names.size(); i++){
+                trace.writer->define_name(first + i, names[i]);
+            }
+        }
+    }
+    for (size_t i = 0; i < names.size(); i++){
+        event.names.emplace_hint(event.names.end(), first + i, std::move(names[i]));
+    }
+    return first;
+}
+
 void MapperEngine::unregisterEvent(uint64_t evid){
     event.names.erase(evid);
 }
@@ -628,14 +729,227 @@ const char* MapperEngine::getEventName(uint64_t evid) const{
     }
 }
 
+// events collected by MapperEngine::EventBatch on the current thread
+static thread_local struct {
+    MapperEngine* engine = nullptr;
+    std::vector<Event> events;
+} event_batch;
+
 void MapperEngine::sendEvent(Event &&ev){
-    std::lock_guard lock(mutex);
-    event.queue.push(std::make_unique<Event>(std::move(ev)));
-    notify_server();
+    if (trace.is_recording.load(std::memory_order_relaxed)){
+        recordEvent(ev);
+    }
+    if (event_batch.engine == this){
+        event_batch.events.push_back(std::move(ev));
+        return;
+    }
+    event.queue.push(std::move(ev));
+    notify_server_for_event();
+}
+
+void MapperEngine::sendEvents(Event* events, size_t num){
+    // events must be recorded by caller if recording is necessary
+    // events are enqueued as a frame, the event-action mapping loop never splits them
+    if (num > 0){
+        for (size_t i = 0; i < num; i++){
+            events[i].setContinuedInFrame(i + 1 < num);
+        }
+        event.queue.push_bulk(events, num);
+        notify_server_for_event();
+    }
+}
+
+MapperEngine::EventBatch::EventBatch(MapperEngine& engine) : engine(engine){
+    is_outermost = event_batch.engine == nullptr;
+    if (is_outermost){
+        event_batch.engine = &engine;
+    }
+}
+
+MapperEngine::EventBatch::~EventBatch(){
+    if (is_outermost){
+        event_batch.engine = nullptr;
+        engine.sendEvents(event_batch.events.data(), event_batch.events.size());
+        event_batch.events.clear();
+    }
 }
 
 void MapperEngine::sendEventNoLock(Event &&ev){
-    event.queue.push(std::make_unique<Event>(std::move(ev)));
+    // this function is called from the event-action mapping loop with holding the mutex,
+    // so the loop is never sleeping
+    if (trace.is_recording.load(std::memory_order_relaxed)){
+        recordEvent(ev);
+    }
+    event.queue.push(std::move(ev));
+}
+
+//============================================================================================
+// action statistics
+//============================================================================================
+std::vector<MapperEngine::ActionStat> MapperEngine::collectActionStats(){
+    // this function must be called from the event-action mapping loop (thread)
+    // since mapping definitions are changed by that thread
+    std::vector<ActionStat> list;
+    auto collect = [this, &list](uint64_t evid, Action* action){
+        auto name = getEventName(evid);
+        list.push_back({name ? name : "", action->getName(), action->isLuaAction(), action->getStats()});
+    };
+    for (auto& layer : mapping){
+        if (layer){
+            for (auto& [evid, action] : *layer){
+                collect(evid, action.get());
+            }
+        }
+    }
+    if (scripting.viewportManager){
+        scripting.viewportManager->enum_actions(collect);
+    }
+    return list;
+}
+
+std::vector<MapperEngine::ActionStat> MapperEngine::get_action_stats(){
+    std::unique_lock lock(mutex);
+    std::vector<ActionStat> list;
+    if (status == Status::running){
+        ApiContext context;
+        context.type = ApiContext::Type::procedure;
+        context.procedure = [this, &list](){list = collectActionStats();};
+        Event ev{static_cast<uint64_t>(EventID::API_REQUEST), &context};
+        lock.unlock();
+        sendEvent(std::move(ev));
+        lock.lock();
+        event.cv_for_client.wait(lock, [this, &context](){return status != Status::running || context.done;});
+    }
+    return list;
+}
+
+//============================================================================================
+// event trace recording and replaying
+//============================================================================================
+void MapperEngine::startEventTrace(){
+    if (options.event_trace_file.size() == 0){
+        return;
+    }
+    try{
+        std::lock_guard lock(trace.writer_mutex);
+        trace.writer = std::make_unique<eventtrace::Writer>(options.event_trace_file.c_str());
+        trace.is_recording = true;
+        std::ostringstream os;
+        os << "mapper-core: events are recorded to \"" << options.event_trace_file << "\"";
+        putLog(MCONSOLE_INFO, os.str());
+    }catch (std::runtime_error& e){
+        std::ostringstream os;
+        os << "mapper-core: " << e.what();
+        putLog(MCONSOLE_WARNING, os.str());
+    }
+}
+
+void MapperEngine::stopEventTrace(){
+    std::lock_guard lock(trace.writer_mutex);
+    trace.is_recording = false;
+    trace.writer = nullptr;
+}
+
+void MapperEngine::recordEvent(const Event& ev){
+    std::lock_guard lock(trace.writer_mutex);
+    if (trace.writer){
+        trace.writer->record(ev);
+    }
+}
+
+void MapperEngine::invokeAction(Action* action, Event& ev){
+    auto start = CLOCK::now();
+    action->invoke(ev, scripting.lua());
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(CLOCK::now() - start).count();
+    action->recordInvocation(static_cast<uint64_t>(elapsed));
+    if (!trace.is_profiling.load(std::memory_order_relaxed)){
+        return;
+    }
+
+    std::lock_guard lock(trace.latency_mutex);
+    auto key = std::make_pair(static_cast<uint64_t>(ev.getId()), action);
+    auto entry = trace.latencies.find(key);
+    if (entry == trace.latencies.end()){
+        auto name = getEventName(ev.getId());
+        entry = trace.latencies.emplace(key, ActionLatency{name ? name : "", action->getName(), {}}).first;
+    }
+    entry->second.histogram.add(static_cast<uint64_t>(elapsed));
+}
+
+bool MapperEngine::replay_event_trace(const char* path, bool realtime){
+    std::unique_ptr<eventtrace::Reader> reader;
+    try{
+        reader = std::make_unique<eventtrace::Reader>(path);
+    }catch (std::runtime_error& e){
+        std::ostringstream os;
+        os << "mapper-core: " << e.what();
+        putLog(MCONSOLE_ERROR, os.str());
+        return false;
+    }
+
+    // recorded event ids are translated to ids in the current session by name
+    std::unordered_map<std::string, uint64_t> ids_by_name;
+    {
+        std::lock_guard lock(mutex);
+        if (status != Status::running){
+            return false;
+        }
+        for (auto& [evid, name] : event.names){
+            ids_by_name.emplace(name, evid);
+        }
+    }
+    {
+        std::lock_guard lock(trace.latency_mutex);
+        trace.latencies.clear();
+    }
+    trace.is_profiling = true;
+
+    std::unordered_map<uint64_t, uint64_t> id_map;
+    auto start = CLOCK::now();
+    uint64_t count = 0;
+    while (auto record = reader->next()){
+        if (record->kind == eventtrace::RecordKind::name_definition){
+            auto name = ids_by_name.find(std::string(record->name()));
+            if (name != ids_by_name.end()){
+                id_map[record->evid] = name->second;
+            }
+        }else if (record->kind == eventtrace::RecordKind::event){
+            auto evid = id_map.find(record->evid);
+            if (evid == id_map.end()){
+                continue;
+            }
+            if (realtime){
+                std::this_thread::sleep_until(start + std::chrono::nanoseconds(record->timestamp));
+            }
+            sendEvent(record->make_event(evid->second));
+            if (++count % 256 == 0 && getStatus() != Status::running){
+                break;
+            }
+        }
+    }
+
+    // wait until all replayed events are processed
+    std::unique_lock lock(mutex);
+    if (status == Status::running){
+        ApiContext context;
+        context.type = ApiContext::Type::sync;
+        Event ev{static_cast<uint64_t>(EventID::API_REQUEST), &context};
+        lock.unlock();
+        sendEvent(std::move(ev));
+        lock.lock();
+        event.cv_for_client.wait(lock, [this, &context](){return status != Status::running || context.done;});
+    }
+    trace.is_profiling = false;
+    return status == Status::running;
+}
+
+std::vector<MapperEngine::ActionLatency> MapperEngine::get_action_latencies(){
+    std::lock_guard lock(trace.latency_mutex);
+    std::vector<ActionLatency> list;
+    for (auto& [key, latency] : trace.latencies){
+        list.push_back(latency);
+    }
+    return list;
 }
 
 //============================================================================================
@@ -643,12 +957,7 @@ void MapperEngine::sendEventNoLock(Event &&ev){
 //============================================================================================
 void MapperEngine::invokeActionIn(std::shared_ptr<Action> action, const Event& ev, MILLISEC millisec){
     std::lock_guard lock(mutex);
-    auto target = now + millisec;
-    while (event.deferred_actions.count(target)){
-        target += MILLISEC(1);
-    }
-    DeferredAction da(action, ev);
-    event.deferred_actions.emplace(target, std::move(da));
+    event.deferred_actions.add(now + millisec, DeferredAction(action, ev));
     notify_server();
 }
 
@@ -656,17 +965,44 @@ void MapperEngine::invokeActionIn(std::shared_ptr<Action> action, const Event& e
 // finding action correspond to event
 //============================================================================================
 Action* MapperEngine::findAction(uint64_t evid){
-    auto action = scripting.viewportManager->find_action(evid);
-    if (action){
-        return action;
-    }else if (mapping[1].get() && mapping[1]->count(evid) > 0){
-        return mapping[1]->at(evid).get();
-    }else if (mapping[0].get() && mapping[0]->count(evid) > 0){
-        return mapping[0]->at(evid).get();
+    if (dispatcher.is_dirty.exchange(false, std::memory_order_acq_rel)){
+        rebuildDispatchTable();
+    }
+    auto index = evid - static_cast<uint64_t>(EventID::DINAMIC_EVENT);
+    if (index < dispatcher.table.size()){
+        return dispatcher.table[index];
+    }else if (dispatcher.sparse_table.size() > 0){
+        auto entry = dispatcher.sparse_table.find(evid);
+        return entry != dispatcher.sparse_table.end() ? entry->second : nullptr;
     }
     return nullptr;
 }
 
+void MapperEngine::rebuildDispatchTable(){
+    auto base = static_cast<uint64_t>(EventID::DINAMIC_EVENT);
+    dispatcher.table.assign(event.idCounter - base, nullptr);
+    dispatcher.sparse_table.clear();
+    auto put = [this, base](uint64_t evid, Action* action){
+        if (evid >= base && evid < event.idCounter){
+            dispatcher.table[evid - base] = action;
+        }else{
+            dispatcher.sparse_table[evid] = action;
+        }
+    };
+
+    // put actions in ascending order of priority: primary, secondary, then viewports
+    for (auto& layer : mapping){
+        if (layer){
+            for (auto& [evid, action] : *layer){
+                put(evid, action.get());
+            }
+        }
+    }
+    scripting.viewportManager->enum_actions(put);
+
+    dispatcher.rebuild_count++;
+}
+
 //============================================================================================
 // funtions to expose to Lua script
 //============================================================================================
@@ -784,8 +1120,10 @@ MAPPINGS_STAT MapperEngine::get_mapping_stat(){
         auto&& vstat = scripting.viewportManager->get_mappings_stat();
         auto primary = static_cast<int>(mapping[0].get() ? mapping[0]->size() : 0);
         auto secondary = static_cast<int>(mapping[1].get() ? mapping[1]->size() : 0);
-        return {primary, secondary, vstat.first, vstat.second};
+        return {primary, secondary, vstat.first, vstat.second, dispatcher.rebuild_count.load(),
+                event.batch_stat.num_batches, event.batch_stat.num_events, event.batch_stat.max_size};
     }else{
-        return {0, 0, 0, 0};
+        return {0, 0, 0, 0, dispatcher.rebuild_count.load(),
+                event.batch_stat.num_batches, event.batch_stat.num_events, event.batch_stat.max_size};
     }
 }
@@ -7,9 +7,12 @@
 
 #include <functional>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
 #include <queue>
 #include <map>
+#include <unordered_map>
+#include <vector>
 #include <string>
 #include <memory>
 #include <stdexcept>
@@ -19,6 +22,9 @@
 #include "mappercore_inner.h"
 #include "option.h"
 #include "event.h"
+#include "eventqueue.h"
+#include "timerqueue.h"
+#include "eventtrace.h"
 #include "action.h"
 #include "tools.h"
 #include "devlog.h"
@@ -95,13 +101,21 @@ protected :
         Event& get_event(){return event;};
     };
 
+    static constexpr size_t EVENT_QUEUE_CAPACITY = 1024;
+
     struct {
         WinHandle event_as_cv;
         std::condition_variable cv_for_client;
         uint64_t idCounter;
         std::map<uint64_t, std::string> names;
-        std::queue< std::unique_ptr<Event> > queue;
-        std::map<TIME_POINT, DeferredAction> deferred_actions;
+        MpscQueue<Event, EVENT_QUEUE_CAPACITY> queue;
+        std::atomic<bool> loop_is_waiting{false};
+        TimerQueue<TIME_POINT, DeferredAction> deferred_actions;
+        struct {
+            uint64_t num_batches = 0;
+            uint64_t num_events = 0;
+            uint64_t max_size = 0;
+        }batch_stat;
         bool need_update_viewports = false;
         bool touch_event_occurred = false;
         TIME_POINT view_updated_time;
@@ -109,6 +123,42 @@ protected :
 
     std::unique_ptr<EventActionMap> mapping[2];
 
+    struct {
+        // actions of all mapping layers (primary, secondary and viewports) are merged in advance
+        // so that an action can be resolved by single indexed load
+        std::vector<Action*> table;                             // index: evid - DINAMIC_EVENT
+        std::unordered_map<uint64_t, Action*> sparse_table;     // evids out of the table range
+        std::atomic<bool> is_dirty{true};
+        std::atomic<uint64_t> rebuild_count{0};
+    }dispatcher;
+
+public:
+    struct ActionStat{
+        std::string event_name;
+        std::string action_name;
+        bool is_lua_function;
+        ActionStats stats;
+    };
+
+    struct ActionLatency{
+        std::string event_name;
+        std::string action_name;
+        eventtrace::LatencyHistogram histogram;
+    };
+
+protected:
+    struct {
+        // producers touch writer_mutex only while recording
+        std::atomic<bool> is_recording{false};
+        std::mutex writer_mutex;
+        std::unique_ptr<eventtrace::Writer> writer;
+
+        // latencies of action invocations are measured while replaying a trace
+        std::atomic<bool> is_profiling{false};
+        std::mutex latency_mutex;
+        std::map<std::pair<uint64_t, Action*>, ActionLatency> latencies;
+    }trace;
+
 public:
     MapperEngine(Callback callback, Logger logger);
     virtual ~MapperEngine();
@@ -170,25 +220,52 @@ public:
     }
 
     uint64_t registerEvent(std::string&& name);
+    uint64_t registerEvents(std::vector<std::string>&& names);
     void unregisterEvent(uint64_t evid);
     const char* getEventName(uint64_t evid) const;
     void sendEvent(Event&& event);
     void sendEventNoLock(Event&& event);
+    void sendEvents(Event* events, size_t num);
+
+    //----------------------------------------------------------------------------------------
+    // Events sent by sendEvent() on the current thread while this object is alive are
+    // collected, then they are enqueued at once when the outermost object is destructed.
+    //----------------------------------------------------------------------------------------
+    class EventBatch{
+    protected:
+        MapperEngine& engine;
+        bool is_outermost;
+
+    public:
+        EventBatch() = delete;
+        EventBatch(const EventBatch&) = delete;
+        EventBatch(EventBatch&&) = delete;
+        explicit EventBatch(MapperEngine& engine);
+        ~EventBatch();
+    };
     void sendHostEvent(MAPPER_EVENT event, int64_t data);
 
     void invokeActionIn(std::shared_ptr<Action> action, const Event& event, MILLISEC millisec);
 
     void notifyUpdate(uint32_t flag){
         std::lock_guard lock(mutex);
-        scripting.updated_flags |= flag;
-        notify_server();
+        notifyUpdateWithNoLock(flag);
     }
 
     void notifyUpdateWithNoLock(uint32_t flag){
+        if (flag & UPDATED_MAPPINGS){
+            invalidateDispatchTable();
+        }
         scripting.updated_flags |= flag;
         notify_server();
     }
 
+    void invalidateDispatchTable(){
+        // the dispatch table is rebuilt by the event-action mapping loop
+        // when it resolves an action next time
+        dispatcher.is_dirty.store(true, std::memory_order_release);
+    }
+
     void invokeViewportsUpdate(){
         // this function must be called from the event-action mapping loop (thread)
         // and this flag (need_update_viewports) is refered by only that thread
@@ -226,11 +303,20 @@ public:
     bool enable_viewports();
     bool disable_viewports();
     MAPPINGS_STAT get_mapping_stat();
+    std::vector<ActionStat> get_action_stats();
+    bool replay_event_trace(const char* path, bool realtime);
+    std::vector<ActionLatency> get_action_latencies();
     
 protected:
     void initScriptingEnv();
     void clearScriptingEnv();
     Action* findAction(uint64_t evid);
+    void rebuildDispatchTable();
+    void startEventTrace();
+    void stopEventTrace();
+    void recordEvent(const Event& ev);
+    void invokeAction(Action* action, Event& ev);
+    std::vector<ActionStat> collectActionStats();
 
     void setMapping(const char* function_name, int level, const sol::object& mapdef);
     void addMapping(const char* function_name, int level, const sol::object& mapdef);
@@ -242,6 +328,17 @@ protected:
             ::SetEvent(event.event_as_cv);
         }
     }
+
+    inline void notify_server_for_event(){
+        // Event queue is lock-free. The event-action mapping loop raises loop_is_waiting flag
+        // before checking the queue and sleeping, so producers need to touch the mutex and
+        // kernel objects only when the loop may sleep.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (event.loop_is_waiting.load(std::memory_order_relaxed)){
+            std::lock_guard lock(mutex);
+            notify_server();
+        }
+    }
 };
 
 template <typename T>
@@ -7,15 +7,18 @@
 
 #include <string>
 #include <map>
+#include <functional>
 #include <memory>
 #include <cmath>
+#include <cstring>
+#include <string_view>
 #include <sol/sol.hpp>
 
 struct ApiContext;
 
 class EventValue{
 public:
-    enum class Type{
+    enum class Type : uint8_t{
         null,
         bool_value,
         int_value,
@@ -26,88 +29,117 @@ public:
         pointer,
     };
 
+    // strings shorter than this are held in the object itself,
+    // longer strings are held as a shared immutable payload
+    static constexpr size_t INLINE_STRING_CAPACITY = 23;
+    using SharedString = std::shared_ptr<const std::string>;
+
 protected:
     Type type;
-    union{
+    bool isSharedString = false;
+    uint8_t inlineLength = 0;
+    union Storage{
         bool boolValue;
         int64_t intValue;
         double doubleValue;
         ApiContext* apiContext;
         void* pointer;
-    }unionValue;
-    std::unique_ptr<std::string> stringValue;
-    sol::object luaValue;
+        char inlineString[INLINE_STRING_CAPACITY + 1];
+        SharedString sharedString;
+        sol::object luaValue;
+
+        Storage(){};
+        ~Storage(){};
+    }storage;
 
 public:
     EventValue(): type(Type::null){};
     EventValue(bool value): type(Type::bool_value){
-        unionValue.boolValue = value;
+        storage.boolValue = value;
     };
     EventValue(int64_t value): type(Type::int_value){
-        unionValue.intValue = value;
+        storage.intValue = value;
     };
     EventValue(double value): type(Type::double_value){
-        unionValue.doubleValue = value;
+        storage.doubleValue = value;
     };
     EventValue(ApiContext* value): type(Type::api_context){
-        unionValue.apiContext = value;
+        storage.apiContext = value;
     }
     EventValue(void* value): type(Type::pointer){
-        unionValue.pointer = value;
+        storage.pointer = value;
     }
     EventValue(const char* value) : type(Type::string_value){
-        stringValue = std::make_unique<std::string>(value);
+        setString(value, std::strlen(value));
+    };
+    EventValue(const std::string& value) : type(Type::string_value){
+        setString(value.data(), value.length());
     };
     EventValue(std::string&& value) : type(Type::string_value){
-        stringValue = std::make_unique<std::string>(std::move(value));
+        if (value.length() <= INLINE_STRING_CAPACITY){
+            setString(value.data(), value.length());
+        }else{
+            isSharedString = true;
+            new (&storage.sharedString) SharedString(std::make_shared<const std::string>(std::move(value)));
+        }
+    };
+    EventValue(const SharedString& value) : type(Type::string_value){
+        isSharedString = true;
+        new (&storage.sharedString) SharedString(value);
     };
     EventValue(const sol::object& value){
         auto valtype = value.get_type();
         if (valtype == sol::type::lua_nil){
             type = Type::null;
         }else if (valtype == sol::type::boolean){
-            type = Type::null;
-            unionValue.boolValue = value.as<bool>();
+            type = Type::bool_value;
+            storage.boolValue = value.as<bool>();
         }else if (valtype == sol::type::number){
-            unionValue.doubleValue = value.as<double>();
+            storage.doubleValue = value.as<double>();
             double intpart ;
-            if (unionValue.doubleValue <= INT64_MAX && unionValue.doubleValue >= INT64_MIN &&
-                std::modf(unionValue.doubleValue, &intpart) == 0.){
+            if (storage.doubleValue <= INT64_MAX && storage.doubleValue >= INT64_MIN &&
+                std::modf(storage.doubleValue, &intpart) == 0.){
                 type = Type::int_value;
-                unionValue.intValue = unionValue.doubleValue;
+                storage.intValue = storage.doubleValue;
             }else{
                 type = Type::double_value;
             }
         }else if (valtype == sol::type::string){
             type = Type::string_value;
-            stringValue = std::make_unique<std::string>(value.as<const char*>());
+            auto&& view = value.as<std::string_view>();
+            if (view.length() <= INLINE_STRING_CAPACITY){
+                setString(view.data(), view.length());
+            }else{
+                isSharedString = true;
+                new (&storage.sharedString) SharedString(std::make_shared<const std::string>(view));
+            }
         }else{
             type = Type::lua_value;
-            luaValue = value;
+            new (&storage.luaValue) sol::object(value);
         }
     }
-    EventValue(const EventValue& src){
-        *this = src;
+    EventValue(const EventValue& src): type(Type::null){
+        copyFrom(src);
     };
-    EventValue(EventValue&& src){
-        *this = std::move(src);
+    EventValue(EventValue&& src): type(Type::null){
+        moveFrom(std::move(src));
+    };
+    ~EventValue(){
+        release();
     };
-    ~EventValue() = default;
 
     EventValue& operator = (const EventValue& src){
-        type = src.type;
-        unionValue = src.unionValue;
-        if (src.stringValue.get()){
-            stringValue = std::make_unique<std::string>(*src.stringValue);
+        if (this != &src){
+            release();
+            copyFrom(src);
         }
-        luaValue = src.luaValue;
         return *this;
     }
     EventValue& operator = (EventValue&& src){
-        type = src.type;
-        unionValue = src.unionValue;
-        stringValue = std::move(src.stringValue);
-        luaValue = src.luaValue;
+        if (this != &src){
+            release();
+            moveFrom(std::move(src));
+        }
         return *this;
     }
 
@@ -115,30 +147,33 @@ public:
 
     operator bool () const{
         switch (type){
-        case Type::null:
-            return false;
         case Type::bool_value:
-            return unionValue.boolValue;
+            return storage.boolValue;
         case Type::int_value:
-            return unionValue.intValue;
+            return storage.intValue;
         case Type::double_value:
-            return unionValue.doubleValue;
+            return storage.doubleValue;
         case Type::string_value:
-            return stringValue->length();
+            return getStringLength();
         case Type::lua_value:
-            return luaValue.get_type() != sol::type::lua_nil;
+            return storage.luaValue.get_type() != sol::type::lua_nil;
         case Type::api_context:
-            return unionValue.apiContext;
+            return storage.apiContext;
+        case Type::pointer:
+            return storage.pointer;
+        case Type::null:
+        default:
+            return false;
         }
     };
     operator int64_t () const{
         switch (type){
         case Type::bool_value:
-            return unionValue.boolValue;
+            return storage.boolValue;
         case Type::int_value:
-            return unionValue.intValue;
+            return storage.intValue;
         case Type::double_value:
-            return unionValue.doubleValue;
+            return storage.doubleValue;
         case Type::null:
         case Type::string_value:
         case Type::lua_value:
@@ -149,11 +184,11 @@ public:
     operator double () const{
         switch (type){
         case Type::bool_value:
-            return unionValue.boolValue;
+            return storage.boolValue;
         case Type::int_value:
-            return unionValue.intValue;
+            return storage.intValue;
         case Type::double_value:
-            return unionValue.doubleValue;
+            return storage.doubleValue;
         case Type::null:
         case Type::string_value:
         case Type::lua_value:
@@ -162,40 +197,100 @@ public:
         }
     };
     operator const char* () const{
-        switch (type){
-        case Type::string_value:
-            return stringValue->c_str();
-        case Type::null:
-        case Type::bool_value:
-        case Type::int_value:
-        case Type::double_value:
-        case Type::lua_value:
-        default:
+        if (type == Type::string_value){
+            return isSharedString ? storage.sharedString->c_str() : storage.inlineString;
+        }else{
             return "";
         }
     };
+    operator std::string_view () const{
+        if (type == Type::string_value){
+            return {this->operator const char*(), getStringLength()};
+        }else{
+            return {};
+        }
+    };
     operator std::string () const{
-        return std::move(std::string(this->operator const char*()));
+        return std::string(this->operator std::string_view());
     };
     operator sol::object () const{
-        return luaValue;
+        if (type == Type::lua_value){
+            return storage.luaValue;
+        }else{
+            return sol::object();
+        }
     };
     operator ApiContext* () const{
         if (type == Type::api_context){
-            return unionValue.apiContext;
+            return storage.apiContext;
         }else{
             return nullptr;
         }
     }
     operator void* () const{
         if (type == Type::pointer){
-            return unionValue.pointer;
+            return storage.pointer;
         }else{
             return nullptr;
         }
     }
 
     template <class T> T getAs() const {return static_cast<T>(*this);};
+
+protected:
+    size_t getStringLength() const{
+        return isSharedString ? storage.sharedString->length() : inlineLength;
+    }
+
+    void setString(const char* value, size_t length){
+        if (length <= INLINE_STRING_CAPACITY){
+            isSharedString = false;
+            inlineLength = static_cast<uint8_t>(length);
+            std::memcpy(storage.inlineString, value, length);
+            storage.inlineString[length] = 0;
+        }else{
+            isSharedString = true;
+            new (&storage.sharedString) SharedString(std::make_shared<const std::string>(value, length));
+        }
+    }
+
+    void copyFrom(const EventValue& src){
+        type = src.type;
+        isSharedString = src.isSharedString;
+        inlineLength = src.inlineLength;
+        if (type == Type::string_value && isSharedString){
+            new (&storage.sharedString) SharedString(src.storage.sharedString);
+        }else if (type == Type::lua_value){
+            new (&storage.luaValue) sol::object(src.storage.luaValue);
+        }else{
+            std::memcpy(static_cast<void*>(&storage), &src.storage, sizeof(storage));
+        }
+    }
+
+    void moveFrom(EventValue&& src){
+        type = src.type;
+        isSharedString = src.isSharedString;
+        inlineLength = src.inlineLength;
+        if (type == Type::string_value && isSharedString){
+            new (&storage.sharedString) SharedString(std::move(src.storage.sharedString));
+        }else if (type == Type::lua_value){
+            new (&storage.luaValue) sol::object(std::move(src.storage.luaValue));
+        }else{
+            std::memcpy(static_cast<void*>(&storage), &src.storage, sizeof(storage));
+        }
+        src.release();
+    }
+
+    void release(){
+        if (type == Type::string_value && isSharedString){
+            std::destroy_at(&storage.sharedString);
+        }else if (type == Type::lua_value){
+            std::destroy_at(&storage.luaValue);
+        }
+        type = Type::null;
+        isSharedString = false;
+        inlineLength = 0;
+    }
 };
 
 
@@ -207,7 +302,8 @@ public:
 protected:
     uint64_t id;
     EventValue value;
-	std::unique_ptr<AssosiativeArray> array;
+    std::shared_ptr<const AssosiativeArray> array;
+    bool continued_in_frame = false;
 
 public:
     Event() = delete;
@@ -217,31 +313,25 @@ public:
     Event(uint64_t id, double value): id(id), value(value){};
     Event(uint64_t id, const char* value) : id(id), value(value){};
     Event(uint64_t id, std::string&& value) : id(id), value(std::move(value)){};
+    Event(uint64_t id, const EventValue::SharedString& value) : id(id), value(value){};
     Event(uint64_t id, sol::object&& value): id(id), value(std::move(value)){};
     Event(uint64_t id, ApiContext* value): id(id), value(value){}
     Event(uint64_t id, void* value): id(id), value(value){}
-    Event(uint64_t id, AssosiativeArray&& value): id(id), array(std::make_unique<AssosiativeArray>(std::move(value))){};
-    Event(const Event& src){*this = src;};
-    Event(Event&& src): id(src.id), value(std::move(src.value)), array(std::move(src.array)){};
+    Event(uint64_t id, AssosiativeArray&& value): id(id), array(std::make_shared<const AssosiativeArray>(std::move(value))){};
+    Event(const Event& src) = default;
+    Event(Event&& src) = default;
     ~Event() = default;
 
-    Event& operator = (const Event& src){
-        id = src.id;
-        value = src.value;
-        if (src.array.get()){
-            array = std::make_unique<AssosiativeArray>(*src.array);
-        }
-        return *this;
-    }
-    Event& operator = (Event&& src){
-        id = src.id;
-        value = std::move(src.value);
-        array = std::move(src.array);
-        return *this;
-    }
+    Event& operator = (const Event& src) = default;
+    Event& operator = (Event&& src) = default;
 
     uint64_t getId() const{return id;};
     bool isArrayValue() const{return array.get();};
+
+    // events in a frame must be handled in a row, this flag indicates that
+    // the following event belongs to the same frame
+    bool isContinuedInFrame() const{return continued_in_frame;};
+    void setContinuedInFrame(bool value){continued_in_frame = value;};
     Type getType() const{return value.getType();};
 
     operator bool () const{
@@ -256,8 +346,11 @@ public:
     operator const char* () const{
         return static_cast<const char*>(value);
     };
+    operator std::string_view () const{
+        return static_cast<std::string_view>(value);
+    };
     operator std::string () const{
-        return std::move(std::string(this->operator const char*()));
+        return static_cast<std::string>(value);
     };
     operator sol::object () const{
         return static_cast<sol::object>(value);
@@ -287,14 +380,16 @@ public:
                 table[key] = value.getAs<int64_t>();
                 break;
             case Type::double_value:
-                table[key] = value.getAs<int64_t>();
+                table[key] = value.getAs<double>();
                 break;
             case Type::string_value:
-                table[key] = value.getAs<const char*>();
+                table[key] = value.getAs<std::string_view>();
                 break;
             case Type::lua_value:
                 table[key] = value.getAs<sol::object>();
                 break;
+            default:
+                break;
             }
         }
     }
@@ -315,10 +410,13 @@ struct ApiContext{
     enum class Type{
         start_viewports,
         stop_viewports,
+        sync,
+        procedure,
     };
     Type type;
     bool done = false;
     bool result = false;
+    std::function<void()> procedure;
 
     ApiContext() = default;
 };
\ No newline at end of file
@@ -0,0 +1,209 @@
+//
+// eventqueue.h
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <queue>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+
+//============================================================================================
+// Bounded multi-producer / single-consumer queue
+//    Producers reserve a slot by a single CAS on the tail counter then construct the item
+//    in the slot directly. Each slot has a sequence number which tells the consumer whether
+//    the item in the slot has been published.
+//    If the ring is full, items spill into the overflow queue guarded by a mutex. Once an
+//    item has spilled, succeeding items are also put into the overflow queue until the
+//    consumer drains it, so that order of items pushed from a same thread is kept.
+//    Items pushed by push_bulk() form a frame. A frame is placed either in the ring or in
+//    the overflow queue as a whole, and becomes visible to the consumer at once, so the
+//    consumer never observes a part of a frame nor items of other frames within a frame.
+//============================================================================================
+template <typename T, size_t CAPACITY>
+class MpscQueue{
+    static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0, "capacity must be a power of 2");
+    static constexpr size_t INDEX_MASK = CAPACITY - 1;
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+
+    struct Slot{
+        std::atomic<size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* item(){return std::launder(reinterpret_cast<T*>(storage));}
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail{0};
+    alignas(CACHE_LINE_SIZE) size_t head = 0;
+    alignas(CACHE_LINE_SIZE) std::atomic<bool> overflowed{false};
+    std::mutex overflow_mutex;
+    std::queue<std::vector<T>> overflow;
+
+    // rest of the frame taken from the overflow queue, touched only by the consumer
+    std::vector<T> overflow_frame;
+    size_t overflow_frame_pos = 0;
+
+public:
+    MpscQueue(): slots(std::make_unique<Slot[]>(CAPACITY)){
+        for (size_t i = 0; i < CAPACITY; i++){
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue(MpscQueue&&) = delete;
+    ~MpscQueue(){
+        while (pop_from_ring());
+    }
+
+    //-------------------------------------------------------------------------------
+    // producer side: these functions can be called from any thread
+    //-------------------------------------------------------------------------------
+    void push(T&& item){
+        if (!overflowed.load(std::memory_order_acquire) && push_to_ring(item)){
+            return;
+        }
+        std::vector<T> frame;
+        frame.push_back(std::move(item));
+        std::lock_guard lock(overflow_mutex);
+        overflow.push(std::move(frame));
+        overflowed.store(true, std::memory_order_release);
+    }
+
+    // items are reserved by a single CAS if the ring has enough free slots, otherwise
+    // all of them spill into the overflow queue as a single frame
+    void push_bulk(T* items, size_t num){
+        if (num == 0){
+            return;
+        }
+        if (!overflowed.load(std::memory_order_acquire) && push_bulk_to_ring(items, num)){
+            return;
+        }
+        std::vector<T> frame;
+        frame.reserve(num);
+        for (size_t i = 0; i < num; i++){
+            frame.push_back(std::move(items[i]));
+        }
+        std::lock_guard lock(overflow_mutex);
+        overflow.push(std::move(frame));
+        overflowed.store(true, std::memory_order_release);
+    }
+
+    //-------------------------------------------------------------------------------
+    // consumer side: these functions must be called from a single thread
+    //-------------------------------------------------------------------------------
+    bool empty(){
+        auto& slot = slots[head & INDEX_MASK];
+        return overflow_frame_pos >= overflow_frame.size() &&
+               slot.sequence.load(std::memory_order_acquire) != head + 1 &&
+               !overflowed.load(std::memory_order_acquire);
+    }
+
+    std::optional<T> pop(){
+        if (overflow_frame_pos < overflow_frame.size()){
+            return pop_from_overflow_frame();
+        }
+        auto item = pop_from_ring();
+        if (item || !overflowed.load(std::memory_order_acquire)){
+            return item;
+        }
+        std::lock_guard lock(overflow_mutex);
+        // items published to the ring before spilling must be taken first
+        item = pop_from_ring();
+        if (!item && !overflow.empty()){
+            overflow_frame = std::move(overflow.front());
+            overflow_frame_pos = 0;
+            overflow.pop();
+            item = pop_from_overflow_frame();
+        }
+        if (overflow.empty()){
+            overflowed.store(false, std::memory_order_release);
+        }
+        return item;
+    }
+
+protected:
+    bool push_to_ring(T& item){
+        auto pos = tail.load(std::memory_order_relaxed);
+        while (true){
+            auto& slot = slots[pos & INDEX_MASK];
+            auto sequence = slot.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0){
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                    new (slot.storage) T(std::move(item));
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }else if (diff < 0){
+                return false;
+            }else{
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool push_bulk_to_ring(T* items, size_t num){
+        if (num > CAPACITY){
+            return false;
+        }
+        auto pos = tail.load(std::memory_order_relaxed);
+        while (true){
+            // slots are released by the consumer in order, so the whole range is free
+            // if the last slot of the range is free
+            auto& last = slots[(pos + num - 1) & INDEX_MASK];
+            auto sequence = last.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + num - 1);
+            if (diff == 0){
+                if (slots[pos & INDEX_MASK].sequence.load(std::memory_order_acquire) != pos){
+                    pos = tail.load(std::memory_order_relaxed);
+                    continue;
+                }
+                if (tail.compare_exchange_weak(pos, pos + num, std::memory_order_relaxed)){
+                    for (size_t i = 0; i < num; i++){
+                        new (slots[(pos + i) & INDEX_MASK].storage) T(std::move(items[i]));
+                    }
+                    // the first slot is published last, the consumer cannot reach the rest
+                    // of the frame before that, so the whole frame becomes visible at once
+                    for (size_t i = 1; i < num; i++){
+                        slots[(pos + i) & INDEX_MASK].sequence.store(pos + i + 1, std::memory_order_release);
+                    }
+                    slots[pos & INDEX_MASK].sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }else if (diff < 0){
+                return false;
+            }else{
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::optional<T> pop_from_overflow_frame(){
+        std::optional<T> item{std::move(overflow_frame[overflow_frame_pos++])};
+        if (overflow_frame_pos >= overflow_frame.size()){
+            overflow_frame.clear();
+            overflow_frame_pos = 0;
+        }
+        return item;
+    }
+
+    std::optional<T> pop_from_ring(){
+        auto& slot = slots[head & INDEX_MASK];
+        if (slot.sequence.load(std::memory_order_acquire) != head + 1){
+            return std::nullopt;
+        }
+        std::optional<T> item{std::move(*slot.item())};
+        slot.item()->~T();
+        slot.sequence.store(head + CAPACITY, std::memory_order_release);
+        head++;
+        return item;
+    }
+};
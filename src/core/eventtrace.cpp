@@ -0,0 +1,350 @@
+//
+// eventtrace.cpp
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+
+#include <stdexcept>
+#include <sstream>
+#include <cstring>
+#include <algorithm>
+#include "eventtrace.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+#   include <windows.h>
+#else
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#endif
+
+using namespace eventtrace;
+
+static constexpr size_t FILE_HEADER_SIZE = 24;
+static constexpr size_t RECORD_HEADER_SIZE = 24;
+static constexpr size_t RECORD_ALIGNMENT = 8;
+
+static size_t aligned_length(size_t length){
+    return (length + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+}
+
+static void throw_file_error(const char* operation, const std::string& path){
+    std::ostringstream os;
+    os << "failed to " << operation << " an event trace file: " << path;
+    throw std::runtime_error(os.str());
+}
+
+//============================================================================================
+// memory mapped file
+//============================================================================================
+MappedFile::~MappedFile(){
+    close();
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+void MappedFile::create(const char* path, size_t size){
+    this->path = path;
+    writable = true;
+    file = ::CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE){
+        file = nullptr;
+        throw_file_error("create", this->path);
+    }
+    map(size);
+}
+
+void MappedFile::open(const char* path){
+    this->path = path;
+    writable = false;
+    file = ::CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE){
+        file = nullptr;
+        throw_file_error("open", this->path);
+    }
+    LARGE_INTEGER size;
+    if (!::GetFileSizeEx(file, &size) || size.QuadPart == 0){
+        throw_file_error("map", this->path);
+    }
+    map(static_cast<size_t>(size.QuadPart));
+}
+
+void MappedFile::map(size_t size){
+    auto size64 = static_cast<uint64_t>(size);
+    mapping = ::CreateFileMappingA(file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY,
+                                   static_cast<DWORD>(size64 >> 32), static_cast<DWORD>(size64 & 0xffffffff), nullptr);
+    if (!mapping){
+        throw_file_error("map", path);
+    }
+    data = static_cast<uint8_t*>(::MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size));
+    if (!data){
+        throw_file_error("map", path);
+    }
+    mapped_size = size;
+}
+
+void MappedFile::unmap(){
+    if (data){
+        ::UnmapViewOfFile(data);
+        data = nullptr;
+    }
+    if (mapping){
+        ::CloseHandle(mapping);
+        mapping = nullptr;
+    }
+    mapped_size = 0;
+}
+
+void MappedFile::close(std::optional<size_t> final_size){
+    unmap();
+    if (file){
+        if (writable && final_size){
+            LARGE_INTEGER position;
+            position.QuadPart = static_cast<LONGLONG>(*final_size);
+            ::SetFilePointerEx(file, position, nullptr, FILE_BEGIN);
+            ::SetEndOfFile(file);
+        }
+        ::CloseHandle(file);
+        file = nullptr;
+    }
+}
+#else
+void MappedFile::create(const char* path, size_t size){
+    this->path = path;
+    writable = true;
+    file = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file < 0){
+        throw_file_error("create", this->path);
+    }
+    map(size);
+}
+
+void MappedFile::open(const char* path){
+    this->path = path;
+    writable = false;
+    file = ::open(path, O_RDONLY);
+    if (file < 0){
+        throw_file_error("open", this->path);
+    }
+    struct stat st;
+    if (::fstat(file, &st) != 0 || st.st_size == 0){
+        throw_file_error("map", this->path);
+    }
+    map(static_cast<size_t>(st.st_size));
+}
+
+void MappedFile::map(size_t size){
+    if (writable && ::ftruncate(file, static_cast<off_t>(size)) != 0){
+        throw_file_error("extend", path);
+    }
+    auto addr = ::mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                       writable ? MAP_SHARED : MAP_PRIVATE, file, 0);
+    if (addr == MAP_FAILED){
+        throw_file_error("map", path);
+    }
+    data = static_cast<uint8_t*>(addr);
+    mapped_size = size;
+}
+
+void MappedFile::unmap(){
+    if (data){
+        ::munmap(data, mapped_size);
+        data = nullptr;
+    }
+    mapped_size = 0;
+}
+
+void MappedFile::close(std::optional<size_t> final_size){
+    unmap();
+    if (file >= 0){
+        if (writable && final_size){
+            [[maybe_unused]] auto rc = ::ftruncate(file, static_cast<off_t>(*final_size));
+        }
+        ::close(file);
+        file = -1;
+    }
+}
+#endif
+
+void MappedFile::resize(size_t size){
+    unmap();
+    map(size);
+}
+
+//============================================================================================
+// trace writer
+//============================================================================================
+Writer::Writer(const char* path){
+    file.create(path, INITIAL_SIZE);
+    start_time = CLOCK::now();
+    auto epoch_time = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    auto data = file.get_data();
+    uint32_t version = VERSION;
+    uint32_t header_size = FILE_HEADER_SIZE;
+    memcpy(data, MAGIC, sizeof(MAGIC));
+    memcpy(data + 8, &version, sizeof(version));
+    memcpy(data + 12, &header_size, sizeof(header_size));
+    memcpy(data + 16, &epoch_time, sizeof(epoch_time));
+    length = FILE_HEADER_SIZE;
+}
+
+Writer::~Writer(){
+    file.close(length);
+}
+
+uint64_t Writer::timestamp() const{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(CLOCK::now() - start_time).count());
+}
+
+void Writer::define_name(uint64_t evid, std::string_view name){
+    defined_ids.insert(evid);
+    put_record(timestamp(), evid, RecordKind::name_definition, ValueType::null, name.data(), name.length());
+}
+
+void Writer::record(const Event& event){
+    auto evid = static_cast<uint64_t>(event.getId());
+    auto type = event.getType();
+    ValueType vtype = ValueType::unsupported;
+    const void* payload = nullptr;
+    size_t payload_length = 0;
+    uint8_t bool_value;
+    int64_t int_value;
+    double double_value;
+    std::string_view string_value;
+    if (event.isArrayValue()){
+        vtype = ValueType::unsupported;
+    }else if (type == Event::Type::null){
+        vtype = ValueType::null;
+    }else if (type == Event::Type::bool_value){
+        vtype = ValueType::bool_value;
+        bool_value = event.getAs<bool>() ? 1 : 0;
+        payload = &bool_value;
+        payload_length = sizeof(bool_value);
+    }else if (type == Event::Type::int_value){
+        vtype = ValueType::int_value;
+        int_value = event.getAs<int64_t>();
+        payload = &int_value;
+        payload_length = sizeof(int_value);
+    }else if (type == Event::Type::double_value){
+        vtype = ValueType::double_value;
+        double_value = event.getAs<double>();
+        payload = &double_value;
+        payload_length = sizeof(double_value);
+    }else if (type == Event::Type::string_value){
+        vtype = ValueType::string_value;
+        string_value = event.getAs<std::string_view>();
+        payload = string_value.data();
+        payload_length = string_value.length();
+    }
+
+    if (defined_ids.count(evid) == 0){
+        // events which have no registered name, such as internal requests, are not recorded
+        return;
+    }
+    put_record(timestamp(), evid, RecordKind::event, vtype, payload, payload_length);
+}
+
+uint8_t* Writer::reserve(size_t payload_length){
+    auto record_length = aligned_length(RECORD_HEADER_SIZE + payload_length);
+    if (length + record_length > file.get_size()){
+        auto new_size = file.get_size() * 2;
+        while (new_size < length + record_length){
+            new_size *= 2;
+        }
+        file.resize(new_size);
+    }
+    auto record = file.get_data() + length;
+    length += record_length;
+    return record;
+}
+
+void Writer::put_record(uint64_t timestamp, uint64_t evid, RecordKind kind, ValueType vtype, const void* payload, size_t payload_length){
+    auto record = reserve(payload_length);
+    uint8_t kind_value = static_cast<uint8_t>(kind);
+    uint8_t type_value = static_cast<uint8_t>(vtype);
+    uint16_t reserved = 0;
+    uint32_t length32 = static_cast<uint32_t>(payload_length);
+    memcpy(record, &timestamp, sizeof(timestamp));
+    memcpy(record + 8, &evid, sizeof(evid));
+    memcpy(record + 16, &kind_value, sizeof(kind_value));
+    memcpy(record + 17, &type_value, sizeof(type_value));
+    memcpy(record + 18, &reserved, sizeof(reserved));
+    memcpy(record + 20, &length32, sizeof(length32));
+    if (payload_length > 0){
+        memcpy(record + RECORD_HEADER_SIZE, payload, payload_length);
+    }
+}
+
+//============================================================================================
+// trace reader
+//============================================================================================
+Reader::Reader(const char* path){
+    file.open(path);
+    auto data = file.get_data();
+    uint32_t version;
+    uint32_t header_size;
+    if (file.get_size() < FILE_HEADER_SIZE || memcmp(data, MAGIC, sizeof(MAGIC)) != 0){
+        throw std::runtime_error("the file is not an event trace file");
+    }
+    memcpy(&version, data + 8, sizeof(version));
+    memcpy(&header_size, data + 12, sizeof(header_size));
+    memcpy(&start_time, data + 16, sizeof(start_time));
+    if (version != VERSION || header_size < FILE_HEADER_SIZE || header_size > file.get_size()){
+        throw std::runtime_error("unsupported version of event trace file");
+    }
+    position = header_size;
+}
+
+void Reader::rewind(){
+    uint32_t header_size;
+    memcpy(&header_size, file.get_data() + 12, sizeof(header_size));
+    position = header_size;
+}
+
+std::optional<Record> Reader::next(){
+    if (position + RECORD_HEADER_SIZE > file.get_size()){
+        return std::nullopt;
+    }
+    auto data = file.get_data() + position;
+    Record record;
+    uint32_t length32;
+    memcpy(&record.timestamp, data, sizeof(record.timestamp));
+    memcpy(&record.evid, data + 8, sizeof(record.evid));
+    record.kind = static_cast<RecordKind>(data[16]);
+    record.value_type = static_cast<ValueType>(data[17]);
+    memcpy(&length32, data + 20, sizeof(length32));
+    record.payload_length = length32;
+    record.payload = data + RECORD_HEADER_SIZE;
+    if (record.kind != RecordKind::name_definition && record.kind != RecordKind::event){
+        // rest of the file has not been written, recording may have been interrupted
+        return std::nullopt;
+    }
+    if (position + RECORD_HEADER_SIZE + record.payload_length > file.get_size()){
+        return std::nullopt;
+    }
+    position += aligned_length(RECORD_HEADER_SIZE + record.payload_length);
+    return record;
+}
+
+Event Record::make_event(uint64_t new_evid) const{
+    switch (value_type){
+    case ValueType::bool_value:
+        return Event(new_evid, payload_length >= 1 && payload[0] != 0);
+    case ValueType::int_value:{
+        int64_t value = 0;
+        memcpy(&value, payload, std::min(payload_length, sizeof(value)));
+        return Event(new_evid, value);
+    }
+    case ValueType::double_value:{
+        double value = 0.;
+        memcpy(&value, payload, std::min(payload_length, sizeof(value)));
+        return Event(new_evid, value);
+    }
+    case ValueType::string_value:
+        return Event(new_evid, std::string(reinterpret_cast<const char*>(payload), payload_length));
+    case ValueType::null:
+    case ValueType::unsupported:
+    default:
+        return Event(new_evid);
+    }
+}
@@ -0,0 +1,183 @@
+//
+// eventtrace.h
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <optional>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include "event.h"
+
+//============================================================================================
+// Event trace file format
+//    A trace file consists of a file header followed by variable length records.
+//    All integers are stored in little endian, and each record is aligned to 8 bytes.
+//
+//    file header:   magic "FSMTRACE" (8 bytes), version (u32), header size (u32),
+//                   system clock at the start of recording in ns since epoch (u64)
+//    record header: timestamp in ns since the start of recording (u64), event id (u64),
+//                   record kind (u8), value type (u8), reserved (u16), payload length (u32)
+//
+//    A name definition record which holds the registered name of an event is placed before
+//    the first event record for the event id. Value payload of event record is 1 byte for
+//    boolean, 8 bytes for integer and double, and the string itself for string. The other
+//    types of value are recorded as unsupported without payload.
+//============================================================================================
+namespace eventtrace{
+    static constexpr char MAGIC[8] = {'F', 'S', 'M', 'T', 'R', 'A', 'C', 'E'};
+    static constexpr uint32_t VERSION = 1;
+
+    enum class RecordKind : uint8_t{
+        name_definition = 1,
+        event = 2,
+    };
+
+    enum class ValueType : uint8_t{
+        null,
+        bool_value,
+        int_value,
+        double_value,
+        string_value,
+        unsupported,
+    };
+
+    using CLOCK = std::chrono::steady_clock;
+
+    //----------------------------------------------------------------------------------------
+    // memory mapped file
+    //----------------------------------------------------------------------------------------
+    class MappedFile{
+    protected:
+        std::string path;
+        bool writable = false;
+        uint8_t* data = nullptr;
+        size_t mapped_size = 0;
+#if defined(_WIN32) || defined(_WIN64)
+        void* file = nullptr;
+        void* mapping = nullptr;
+#else
+        int file = -1;
+#endif
+
+    public:
+        MappedFile() = default;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile(MappedFile&&) = delete;
+        ~MappedFile();
+
+        void create(const char* path, size_t size);
+        void open(const char* path);
+        void resize(size_t size);
+        void close(std::optional<size_t> final_size = std::nullopt);
+
+        uint8_t* get_data() const{return data;}
+        size_t get_size() const{return mapped_size;}
+
+    protected:
+        void map(size_t size);
+        void unmap();
+    };
+
+    //----------------------------------------------------------------------------------------
+    // trace writer
+    //    This class is not thread safe. Owner must serialize accesses.
+    //----------------------------------------------------------------------------------------
+    class Writer{
+    protected:
+        static constexpr size_t INITIAL_SIZE = 4 * 1024 * 1024;
+
+        MappedFile file;
+        size_t length = 0;
+        CLOCK::time_point start_time;
+        std::unordered_set<uint64_t> defined_ids;
+
+    public:
+        Writer() = delete;
+        Writer(const Writer&) = delete;
+        Writer(Writer&&) = delete;
+        explicit Writer(const char* path);
+        ~Writer();
+
+        void define_name(uint64_t evid, std::string_view name);
+        void record(const Event& event);
+
+    protected:
+        uint64_t timestamp() const;
+        uint8_t* reserve(size_t payload_length);
+        void put_record(uint64_t timestamp, uint64_t evid, RecordKind kind, ValueType vtype, const void* payload, size_t payload_length);
+    };
+
+    //----------------------------------------------------------------------------------------
+    // trace reader
+    //----------------------------------------------------------------------------------------
+    struct Record{
+        uint64_t timestamp;
+        uint64_t evid;
+        RecordKind kind;
+        ValueType value_type;
+        const uint8_t* payload;
+        size_t payload_length;
+
+        std::string_view name() const{
+            return {reinterpret_cast<const char*>(payload), payload_length};
+        }
+        Event make_event(uint64_t new_evid) const;
+    };
+
+    class Reader{
+    protected:
+        MappedFile file;
+        size_t position = 0;
+        uint64_t start_time = 0;
+
+    public:
+        Reader() = delete;
+        Reader(const Reader&) = delete;
+        Reader(Reader&&) = delete;
+        explicit Reader(const char* path);
+        ~Reader() = default;
+
+        uint64_t get_start_time() const{return start_time;}
+        std::optional<Record> next();
+        void rewind();
+    };
+
+    //----------------------------------------------------------------------------------------
+    // latency histogram
+    //    bucket i counts samples in range [2^i, 2^(i+1)) ns, bucket 0 also counts 0 ns
+    //----------------------------------------------------------------------------------------
+    class LatencyHistogram{
+    public:
+        static constexpr size_t NUM_BUCKETS = 40;
+
+    protected:
+        uint64_t count = 0;
+        uint64_t total = 0;
+        uint64_t max = 0;
+        std::array<uint64_t, NUM_BUCKETS> buckets{};
+
+    public:
+        void add(uint64_t nanosec){
+            count++;
+            total += nanosec;
+            max = nanosec > max ? nanosec : max;
+            size_t index = 0;
+            for (auto value = nanosec >> 1; value > 0 && index < NUM_BUCKETS - 1; value >>= 1){
+                index++;
+            }
+            buckets[index]++;
+        }
+
+        uint64_t get_count() const{return count;}
+        uint64_t get_total() const{return total;}
+        uint64_t get_max() const{return max;}
+        const std::array<uint64_t, NUM_BUCKETS>& get_buckets() const{return buckets;}
+    };
+}
@@ -8,11 +8,104 @@
 #include <unordered_map>
 #include <sstream>
 #include <algorithm>
+#include <optional>
+#include <chrono>
+#include <cmath>
 #include "filter.h"
+#include "interpolation.h"
+#include "signalfilter.h"
 #include "action.h"
 #include "engine.h"
 #include "tools.h"
 
+//============================================================================================
+// Filter graph
+//    Each native filter keeps a descriptor of the graph which consists of the filter itself
+//    and downstream actions. When a filter is created, the whole graph is compiled into a
+//    flat stage array, and nested native filters are expanded in place instead of being
+//    invoked through NativeAction and std::function of each filter.
+//    Lua functions and native actions other than filters remain as terminal stages.
+//============================================================================================
+struct lerp_rule;
+struct branch_rule;
+struct smooth_rule;
+struct deadband_rule;
+struct rate_limit_rule;
+
+struct FilterNode{
+    enum class Type : uint8_t {
+        terminal, duplicator, delay, lerp_double, lerp_int, branch,
+        smooth_ema, smooth_one_euro, deadband, rate_limit,
+    };
+
+    Type type;
+    std::string name;
+    std::vector<std::shared_ptr<FilterNode>> children;
+    std::shared_ptr<Action> action;                 // terminal, delay
+    MapperEngine* engine = nullptr;                 // delay
+    MapperEngine::MILLISEC millisec{0};             // delay
+    std::shared_ptr<const lerp_rule> lerp;          // lerp_double, lerp_int
+    std::shared_ptr<branch_rule> branch;            // branch
+    std::shared_ptr<smooth_rule> smooth;            // smooth_ema, smooth_one_euro
+    std::shared_ptr<deadband_rule> deadband;        // deadband
+    std::shared_ptr<rate_limit_rule> rate_limit;    // rate_limit
+
+    FilterNode(Type type, std::string&& name): type(type), name(std::move(name)){};
+    FilterNode(const FilterNode&) = delete;
+    FilterNode(FilterNode&&) = delete;
+};
+
+class FilterPipeline{
+protected:
+    struct Stage{
+        FilterNode::Type type;
+        uint32_t first_edge;
+        uint32_t num_edges;
+        FilterNode* node;
+    };
+    std::shared_ptr<FilterNode> root;
+    std::vector<Stage> stages;
+    std::vector<uint32_t> edges;
+
+public:
+    FilterPipeline() = delete;
+    FilterPipeline(const FilterPipeline&) = delete;
+    FilterPipeline(FilterPipeline&&) = delete;
+    FilterPipeline(std::shared_ptr<FilterNode> root): root(std::move(root)){
+        compile(this->root.get());
+    }
+    ~FilterPipeline() = default;
+
+    void invoke(Event& event, sol::state& lua) const{
+        run(0, event, lua);
+    }
+
+protected:
+    uint32_t compile(FilterNode* node){
+        auto index = static_cast<uint32_t>(stages.size());
+        stages.push_back({node->type, 0, 0, node});
+        std::vector<uint32_t> children;
+        for (auto& child : node->children){
+            children.push_back(compile(child.get()));
+        }
+        stages[index].first_edge = static_cast<uint32_t>(edges.size());
+        stages[index].num_edges = static_cast<uint32_t>(children.size());
+        edges.insert(edges.end(), children.begin(), children.end());
+        return index;
+    }
+
+    void run(uint32_t index, Event& event, sol::state& lua) const;
+};
+
+static std::shared_ptr<NativeAction::Function> make_filter_function(std::shared_ptr<FilterNode>&& node){
+    auto pipeline = std::make_shared<const FilterPipeline>(node);
+    NativeAction::Function::ACTION_FUNCTION func = [pipeline = std::move(pipeline)](Event& event, sol::state& lua){
+        pipeline->invoke(event, lua);
+    };
+    auto name = node->name;
+    return std::make_shared<NativeAction::Function>(name.c_str(), func, std::move(node));
+}
+
 //============================================================================================
 // Utility functions
 //============================================================================================
@@ -26,6 +119,22 @@ static std::shared_ptr<Action> generate_action(const sol::object& o_function){
     }
 }
 
+static std::shared_ptr<FilterNode> generate_node(const sol::object& o_function){
+    if (o_function.is<NativeAction::Function&>()){
+        auto function = o_function.as<std::shared_ptr<NativeAction::Function>>();
+        if (function->getFilterNode()){
+            return function->getFilterNode();
+        }
+    }
+    auto action = generate_action(o_function);
+    if (!action){
+        return nullptr;
+    }
+    auto node = std::make_shared<FilterNode>(FilterNode::Type::terminal, action->getName());
+    node->action = std::move(action);
+    return node;
+}
+
 //============================================================================================
 // Event duplicator
 //============================================================================================
@@ -33,24 +142,21 @@ static std::shared_ptr<NativeAction::Function> duplicator(sol::variadic_args& va
     std::ostringstream os;
     os << "filter.duplicate(";
     const char* prefix = "";
-    std::vector<std::shared_ptr<Action>> actions;
+    std::vector<std::shared_ptr<FilterNode>> children;
     for (sol::object arg : va){
-        auto action = std::move(generate_action(arg));
-        if (!action.get()){
+        auto child = generate_node(arg);
+        if (!child){
             throw std::runtime_error("only native action or Lua function can be specified");
         }
-        actions.push_back(action);
-        os << prefix << action->getName();
+        os << prefix << child->name;
         prefix = ", ";
+        children.push_back(std::move(child));
     }
     os << ")";
 
-    NativeAction::Function::ACTION_FUNCTION func = [actions = std::move(actions)](Event& event, sol::state& lua){
-        for (auto& action : actions){
-            action->invoke(event, lua);
-        }
-    };
-    return std::make_shared<NativeAction::Function>(os.str().c_str(), func);
+    auto node = std::make_shared<FilterNode>(FilterNode::Type::duplicator, os.str());
+    node->children = std::move(children);
+    return make_filter_function(std::move(node));
 }
 
 //============================================================================================
@@ -66,25 +172,19 @@ static std::shared_ptr<NativeAction::Function> deferred_executor(MapperEngine& e
     std::ostringstream os;
     os << "filter.delay(" << function->getName() << ")";
 
-    NativeAction::Function::ACTION_FUNCTION func = [&engine, millisec, function](Event& event, sol::state& lua){
-        engine.invokeActionIn(function, event, MapperEngine::MILLISEC(*millisec));
-    };
-    return std::make_shared<NativeAction::Function>(os.str().c_str(), func);
+    // downstream action is invoked later as an independent action,
+    // so it is not expanded into the pipeline which contains this stage
+    auto node = std::make_shared<FilterNode>(FilterNode::Type::delay, os.str());
+    node->action = std::move(function);
+    node->engine = &engine;
+    node->millisec = MapperEngine::MILLISEC(*millisec);
+    return make_filter_function(std::move(node));
 }
 
 //============================================================================================
 // interpolation filters
 //============================================================================================
-template <typename T>
-struct value_map{
-    T in;
-    T out;
-};
-using double_map = value_map<double>;
-using int_map = value_map<int64_t>;
-template <typename T> using value_map_set = std::vector<value_map<T>>;
-using double_map_set = value_map_set<double>;
-using int_map_set = value_map_set<int64_t>;
+template <typename T> using value_map_set = std::vector<typename PiecewiseLinear<T>::Breakpoint>;
 
 enum class val_map_type{invalid, double_map, int_map};
 
@@ -116,7 +216,7 @@ static val_map_type verify_map_rule(sol::object& o_list){
                 return val_map_type::invalid;
             }
             sol::object in_val = valmap[1];
-            sol::object out_val = valmap[1];
+            sol::object out_val = valmap[2];
             auto in_type = lua_numeric_type(in_val);
             auto out_type = lua_numeric_type(out_val);
             if (in_type == val_map_type::invalid || out_type == val_map_type::invalid){
@@ -134,7 +234,7 @@ static val_map_type verify_map_rule(sol::object& o_list){
 }
 
 template <typename T>
-value_map_set<T> generate_value_map(sol::object& o_def){
+PiecewiseLinear<T> generate_value_map(sol::object& o_def){
     value_map_set<T> maps;
     auto def = o_def.as<sol::table>();
     for (int i = 1; i <= def.size(); i++){
@@ -142,85 +242,216 @@ value_map_set<T> generate_value_map(sol::object& o_def){
         T in = map[1];
         T out = map[2];
         maps.push_back({in, out});
-        if (i >= 2){
-            if (maps[i - 2].in <= maps[i - 1].in){
-                "reference value for input value in the interpolation rule must be monotonic increased";
-            }
-        }
     }
-    return std::move(maps);
+    return PiecewiseLinear<T>(maps);
 }
 
-template <typename T>
-struct leap_parameter{
-    T in_range;
-    T out_range;
-    T in_bias;
-    T out_bias;
+struct lerp_rule{
+    PiecewiseLinear<double> double_map;
+    PiecewiseLinear<int64_t> int_map;
 };
 
-template <typename T>
-T translate_value(const value_map_set<T>& maps, T target){
-    auto make_param = [](const value_map<T>& a, const value_map<T>& b, leap_parameter<T>& param){
-        param.in_range = b.in - a.in;
-        param.out_range = b.out - a.out;
-        param.in_bias = a.in;
-        param.out_bias = a.out;
-    };
-    int i = 0;
-    for (;i < maps.size(); i++){
-        auto& map = maps[i];
-        if (map.in >= target){
-            break;
-        }
-    }
-    leap_parameter<T> param;
-    if (i == 0){
-        make_param(maps[0], maps[1], param);
-    }else if (i == maps.size()){
-        make_param(maps[i - 2], maps[i - 1], param);
-    }else{
-        make_param(maps[i - 1], maps[i], param);
-    }
-    return (target - param.in_bias) * param.out_range / param.in_range + param.out_bias;
-}
-
 static std::shared_ptr<NativeAction::Function> lerp(sol::object& o_action, sol::object& o_list){
-    auto action = generate_action(o_action);
-    if (!action.get()){
+    auto child = generate_node(o_action);
+    if (!child){
         throw std::runtime_error("1st argument must be native action or Lua function");
     }
     auto type = verify_map_rule(o_list);
     if (type == val_map_type::invalid){
         throw std::runtime_error("the interpolation rule specified at 2nd argument is invalid format");
     }
-    std::optional<double_map_set> double_maps;
-    std::optional<int_map_set> int_maps;
+    auto rule = std::make_shared<lerp_rule>();
     if (type == val_map_type::double_map){
-        double_maps = std::move(generate_value_map<double>(o_list));
+        rule->double_map = generate_value_map<double>(o_list);
     }
     if (type == val_map_type::int_map){
-        int_maps = std::move(generate_value_map<int64_t>(o_list));
+        rule->int_map = generate_value_map<int64_t>(o_list);
     }
     std::ostringstream os;
-    os << "filter.lerp(" << action->getName() << ")";
+    os << "filter.lerp(" << child->name << ")";
 
-    NativeAction::Function::ACTION_FUNCTION func = 
-    [action, double_maps = std::move(double_maps), int_maps = std::move(int_maps)](Event& event, sol::state& lua){
-        auto event_type = event.getType();
-        if (event_type == Event::Type::double_value || event_type == Event::Type::int_value){
-            if (double_maps){
-                Event new_event(event.getId(), translate_value(*double_maps, event.getAs<double>()));
-                action->invoke(new_event, lua);
-            }else{
-                Event new_event(event.getId(), translate_value(*int_maps, event.getAs<int64_t>()));
-                action->invoke(new_event, lua);
-            }
-        }else{
-            action->invoke(event, lua);
+    auto node = std::make_shared<FilterNode>(
+        type == val_map_type::double_map ? FilterNode::Type::lerp_double : FilterNode::Type::lerp_int, os.str());
+    node->lerp = std::move(rule);
+    node->children.push_back(std::move(child));
+    return make_filter_function(std::move(node));
+}
+
+//============================================================================================
+// Signal conditioning filters
+//    These filters handle events with numerical value, other events are passed through.
+//    An event is dropped if the output value would be same as the last value sent to the
+//    downstream action. Results for integer input are rounded to integer.
+//============================================================================================
+static bool event_numeric_value(const Event& event, double& value){
+    auto type = event.getType();
+    if (type == Event::Type::int_value || type == Event::Type::double_value){
+        value = event.getAs<double>();
+        return true;
+    }
+    return false;
+}
+
+static Event make_numeric_event(const Event& source, double value){
+    if (source.getType() == Event::Type::int_value){
+        return Event(source.getId(), static_cast<int64_t>(std::llround(value)));
+    }else{
+        return Event(source.getId(), value);
+    }
+}
+
+static double rounded_value(const Event& source, double value){
+    return source.getType() == Event::Type::int_value ? std::round(value) : value;
+}
+
+template <typename T>
+static T rule_parameter(sol::table& def, const char* name, std::optional<T> default_value = std::nullopt){
+    auto value = lua_safevalue<T>(def[name]);
+    if (value){
+        return *value;
+    }else if (default_value){
+        return *default_value;
+    }
+    std::ostringstream os;
+    os << "\"" << name << "\" parameter is not specified or it's value is invalid";
+    throw std::runtime_error(os.str());
+}
+
+static sol::table rule_definition(const sol::object& o_def){
+    if (o_def.get_type() != sol::type::table){
+        throw std::runtime_error("2nd argument must be a table to specify filter parameters");
+    }
+    return o_def.as<sol::table>();
+}
+
+//--------------------------------------------------------------------------------------------
+// smoothing filters: exponential moving average and 1 euro filter
+//--------------------------------------------------------------------------------------------
+struct smooth_rule{
+    SignalSmoother smoother;
+    SignalOutput output;
+};
+
+static std::shared_ptr<NativeAction::Function> smooth(sol::object& o_action, sol::object& o_def){
+    auto child = generate_node(o_action);
+    if (!child){
+        throw std::runtime_error("1st argument must be native action or Lua function");
+    }
+    auto def = rule_definition(o_def);
+    auto method = lua_safestring(def["method"]);
+    auto rule = std::make_shared<smooth_rule>();
+    FilterNode::Type type;
+    if (method.length() == 0 || method == "ema"){
+        type = FilterNode::Type::smooth_ema;
+        rule->smoother.alpha = rule_parameter<double>(def, "alpha");
+        if (!(rule->smoother.alpha > 0. && rule->smoother.alpha <= 1.)){
+            throw std::runtime_error("\"alpha\" parameter must be greater than 0 and less than or equal to 1");
+        }
+    }else if (method == "one_euro"){
+        type = FilterNode::Type::smooth_one_euro;
+        auto& smoother = rule->smoother;
+        smoother.min_cutoff = rule_parameter<double>(def, "min_cutoff", 1.);
+        smoother.beta = rule_parameter<double>(def, "beta", 0.);
+        smoother.d_cutoff = rule_parameter<double>(def, "d_cutoff", 1.);
+        if (!(smoother.min_cutoff > 0. && smoother.d_cutoff > 0. && smoother.beta >= 0.)){
+            throw std::runtime_error("\"min_cutoff\" and \"d_cutoff\" parameters must be positive, "
+                                     "and \"beta\" parameter must not be negative");
+        }
+    }else{
+        throw std::runtime_error("the value of \"method\" parameter must be either \"ema\" or \"one_euro\"");
+    }
+    std::ostringstream os;
+    os << "filter.smooth(" << child->name << ")";
+
+    auto node = std::make_shared<FilterNode>(type, os.str());
+    node->smooth = std::move(rule);
+    node->children.push_back(std::move(child));
+    return make_filter_function(std::move(node));
+}
+
+//--------------------------------------------------------------------------------------------
+// deadband with hysteresis
+//--------------------------------------------------------------------------------------------
+struct deadband_rule{
+    SignalDeadband deadband;
+    SignalOutput output;
+};
+
+static std::shared_ptr<NativeAction::Function> deadband(sol::object& o_action, sol::object& o_def){
+    auto child = generate_node(o_action);
+    if (!child){
+        throw std::runtime_error("1st argument must be native action or Lua function");
+    }
+    auto def = rule_definition(o_def);
+    auto rule = std::make_shared<deadband_rule>();
+    auto& band = rule->deadband;
+    band.width = rule_parameter<double>(def, "width");
+    band.center = rule_parameter<double>(def, "center", 0.);
+    band.hysteresis = rule_parameter<double>(def, "hysteresis", 0.);
+    if (band.width < 0. || band.hysteresis < 0. || band.hysteresis > band.width){
+        throw std::runtime_error("\"width\" and \"hysteresis\" parameters must not be negative, "
+                                 "and \"hysteresis\" must not be greater than \"width\"");
+    }
+    std::ostringstream os;
+    os << "filter.deadband(" << child->name << ")";
+
+    auto node = std::make_shared<FilterNode>(FilterNode::Type::deadband, os.str());
+    node->deadband = std::move(rule);
+    node->children.push_back(std::move(child));
+    return make_filter_function(std::move(node));
+}
+
+//--------------------------------------------------------------------------------------------
+// rate limiter
+//    The deferred event is sent by a deferred action when the interval elapses.
+//--------------------------------------------------------------------------------------------
+struct rate_limit_rule{
+    MapperEngine* engine = nullptr;
+    std::shared_ptr<Action> trailing_action;
+    SignalRateLimiter limiter;
+    std::optional<Event> pending;
+};
+
+static std::shared_ptr<NativeAction::Function> rate_limit(MapperEngine& engine, sol::object& o_action, sol::object& o_def){
+    auto child = generate_node(o_action);
+    if (!child){
+        throw std::runtime_error("1st argument must be native action or Lua function");
+    }
+    auto def = rule_definition(o_def);
+    auto interval = rule_parameter<int>(def, "interval");
+    if (interval <= 0){
+        throw std::runtime_error("\"interval\" parameter must be positive");
+    }
+    auto rule = std::make_shared<rate_limit_rule>();
+    rule->engine = &engine;
+    rule->limiter = SignalRateLimiter(MapperEngine::MILLISEC(interval));
+    std::ostringstream os;
+    os << "filter.rate_limit(" << child->name << ")";
+
+    // the trailing event is sent through an independent pipeline for the downstream action
+    // since it's invoked as a deferred action, the rule must not be owned by that action
+    auto downstream = std::make_shared<const FilterPipeline>(child);
+    NativeAction::Function::ACTION_FUNCTION trailing = [weak_rule = std::weak_ptr<rate_limit_rule>(rule), downstream](Event&, sol::state& lua){
+        auto rule = weak_rule.lock();
+        if (!rule){
+            return;
+        }
+        double value;
+        auto is_numeric = rule->pending && event_numeric_value(*rule->pending, value);
+        if (rule->limiter.expire(is_numeric ? std::optional<double>(value) : std::nullopt, MapperEngine::CLOCK::now())){
+            auto event = std::move(*rule->pending);
+            rule->pending.reset();
+            downstream->invoke(event, lua);
         }
     };
-    return std::make_shared<NativeAction::Function>(os.str().c_str(), func);
+    auto trailing_name = os.str() + ":trailing";
+    rule->trailing_action = std::make_shared<NativeAction>(
+        std::make_shared<NativeAction::Function>(trailing_name.c_str(), trailing));
+
+    auto node = std::make_shared<FilterNode>(FilterNode::Type::rate_limit, os.str());
+    node->rate_limit = std::move(rule);
+    node->children.push_back(std::move(child));
+    return make_filter_function(std::move(node));
 }
 
 //============================================================================================
@@ -230,7 +461,7 @@ struct branch_condition {
     enum class optype {exceeded, falled};
     optype type;
     int64_t value;
-    std::shared_ptr<Action> action;
+    std::shared_ptr<FilterNode> action;
 
     branch_condition() = delete;
     branch_condition(const sol::object& object){
@@ -250,8 +481,8 @@ struct branch_condition {
                 throw std::runtime_error("\"value\" parameter is not specified or it's value is invalid");
             }
             value = *o_value;
-            action = generate_action(defs["action"]);
-            if (!action.get()){
+            action = generate_node(defs["action"]);
+            if (!action){
                 throw std::runtime_error("the value of \"action\" parameter must be either native action or Lua function");
             }
         }else{
@@ -262,6 +493,16 @@ struct branch_condition {
     branch_condition& operator = (const branch_condition&) = default;
 };
 
+struct branch_rule{
+    // thresholds are sorted in order of evaluation,
+    // edges of the stage are actions for exceeded conditions followed by actions for falled conditions
+    std::vector<int64_t> exceeded_values;
+    std::vector<int64_t> falled_values;
+    int64_t last = 0;
+    size_t ix_exceeded = 0;
+    size_t ix_falled = 0;
+};
+
 static std::shared_ptr<NativeAction::Function> branch(sol::variadic_args& va){
     std::ostringstream os;
     os << "filter.branch(";
@@ -275,7 +516,7 @@ static std::shared_ptr<NativeAction::Function> branch(sol::variadic_args& va){
         }else{
             conds_falled.push_back(cond);
         }
-        os << prefix << cond.action->getName();
+        os << prefix << cond.action->name;
         prefix = ", ";
     }
     os << ")";
@@ -285,41 +526,143 @@ static std::shared_ptr<NativeAction::Function> branch(sol::variadic_args& va){
     std::sort(std::begin(conds_falled), std::end(conds_falled), [](const branch_condition& a, const branch_condition& b){
         return a.value > b.value;
     });
-    int64_t last = 0;
-    int ix_exeeded = 0;
-    for (; ix_exeeded < conds_exeeded.size() && conds_exeeded[ix_exeeded].value < last; ix_exeeded++);
-    int ix_falled = 0;
-    for (; ix_falled < conds_falled.size() && conds_falled[ix_falled].value > last; ix_falled++);
-
-    NativeAction::Function::ACTION_FUNCTION func = [
-        conds_exeeded = std::move(conds_exeeded), conds_falled = std::move(conds_falled),
-        last, ix_exeeded, ix_falled
-    ](Event& event, sol::state& lua) mutable {
+
+    auto rule = std::make_shared<branch_rule>();
+    auto node = std::make_shared<FilterNode>(FilterNode::Type::branch, os.str());
+    for (auto& cond : conds_exeeded){
+        rule->exceeded_values.push_back(cond.value);
+        node->children.push_back(cond.action);
+    }
+    for (auto& cond : conds_falled){
+        rule->falled_values.push_back(cond.value);
+        node->children.push_back(cond.action);
+    }
+    for (; rule->ix_exceeded < rule->exceeded_values.size() && rule->exceeded_values[rule->ix_exceeded] < rule->last; rule->ix_exceeded++);
+    for (; rule->ix_falled < rule->falled_values.size() && rule->falled_values[rule->ix_falled] > rule->last; rule->ix_falled++);
+    node->branch = std::move(rule);
+    return make_filter_function(std::move(node));
+};
+
+//============================================================================================
+// Pipeline execution
+//============================================================================================
+void FilterPipeline::run(uint32_t index, Event& event, sol::state& lua) const{
+    const auto& stage = stages[index];
+    const auto* edge = edges.data() + stage.first_edge;
+    switch (stage.type){
+    case FilterNode::Type::terminal:
+        stage.node->action->invoke(event, lua);
+        break;
+
+    case FilterNode::Type::duplicator:
+        for (uint32_t i = 0; i < stage.num_edges; i++){
+            run(edge[i], event, lua);
+        }
+        break;
+
+    case FilterNode::Type::delay:
+        stage.node->engine->invokeActionIn(stage.node->action, event, stage.node->millisec);
+        break;
+
+    case FilterNode::Type::lerp_double:
+    case FilterNode::Type::lerp_int:{
+        auto event_type = event.getType();
+        if (event_type == Event::Type::double_value || event_type == Event::Type::int_value){
+            if (stage.type == FilterNode::Type::lerp_double){
+                Event new_event(event.getId(), stage.node->lerp->double_map(event.getAs<double>()));
+                run(edge[0], new_event, lua);
+            }else{
+                Event new_event(event.getId(), stage.node->lerp->int_map(event.getAs<int64_t>()));
+                run(edge[0], new_event, lua);
+            }
+        }else{
+            run(edge[0], event, lua);
+        }
+        break;
+    }
+
+    case FilterNode::Type::branch:{
         auto evtype = event.getType();
         if (evtype == Event::Type::int_value || evtype == Event::Type::double_value || evtype == Event::Type::bool_value){
+            auto& rule = *stage.node->branch;
+            auto& exceeded = rule.exceeded_values;
+            auto& falled = rule.falled_values;
             auto value = event.getAs<int64_t>();
-            if (value > last){
-                if (ix_exeeded < conds_exeeded.size() && conds_exeeded[ix_exeeded].value < value){
-                    conds_exeeded[ix_exeeded].action->invoke(event, lua);
-                    ix_exeeded++;
+            if (value > rule.last){
+                if (rule.ix_exceeded < exceeded.size() && exceeded[rule.ix_exceeded] < value){
+                    run(edge[rule.ix_exceeded], event, lua);
+                    rule.ix_exceeded++;
                 }
-                if (ix_falled > 0 && conds_falled[ix_falled - 1].value < value){
-                    ix_falled--;
+                if (rule.ix_falled > 0 && falled[rule.ix_falled - 1] < value){
+                    rule.ix_falled--;
                 }
-            }else if (value < last){
-                if (ix_falled < conds_falled.size() && conds_falled[ix_falled].value > value){
-                    conds_falled[ix_falled].action->invoke(event, lua);
-                    ix_falled++;
+            }else if (value < rule.last){
+                if (rule.ix_falled < falled.size() && falled[rule.ix_falled] > value){
+                    run(edge[exceeded.size() + rule.ix_falled], event, lua);
+                    rule.ix_falled++;
                 }
-                if (ix_exeeded > 0 && conds_exeeded[ix_exeeded - 1].value > value){
-                    ix_exeeded--;
+                if (rule.ix_exceeded > 0 && exceeded[rule.ix_exceeded - 1] > value){
+                    rule.ix_exceeded--;
                 }
             }
-            last = value;
+            rule.last = value;
         }
-    };
-    return std::make_shared<NativeAction::Function>(os.str().c_str(), func);
-};
+        break;
+    }
+
+    case FilterNode::Type::smooth_ema:
+    case FilterNode::Type::smooth_one_euro:{
+        double input;
+        if (event_numeric_value(event, input)){
+            auto& rule = *stage.node->smooth;
+            auto value = stage.type == FilterNode::Type::smooth_ema ?
+                         rule.smoother.ema(input) : rule.smoother.one_euro(input, MapperEngine::CLOCK::now());
+            if (rule.output.update(rounded_value(event, value))){
+                auto new_event = make_numeric_event(event, value);
+                run(edge[0], new_event, lua);
+            }
+        }else{
+            run(edge[0], event, lua);
+        }
+        break;
+    }
+
+    case FilterNode::Type::deadband:{
+        double input;
+        if (event_numeric_value(event, input)){
+            auto& rule = *stage.node->deadband;
+            auto value = rule.deadband.apply(input);
+            if (rule.output.update(rounded_value(event, value))){
+                auto new_event = make_numeric_event(event, value);
+                run(edge[0], new_event, lua);
+            }
+        }else{
+            run(edge[0], event, lua);
+        }
+        break;
+    }
+
+    case FilterNode::Type::rate_limit:{
+        auto& rule = *stage.node->rate_limit;
+        double input;
+        auto is_numeric = event_numeric_value(event, input);
+        auto now = MapperEngine::CLOCK::now();
+        auto decision = rule.limiter.offer(is_numeric ? std::optional<double>(input) : std::nullopt, now);
+        if (decision == SignalRateLimiter::Decision::send){
+            rule.pending.reset();
+            run(edge[0], event, lua);
+        }else if (decision == SignalRateLimiter::Decision::defer){
+            rule.pending.emplace(event);
+            if (auto delay = rule.limiter.schedule(now)){
+                rule.engine->invokeActionIn(rule.trailing_action, event, std::chrono::ceil<MapperEngine::MILLISEC>(*delay));
+            }
+        }else{
+            rule.pending.reset();
+        }
+        break;
+    }
+    }
+}
 
 //============================================================================================
 // Create lua scripting environment
@@ -350,4 +693,22 @@ void filter_create_lua_env(MapperEngine& engine, sol::state& lua){
             return branch(va);
         });
     };
+
+    table["smooth"] = [&engine](sol::object action, sol::object def){
+        return lua_c_interface(engine, "filter.smooth", [&action, &def]{
+            return smooth(action, def);
+        });
+    };
+
+    table["deadband"] = [&engine](sol::object action, sol::object def){
+        return lua_c_interface(engine, "filter.deadband", [&action, &def]{
+            return deadband(action, def);
+        });
+    };
+
+    table["rate_limit"] = [&engine](sol::object action, sol::object def){
+        return lua_c_interface(engine, "filter.rate_limit", [&engine, &action, &def]{
+            return rate_limit(engine, action, def);
+        });
+    };
 }
\ No newline at end of file
@@ -0,0 +1,182 @@
+//
+// interpolation.h
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <type_traits>
+#include <stdexcept>
+
+//============================================================================================
+// Piecewise linear function
+//    Parameters of each segment are computed when the function is built, so translating a
+//    value consists of a segment lookup and a multiply-add.
+//    Segments are looked up by a branchless binary search over the breakpoints, or by
+//    direct indexing if breakpoints are equally spaced.
+//    Values out of the range of breakpoints are extrapolated by the first or last segment.
+//    For integer type, the result is calculated by integer arithmetic in same manner as
+//    (x - x0) * (y1 - y0) / (x1 - x0) + y0.
+//============================================================================================
+template <typename T>
+class PiecewiseLinear{
+public:
+    struct Breakpoint{
+        T in;
+        T out;
+    };
+
+protected:
+    struct IntegralSegment{
+        T in_bias;
+        T out_bias;
+        T out_range;
+        T in_range;
+    };
+    struct FloatingSegment{
+        T in_bias;
+        T out_bias;
+        double slope;
+    };
+    using Segment = std::conditional_t<std::is_integral_v<T>, IntegralSegment, FloatingSegment>;
+
+    std::vector<T> inputs;
+    std::vector<Segment> segments;
+    bool is_uniform = false;
+    T grid_origin{};
+    T grid_step{};
+    double grid_scale = 0.;
+
+public:
+    PiecewiseLinear() = default;
+    PiecewiseLinear(const PiecewiseLinear&) = default;
+    PiecewiseLinear(PiecewiseLinear&&) = default;
+    PiecewiseLinear(const std::vector<Breakpoint>& points){
+        if (points.size() < 2){
+            throw std::runtime_error("at least two reference points must be specified in the interpolation rule");
+        }
+        for (size_t i = 1; i < points.size(); i++){
+            if (!(points[i - 1].in < points[i].in)){
+                throw std::runtime_error("reference value for input value in the interpolation rule must be monotonic increased");
+            }
+        }
+        inputs.reserve(points.size());
+        segments.reserve(points.size() - 1);
+        for (size_t i = 0; i < points.size(); i++){
+            inputs.push_back(points[i].in);
+            if (i > 0){
+                auto& a = points[i - 1];
+                auto& b = points[i];
+                if constexpr (std::is_integral_v<T>){
+                    segments.push_back({a.in, a.out, b.out - a.out, b.in - a.in});
+                }else{
+                    segments.push_back({a.in, a.out, static_cast<double>(b.out - a.out) / (b.in - a.in)});
+                }
+            }
+        }
+        check_uniformity();
+    }
+    ~PiecewiseLinear() = default;
+    PiecewiseLinear& operator = (const PiecewiseLinear&) = default;
+    PiecewiseLinear& operator = (PiecewiseLinear&&) = default;
+
+    size_t size() const{return inputs.size();}
+    bool uniform() const{return is_uniform;}
+
+    T operator () (T value) const{
+        return apply(segments[find_segment(value)], value);
+    }
+
+    // translate an array of samples
+    // loops are kept simple so that compiler can vectorize them
+    void operator () (const T* values, T* results, size_t count) const{
+        if (is_uniform){
+            for (size_t i = 0; i < count; i++){
+                results[i] = apply(segments[grid_index(values[i])], values[i]);
+            }
+        }else{
+            for (size_t i = 0; i < count; i++){
+                results[i] = apply(segments[search_index(values[i])], values[i]);
+            }
+        }
+    }
+
+protected:
+    void check_uniformity(){
+        auto n = inputs.size();
+        auto origin = inputs.front();
+        auto range = inputs.back() - origin;
+        if constexpr (std::is_integral_v<T>){
+            if (range % static_cast<T>(n - 1) != 0){
+                return;
+            }
+            auto step = range / static_cast<T>(n - 1);
+            for (size_t i = 0; i < n; i++){
+                if (inputs[i] != origin + step * static_cast<T>(i)){
+                    return;
+                }
+            }
+            grid_step = step;
+        }else{
+            auto step = range / static_cast<T>(n - 1);
+            auto tolerance = range * 1e-9;
+            for (size_t i = 0; i < n; i++){
+                if (std::abs(inputs[i] - (origin + step * static_cast<T>(i))) > tolerance){
+                    return;
+                }
+            }
+            grid_step = step;
+        }
+        grid_origin = origin;
+        grid_scale = 1. / static_cast<double>(grid_step);
+        is_uniform = true;
+    }
+
+    size_t find_segment(T value) const{
+        return is_uniform ? grid_index(value) : search_index(value);
+    }
+
+    size_t grid_index(T value) const{
+        auto last = segments.size() - 1;
+        if constexpr (std::is_integral_v<T>){
+            if (value <= grid_origin){
+                return 0;
+            }
+            auto index = static_cast<uint64_t>(value - grid_origin) / static_cast<uint64_t>(grid_step);
+            return index < last ? static_cast<size_t>(index) : last;
+        }else{
+            auto position = (value - grid_origin) * grid_scale;
+            if (!(position > 0.)){
+                return 0;
+            }
+            return position < static_cast<double>(last) ? static_cast<size_t>(position) : last;
+        }
+    }
+
+    size_t search_index(T value) const{
+        // lower bound of the breakpoints without data dependent branches
+        const T* base = inputs.data();
+        auto length = inputs.size();
+        while (length > 1){
+            auto half = length / 2;
+            base += (base[half] < value) ? half : 0;
+            length -= half;
+        }
+        size_t index = (base - inputs.data()) + (*base < value);
+        auto last = segments.size() - 1;
+        index = index > 0 ? index - 1 : 0;
+        return index < last ? index : last;
+    }
+
+    static T apply(const Segment& segment, T value){
+        if constexpr (std::is_integral_v<T>){
+            return (value - segment.in_bias) * segment.out_range / segment.in_range + segment.out_bias;
+        }else{
+            return static_cast<T>((value - segment.in_bias) * segment.slope + segment.out_bias);
+        }
+    }
+};
@@ -122,6 +122,40 @@ DLLEXPORT MAPPINGS_STAT mapper_getMappingsStat(MapperHandle handle){
     return handle->engine->get_mapping_stat();
 }
 
+DLLEXPORT bool mapper_enumActionStats(MapperHandle handle, MAPPER_ENUM_ACTION_STAT_FUNC func, void* context){
+    auto&& list = handle->engine->get_action_stats();
+    for (auto& item : list){
+        ACTION_STAT stat{
+            item.event_name.c_str(), item.action_name.c_str(), item.is_lua_function,
+            item.stats.count, item.stats.total_time, item.stats.max_time,
+        };
+        if (!func(handle, context, &stat)){
+            return false;
+        }
+    }
+    return true;
+}
+
+DLLEXPORT bool mapper_replayEventTrace(MapperHandle handle, const char* path, bool realtime){
+    return handle->engine->replay_event_trace(path, realtime);
+}
+
+DLLEXPORT bool mapper_enumActionLatencies(MapperHandle handle, MAPPER_ENUM_ACTION_LATENCY_FUNC func, void* context){
+    auto&& list = handle->engine->get_action_latencies();
+    for (auto& item : list){
+        auto& buckets = item.histogram.get_buckets();
+        ACTION_LATENCY latency{
+            item.event_name.c_str(), item.action_name.c_str(),
+            item.histogram.get_count(), item.histogram.get_total(), item.histogram.get_max(),
+            buckets.size(), buckets.data(),
+        };
+        if (!func(handle, context, &latency)){
+            return false;
+        }
+    }
+    return true;
+}
+
 DLLEXPORT bool mapper_enumDevices(MapperHandle handle, MAPPER_ENUM_DEVICE_FUNC func, void *context){
     auto&& list = handle->engine->get_device_list();
     for (auto info : list){
@@ -76,8 +76,31 @@ typedef struct{
     int num_secondary;
     int num_for_viewports;
     int num_for_views;
+    uint64_t num_dispatch_table_rebuilds;
+    uint64_t num_event_batches;
+    uint64_t num_batched_events;
+    uint64_t max_event_batch_size;
 }MAPPINGS_STAT;
 
+typedef struct{
+    const char* event_name;
+    const char* action_name;
+    bool is_lua_function;
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+}ACTION_STAT;
+
+typedef struct{
+    const char* event_name;
+    const char* action_name;
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    size_t num_buckets;
+    const uint64_t* buckets;    // buckets[i] counts invocations which took [2^i, 2^(i+1)) ns
+}ACTION_LATENCY;
+
 typedef struct{
     const char* viewport_name;
     int32_t viewid;
@@ -94,6 +117,9 @@ typedef enum{
     MOPT_STDLIB,                // integer
     MOPT_DCS_EXPORTER,          // integer (as boolean: 0 is false, other than 0 is true)
     MOPT_LOGMODE,              //  integer (as boolean: 0 is false, other than 0 is true)
+    MOPT_EVENT_BATCH_SIZE,      // integer (maximum number of events to dispatch in a loop iteration)
+    MOPT_EVENT_TRACE_FILE,      // string (path of a file to record events, empty string disables recording)
+    MOPT_MODIFIER_WORKER_NUM,   // integer (number of threads to process device modifiers, 0 means automatic)
 }MAPPER_OPTION;
 
 typedef enum{
@@ -123,6 +149,8 @@ typedef bool (*MAPPER_ENUM_DEVICE_FUNC)(MapperHandle mapper, void* context, cons
 typedef bool (*MAPPER_ENUM_CAPUTURED_WINDOW)(MapperHandle mapper, void* context, CAPTURED_WINDOW_DEF* cwdef);
 typedef bool (*MAPPER_ENUM_CAPTURED_WINDOW_TITLE)(MapperHandle mapper, void* context, const char* title);
 typedef bool (*MAPPER_ENUM_VIEWPORT_FUNC)(MapperHandle mapper, void* context, VIEWPORT_DEF* vpdef);
+typedef bool (*MAPPER_ENUM_ACTION_STAT_FUNC)(MapperHandle mapper, void* context, const ACTION_STAT* stat);
+typedef bool (*MAPPER_ENUM_ACTION_LATENCY_FUNC)(MapperHandle mapper, void* context, const ACTION_LATENCY* latency);
 
 DLLEXPORT MapperHandle mapper_init(MAPPER_CALLBACK_FUNC callback, MAPPER_CONSOLE_HANDLER logger, void *hostContext);
 DLLEXPORT bool mapper_terminate(MapperHandle handle);
@@ -140,6 +168,9 @@ DLLEXPORT void* mapper_getHostContext(MapperHandle handle);
 DLLEXPORT MAPPER_SIM_CONNECTION mapper_getSimConnection(MapperHandle handle);
 DLLEXPORT const char* mapper_getAircraftName(MapperHandle handle);
 DLLEXPORT MAPPINGS_STAT mapper_getMappingsStat(MapperHandle handle);
+DLLEXPORT bool mapper_enumActionStats(MapperHandle handle, MAPPER_ENUM_ACTION_STAT_FUNC func, void* context);
+DLLEXPORT bool mapper_replayEventTrace(MapperHandle handle, const char* path, bool realtime);
+DLLEXPORT bool mapper_enumActionLatencies(MapperHandle handle, MAPPER_ENUM_ACTION_LATENCY_FUNC func, void* context);
 
 DLLEXPORT bool mapper_enumDevices(MapperHandle handle, MAPPER_ENUM_DEVICE_FUNC func, void* context);
 DLLEXPORT bool mapper_enumCapturedWindows(MapperHandle handle, MAPPER_ENUM_CAPUTURED_WINDOW func, void* context);
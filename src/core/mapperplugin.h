@@ -40,6 +40,25 @@ __declspec(dllexport) void fsmapper_setContextForDevice(FSMAPPER_HANDLE mapper,
 __declspec(dllexport) void* fsmapper_getContextForDevice(FSMAPPER_HANDLE mapper, FSMDEVICE device);
 __declspec(dllexport) void fsmapper_raiseEvent(FSMAPPER_HANDLE mapper, FSMDEVICE device, int index, int value);
 
+typedef enum {
+    FSMDU_VALUE_INT,
+    FSMDU_VALUE_DOUBLE,
+    FSMDU_VALUE_INT64,
+    FSMDU_VALUE_BOOL,
+}FSMDEVUNITVALUE_TYPE;
+
+typedef struct {
+    int index;
+    FSMDEVUNITVALUE_TYPE type;
+    union {
+        int intValue;
+        double doubleValue;
+        int64_t int64Value;
+        bool boolValue;
+    }value;
+}FSMDEVUNITVALUE;
+__declspec(dllexport) void fsmapper_raiseEvents(FSMAPPER_HANDLE mapper, FSMDEVICE device, const FSMDEVUNITVALUE* values, size_t num);
+
 //============================================================================================
 // LUA value accessor
 //============================================================================================
@@ -112,6 +131,33 @@ typedef struct {
 // if a module exports this function.
 __declspec(dllexport) const MAPPER_PLUGIN_DEVICE_OPS* getMapperPluginDeviceOps();
 
+//============================================================================================
+// Device plugin interface version 2
+// Output unit values are passed as tagged values instead of int.
+// Members may be appended in future versions, fsmapper checks the version member to know
+// which members are available.
+//============================================================================================
+#define MAPPER_PLUGIN_DEVICE_OPS_VERSION_2 2
+
+typedef bool (*FSMDEV_SEND_UNIT_VALUE_V2)(FSMAPPER_HANDLE mapper, FSMDEVICE device, const FSMDEVUNITVALUE* value);
+
+typedef struct {
+    int version;
+    const char* name;
+    const char* description;
+    FSMDEV_INIT init;
+    FSMDEV_TERM term;
+    FSMDEV_OPEN open;
+    FSMDEV_START start;
+    FSMDEV_CLOSE close;
+    FSMDEV_GET_UNIT_NUM getUnitNum;
+    FSMDEV_GET_UNIT_DEF getUnitDef;
+    FSMDEV_SEND_UNIT_VALUE_V2 sendUnitValue;
+} MAPPER_PLUGIN_DEVICE_OPS_V2;
+
+// fsmapper prefers this function to getMapperPluginDeviceOps() if a module exports both.
+__declspec(dllexport) const MAPPER_PLUGIN_DEVICE_OPS_V2* getMapperPluginDeviceOpsV2();
+
 #ifdef __cplusplus
 }
 #endif
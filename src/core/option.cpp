@@ -12,11 +12,14 @@ static std::unordered_map<MAPPER_OPTION, std::string MapperOption::*> string_opt
     {MOPT_PLUGIN_FOLDER, &MapperOption::plugin_folder},
     {MOPT_APP_PLUGIN_FOLDER, &MapperOption::app_plugin_folder},
     {MOPT_USER_PLUGIN_FOLDER, &MapperOption::user_plugin_folder},
+    {MOPT_EVENT_TRACE_FILE, &MapperOption::event_trace_file},
 };
 
 static std::unordered_map<MAPPER_OPTION, int64_t MapperOption::*> integer_options{
     {MOPT_RENDERING_METHOD, &MapperOption::rendering_method},
     {MOPT_STDLIB, &MapperOption::stdlib},
+    {MOPT_EVENT_BATCH_SIZE, &MapperOption::event_batch_size},
+    {MOPT_MODIFIER_WORKER_NUM, &MapperOption::modifier_worker_num},
 };
 
 static std::unordered_map<MAPPER_OPTION, bool MapperOption::*> boolean_options{
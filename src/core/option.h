@@ -18,6 +18,9 @@ struct MapperOption{
     int64_t stdlib{0};
     bool is_dcs_exporter_enabled{false};
     bool log_mode{false};
+    int64_t event_batch_size{64};
+    std::string event_trace_file;
+    int64_t modifier_worker_num{0};
 
     bool set_value(MAPPER_OPTION type, const char* value);
     bool set_value(MAPPER_OPTION type, int64_t value);
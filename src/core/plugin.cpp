@@ -9,6 +9,7 @@
 #include <filesystem>
 #include <algorithm>
 #include <sstream>
+#include <optional>
 
 PluginManager::PluginManager(){
     auto engine = mapper_EngineInstance();
@@ -33,13 +34,29 @@ PluginManager::PluginManager(){
                         engine->putLog(MCONSOLE_WARNING, os.str().c_str());
                         break;
                     }
+                    std::optional<PluginDeviceOps> ops;
+                    auto proc_v2 = reinterpret_cast<MAPPER_PLUGIN_DEVICE_OPS_V2* (*)()>(
+                        ::GetProcAddress(module, "getMapperPluginDeviceOpsV2")
+                    );
                     auto proc = reinterpret_cast<MAPPER_PLUGIN_DEVICE_OPS* (*)()>(
                         ::GetProcAddress(module, "getMapperPluginDeviceOps")
                     );
-                    auto ops = proc ? proc() : nullptr;
-                    if (ops && ops->name && ops->init && ops->term && ops->open && ops->start &&
-                        ops->close && ops->getUnitNum && ops->getUnitDef &&ops->sendUnitValue){
-                        modules.emplace_back(file.path().filename().string(), module, ops);
+                    if (proc_v2){
+                        // later versions are compatible with version 2 since members are only appended
+                        auto ops_v2 = proc_v2();
+                        if (ops_v2 && ops_v2->version >= MAPPER_PLUGIN_DEVICE_OPS_VERSION_2){
+                            ops.emplace(*ops_v2);
+                        }
+                    }
+                    if (!ops && proc){
+                        // a module may export both entries, then version 1 is used if version 2 is unavailable
+                        auto ops_v1 = proc();
+                        if (ops_v1){
+                            ops.emplace(*ops_v1);
+                        }
+                    }
+                    if (ops && ops->isValid()){
+                        modules.emplace_back(file.path().filename().string(), module, *ops);
                     }else{
                         std::ostringstream os;
                         os << "plugin: " << file.path().filename();
@@ -67,7 +84,10 @@ PluginManager::PluginManager(){
         std::ostringstream os;
         os << "plugin: " << modules.size() << (modules.size() == 1 ? " plugin module is " : " plugin modules are ") << "found:";
         for (auto& module : modules){
-            os << std::endl << "    " << module.ops->name << " : " << module.ops->description;
+            os << std::endl << "    " << module.ops.name << " : " << module.ops.description;
+            if (module.ops.version >= MAPPER_PLUGIN_DEVICE_OPS_VERSION_2){
+                os << " (v" << module.ops.version << ")";
+            }
         }
         engine->putLog(MCONSOLE_DEBUG, os.str().c_str());
     }
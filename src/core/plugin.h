@@ -10,12 +10,46 @@
 #include <windows.h>
 #include "mapperplugin.h"
 
+//============================================================================================
+// Device plugin operations independent from the plugin interface version
+//    sendUnitValue is valid for version 1 plugins, and sendUnitValueV2 is valid for
+//    version 2 plugins.
+//============================================================================================
+struct PluginDeviceOps{
+    int version;
+    const char* name;
+    const char* description;
+    FSMDEV_INIT init;
+    FSMDEV_TERM term;
+    FSMDEV_OPEN open;
+    FSMDEV_START start;
+    FSMDEV_CLOSE close;
+    FSMDEV_GET_UNIT_NUM getUnitNum;
+    FSMDEV_GET_UNIT_DEF getUnitDef;
+    FSMDEV_SEND_UNIT_VALUE sendUnitValue = nullptr;
+    FSMDEV_SEND_UNIT_VALUE_V2 sendUnitValueV2 = nullptr;
+
+    PluginDeviceOps(const MAPPER_PLUGIN_DEVICE_OPS& ops) :
+        version(1), name(ops.name), description(ops.description), init(ops.init), term(ops.term),
+        open(ops.open), start(ops.start), close(ops.close), getUnitNum(ops.getUnitNum),
+        getUnitDef(ops.getUnitDef), sendUnitValue(ops.sendUnitValue){}
+    PluginDeviceOps(const MAPPER_PLUGIN_DEVICE_OPS_V2& ops) :
+        version(MAPPER_PLUGIN_DEVICE_OPS_VERSION_2), name(ops.name), description(ops.description),
+        init(ops.init), term(ops.term), open(ops.open), start(ops.start), close(ops.close),
+        getUnitNum(ops.getUnitNum), getUnitDef(ops.getUnitDef), sendUnitValueV2(ops.sendUnitValue){}
+
+    bool isValid() const{
+        return name && init && term && open && start && close && getUnitNum && getUnitDef &&
+               (version == 1 ? sendUnitValue != nullptr : sendUnitValueV2 != nullptr);
+    }
+};
+
 class PluginManager{
     struct PluginModule{
         std::string file_name;
         HMODULE module;
-        MAPPER_PLUGIN_DEVICE_OPS* ops;
-        PluginModule(const std::string& file_name, HMODULE module, MAPPER_PLUGIN_DEVICE_OPS* ops) :
+        PluginDeviceOps ops;
+        PluginModule(const std::string& file_name, HMODULE module, const PluginDeviceOps& ops) :
             file_name(file_name), module(module), ops(ops){}
     };
     std::vector<PluginModule> modules;
@@ -28,12 +62,12 @@ public:
         return modules.size();
     }
     const char* get_name_at(size_t index){
-        return modules.at(index).ops->name;
+        return modules.at(index).ops.name;
     }
     const std::string& get_file_name_at(size_t index){
         return modules.at(index).file_name;
     }
-    MAPPER_PLUGIN_DEVICE_OPS* get_ops_at(size_t index){
+    const PluginDeviceOps& get_ops_at(size_t index){
         return modules.at(index).ops;
     }
 };
\ No newline at end of file
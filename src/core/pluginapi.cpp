@@ -44,6 +44,10 @@ DLLEXPORT void fsmapper_raiseEvent(FSMAPPER_HANDLE mapper, FSMDEVICE device, int
     device->device.issueEvent(index, value);
 }
 
+DLLEXPORT void fsmapper_raiseEvents(FSMAPPER_HANDLE mapper, FSMDEVICE device, const FSMDEVUNITVALUE* values, size_t num){
+    device->device.issueEvents(values, num);
+}
+
 //============================================================================================
 // LUA value accessor
 //============================================================================================
@@ -0,0 +1,179 @@
+//
+// signalfilter.h
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <algorithm>
+#include <cmath>
+
+//============================================================================================
+// Signal conditioning
+//    State machines of filter.smooth, filter.deadband and filter.rate_limit.
+//    They handle numerical values and time only, so that they can be evaluated with
+//    recorded samples without events and Lua.
+//============================================================================================
+
+//--------------------------------------------------------------------------------------------
+// last value sent to downstream
+//--------------------------------------------------------------------------------------------
+struct SignalOutput{
+    double value = 0.;
+    bool is_valid = false;
+
+    // returns true if the value differs from the last output, then update the last output
+    bool update(double new_value){
+        if (is_valid && new_value == value){
+            return false;
+        }
+        value = new_value;
+        is_valid = true;
+        return true;
+    }
+};
+
+//--------------------------------------------------------------------------------------------
+// smoothing filters: exponential moving average and 1 euro filter
+//--------------------------------------------------------------------------------------------
+struct SignalSmoother{
+    using CLOCK = std::chrono::steady_clock;
+
+    // parameters
+    double alpha = 1.;          // ema
+    double min_cutoff = 1.;     // one euro
+    double beta = 0.;           // one euro
+    double d_cutoff = 1.;       // one euro
+
+    // state
+    double value = 0.;
+    double derivative = 0.;
+    double raw_value = 0.;
+    CLOCK::time_point last_time;
+    bool is_initialized = false;
+
+    static double smoothing_factor(double cutoff, double interval){
+        auto tau = 1. / (2. * 3.14159265358979323846 * cutoff);
+        return 1. / (1. + tau / interval);
+    }
+
+    double ema(double input){
+        value = is_initialized ? value + alpha * (input - value) : input;
+        is_initialized = true;
+        return value;
+    }
+
+    double one_euro(double input, CLOCK::time_point now){
+        if (!is_initialized){
+            value = input;
+            raw_value = input;
+            derivative = 0.;
+            last_time = now;
+            is_initialized = true;
+            return value;
+        }
+        auto interval = std::chrono::duration<double>(now - last_time).count();
+        interval = std::max(interval, 0.001);
+        last_time = now;
+        auto raw_derivative = (input - raw_value) / interval;
+        raw_value = input;
+        derivative += smoothing_factor(d_cutoff, interval) * (raw_derivative - derivative);
+        auto cutoff = min_cutoff + beta * std::abs(derivative);
+        value += smoothing_factor(cutoff, interval) * (input - value);
+        return value;
+    }
+};
+
+//--------------------------------------------------------------------------------------------
+// deadband with hysteresis
+//    Output is fixed to the center value while input stays in the band. Once input goes out
+//    of the band, it is not regarded as entered again until it reaches the inner edge of the
+//    band which is narrowed by the hysteresis width.
+//--------------------------------------------------------------------------------------------
+struct SignalDeadband{
+    double center = 0.;
+    double width = 0.;
+    double hysteresis = 0.;
+    bool in_band = true;
+
+    double apply(double input){
+        auto distance = std::abs(input - center);
+        in_band = in_band ? distance <= width : distance <= width - hysteresis;
+        return in_band ? center : input;
+    }
+};
+
+//--------------------------------------------------------------------------------------------
+// rate limiter
+//    Inputs are sent at most once within the interval. The latest input offered in the
+//    interval is deferred, and it must be sent when the interval elapses by calling expire(),
+//    so the final value always reaches the downstream. Non numerical inputs are given as
+//    std::nullopt.
+//--------------------------------------------------------------------------------------------
+class SignalRateLimiter{
+public:
+    using CLOCK = std::chrono::steady_clock;
+
+    enum class Decision{
+        send,       // send the input now
+        defer,      // keep the input as the deferred input, it replaces the previous one
+        drop,       // the latest value has already been sent, the deferred input is canceled
+    };
+
+protected:
+    CLOCK::duration interval{0};
+    CLOCK::time_point last_time;
+    bool has_sent = false;
+    bool has_deferred = false;
+    bool is_scheduled = false;
+    SignalOutput output;
+
+public:
+    SignalRateLimiter() = default;
+    explicit SignalRateLimiter(CLOCK::duration interval) : interval(interval){}
+
+    Decision offer(std::optional<double> value, CLOCK::time_point now){
+        if (value && output.is_valid && *value == output.value){
+            has_deferred = false;
+            return Decision::drop;
+        }
+        if (!has_sent || now - last_time >= interval){
+            has_sent = true;
+            has_deferred = false;
+            send(value, now);
+            return Decision::send;
+        }
+        has_deferred = true;
+        return Decision::defer;
+    }
+
+    // returns the delay to call expire() if it has not been scheduled yet
+    std::optional<CLOCK::duration> schedule(CLOCK::time_point now){
+        if (is_scheduled){
+            return std::nullopt;
+        }
+        is_scheduled = true;
+        return interval - (now - last_time);
+    }
+
+    // returns true if the deferred input must be sent now
+    bool expire(std::optional<double> value, CLOCK::time_point now){
+        is_scheduled = false;
+        if (!has_deferred){
+            return false;
+        }
+        has_deferred = false;
+        send(value, now);
+        return true;
+    }
+
+protected:
+    void send(std::optional<double> value, CLOCK::time_point now){
+        last_time = now;
+        if (value){
+            output.update(*value);
+        }
+    }
+};
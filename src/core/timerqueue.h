@@ -0,0 +1,126 @@
+//
+// timerqueue.h
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <optional>
+#include <algorithm>
+#include <functional>
+#include <cstdint>
+
+//============================================================================================
+// Timer queue with stable handles
+//    Timers are ordered by a binary heap keyed by deadline and handle. Handles are issued
+//    in ascending order, so timers which have a same deadline expire in order of addition
+//    and deadline of a timer is never shifted.
+//    Cancelling a timer just removes its payload, that is O(1). The orphaned heap entry is
+//    discarded when it reaches the top of the heap, or when orphaned entries occupy the
+//    most part of the heap.
+//    This class is not thread safe. Owner must serialize accesses.
+//============================================================================================
+template <typename TIME_POINT, typename PAYLOAD>
+class TimerQueue{
+public:
+    using Handle = uint64_t;
+    static constexpr Handle INVALID_HANDLE = 0;
+
+    struct Timer{
+        Handle handle;
+        TIME_POINT deadline;
+        PAYLOAD payload;
+    };
+
+protected:
+    struct Entry{
+        TIME_POINT deadline;
+        Handle handle;
+        bool operator > (const Entry& rhs) const{
+            return deadline > rhs.deadline || (deadline == rhs.deadline && handle > rhs.handle);
+        }
+    };
+    using Compare = std::greater<Entry>;
+    static constexpr size_t COMPACTION_THRESHOLD = 64;
+
+    std::vector<Entry> heap;
+    std::unordered_map<Handle, PAYLOAD> payloads;
+    Handle last_handle = INVALID_HANDLE;
+
+public:
+    TimerQueue() = default;
+    TimerQueue(const TimerQueue&) = delete;
+    TimerQueue(TimerQueue&&) = default;
+    ~TimerQueue() = default;
+    TimerQueue& operator = (const TimerQueue&) = delete;
+    TimerQueue& operator = (TimerQueue&&) = default;
+
+    size_t size() const{return payloads.size();}
+    bool empty() const{return payloads.empty();}
+
+    Handle add(TIME_POINT deadline, PAYLOAD&& payload){
+        auto handle = ++last_handle;
+        payloads.emplace(handle, std::move(payload));
+        heap.push_back({deadline, handle});
+        std::push_heap(heap.begin(), heap.end(), Compare());
+        return handle;
+    }
+
+    Handle add(TIME_POINT deadline, const PAYLOAD& payload){
+        return add(deadline, PAYLOAD(payload));
+    }
+
+    bool cancel(Handle handle){
+        if (payloads.erase(handle) == 0){
+            return false;
+        }
+        if (heap.size() > COMPACTION_THRESHOLD && heap.size() > payloads.size() * 2){
+            compact();
+        }
+        return true;
+    }
+
+    void clear(){
+        heap.clear();
+        payloads.clear();
+    }
+
+    std::optional<TIME_POINT> next_deadline(){
+        discard_orphans();
+        if (heap.size() > 0){
+            return heap.front().deadline;
+        }else{
+            return std::nullopt;
+        }
+    }
+
+    std::optional<Timer> pop_expired(TIME_POINT now){
+        discard_orphans();
+        if (heap.size() == 0 || heap.front().deadline > now){
+            return std::nullopt;
+        }
+        auto entry = heap.front();
+        std::pop_heap(heap.begin(), heap.end(), Compare());
+        heap.pop_back();
+        auto node = payloads.extract(entry.handle);
+        return Timer{entry.handle, entry.deadline, std::move(node.mapped())};
+    }
+
+protected:
+    void discard_orphans(){
+        while (heap.size() > 0 && payloads.count(heap.front().handle) == 0){
+            std::pop_heap(heap.begin(), heap.end(), Compare());
+            heap.pop_back();
+        }
+    }
+
+    void compact(){
+        auto end = std::remove_if(heap.begin(), heap.end(), [this](const Entry& entry){
+            return payloads.count(entry.handle) == 0;
+        });
+        heap.erase(end, heap.end());
+        std::make_heap(heap.begin(), heap.end(), Compare());
+    }
+};
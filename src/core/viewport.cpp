@@ -622,6 +622,14 @@ Action* View::findAction(uint64_t evid){
     }
 }
 
+void View::enumActions(const EventActionEnumerator& enumerator){
+    if (mappings){
+        for (auto& [evid, action] : *mappings){
+            enumerator(evid, action.get());
+        }
+    }
+}
+
 bool View::findCapturedWindow(FloatPoint point, CapturedWindowAttributes& attrs){
     for (auto& element : captured_window_elements){
         if (element->region.pointIsInRectangle(point.x, point.y)){
@@ -971,6 +979,7 @@ void ViewPort::enable(const std::vector<IntRect> displays){
     region_client.x = region.x - entire_region.x;
     region_client.y = region.y - entire_region.y;
     is_enable = true;
+    manager.get_engine().invalidateDispatchTable();
     cover_window->start(entire_region, region);
     if (ignore_transparent_touches){
         composition_target = std::move(composition::create_viewport_target(*cover_window, entire_region.width, entire_region.height));
@@ -999,6 +1008,7 @@ void ViewPort::enable(const std::vector<IntRect> displays){
 void ViewPort::disable(){
     if (is_enable) {
         is_enable = false;
+        manager.get_engine().invalidateDispatchTable();
         views[current_view]->hide();
         cover_window->stop();
         render_target = nullptr;
@@ -1081,6 +1091,18 @@ Action* ViewPort::findAction(uint64_t evid){
     return nullptr;
 }
 
+void ViewPort::enumActions(const EventActionEnumerator& enumerator){
+    if (is_enable){
+        // actions for the current view take priority over actions for the viewport
+        if (mappings){
+            for (auto& [evid, action] : *mappings){
+                enumerator(evid, action.get());
+            }
+        }
+        views[current_view]->enumActions(enumerator);
+    }
+}
+
 std::pair<int, int> ViewPort::getMappingsStat(){
     return {mappings ?  mappings->size() : 0, mappings_num_for_views};
 }
@@ -1107,6 +1129,7 @@ void ViewPort::setCurrentView(sol::optional<int> view_no){
             if (current_view != *view_no){
                 auto prev = current_view;
                 current_view = *view_no;
+                manager.get_engine().invalidateDispatchTable();
                 if (is_enable){
                     if (composition_target){
                         composition_target->reset_visual_tree();
@@ -1300,6 +1323,27 @@ Action* ViewPortManager::find_action(uint64_t evid){
     return nullptr;
 }
 
+void ViewPortManager::change_status(Status status){
+    if (this->status == Status::init && status != Status::init){
+        for (auto& viewport : viewports){
+            viewport->freeze();
+        }
+    }
+    this->status = status;
+    engine.invalidateDispatchTable();
+    cv.notify_all();
+}
+
+void ViewPortManager::enum_actions(const EventActionEnumerator& enumerator){
+    std::lock_guard lock(mutex);
+    if (status == Status::running){
+        // a preceding viewport takes priority over succeeding viewports
+        for (auto viewport = viewports.rbegin(); viewport != viewports.rend(); viewport++){
+            (*viewport)->enumActions(enumerator);
+        }
+    }
+}
+
 bool ViewPortManager::findCapturedWindow(FloatPoint point, View::CapturedWindowAttributes& attrs){
     std::lock_guard lock(mutex);
     if (status == Status::running){
@@ -1622,4 +1666,4 @@ std::pair<int, int> ViewPortManager::get_mappings_stat(){
         for_views += stat.second;
     }
     return {for_viewports, for_views};
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -186,6 +186,7 @@ public:
     bool render_view(graphics::render_target& render_target, const FloatRect& rect);
     HWND getBottomWnd();
     Action* findAction(uint64_t evid);
+    void enumActions(const EventActionEnumerator& enumerator);
     int getMappingsNum(){return mappings.get() ? mappings->size() : 0;}
     bool findCapturedWindow(FloatPoint point, CapturedWindowAttributes& attrs);
     size_t getCapturedImageNum(){return captured_image_elements.size();}
@@ -299,6 +300,7 @@ public:
     void process_touch_event();
     void update();
     Action* findAction(uint64_t evid);
+    void enumActions(const EventActionEnumerator& enumerator);
     std::pair<int, int> getMappingsStat();
     bool findCapturedWindow(FloatPoint point, View::CapturedWindowAttributes& attrs);
 
@@ -354,6 +356,7 @@ public:
     mouse_emu::emulator& get_mouse_emulator() {return *mouse_emulator.get();}
     void init_scripting_env(sol::table& mapper_table);
     Action* find_action(uint64_t evid);
+    void enum_actions(const EventActionEnumerator& enumerator);
     bool findCapturedWindow(FloatPoint point, View::CapturedWindowAttributes& attrs);
 
     Status get_status(){
@@ -386,15 +389,7 @@ public:
     std::pair<int, int> get_mappings_stat();
 
 protected:
-    void change_status(Status status){
-        if (this->status == Status::init && status != Status::init){
-            for (auto& viewport : viewports){
-                viewport->freeze();
-            }
-        }
-        this->status = status;
-        cv.notify_all();
-    };
+    void change_status(Status status);
     void enable_viewport_primitive();
     void disable_viewport_primitive();
     static void notify_close_proc(HWND hWnd, void* context);
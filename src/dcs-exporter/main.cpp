@@ -15,12 +15,14 @@ extern "C" {
 }
 
 #include "struct.hpp"
+#include "observer.hpp"
 
 //============================================================================================
 // Lua C module entry point
 //============================================================================================
 static luaL_Reg module[]{
     {"struct", lua_struct::create_struct},
+    {"observer_set", lua_observer::create_observer_set},
     {nullptr, nullptr},
 };
 
@@ -28,6 +30,9 @@ extern "C" __declspec(dllexport) int luaopen_fsmapper_utils(lua_State* L){
     // register a metatable for "struct"
     lua_struct::register_meta_table(L);
 
+    // register a metatable for "observer_set"
+    lua_observer::register_meta_table(L);
+
     // register module
     luaL_register(L, "fsmapper_utils", module);
     return 1;
@@ -0,0 +1,317 @@
+//
+// observer.cpp:
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+//  Note:
+//    Observers of cockpit arguments and indication texts are polled natively in this
+//    module, observers defined by Lua chunk are still handled by observer.lua.
+//
+
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include "observer.hpp"
+#include "observer_core.hpp"
+
+//============================================================================================
+// Utilities
+//============================================================================================
+static void write_error_log(lua_State* L, const char* msg){
+    lua_getglobal(L, "log");
+    if (lua_istable(L, -1)){
+        lua_getfield(L, -1, "write");
+        lua_pushstring(L, "FSMAPPER.LUA");
+        lua_getfield(L, -3, "ERROR");
+        lua_pushstring(L, msg);
+        if (lua_pcall(L, 3, 0, 0) != 0){
+            lua_pop(L, 1);
+        }
+    }
+    lua_pop(L, 1);
+}
+
+//============================================================================================
+// Value source which fetches raw values from DCS World
+//============================================================================================
+class dcs_value_source{
+    lua_State* L;
+    int device;
+    int get_argument_value;
+    int list_indication;
+    const std::unordered_map<uint32_t, int>& function_filters;
+    std::string string_value;
+
+public:
+    // stack indexes of objects to access, 0 means the object is not available
+    dcs_value_source(lua_State* L, int device, int get_argument_value, int list_indication,
+                     const std::unordered_map<uint32_t, int>& function_filters) :
+        L(L), device(device), get_argument_value(get_argument_value), list_indication(list_indication),
+        function_filters(function_filters){}
+
+    void get_value(observer_core::observer_type type, uint32_t source, observer_core::observed_value& value){
+        if (type == observer_core::observer_type::argument && get_argument_value){
+            lua_pushvalue(L, get_argument_value);
+            lua_pushvalue(L, device);
+            lua_pushinteger(L, source);
+            call(2, value, nullptr);
+        }else if (type == observer_core::observer_type::indication && list_indication){
+            lua_pushvalue(L, list_indication);
+            lua_pushinteger(L, source);
+            call(1, value, nullptr);
+        }
+    }
+
+    void apply_function_filter(uint32_t id, observer_core::observed_value& value){
+        auto filter = function_filters.find(id);
+        if (filter == function_filters.end()){
+            return;
+        }
+        lua_rawgeti(L, LUA_REGISTRYINDEX, filter->second);
+        if (value.value_type == observer_core::observed_value::type::number){
+            lua_pushnumber(L, value.number);
+        }else{
+            lua_pushlstring(L, value.string.data(), value.string.length());
+        }
+        call(1, value, "An error occured during executing a cunk set as a filter for a observer: ");
+    }
+
+protected:
+    void call(int nargs, observer_core::observed_value& value, const char* error_prefix){
+        value.set_nil();
+        if (lua_pcall(L, nargs, 1, 0) == 0){
+            auto type = lua_type(L, -1);
+            if (type == LUA_TNUMBER){
+                value.set_number(static_cast<float>(lua_tonumber(L, -1)));
+            }else if (type == LUA_TSTRING){
+                size_t length;
+                auto string = lua_tolstring(L, -1, &length);
+                string_value.assign(string, length);
+                value.set_string(string_value);
+            }
+        }else if (error_prefix){
+            std::string msg{error_prefix};
+            auto error = lua_tostring(L, -1);
+            msg.append(error ? error : "");
+            write_error_log(L, msg.c_str());
+        }
+        lua_pop(L, 1);
+    }
+};
+
+//============================================================================================
+// Observer set object exported to Lua
+//============================================================================================
+class lua_observer_set : public observer_core::observer_set{
+    std::unordered_map<uint32_t, int> function_filters;
+    std::string buffer;
+
+public:
+    void remove_observer(lua_State* L, uint32_t id){
+        remove_function_filter(L, id);
+        remove(id);
+    }
+
+    void clear_observers(lua_State* L){
+        for (auto& [id, ref] : function_filters){
+            luaL_unref(L, LUA_REGISTRYINDEX, ref);
+        }
+        function_filters.clear();
+        clear();
+    }
+
+    // the function placed at the top of the stack is popped
+    void set_function_filter(lua_State* L, uint32_t id){
+        if (!contains(id)){
+            lua_pop(L, 1);
+            return;
+        }
+        remove_function_filter(L, id);
+        function_filters[id] = luaL_ref(L, LUA_REGISTRYINDEX);
+        observer_set::set_function_filter(id, true);
+    }
+
+    // the arguments are placed at index 2 (device) and index 3 (list_indication)
+    int poll(lua_State* L){
+        auto device = lua_isnoneornil(L, 2) ? 0 : 2;
+        auto list_indication = lua_isfunction(L, 3) ? 3 : 0;
+        auto get_argument_value = 0;
+        if (device){
+            lua_getfield(L, device, "get_argument_value");
+            if (lua_isfunction(L, -1)){
+                get_argument_value = lua_gettop(L);
+            }
+        }
+        dcs_value_source source{L, device, get_argument_value, list_indication, function_filters};
+        buffer.clear();
+        auto count = observer_set::poll(source, buffer);
+        lua_pushlstring(L, buffer.data(), buffer.length());
+        lua_pushinteger(L, count);
+        return 2;
+    }
+
+protected:
+    void remove_function_filter(lua_State* L, uint32_t id){
+        auto filter = function_filters.find(id);
+        if (filter != function_filters.end()){
+            luaL_unref(L, LUA_REGISTRYINDEX, filter->second);
+            function_filters.erase(filter);
+        }
+    }
+};
+
+//============================================================================================
+// Lua C functions
+//============================================================================================
+static const char* l_observer_set_type_name = "fsmapper_observer_set";
+
+static lua_observer_set* check_observer_set(lua_State* L){
+    return reinterpret_cast<lua_observer_set*>(luaL_checkudata(L, 1, l_observer_set_type_name));
+}
+
+static uint32_t check_observer_id(lua_State* L){
+    auto id = luaL_checkinteger(L, 2);
+    if (id < 0 || id > 0xffffff){
+        luaL_argerror(L, 2, "observer id is out of range");
+    }
+    return static_cast<uint32_t>(id);
+}
+
+static int l_observer_set(lua_State* L){
+    auto object = lua_newuserdata(L, sizeof(lua_observer_set));
+    auto user_data = lua_gettop(L);
+    luaL_getmetatable(L, l_observer_set_type_name);
+    lua_setmetatable(L, user_data);
+    new(object) lua_observer_set;
+    return 1;
+}
+
+static int l_observer_set_gc(lua_State* L){
+    auto data = lua_touserdata(L, 1);
+    if (data){
+        auto observers = reinterpret_cast<lua_observer_set*>(data);
+        observers->clear_observers(L);
+        observers->~lua_observer_set();
+    }
+    return 0;
+}
+
+static int l_observer_set_add_argument(lua_State* L){
+    auto observers = check_observer_set(L);
+    auto id = check_observer_id(L);
+    auto arg_number = luaL_checkinteger(L, 3);
+    auto epsilon = luaL_optnumber(L, 4, 0);
+    observers->remove_observer(L, id);
+    observers->add(id, observer_core::observer_type::argument, static_cast<uint32_t>(arg_number), static_cast<float>(epsilon));
+    return 0;
+}
+
+static int l_observer_set_add_indication(lua_State* L){
+    auto observers = check_observer_set(L);
+    auto id = check_observer_id(L);
+    auto indicator_id = luaL_checkinteger(L, 3);
+    auto epsilon = luaL_optnumber(L, 4, 0);
+    observers->remove_observer(L, id);
+    observers->add(id, observer_core::observer_type::indication, static_cast<uint32_t>(indicator_id), static_cast<float>(epsilon));
+    return 0;
+}
+
+static int l_observer_set_remove(lua_State* L){
+    auto observers = check_observer_set(L);
+    auto id = check_observer_id(L);
+    observers->remove_observer(L, id);
+    return 0;
+}
+
+static int l_observer_set_contains(lua_State* L){
+    auto observers = check_observer_set(L);
+    auto id = check_observer_id(L);
+    lua_pushboolean(L, observers->contains(id));
+    return 1;
+}
+
+static int l_observer_set_add_numeric_filter(lua_State* L){
+    auto observers = check_observer_set(L);
+    auto id = check_observer_id(L);
+    auto value = luaL_checknumber(L, 3);
+    lua_pushboolean(L, observers->add_numeric_filter(id, static_cast<float>(value)));
+    return 1;
+}
+
+static int l_observer_set_add_string_filter(lua_State* L){
+    auto observers = check_observer_set(L);
+    auto id = check_observer_id(L);
+    size_t length;
+    auto value = luaL_checklstring(L, 3, &length);
+    lua_pushboolean(L, observers->add_string_filter(id, std::string_view(value, length)));
+    return 1;
+}
+
+static int l_observer_set_set_filter_function(lua_State* L){
+    auto observers = check_observer_set(L);
+    auto id = check_observer_id(L);
+    luaL_checktype(L, 3, LUA_TFUNCTION);
+    lua_settop(L, 3);
+    observers->set_function_filter(L, id);
+    return 0;
+}
+
+static int l_observer_set_enable(lua_State* L){
+    auto observers = check_observer_set(L);
+    auto id = check_observer_id(L);
+    lua_pushboolean(L, observers->enable(id));
+    return 1;
+}
+
+static int l_observer_set_clear(lua_State* L){
+    auto observers = check_observer_set(L);
+    observers->clear_observers(L);
+    return 0;
+}
+
+static int l_observer_set_poll(lua_State* L){
+    auto observers = check_observer_set(L);
+    try{
+        return observers->poll(L);
+    }catch (std::exception& e){
+        return luaL_error(L, "%s", e.what());
+    }
+}
+
+//============================================================================================
+// exported functions
+//============================================================================================
+namespace lua_observer {
+    void register_meta_table(lua_State* L){
+        // register a metatable for "observer_set"
+        static const luaL_Reg methods[]{
+            {"add_argument", l_observer_set_add_argument},
+            {"add_indication", l_observer_set_add_indication},
+            {"remove", l_observer_set_remove},
+            {"contains", l_observer_set_contains},
+            {"add_numeric_filter", l_observer_set_add_numeric_filter},
+            {"add_string_filter", l_observer_set_add_string_filter},
+            {"set_filter_function", l_observer_set_set_filter_function},
+            {"enable", l_observer_set_enable},
+            {"clear", l_observer_set_clear},
+            {"poll", l_observer_set_poll},
+            {nullptr, nullptr},
+        };
+        luaL_newmetatable(L, l_observer_set_type_name);
+        auto meta_table = lua_gettop(L);
+        lua_pushcfunction(L, l_observer_set_gc);
+        lua_setfield(L, meta_table, "__gc");
+        lua_newtable(L);
+        auto index_table = lua_gettop(L);
+        for (auto method = methods; method->name; method++){
+            lua_pushcfunction(L, method->func);
+            lua_setfield(L, index_table, method->name);
+        }
+        lua_setfield(L, meta_table, "__index");
+        lua_pop(L, 1);
+    }
+
+    int create_observer_set(lua_State* L){
+        return l_observer_set(L);
+    }
+}
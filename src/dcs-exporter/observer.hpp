@@ -0,0 +1,14 @@
+//
+// observer.hpp:
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+
+extern "C" {
+    #include <lua.h>
+    #include <lauxlib.h>
+}
+
+namespace lua_observer {
+    void register_meta_table(lua_State* L);
+    int create_observer_set(lua_State* L);
+}
@@ -0,0 +1,249 @@
+//
+// observer_core.hpp:
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+//  Note:
+//    This file doesn't depend on Lua, so that the observation logic can be examined
+//    outside of DCS World.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <unordered_map>
+#include <algorithm>
+
+namespace observer_core {
+
+enum class observer_type : uint8_t{
+    argument,
+    indication,
+};
+
+struct observed_value{
+    enum class type : uint8_t{nil, number, string};
+    type value_type{type::nil};
+    float number{0};
+    std::string_view string;
+
+    void set_nil(){value_type = type::nil;}
+    void set_number(float value){value_type = type::number; number = value;}
+    void set_string(std::string_view value){value_type = type::string; string = value;}
+};
+
+//============================================================================================
+// Set of observers polled at once in each DCS frame
+//    Attributes and states of observers are held in flat arrays indexed by slot. Raw values
+//    are fetched through a value source which has following functions.
+//      void get_value(observer_type type, uint32_t source, observed_value& value);
+//      void apply_function_filter(uint32_t id, observed_value& value);
+//    Values which need to be notified are packed as entries of a 'B' frame.
+//============================================================================================
+class observer_set{
+    static constexpr uint8_t flag_enabled = 1 << 0;
+    static constexpr uint8_t flag_dirty = 1 << 1;
+    static constexpr uint8_t flag_function_filter = 1 << 2;
+
+    std::vector<uint32_t> ids;
+    std::vector<observer_type> types;
+    std::vector<uint32_t> sources;
+    std::vector<float> epsilons;
+    std::vector<uint8_t> flags;
+    std::vector<observed_value::type> value_types;
+    std::vector<float> numbers;
+    std::vector<std::string> strings;
+    std::vector<std::vector<float>> numeric_filters;
+    std::vector<std::vector<std::string>> string_filters;
+    std::unordered_map<uint32_t, size_t> slots;
+
+public:
+    size_t size() const{return ids.size();}
+
+    bool contains(uint32_t id) const{return slots.count(id) > 0;}
+
+    void add(uint32_t id, observer_type type, uint32_t source, float epsilon){
+        // an observer registered with the same id is replaced
+        remove(id);
+        slots[id] = ids.size();
+        ids.push_back(id);
+        types.push_back(type);
+        sources.push_back(source);
+        epsilons.push_back(epsilon);
+        flags.push_back(flag_dirty);
+        value_types.push_back(observed_value::type::nil);
+        numbers.push_back(0);
+        strings.emplace_back();
+        numeric_filters.emplace_back();
+        string_filters.emplace_back();
+    }
+
+    bool remove(uint32_t id){
+        auto found = slots.find(id);
+        if (found == slots.end()){
+            return false;
+        }
+        // the last slot is moved to the removed slot
+        auto slot = found->second;
+        auto last = ids.size() - 1;
+        slots.erase(found);
+        if (slot != last){
+            ids[slot] = ids[last];
+            types[slot] = types[last];
+            sources[slot] = sources[last];
+            epsilons[slot] = epsilons[last];
+            flags[slot] = flags[last];
+            value_types[slot] = value_types[last];
+            numbers[slot] = numbers[last];
+            strings[slot] = std::move(strings[last]);
+            numeric_filters[slot] = std::move(numeric_filters[last]);
+            string_filters[slot] = std::move(string_filters[last]);
+            slots[ids[slot]] = slot;
+        }
+        ids.pop_back();
+        types.pop_back();
+        sources.pop_back();
+        epsilons.pop_back();
+        flags.pop_back();
+        value_types.pop_back();
+        numbers.pop_back();
+        strings.pop_back();
+        numeric_filters.pop_back();
+        string_filters.pop_back();
+        return true;
+    }
+
+    void clear(){
+        ids.clear();
+        types.clear();
+        sources.clear();
+        epsilons.clear();
+        flags.clear();
+        value_types.clear();
+        numbers.clear();
+        strings.clear();
+        numeric_filters.clear();
+        string_filters.clear();
+        slots.clear();
+    }
+
+    bool add_numeric_filter(uint32_t id, float value){
+        auto slot = find(id);
+        if (slot){
+            numeric_filters[*slot].push_back(value);
+        }
+        return slot.has_value();
+    }
+
+    bool add_string_filter(uint32_t id, std::string_view value){
+        auto slot = find(id);
+        if (slot){
+            string_filters[*slot].emplace_back(value);
+        }
+        return slot.has_value();
+    }
+
+    bool set_function_filter(uint32_t id, bool enable){
+        auto slot = find(id);
+        if (slot){
+            flags[*slot] = enable ? flags[*slot] | flag_function_filter : flags[*slot] & ~flag_function_filter;
+        }
+        return slot.has_value();
+    }
+
+    bool enable(uint32_t id){
+        auto slot = find(id);
+        if (slot){
+            flags[*slot] |= flag_enabled | flag_dirty;
+        }
+        return slot.has_value();
+    }
+
+    // returns the number of entries appended to the buffer
+    template <typename SOURCE>
+    size_t poll(SOURCE& source, std::string& buffer){
+        size_t count{0};
+        for (size_t slot = 0; slot < ids.size(); slot++){
+            auto& flag = flags[slot];
+            if (!(flag & flag_enabled)){
+                continue;
+            }
+            observed_value value;
+            source.get_value(types[slot], sources[slot], value);
+            if (value.value_type != observed_value::type::nil){
+                if (flag & flag_function_filter){
+                    source.apply_function_filter(ids[slot], value);
+                }else{
+                    reflect_filter(slot, value);
+                }
+            }
+            auto& current_type = value_types[slot];
+            if (value.value_type == observed_value::type::number){
+                if (current_type != value.value_type || std::fabs(numbers[slot] - value.number) > epsilons[slot] || flag & flag_dirty){
+                    current_type = value.value_type;
+                    numbers[slot] = value.number;
+                    flag |= flag_dirty;
+                }
+            }else if (value.value_type == observed_value::type::string){
+                if (current_type != value.value_type || strings[slot] != value.string || flag & flag_dirty){
+                    current_type = value.value_type;
+                    strings[slot].assign(value.string);
+                    flag |= flag_dirty;
+                }
+            }
+            if (flag & flag_dirty && current_type != observed_value::type::nil){
+                flag &= ~flag_dirty;
+                pack_entry(slot, buffer);
+                count++;
+            }
+        }
+        return count;
+    }
+
+protected:
+    std::optional<size_t> find(uint32_t id) const{
+        auto found = slots.find(id);
+        return found == slots.end() ? std::nullopt : std::optional<size_t>(found->second);
+    }
+
+    // a value which is not contained in filters is ignored if any filter is specified
+    void reflect_filter(size_t slot, observed_value& value) const{
+        const auto& numeric_filter = numeric_filters[slot];
+        const auto& string_filter = string_filters[slot];
+        if (numeric_filter.empty() && string_filter.empty()){
+            return;
+        }
+        if (value.value_type == observed_value::type::number){
+            if (std::find(numeric_filter.begin(), numeric_filter.end(), value.number) == numeric_filter.end()){
+                value.set_nil();
+            }
+        }else if (std::find(string_filter.begin(), string_filter.end(), value.string) == string_filter.end()){
+            value.set_nil();
+        }
+    }
+
+    // entry layout: char type, uint24_t observer id, value
+    //               value is float for 'N', or uint16_t length and string body for 'S'
+    void pack_entry(size_t slot, std::string& buffer) const{
+        char header[4];
+        memcpy(header + 1, &ids[slot], 3);
+        if (value_types[slot] == observed_value::type::number){
+            header[0] = 'N';
+            buffer.append(header, sizeof(header));
+            buffer.append(reinterpret_cast<const char*>(&numbers[slot]), sizeof(float));
+        }else{
+            header[0] = 'S';
+            auto length = static_cast<uint16_t>(std::min<size_t>(strings[slot].length(), UINT16_MAX));
+            buffer.append(header, sizeof(header));
+            buffer.append(reinterpret_cast<const char*>(&length), sizeof(length));
+            buffer.append(strings[slot].data(), length);
+        }
+    }
+};
+
+}
@@ -54,43 +54,19 @@ observer.base_observer = {
         end
     end,
     
-    float_msg_fmt = fsmapper.utils.struct('c1I3c1I3f'),
-    string_msg_fmt = fsmapper.utils.struct('c1I3:4c1I3S2'),
-    generate_notification_message = function (self)
+    -- an entry of a 'B' (bulk) frame
+    float_entry_fmt = fsmapper.utils.struct('c1I3f'),
+    string_entry_fmt = fsmapper.utils.struct('c1I3s2'),
+    generate_bulk_entry = function (self)
         self.is_dirty = false
         local value_type = type(self.value)
         if value_type == 'number' then
-            return self.float_msg_fmt:pack('O', self.float_msg_size, 'N', self.id, self.value)
+            return self.float_entry_fmt:pack('N', self.id, self.value)
         elseif value_type == 'string' then
-            return self.string_msg_fmt:pack('O', 'S', self.id, self.value)
+            return self.string_entry_fmt:pack('S', self.id, self.value)
         end
     end,
 }
-observer.base_observer.float_msg_size = observer.base_observer.float_msg_fmt:packsize() - 4
-
-observer.argument_value_observer = {
-    new = function (id, arg_number, epsilon)
-        local self = common.instantiate(observer.argument_value_observer, observer.base_observer, id, epsilon)
-        self.arg_number = arg_number
-        return self
-    end,
-
-    raw_value = function (self)
-        return GetDevice(0):get_argument_value(self.arg_number)
-    end,
-}
-
-observer.indication_text_observer = {
-    new = function (id, indicator_id, epsilon)
-        local self = common.instantiate(observer.indication_text_observer, observer.base_observer, id, epsilon)
-        self.indicator_id = indicator_id
-        return self
-    end,
-
-    raw_value = function (self)
-        return list_indication(self.indicator_id)
-    end,
-}
 
 observer.chunk_value_observer = {
     new = function (id, chunk_text, epsilon)
@@ -114,10 +90,15 @@ observer.chunk_value_observer = {
     end,
 }
 
+-- argument value observers and indication text observers are polled by fsmapper_utils natively,
+-- only chunk value observers are handled in Lua
 observer.observer_list = {
     new = function ()
         local self = common.instantiate(observer.observer_list)
+        self.native = fsmapper.utils.observer_set()
         self.observers ={}
+        self.entries = {}
+        self.frame_number = 0
         return self
     end,
     
@@ -133,19 +114,22 @@ observer.observer_list = {
         if type == 'A' then
             local arg_number, epsilon = self.A_sub_fmt:unpack(cmd, self.O_fmt:packsize() + 1)
             if epsilon then
-                self.observers[id] = observer.argument_value_observer.new(id, arg_number, epsilon)
+                self.observers[id] = nil
+                self.native:add_argument(id, arg_number, epsilon)
                 fsmapper.log("Registered an argument value observer for " .. arg_number .. " as id=" .. id)
             end
         elseif type == 'I' then
             local indicator_id, epsilon = self.I_sub_fmt:unpack(cmd, self.O_fmt:packsize() + 1)
             if epsilon then
-                self.observers[id] = observer.indication_text_observer.new(id, indicator_id, epsilon)
+                self.observers[id] = nil
+                self.native:add_indication(id, indicator_id, epsilon)
                 fsmapper.log("Registered an indication text observer for " .. indicator_id .. " as id=" .. id)
             end
         elseif type == 'C' then
             local epsilon = self.C_sub_fmt:unpack(cmd, self.O_fmt:packsize() + 1)
             local chunk = cmd:sub(self.O_fmt:packsize() + self.C_sub_fmt:packsize() + 1)
             if chunk:len() > 0 then
+                self.native:remove(id)
                 self.observers[id] = observer.chunk_value_observer.new(id, chunk, epsilon)
                 fsmapper.log("Registered a chunk value observer as id=" .. id)
             end
@@ -156,16 +140,20 @@ observer.observer_list = {
                 if ob then
                     ob.filter = ob.filter or {}
                     ob.filter[value] = true
+                end
+                if ob or self.native:add_numeric_filter(id, value) then
                     fsmapper.log("Added a numeric filter to the observer: id=" .. id .. " value=" .. value)
                 end
             end
         elseif type == 'G' then
             local value = self.G_sub_fmt:unpack(cmd, self.O_fmt:packsize() + 1)
             if value then
-                local ob = ob.observers[id]
+                local ob = self.observers[id]
                 if ob then
-                    ob.filter = self.filter or {}
+                    ob.filter = ob.filter or {}
                     ob.filter[value] = true
+                end
+                if ob or self.native:add_string_filter(id, value) then
                     fsmapper.log("Added a string filter to the observer: id=" .. id .. " value=" .. value)
                 end
             end
@@ -173,13 +161,22 @@ observer.observer_list = {
             local value = self.H_sub_fmt:unpack(cmd, self.O_fmt:packsize() + 1)
             if value then
                 local ob = self.observers[id]
-                if ob then
+                if ob or self.native:contains(id) then
                     local chunk, error = loadstring(value)
                     if error then
                         log.write('FSMAPPER.LUA', log.ERROR, 'An error occured while parcing a chunk for observer filter: ' .. error)
-                        ob.filter = {}
+                        if ob then
+                            ob.filter = {}
+                        else
+                            -- a filter which never matches
+                            self.native:set_filter_function(id, function () return nil end)
+                        end
                     else
-                        ob.filter= common.configure_fenv(chunk)
+                        if ob then
+                            ob.filter = common.configure_fenv(chunk)
+                        else
+                            self.native:set_filter_function(id, common.configure_fenv(chunk))
+                        end
                         fsmapper.log("Added a chunk filter to the observer: id=" .. id)
                     end
                 end
@@ -190,6 +187,8 @@ observer.observer_list = {
                 ob.is_enabled = true
                 ob:update()
                 fsmapper.log("Enabled an observer: id=" .. id)
+            elseif self.native:enable(id) then
+                fsmapper.log("Enabled an observer: id=" .. id)
             end
         else
             fsmapper.log(string.format('Unknown observer manipulation subcommand: subcmd=%q id=%q', type, id))
@@ -197,17 +196,34 @@ observer.observer_list = {
     end,
 
     clear = function (self)
+        self.native:clear()
         self.observers = {}
         fsmapper.log("Cleared all observer")
     end,
 
+    -- all values changed in a DCS frame are sent as a single 'B' frame:
+    --   'B', length, frame number, entry count, entries
+    -- entries of native observers are packed by fsmapper_utils in a single call
+    B_fmt = fsmapper.utils.struct('c1I3I4I4'),
     refresh = function (self, now, connection)
+        self.frame_number = self.frame_number + 1
+        local native_entries, native_count = self.native:poll(GetDevice(0), list_indication)
+        local entries = self.entries
+        local count = 0
         for _, ob in pairs(self.observers) do
             if ob:update() then
-                connection:send(ob:generate_notification_message())
-                fsmapper.log("Send observed data: id=" .. ob.id)
+                local entry = ob:generate_bulk_entry()
+                if entry then
+                    count = count + 1
+                    entries[count] = entry
+                end
             end
         end
+        if native_count + count > 0 then
+            local body = native_entries .. table.concat(entries, '', 1, count)
+            connection:send(self.B_fmt:pack('B', body:len() + 8, self.frame_number, native_count + count) .. body)
+            fsmapper.log("Send observed data: frame=" .. self.frame_number .. " count=" .. native_count + count)
+        end
     end,
 }
 
@@ -0,0 +1,54 @@
+-- checks of the observer set in fsmapper_utils with stubs of DCS World functions
+local utils = require('fsmapper_utils')
+local logged = {}
+log = {ERROR = 1, INFO = 2, write = function (tag, level, msg) logged[#logged + 1] = msg end}
+local device = {get_argument_value = function (self, n) return n == 1 and 0.5 or nil end}
+local indication = 'text'
+local function list_indication(n) return n == 2 and indication or nil end
+
+local observers = utils.observer_set()
+observers:add_argument(1, 1, 0)
+observers:add_argument(2, 9, 0)
+observers:add_indication(3, 2, 0)
+assert(not observers:enable(99))
+assert(observers:enable(1) and observers:enable(2) and observers:enable(3))
+
+-- entries: 'S' with uint24 id, uint16 length and body, or 'N' with uint24 id and float
+local entries, count = observers:poll(nil, list_indication)
+assert(count == 1 and entries:len() == 4 + 2 + 4, 'arguments must be nil without device')
+entries, count = observers:poll(device, nil)
+assert(count == 1 and entries:len() == 8, 'argument must be notified')
+entries, count = observers:poll(device, list_indication)
+assert(count == 0, 'unchanged values must not be notified')
+
+observers:set_filter_function(1, function (value) error('filter error') end)
+entries, count = observers:poll(device, list_indication)
+assert(count == 0 and #logged == 1 and logged[1]:find('filter error'), 'filter error must be logged')
+observers:set_filter_function(1, function (value) return value * 4 end)
+entries, count = observers:poll(device, list_indication)
+assert(count == 1, 'filtered value must be notified')
+
+observers:remove(1)
+assert(not observers:contains(1) and observers:contains(3))
+assert(not observers:add_numeric_filter(1, 1))
+assert(observers:add_string_filter(3, 'other'))
+indication = 'changed'
+entries, count = observers:poll(device, list_indication)
+assert(count == 0, 'values out of filters must be ignored')
+observers:enable(3)
+entries, count = observers:poll(device, list_indication)
+assert(count == 1, 'enabling again must notify the last value')
+assert(not pcall(observers.add_argument, observers, 0x1000000, 1, 0), 'id must be 24 bits')
+observers:clear()
+assert(not observers:contains(3))
+
+for i = 1, 1000 do
+    observers:add_argument(i, 1, 0)
+    observers:set_filter_function(i, function (value) return value end)
+    observers:enable(i)
+end
+entries, count = observers:poll(device, list_indication)
+assert(count == 1000)
+observers = nil
+collectgarbage()
+print('ok')
@@ -0,0 +1,355 @@
+//
+// dcsmock.cpp
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+//  stand-in of the DCS World exporter, and load driver of the DCS World connection
+//  usage: dcsmock server [options]
+//         dcsmock bench [options]
+//  options:
+//      --port N          TCP port number (default: 8544)
+//      --rate N          number of DCS frames per second, 0 means unlimited (default: 60)
+//      --observers N     number of observed values which change in each frame (default: 100)
+//      --strings N       percentage of string values (default: 10)
+//      --legacy          notify each value by an 'O' packet instead of a 'B' packet
+//      --drop N          close the connection every N milliseconds, 0 means never (default: 0)
+//      --duration N      duration of the benchmark in seconds (default: 5)
+//      --burst N         number of chunk invocations queued at once by the benchmark (default: 1)
+//      --coalesce        queue chunk invocations with a coalescing key
+//
+
+#include <iostream>
+#include <iomanip>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "dcsprotocol.h"
+#include "dcsconnection.h"
+#include "dcsposixtransport.h"
+
+using mock_clock = std::chrono::steady_clock;
+
+struct MockOptions{
+    uint16_t port = 8544;
+    int rate = 60;
+    int observers = 100;
+    int strings = 10;
+    bool legacy = false;
+    int drop = 0;
+    int duration = 5;
+    int burst = 1;
+    bool coalesce = false;
+
+    bool parse(int argc, char** argv){
+        for (auto i = 0; i < argc; i++){
+            std::string option{argv[i]};
+            if (option == "--legacy"){
+                legacy = true;
+                continue;
+            }else if (option == "--coalesce"){
+                coalesce = true;
+                continue;
+            }
+            if (i + 1 >= argc){
+                return false;
+            }
+            auto value = std::atoi(argv[++i]);
+            if (option == "--port"){
+                port = static_cast<uint16_t>(value);
+            }else if (option == "--rate"){
+                rate = value;
+            }else if (option == "--observers"){
+                observers = value;
+            }else if (option == "--strings"){
+                strings = value;
+            }else if (option == "--drop"){
+                drop = value;
+            }else if (option == "--duration"){
+                duration = value;
+            }else if (option == "--burst"){
+                burst = value;
+            }else{
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+//============================================================================================
+// Stand-in of the DCS World exporter
+//    The exporter behaves as a TCP server. 'V' and 'A' packets are sent when a connection
+//    is established, then changes of observed values are notified in each DCS frame.
+//    Commands sent from fsmapper are read and discarded.
+//============================================================================================
+class MockExporter{
+protected:
+    const MockOptions& options;
+    int listen_fd = -1;
+    std::atomic<bool> should_stop{false};
+    std::thread server;
+
+public:
+    std::atomic<uint64_t> sent_values{0};
+    std::atomic<uint64_t> received_bytes{0};
+    std::atomic<int64_t> last_drop{0};
+
+    MockExporter(const MockOptions& options) : options(options){}
+    ~MockExporter(){stop();}
+
+    bool start(){
+        listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        int on = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(options.port);
+        if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listen_fd, 1) != 0){
+            std::cerr << "failed to listen the port " << options.port << ": " << strerror(errno) << std::endl;
+            return false;
+        }
+        server = std::thread([this](){serve();});
+        return true;
+    }
+
+    void stop(){
+        if (server.joinable()){
+            should_stop = true;
+            shutdown(listen_fd, SHUT_RDWR);
+            server.join();
+        }
+        if (listen_fd >= 0){
+            close(listen_fd);
+            listen_fd = -1;
+        }
+    }
+
+protected:
+    void serve(){
+        while (!should_stop){
+            auto fd = accept(listen_fd, nullptr, nullptr);
+            if (fd < 0){
+                continue;
+            }
+            std::atomic<bool> is_closed{false};
+            std::thread reader([this, fd, &is_closed](){
+                char buf[4096];
+                while (true){
+                    auto rc = recv(fd, buf, sizeof(buf), 0);
+                    if (rc <= 0){
+                        break;
+                    }
+                    received_bytes += rc;
+                }
+                is_closed = true;
+            });
+            communicate(fd, is_closed);
+            shutdown(fd, SHUT_RDWR);
+            reader.join();
+            close(fd);
+        }
+    }
+
+    bool send_all(int fd, const std::string& data){
+        size_t sent = 0;
+        while (sent < data.size()){
+            auto rc = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (rc <= 0){
+                return false;
+            }
+            sent += rc;
+        }
+        return true;
+    }
+
+    void communicate(int fd, std::atomic<bool>& is_closed){
+        std::string packet;
+        const char product_name[] = "DCS mock";
+        uint32_t version[] = {2, 9, 0, 0, sizeof(product_name) - 1};
+        append_command_header(packet, 'V', sizeof(version) + sizeof(product_name) - 1);
+        packet.append(reinterpret_cast<const char*>(version), sizeof(version));
+        packet.append(product_name, sizeof(product_name) - 1);
+        const char aircraft_name[] = "F-16C_50";
+        append_command_header(packet, 'A', sizeof(aircraft_name) - 1);
+        packet.append(aircraft_name, sizeof(aircraft_name) - 1);
+        if (!send_all(fd, packet)){
+            return;
+        }
+
+        auto connected_at = mock_clock::now();
+        auto next_frame = connected_at;
+        uint32_t frame_number = 0;
+        std::string body;
+        std::string value;
+        while (!should_stop && !is_closed){
+            auto now = mock_clock::now();
+            if (options.drop > 0 && now - connected_at >= std::chrono::milliseconds(options.drop)){
+                last_drop = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+                return;
+            }
+            frame_number++;
+            packet.clear();
+            body.assign(sizeof(DCSBulkFrameHeader), '\0');
+            for (auto i = 0; i < options.observers; i++){
+                auto entry_start = body.size();
+                if (i * 100 < options.strings * options.observers){
+                    value = "value " + std::to_string(frame_number + i);
+                    append_bulk_frame_entry(body, i, value);
+                }else{
+                    append_bulk_frame_entry(body, i, static_cast<float>(frame_number + i));
+                }
+                if (options.legacy){
+                    append_command_header(packet, 'O', body.size() - entry_start);
+                    packet.append(body, entry_start);
+                    body.resize(entry_start);
+                }
+            }
+            if (!options.legacy){
+                DCSBulkFrameHeader header{frame_number, static_cast<uint32_t>(options.observers)};
+                memcpy(&body[0], &header, sizeof(header));
+                append_command_header(packet, 'B', body.size());
+                packet.append(body);
+            }
+            if (!send_all(fd, packet)){
+                return;
+            }
+            sent_values += options.observers;
+            if (options.rate > 0){
+                next_frame += std::chrono::microseconds(1000000 / options.rate);
+                std::this_thread::sleep_until(next_frame);
+            }
+        }
+    }
+};
+
+//============================================================================================
+// Load driver
+//    DCSConnection with the POSIX transport connects to the stand-in exporter running in
+//    the same process, then sustained throughput of observed values and reconnect latency
+//    are measured.
+//============================================================================================
+static int run_bench(const MockOptions& options){
+    MockExporter exporter{options};
+    if (!exporter.start()){
+        return 1;
+    }
+
+    std::mutex mutex;
+    DCSWorldSendBuffer tx_buf;
+    DCSConnection connection{mutex, std::make_unique<DCSPosixTransport>(), tx_buf};
+    uint64_t received_values = 0;
+    uint64_t received_bytes = 0;
+    uint64_t connections = 0;
+    std::vector<double> reconnect_latencies;
+
+    std::thread client([&](){
+        std::unique_lock lock{mutex};
+        connection.run(lock, options.port, [&](auto&, const DCSPacket& packet){
+            received_bytes += command_header_size + packet.get_data_length();
+            if (packet.get_command() == 'B'){
+                DCSBulkFrameHeader header;
+                parse_bulk_frame(packet, header, [&](char, uint32_t, const char*, size_t){
+                    received_values++;
+                });
+            }else if (packet.get_command() == 'O'){
+                received_values++;
+            }
+        }, [&](auto&, bool connected){
+            if (connected){
+                connections++;
+                auto last_drop = exporter.last_drop.load();
+                if (last_drop){
+                    auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(mock_clock::now().time_since_epoch()).count();
+                    reconnect_latencies.push_back((now - last_drop) / 1000000.0);
+                }
+            }
+        }, [](const char*){});
+    });
+
+    // commands from fsmapper are also sent to exercise the transmit path
+    auto start = mock_clock::now();
+    auto deadline = start + std::chrono::seconds(options.duration);
+    uint64_t sent_commands = 0;
+    while (mock_clock::now() < deadline){
+        auto need_to_notify{false};
+        for (auto i = 0; i < options.burst; i++){
+            struct{
+                command_header hdr;
+                uint32_t chunk_id;
+                float argument;
+            }cmd{make_command_header('U', 8), 0, static_cast<float>(sent_commands)};
+            if (options.coalesce){
+                need_to_notify = tx_buf.insert_data(&cmd, sizeof(cmd), cmd.chunk_id) || need_to_notify;
+            }else{
+                need_to_notify = tx_buf.insert_data(&cmd, sizeof(cmd)) || need_to_notify;
+            }
+            sent_commands++;
+        }
+        if (need_to_notify){
+            connection.notify();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    auto elapsed = std::chrono::duration<double>(mock_clock::now() - start).count();
+
+    {
+        std::lock_guard lock{mutex};
+        connection.stop();
+    }
+    client.join();
+    exporter.stop();
+
+    std::cout << std::fixed << std::setprecision(0);
+    std::cout << "mode               : " << (options.legacy ? "O packet per value" : "B packet per frame") << std::endl;
+    std::cout << "connections        : " << connections << std::endl;
+    std::cout << "sent values        : " << exporter.sent_values.load() << std::endl;
+    std::cout << "received values    : " << received_values << " (" << received_values / elapsed << " values/sec)" << std::endl;
+    std::cout << "received bytes     : " << received_bytes << " (" << received_bytes / elapsed / 1024 << " KiB/sec)" << std::endl;
+    std::cout << "queued commands    : " << sent_commands << (options.coalesce ? " (coalesced)" : "") << std::endl;
+    std::cout << "transmitted bytes  : " << exporter.received_bytes.load() << std::endl;
+    if (reconnect_latencies.size()){
+        double total = 0;
+        double max = 0;
+        for (auto latency : reconnect_latencies){
+            total += latency;
+            max = std::max(max, latency);
+        }
+        std::cout << std::setprecision(3);
+        std::cout << "reconnect latency  : avg " << total / reconnect_latencies.size() << " ms, max " << max << " ms" << std::endl;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv){
+    MockOptions options;
+    std::string mode = argc > 1 ? argv[1] : "";
+    if ((mode != "server" && mode != "bench") || !options.parse(argc - 2, argv + 2)){
+        std::cerr << "usage: " << argv[0] << " server|bench [--port N] [--rate N] [--observers N] [--strings N] [--legacy] [--drop N] [--duration N] [--burst N] [--coalesce]" << std::endl;
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    if (mode == "server"){
+        MockExporter exporter{options};
+        if (!exporter.start()){
+            return 1;
+        }
+        while (true){
+            std::this_thread::sleep_for(std::chrono::seconds(options.duration));
+            std::cout << "sent values: " << exporter.sent_values.load() << std::endl;
+        }
+    }
+    return run_bench(options);
+}
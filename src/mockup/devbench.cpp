@@ -0,0 +1,163 @@
+//
+// devbench.cpp
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+//  benchmark of devices with the mock device plugin
+//  usage: devbench raise [--units N] [--reports N]
+//         devbench open [--units N] [--opens N]
+//
+//  raise: A device with absolute units reports changes of all units at once like a HID
+//         report. Values are raised unit by unit with fsmapper_raiseEvent(), then raised
+//         at once with fsmapper_raiseEvents(). (default: 256 units, 20000 reports)
+//  open:  A device with binary units is opened and closed repeatedly, with and without a
+//         button modifier which detects double click and long press for each unit.
+//         (default: 1000 units, 20 opens)
+//
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include "mockdevice.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+struct BenchOptions{
+    int units = 0;
+    int count = 0;
+
+    bool parse(int argc, char** argv, const char* count_option){
+        for (auto i = 0; i < argc; i++){
+            std::string option{argv[i]};
+            if (i + 1 >= argc){
+                return false;
+            }
+            auto value = std::atoi(argv[++i]);
+            if (option == "--units" && value > 0){
+                units = value;
+            }else if (option == count_option && value > 0){
+                count = value;
+            }else{
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+static std::vector<MockDevice::Unit> make_units(int num, FSMDEVUNIT_VALTYPE type, int max_value){
+    std::vector<MockDevice::Unit> units;
+    for (auto i = 0; i < num; i++){
+        units.push_back({"unit" + std::to_string(i), type, 0, max_value});
+    }
+    return units;
+}
+
+//============================================================================================
+// Raising unit values
+//============================================================================================
+static void run_raise(const BenchOptions& options){
+    MockDeviceHost host;
+    MockDevice device{make_units(options.units, FSMDU_TYPE_ABSOLUTE, 1023)};
+    host.open(device, "hid", nullptr);
+
+    std::vector<FSMDEVUNITVALUE> values(options.units);
+    for (auto i = 0; i < options.units; i++){
+        values[i].index = i;
+        values[i].type = FSMDU_VALUE_INT;
+    }
+    auto fill_report = [&](int report){
+        for (auto i = 0; i < options.units; i++){
+            values[i].value.intValue = (report + i) % 1024;
+        }
+    };
+
+    std::cout << options.units << " units, " << options.count << " reports" << std::endl;
+    for (auto is_batched : {false, true}){
+        uint64_t events = 0;
+        uint64_t frames = 0;
+        auto start = bench_clock::now();
+        for (auto report = 0; report < options.count; report++){
+            fill_report(report);
+            if (is_batched){
+                device.raise(values.data(), values.size());
+            }else{
+                for (const auto& value : values){
+                    device.raise(value.index, value.value.intValue);
+                }
+            }
+            while (auto ev = host.receiveEvent()){
+                events++;
+                frames += ev->isContinuedInFrame() ? 0 : 1;
+            }
+        }
+        auto elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+        std::cout << (is_batched ? "fsmapper_raiseEvents" : "fsmapper_raiseEvent") << std::endl;
+        std::cout << std::fixed << std::setprecision(0);
+        std::cout << "    reports        : " << options.count / elapsed << " reports/sec" << std::endl;
+        std::cout << std::setprecision(1);
+        std::cout << "    unit values    : " << elapsed * 1e9 / options.count / options.units << " ns/value" << std::endl;
+        std::cout << "    events         : " << events << " in " << frames << " frames" << std::endl;
+    }
+}
+
+//============================================================================================
+// Opening a device
+//============================================================================================
+static void run_open(const BenchOptions& options){
+    MockDeviceHost host;
+    struct Case{
+        const char* name;
+        const char* modifiers;
+    };
+    Case cases[] = {
+        {"raw modifier", nullptr},
+        {"button modifier", "{{class = 'binary', modtype = 'button', modparam = {doubleclick = 300, longpress = 600}}}"},
+    };
+
+    std::cout << options.units << " units, " << options.count << " opens" << std::endl;
+    for (const auto& item : cases){
+        MockDevice device{make_units(options.units, FSMDU_TYPE_BINARY, 1)};
+        // the first open is not measured so that the event name table is allocated
+        host.open(device, "warmup", item.modifiers);
+        device.close();
+        auto start = bench_clock::now();
+        for (auto i = 0; i < options.count; i++){
+            host.open(device, ("device" + std::to_string(i)).c_str(), item.modifiers);
+            device.close();
+        }
+        auto elapsed = std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+        std::cout << item.name << std::endl;
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << "    open + close   : " << elapsed / options.count << " ms/device" << std::endl;
+        std::cout << std::setprecision(1);
+        std::cout << "    per unit       : " << elapsed * 1e6 / options.count / options.units << " ns/unit" << std::endl;
+    }
+}
+
+int main(int argc, char** argv){
+    std::string mode = argc > 1 ? argv[1] : "";
+    BenchOptions options;
+    auto is_valid = false;
+    if (mode == "raise"){
+        options = {256, 20000};
+        is_valid = options.parse(argc - 2, argv + 2, "--reports");
+    }else if (mode == "open"){
+        options = {1000, 20};
+        is_valid = options.parse(argc - 2, argv + 2, "--opens");
+    }
+    if (!is_valid){
+        std::cerr << "usage: " << argv[0] << " raise [--units N] [--reports N]" << std::endl;
+        std::cerr << "       " << argv[0] << " open [--units N] [--opens N]" << std::endl;
+        return 1;
+    }
+
+    if (mode == "raise"){
+        run_raise(options);
+    }else{
+        run_open(options);
+    }
+    return 0;
+}
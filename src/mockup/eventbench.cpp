@@ -0,0 +1,203 @@
+//
+// eventbench.cpp
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+//  checks of value conversion between Lua and EventValue, and microbenchmark of EventValue
+//  usage: eventbench [--iterations N]
+//
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <functional>
+#include <cstdlib>
+#include <sol/sol.hpp>
+#include "event.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+//============================================================================================
+// Value round-trip checks
+//============================================================================================
+class Checker{
+protected:
+    int failed = 0;
+    int passed = 0;
+
+public:
+    void check(bool condition, const char* description){
+        if (condition){
+            passed++;
+        }else{
+            failed++;
+            std::cout << "    FAILED: " << description << std::endl;
+        }
+    }
+
+    int result(){
+        std::cout << "    " << passed << " passed, " << failed << " failed" << std::endl;
+        return failed;
+    }
+};
+
+static int check_round_trips(){
+    std::cout << "value round-trip checks" << std::endl;
+    Checker checker;
+    sol::state lua;
+    lua.open_libraries(sol::lib::base);
+    lua.script(R"(
+        v_nil = nil
+        v_true = true
+        v_false = false
+        v_int = 42
+        v_double = 1.25
+        v_short = "short string"
+        v_long = "a string longer than the inline capacity of EventValue"
+        v_table = {1, 2, 3}
+    )");
+
+    // Lua value to EventValue
+    EventValue nil_value{static_cast<sol::object>(lua["v_nil"])};
+    checker.check(nil_value.getType() == EventValue::Type::null, "nil is typed as null");
+    EventValue true_value{static_cast<sol::object>(lua["v_true"])};
+    checker.check(true_value.getType() == EventValue::Type::bool_value, "true is typed as bool_value");
+    checker.check(true_value.getAs<bool>(), "true is converted to true");
+    EventValue false_value{static_cast<sol::object>(lua["v_false"])};
+    checker.check(false_value.getType() == EventValue::Type::bool_value, "false is typed as bool_value");
+    checker.check(!false_value.getAs<bool>(), "false is converted to false");
+    EventValue int_value{static_cast<sol::object>(lua["v_int"])};
+    checker.check(int_value.getType() == EventValue::Type::int_value, "integral number is typed as int_value");
+    checker.check(int_value.getAs<int64_t>() == 42, "integral number keeps its value");
+    EventValue double_value{static_cast<sol::object>(lua["v_double"])};
+    checker.check(double_value.getType() == EventValue::Type::double_value, "fractional number is typed as double_value");
+    checker.check(double_value.getAs<double>() == 1.25, "fractional number keeps its value");
+    EventValue short_value{static_cast<sol::object>(lua["v_short"])};
+    checker.check(short_value.getAs<std::string>() == "short string", "short string keeps its value");
+    EventValue long_value{static_cast<sol::object>(lua["v_long"])};
+    checker.check(long_value.getAs<std::string>() == lua["v_long"].get<std::string>(), "long string keeps its value");
+    EventValue table_value{static_cast<sol::object>(lua["v_table"])};
+    checker.check(table_value.getType() == EventValue::Type::lua_value, "table is typed as lua_value");
+
+    // copies
+    EventValue short_copy{short_value};
+    checker.check(short_copy.getAs<const char*>() != short_value.getAs<const char*>(), "short string is copied inline");
+    checker.check(short_copy.getAs<std::string>() == "short string", "copied short string keeps its value");
+    EventValue long_copy{long_value};
+    checker.check(long_copy.getAs<const char*>() == long_value.getAs<const char*>(), "long string is shared by copies");
+    EventValue moved{std::move(long_copy)};
+    checker.check(moved.getAs<std::string>() == lua["v_long"].get<std::string>(), "moved long string keeps its value");
+    checker.check(long_copy.getType() == EventValue::Type::null, "moved-from value becomes null");
+    EventValue table_copy{table_value};
+    checker.check(table_copy.getAs<sol::object>().as<sol::table>().size() == 3, "copied table refers the same table");
+
+    // EventValue to Lua table via applyToTable
+    Event::AssosiativeArray array;
+    array.emplace("null", EventValue{});
+    array.emplace("bool", EventValue{true});
+    array.emplace("int", EventValue{static_cast<int64_t>(-7)});
+    array.emplace("double", EventValue{2.75});
+    array.emplace("short", EventValue{"short"});
+    array.emplace("long", EventValue{std::string(64, 'x')});
+    array.emplace("table", EventValue{static_cast<sol::object>(lua["v_table"])});
+    Event event{1, std::move(array)};
+    sol::table table = lua.create_table();
+    table["null"] = 1;
+    event.applyToTable(table);
+    checker.check(table["null"].get_type() == sol::type::lua_nil, "null is applied as nil");
+    checker.check(table["bool"].get_type() == sol::type::boolean && table["bool"].get<bool>(), "bool is applied as boolean");
+    checker.check(table["int"].get<int64_t>() == -7, "int is applied as integer");
+    checker.check(table["double"].get<double>() == 2.75, "double is applied without truncation");
+    checker.check(table["short"].get<std::string>() == "short", "short string is applied");
+    checker.check(table["long"].get<std::string>() == std::string(64, 'x'), "long string is applied");
+    checker.check(table["table"].get<sol::table>().size() == 3, "table is applied as the same table");
+
+    return checker.result();
+}
+
+//============================================================================================
+// Microbenchmark
+//============================================================================================
+template <typename FUNC>
+static double measure(int iterations, FUNC&& func){
+    auto start = bench_clock::now();
+    for (auto i = 0; i < iterations; i++){
+        func(i);
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(bench_clock::now() - start).count();
+    return elapsed / iterations;
+}
+
+static void run_bench(int iterations){
+    sol::state lua;
+    lua.open_libraries(sol::lib::base);
+    lua.script("bench_table = {}");
+    sol::object lua_table = lua["bench_table"];
+    std::string short_string = "indication text";
+    std::string long_string = "a line of DCS indication text which does not fit inline";
+
+    struct ValueType{
+        const char* name;
+        std::function<EventValue()> make;
+    };
+    std::vector<ValueType> types = {
+        {"null", []{return EventValue{};}},
+        {"bool", []{return EventValue{true};}},
+        {"int", []{return EventValue{static_cast<int64_t>(1234)};}},
+        {"double", []{return EventValue{0.5};}},
+        {"short string", [&short_string]{return EventValue{short_string};}},
+        {"long string", [&long_string]{return EventValue{long_string};}},
+        {"lua value", [&lua_table]{return EventValue{lua_table};}},
+    };
+
+    std::cout << "EventValue microbenchmark (" << iterations << " iterations, ns/op)" << std::endl;
+    std::cout << "    " << std::left << std::setw(14) << "type" << std::right
+              << std::setw(12) << "construct" << std::setw(12) << "copy" << std::setw(14) << "applyToTable" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    sol::table table = lua.create_table();
+    auto bench_type = [&](const ValueType& type, bool print){
+        std::vector<EventValue> values;
+        values.reserve(iterations);
+        auto construct = measure(iterations, [&](int){
+            values.push_back(type.make());
+        });
+        std::vector<EventValue> copies;
+        copies.reserve(iterations);
+        auto copy = measure(iterations, [&](int i){
+            copies.push_back(values[i]);
+        });
+        Event::AssosiativeArray array;
+        array.emplace("value", type.make());
+        Event event{1, std::move(array)};
+        auto apply = measure(iterations, [&](int){
+            event.applyToTable(table);
+        });
+        if (print){
+            std::cout << "    " << std::left << std::setw(14) << type.name << std::right
+                      << std::setw(12) << construct << std::setw(12) << copy << std::setw(14) << apply << std::endl;
+        }
+    };
+    // the first pass warms up the heap so that page faults are not counted
+    for (auto& type : types){
+        bench_type(type, false);
+    }
+    for (auto& type : types){
+        bench_type(type, true);
+    }
+}
+
+int main(int argc, char** argv){
+    auto iterations = 1000000;
+    if (argc == 3 && std::string(argv[1]) == "--iterations"){
+        iterations = std::max(std::atoi(argv[2]), 1);
+    }else if (argc != 1){
+        std::cerr << "usage: " << argv[0] << " [--iterations N]" << std::endl;
+        return 1;
+    }
+
+    auto failed = check_round_trips();
+    std::cout << std::endl;
+    run_bench(iterations);
+    return failed ? 1 : 0;
+}
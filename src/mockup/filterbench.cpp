@@ -0,0 +1,159 @@
+//
+// filterbench.cpp
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+//  benchmark of native filters
+//  usage: filterbench chain [--events N]
+//
+//  chain: Events of an axis are sent to a chain of 5 native filters as below.
+//             filter.lerp -> filter.duplicator -> filter.lerp -> filter.lerp -> sink
+//                                              -> filter.branch -> sink
+//         The chain is compiled into a single pipeline as mapper scripts build it, then the
+//         same chain is built with an opaque native action between stages so that each stage
+//         is invoked through NativeAction and std::function as before filters were compiled.
+//         The opaque action adds one more std::function call to each stage, so the baseline
+//         is slightly slower than the former implementation. (default: 2000000 events)
+//
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+#include <cstdlib>
+#include <sol/sol.hpp>
+#include "engine.h"
+#include "action.h"
+#include "filter.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+struct BenchOptions{
+    int events = 2000000;
+
+    bool parse(int argc, char** argv){
+        for (auto i = 0; i < argc; i++){
+            std::string option{argv[i]};
+            if (i + 1 >= argc){
+                return false;
+            }
+            auto value = std::atoi(argv[++i]);
+            if (option == "--events" && value > 0){
+                events = value;
+            }else{
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+//============================================================================================
+// Filter chain
+//============================================================================================
+static const char* chain_script = R"(
+    local function curve(points, gamma)
+        local rule = {}
+        for i = 0, points - 1 do
+            local x = math.floor(i * 1023 / (points - 1))
+            rule[#rule + 1] = {x, math.floor(1023 * (x / 1023) ^ gamma)}
+        end
+        return rule
+    end
+
+    function make_chain(wrap)
+        return filter.lerp(wrap(filter.duplicator(
+            wrap(filter.lerp(wrap(filter.lerp(sink, curve(64, 0.5))), curve(16, 2.0))),
+            wrap(filter.branch(
+                {condition = 'exceeded', value = 768, action = sink},
+                {condition = 'falled', value = 256, action = sink}))
+        )), curve(64, 1.5))
+    end
+
+    compiled_chain = make_chain(function (action) return action end)
+    nested_chain = make_chain(opaque)
+)";
+
+struct Sink{
+    uint64_t events = 0;
+    int64_t sum = 0;
+};
+
+static int run_chain(const BenchOptions& options){
+    MapperEngine engine{[](MAPPER_EVENT, int64_t){}, [](MCONSOLE_MESSAGE_TYPE, const std::string&){}};
+    sol::state lua;
+    lua.open_libraries(sol::lib::base, sol::lib::math);
+    filter_create_lua_env(engine, lua);
+
+    Sink sink;
+    NativeAction::Function::ACTION_FUNCTION sink_func = [&sink](Event& event, sol::state&){
+        sink.events++;
+        sink.sum += event.getAs<int64_t>();
+    };
+    lua["sink"] = std::make_shared<NativeAction::Function>("sink", sink_func);
+
+    // a native action which hides the filter graph of a filter from the upstream filter
+    lua["opaque"] = [](std::shared_ptr<NativeAction::Function> function){
+        auto name = std::string("opaque(") + function->getName() + ")";
+        NativeAction::Function::ACTION_FUNCTION func = [action = std::make_shared<NativeAction>(function)](Event& event, sol::state& lua){
+            action->invoke(event, lua);
+        };
+        return std::make_shared<NativeAction::Function>(name.c_str(), func);
+    };
+
+    lua.script(chain_script);
+
+    struct Case{
+        const char* name;
+        const char* variable;
+    };
+    Case cases[] = {
+        {"nested filters", "nested_chain"},
+        {"compiled pipeline", "compiled_chain"},
+    };
+
+    std::cout << options.events << " events" << std::endl;
+    std::optional<Sink> baseline;
+    auto failed = 0;
+    for (const auto& item : cases){
+        std::shared_ptr<NativeAction::Function> chain = lua[item.variable];
+        sink = {};
+        auto start = bench_clock::now();
+        for (auto i = 0; i < options.events; i++){
+            // triangle wave which sweeps the whole range of the axis
+            auto phase = i % 2046;
+            Event event(1, static_cast<int64_t>(phase < 1023 ? phase : 2046 - phase));
+            chain->invoke(event, lua);
+        }
+        auto elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+        std::cout << item.name << std::endl;
+        std::cout << std::fixed << std::setprecision(0);
+        std::cout << "    throughput     : " << options.events / elapsed << " events/sec" << std::endl;
+        std::cout << std::setprecision(1);
+        std::cout << "    latency        : " << elapsed * 1e9 / options.events << " ns/event" << std::endl;
+        std::cout << "    sink           : " << sink.events << " events, sum of values: " << sink.sum << std::endl;
+        if (!baseline){
+            baseline = sink;
+        }else if (baseline->events != sink.events || baseline->sum != sink.sum){
+            std::cout << "    FAILED: output differs from the nested filters" << std::endl;
+            failed++;
+        }
+    }
+    return failed;
+}
+
+int main(int argc, char** argv){
+    std::string mode = argc > 1 ? argv[1] : "";
+    BenchOptions options;
+    auto is_valid = false;
+    if (mode == "chain"){
+        is_valid = options.parse(argc - 2, argv + 2);
+    }
+    if (!is_valid){
+        std::cerr << "usage: " << argv[0] << " chain [--events N]" << std::endl;
+        return 1;
+    }
+
+    return run_chain(options) ? 1 : 0;
+}
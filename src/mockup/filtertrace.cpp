@@ -0,0 +1,373 @@
+//
+// filtertrace.cpp
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+//  event count reduction by signal conditioning filters on an event trace
+//  usage: filtertrace reduce trace-path [--event NAME]
+//         filtertrace record trace-path [--seconds N]
+//
+//  reduce: Values of an axis event in a trace recorded by the option MOPT_EVENT_TRACE_FILE
+//          are sent to the state machines of filter.smooth, filter.deadband and
+//          filter.rate_limit with the recorded timing, and the number of events which reach
+//          the downstream action is counted for each filter. Filters drop events in the same
+//          manner as the filter pipeline. If no event name is specified, the event recorded
+//          most is used.
+//  record: An axis trace of a load cell pedal is synthesized and recorded in real time at
+//          500 Hz. Pedal operations are ramps and holds with sensor noise.
+//          (default: 20 seconds)
+//
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <memory>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <optional>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include "eventtrace.h"
+#include "signalfilter.h"
+
+using CLOCK = std::chrono::steady_clock;
+using MILLISEC = std::chrono::milliseconds;
+
+//============================================================================================
+// Filter stages
+//    Each stage sends output values to the next stage. A value of integer event is rounded
+//    when it's sent as the filter pipeline does.
+//============================================================================================
+class Stage{
+protected:
+    Stage* next = nullptr;
+    uint64_t sent = 0;
+
+public:
+    virtual ~Stage() = default;
+
+    void connect(Stage* next){this->next = next;}
+    uint64_t getSent() const{return sent;}
+
+    virtual void input(double value, bool is_int, CLOCK::time_point now) = 0;
+
+    // deferred outputs until the time are sent
+    virtual void advance(CLOCK::time_point now){
+        if (next){
+            next->advance(now);
+        }
+    }
+
+protected:
+    void send(double value, bool is_int, CLOCK::time_point now){
+        sent++;
+        if (next){
+            next->input(is_int ? static_cast<double>(std::llround(value)) : value, is_int, now);
+        }
+    }
+
+    static double rounded(double value, bool is_int){
+        return is_int ? std::round(value) : value;
+    }
+};
+
+class SinkStage : public Stage{
+public:
+    double last = 0.;
+
+    void input(double value, bool is_int, CLOCK::time_point now) override{
+        last = value;
+        send(value, is_int, now);
+    }
+};
+
+class SmoothStage : public Stage{
+protected:
+    SignalSmoother smoother;
+    SignalOutput output;
+    bool is_one_euro;
+
+public:
+    SmoothStage(double alpha) : is_one_euro(false){
+        smoother.alpha = alpha;
+    }
+    SmoothStage(double min_cutoff, double beta, double d_cutoff) : is_one_euro(true){
+        smoother.min_cutoff = min_cutoff;
+        smoother.beta = beta;
+        smoother.d_cutoff = d_cutoff;
+    }
+
+    void input(double value, bool is_int, CLOCK::time_point now) override{
+        auto result = is_one_euro ? smoother.one_euro(value, now) : smoother.ema(value);
+        if (output.update(rounded(result, is_int))){
+            send(result, is_int, now);
+        }
+    }
+};
+
+class DeadbandStage : public Stage{
+protected:
+    SignalDeadband deadband;
+    SignalOutput output;
+
+public:
+    DeadbandStage(double center, double width, double hysteresis){
+        deadband.center = center;
+        deadband.width = width;
+        deadband.hysteresis = hysteresis;
+    }
+
+    void input(double value, bool is_int, CLOCK::time_point now) override{
+        auto result = deadband.apply(value);
+        if (output.update(rounded(result, is_int))){
+            send(result, is_int, now);
+        }
+    }
+};
+
+class RateLimitStage : public Stage{
+protected:
+    SignalRateLimiter limiter;
+    double pending = 0.;
+    bool pending_is_int = false;
+    std::optional<CLOCK::time_point> trailing_time;
+
+public:
+    RateLimitStage(MILLISEC interval) : limiter(interval){}
+
+    void input(double value, bool is_int, CLOCK::time_point now) override{
+        auto decision = limiter.offer(value, now);
+        if (decision == SignalRateLimiter::Decision::send){
+            send(value, is_int, now);
+        }else if (decision == SignalRateLimiter::Decision::defer){
+            pending = value;
+            pending_is_int = is_int;
+            if (auto delay = limiter.schedule(now)){
+                // deferred actions are scheduled in milliseconds
+                trailing_time = now + std::chrono::ceil<MILLISEC>(*delay);
+            }
+        }
+    }
+
+    void advance(CLOCK::time_point now) override{
+        if (trailing_time && *trailing_time <= now){
+            auto time = *trailing_time;
+            trailing_time.reset();
+            if (limiter.expire(pending, time)){
+                send(pending, pending_is_int, time);
+            }
+        }
+        Stage::advance(now);
+    }
+};
+
+//============================================================================================
+// Event count reduction
+//============================================================================================
+struct Sample{
+    CLOCK::time_point time;
+    double value;
+    bool is_int;
+};
+
+class Filter{
+protected:
+    std::string name;
+    std::vector<std::unique_ptr<Stage>> stages;
+    SinkStage sink;
+
+public:
+    Filter(const char* name) : name(name){}
+
+    Filter& add(std::unique_ptr<Stage>&& stage){
+        if (!stages.empty()){
+            stages.back()->connect(stage.get());
+        }
+        stages.push_back(std::move(stage));
+        stages.back()->connect(&sink);
+        return *this;
+    }
+
+    void run(const std::vector<Sample>& samples, std::ostream& os){
+        // difference between the input and the latest value received by the downstream
+        double total_error = 0.;
+        double max_error = 0.;
+        for (const auto& sample : samples){
+            stages.front()->advance(sample.time);
+            stages.front()->input(sample.value, sample.is_int, sample.time);
+            auto error = std::abs(sample.value - sink.last);
+            total_error += error;
+            max_error = std::max(max_error, error);
+        }
+        stages.front()->advance(CLOCK::time_point::max());
+
+        auto received = sink.getSent();
+        os << name << std::endl;
+        os << "    events         : " << received << " in " << samples.size() << " ("
+           << std::fixed << std::setprecision(1) << 100. * (samples.size() - received) / samples.size()
+           << "% reduced)" << std::endl;
+        os << "    deviation      : mean " << total_error / samples.size() << ", max " << max_error << std::endl;
+    }
+};
+
+static std::optional<std::vector<Sample>> load_samples(const char* path, const char* event_name){
+    eventtrace::Reader reader(path);
+    std::unordered_map<uint64_t, std::string> names;
+    std::unordered_map<uint64_t, size_t> counts;
+    while (auto record = reader.next()){
+        if (record->kind == eventtrace::RecordKind::name_definition){
+            names[record->evid] = record->name();
+        }else if (record->value_type == eventtrace::ValueType::int_value ||
+                  record->value_type == eventtrace::ValueType::double_value){
+            counts[record->evid]++;
+        }
+    }
+
+    std::optional<uint64_t> evid;
+    for (const auto& [id, count] : counts){
+        if (event_name ? names[id] == event_name : (!evid || count > counts[*evid])){
+            evid = id;
+        }
+    }
+    if (!evid){
+        return std::nullopt;
+    }
+    std::cout << "event: " << names[*evid] << std::endl;
+
+    std::vector<Sample> samples;
+    auto origin = CLOCK::now();
+    reader.rewind();
+    while (auto record = reader.next()){
+        if (record->kind == eventtrace::RecordKind::event && record->evid == *evid &&
+            (record->value_type == eventtrace::ValueType::int_value ||
+             record->value_type == eventtrace::ValueType::double_value)){
+            auto event = record->make_event(*evid);
+            samples.push_back({origin + std::chrono::nanoseconds(record->timestamp), event.getAs<double>(),
+                               record->value_type == eventtrace::ValueType::int_value});
+        }
+    }
+    return samples;
+}
+
+static int run_reduce(const char* path, const char* event_name){
+    auto samples = load_samples(path, event_name);
+    if (!samples || samples->empty()){
+        std::cerr << "no numerical event is found in the trace" << std::endl;
+        return 1;
+    }
+    auto duration = std::chrono::duration<double>(samples->back().time - samples->front().time).count();
+    std::cout << samples->size() << " events in " << std::fixed << std::setprecision(1) << duration << " sec" << std::endl;
+
+    std::vector<std::unique_ptr<Filter>> filters;
+    auto add = [&filters](const char* name){
+        filters.push_back(std::make_unique<Filter>(name));
+        return filters.back().get();
+    };
+    add("filter.smooth {method = 'ema', alpha = 0.2}")->add(std::make_unique<SmoothStage>(0.2));
+    add("filter.smooth {method = 'one_euro', min_cutoff = 1, beta = 0.001}")->add(std::make_unique<SmoothStage>(1., 0.001, 1.));
+    add("filter.deadband {width = 300, hysteresis = 100}")->add(std::make_unique<DeadbandStage>(0., 300., 100.));
+    add("filter.rate_limit {interval = 20}")->add(std::make_unique<RateLimitStage>(MILLISEC(20)));
+    add("deadband -> one_euro -> rate_limit")
+        ->add(std::make_unique<DeadbandStage>(0., 300., 100.))
+        .add(std::make_unique<SmoothStage>(1., 0.001, 1.))
+        .add(std::make_unique<RateLimitStage>(MILLISEC(20)));
+    for (auto& filter : filters){
+        filter->run(*samples, std::cout);
+    }
+    return 0;
+}
+
+//============================================================================================
+// Synthesized load cell pedal
+//============================================================================================
+static int run_record(const char* path, int seconds){
+    constexpr auto RATE = 500;
+    constexpr double RANGE = 65535.;
+    std::mt19937 random(1);
+    std::normal_distribution<double> noise(0., 40.);
+    std::uniform_real_distribution<double> uniform(0., 1.);
+
+    // pedal operations as a list of segments which move the force to the target in the duration
+    struct Segment{
+        double duration;
+        double target;
+    };
+    std::vector<Segment> segments;
+    for (double total = 0.; total < seconds;){
+        Segment segments_of_press[] = {
+            {0.5 + uniform(random) * 1.5, 0.},
+            {0.1 + uniform(random) * 0.4, 0.2 + uniform(random) * 0.7},
+            {0.5 + uniform(random) * 2., -1.},
+            {0.1 + uniform(random) * 0.3, 0.},
+        };
+        for (const auto& segment : segments_of_press){
+            segments.push_back(segment);
+            total += segment.duration;
+        }
+    }
+
+    eventtrace::Writer writer(path);
+    constexpr uint64_t EVID = 1;
+    writer.define_name(EVID, "pedal:brake");
+    auto start = CLOCK::now();
+    double force = 0.;
+    double from = 0.;
+    double elapsed_in_segment = 0.;
+    size_t index = 0;
+    for (auto i = 0; i < seconds * RATE; i++){
+        std::this_thread::sleep_until(start + std::chrono::microseconds(i * 1000000 / RATE));
+        const auto& segment = segments[index];
+        if (segment.target >= 0.){
+            force = from + (segment.target - from) * std::min(elapsed_in_segment / segment.duration, 1.);
+        }
+        elapsed_in_segment += 1. / RATE;
+        if (elapsed_in_segment >= segment.duration && index + 1 < segments.size()){
+            from = force;
+            elapsed_in_segment = 0.;
+            index++;
+        }
+        // a load cell at rest still reports a small offset with noise
+        auto value = std::clamp(std::llround(force * RANGE + 150. + noise(random)), 0ll, static_cast<long long>(RANGE));
+        writer.record(Event(EVID, static_cast<int64_t>(value)));
+    }
+    std::cout << seconds * RATE << " events are recorded to " << path << std::endl;
+    return 0;
+}
+
+//============================================================================================
+// Entry point
+//============================================================================================
+int main(int argc, char** argv){
+    std::string mode = argc > 1 ? argv[1] : "";
+    const char* path = argc > 2 ? argv[2] : nullptr;
+    const char* event_name = nullptr;
+    auto seconds = 20;
+    auto is_valid = (mode == "reduce" || mode == "record") && path;
+    for (auto i = 3; is_valid && i < argc; i += 2){
+        std::string option{argv[i]};
+        if (i + 1 >= argc){
+            is_valid = false;
+        }else if (mode == "reduce" && option == "--event"){
+            event_name = argv[i + 1];
+        }else if (mode == "record" && option == "--seconds" && std::atoi(argv[i + 1]) > 0){
+            seconds = std::atoi(argv[i + 1]);
+        }else{
+            is_valid = false;
+        }
+    }
+    if (!is_valid){
+        std::cerr << "usage: " << argv[0] << " reduce trace-path [--event NAME]" << std::endl;
+        std::cerr << "       " << argv[0] << " record trace-path [--seconds N]" << std::endl;
+        return 1;
+    }
+
+    try{
+        return mode == "reduce" ? run_reduce(path, event_name) : run_record(path, seconds);
+    }catch (const std::exception& e){
+        std::cerr << e.what() << std::endl;
+    }
+    return 1;
+}
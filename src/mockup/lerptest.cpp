@@ -0,0 +1,360 @@
+//
+// lerptest.cpp
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+//  tests and microbenchmark of the piecewise linear function used by filter.lerp
+//  usage: lerptest test [--rounds N] [--seed N]
+//         lerptest bench [--points N] [--samples N]
+//
+//  test:  Translation of fixed rules, rejection of invalid rules and detection of equally
+//         spaced breakpoints are checked. Then random rules are translated at random points,
+//         on breakpoints and out of the range of breakpoints, and results are compared with
+//         the linear scan which filter.lerp used before. Results of the batch translation
+//         are compared with the single translation. (default: 2000 rounds)
+//  bench: Response curves are translated at random points by the former linear scan, by
+//         the binary search, by the direct index for equally spaced breakpoints, and by the
+//         batch translation. If the number of breakpoints is not specified, curves with 16,
+//         64 and 256 points are measured. (default: 1000000 samples)
+//
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include <type_traits>
+#include <stdexcept>
+#include <cmath>
+#include <cstdlib>
+#include "interpolation.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+template <typename T> using Breakpoints = std::vector<typename PiecewiseLinear<T>::Breakpoint>;
+
+//============================================================================================
+// Test driver
+//============================================================================================
+class Checker{
+protected:
+    int failed = 0;
+    int passed = 0;
+    int reported = 0;
+
+public:
+    void check(bool condition, const std::string& description){
+        if (condition){
+            passed++;
+        }else{
+            failed++;
+            // a broken implementation fails on many inputs, so only the first ones are shown
+            if (reported++ < 10){
+                std::cout << "    FAILED: " << description << std::endl;
+            }
+        }
+    }
+
+    int result(){
+        std::cout << "    " << passed << " passed, " << failed << " failed" << std::endl;
+        return failed;
+    }
+};
+
+//============================================================================================
+// Reference implementation
+//    This is the translation which filter.lerp used before. Breakpoints are scanned linearly
+//    and parameters of the segment are computed for each translation.
+//============================================================================================
+template <typename T>
+static T reference_translate(const Breakpoints<T>& points, T value){
+    size_t i = 0;
+    for (; i < points.size(); i++){
+        if (points[i].in >= value){
+            break;
+        }
+    }
+    size_t a = i == 0 ? 0 : (i == points.size() ? i - 2 : i - 1);
+    auto& p0 = points[a];
+    auto& p1 = points[a + 1];
+    return (value - p0.in) * (p1.out - p0.out) / (p1.in - p0.in) + p0.out;
+}
+
+template <typename T>
+static bool is_close(T expected, T actual){
+    if constexpr (std::is_integral_v<T>){
+        return expected == actual;
+    }else{
+        return std::abs(expected - actual) <= 1e-9 * std::max<T>(1., std::abs(expected));
+    }
+}
+
+template <typename T>
+static std::string describe(const Breakpoints<T>& points, T value, T expected, T actual){
+    std::ostringstream os;
+    os << points.size() << " points";
+    if (points.size() <= 8){
+        os << " {";
+        for (const auto& point : points){
+            os << "{" << point.in << ", " << point.out << "}";
+        }
+        os << "}";
+    }
+    os << ", f(" << value << ") must be " << expected << " but " << actual;
+    return os.str();
+}
+
+//============================================================================================
+// Test cases
+//============================================================================================
+static void test_fixed_rules(Checker& checker){
+    std::cout << "fixed rules" << std::endl;
+
+    Breakpoints<int64_t> line{{0, 0}, {100, 1000}};
+    PiecewiseLinear<int64_t> f_line{line};
+    checker.check(f_line(50) == 500, "interpolated in a segment");
+    checker.check(f_line(100) == 1000, "translated on a breakpoint");
+    checker.check(f_line(-10) == -100, "extrapolated below the first breakpoint");
+    checker.check(f_line(150) == 1500, "extrapolated above the last breakpoint");
+
+    Breakpoints<int64_t> peak{{0, 0}, {10, 100}, {20, 0}};
+    PiecewiseLinear<int64_t> f_peak{peak};
+    checker.check(f_peak(15) == 50, "interpolated in a segment with negative slope");
+    checker.check(f_peak(25) == -50, "extrapolated by the last segment with negative slope");
+
+    // integers are divided after multiplication and truncated toward zero as before
+    Breakpoints<int64_t> step{{0, 0}, {3, 1}};
+    PiecewiseLinear<int64_t> f_step{step};
+    checker.check(f_step(2) == 0 && f_step(5) == 1 && f_step(-2) == 0, "integer result is truncated toward zero");
+
+    Breakpoints<double> curve{{0., 0.}, {0.5, 0.25}, {1., 1.}};
+    PiecewiseLinear<double> f_curve{curve};
+    checker.check(is_close(f_curve(0.25), 0.125), "floating point value is interpolated");
+    checker.check(is_close(f_curve(0.75), 0.625), "floating point value is interpolated in the last segment");
+    checker.check(is_close(f_curve(2.), 2.5), "floating point value is extrapolated");
+}
+
+static void test_invalid_rules(Checker& checker){
+    std::cout << "invalid rules" << std::endl;
+    auto is_rejected = [](const Breakpoints<double>& points){
+        try{
+            PiecewiseLinear<double> f{points};
+            return false;
+        }catch (const std::runtime_error&){
+            return true;
+        }
+    };
+    checker.check(is_rejected({}), "a rule without breakpoints is rejected");
+    checker.check(is_rejected({{0., 0.}}), "a rule with only one breakpoint is rejected");
+    checker.check(is_rejected({{0., 0.}, {0., 1.}}), "breakpoints with same input are rejected");
+    checker.check(is_rejected({{0., 0.}, {2., 1.}, {1., 2.}}), "decreasing breakpoints are rejected");
+    checker.check(!is_rejected({{0., 0.}, {1., 1.}}), "a rule with two breakpoints is accepted");
+}
+
+static void test_uniformity(Checker& checker){
+    std::cout << "equally spaced breakpoints" << std::endl;
+    Breakpoints<int64_t> int_points;
+    for (int64_t i = 0; i < 64; i++){
+        int_points.push_back({i * 16 - 512, i * i});
+    }
+    checker.check(PiecewiseLinear<int64_t>{int_points}.uniform(), "equally spaced integer breakpoints are detected");
+    int_points[10].in++;
+    checker.check(!PiecewiseLinear<int64_t>{int_points}.uniform(), "unequally spaced integer breakpoints are detected");
+
+    // 0.1 is not represented exactly, so breakpoints are not exactly equally spaced
+    Breakpoints<double> double_points;
+    for (auto i = 0; i <= 10; i++){
+        double_points.push_back({i * 0.1, i * 0.3});
+    }
+    checker.check(PiecewiseLinear<double>{double_points}.uniform(), "equally spaced floating point breakpoints are detected");
+    double_points[5].in += 0.01;
+    checker.check(!PiecewiseLinear<double>{double_points}.uniform(), "unequally spaced floating point breakpoints are detected");
+}
+
+template <typename T>
+static void test_random_rule(Checker& checker, std::mt19937& random, size_t num, bool is_uniform){
+    Breakpoints<T> points;
+    T in = static_cast<T>(static_cast<int>(random() % 2001) - 1000);
+    for (size_t i = 0; i < num; i++){
+        auto out = static_cast<T>(static_cast<int>(random() % 20001) - 10000);
+        if constexpr (!std::is_integral_v<T>){
+            out += static_cast<T>(random() % 1000) / 1000;
+        }
+        points.push_back({in, out});
+        // the first step differs from the others so that breakpoints are never equally spaced by chance
+        in += is_uniform ? 10 : static_cast<T>(i == 0 ? 21 : 1 + random() % 20);
+    }
+    PiecewiseLinear<T> f{points};
+    if (num > 2){
+        checker.check(f.uniform() == is_uniform, std::to_string(num) + " breakpoints must be detected as " +
+                                                 (is_uniform ? "" : "not ") + "equally spaced");
+    }
+
+    std::vector<T> values;
+    auto first = points.front().in;
+    auto last = points.back().in;
+    for (const auto& point : points){
+        values.push_back(point.in);
+    }
+    for (auto i = 0; i < 64; i++){
+        auto value = first - (last - first) / 4 + static_cast<T>(random() % static_cast<uint64_t>((last - first) * 3 / 2 + 1));
+        if constexpr (!std::is_integral_v<T>){
+            value += static_cast<T>(random() % 1000) / 1000;
+        }
+        values.push_back(value);
+    }
+
+    for (auto value : values){
+        auto expected = reference_translate(points, value);
+        auto actual = f(value);
+        checker.check(is_close(expected, actual), describe(points, value, expected, actual));
+    }
+
+    std::vector<T> results(values.size());
+    f(values.data(), results.data(), values.size());
+    for (size_t i = 0; i < values.size(); i++){
+        checker.check(results[i] == f(values[i]), "batch translation: " + describe(points, values[i], f(values[i]), results[i]));
+    }
+}
+
+static int run_test(int rounds, int seed){
+    Checker checker;
+    test_fixed_rules(checker);
+    test_invalid_rules(checker);
+    test_uniformity(checker);
+
+    std::cout << "random rules" << std::endl;
+    std::mt19937 random(seed);
+    static const size_t sizes[] = {2, 3, 4, 5, 8, 16, 64, 128, 256};
+    for (auto round = 0; round < rounds; round++){
+        auto num = sizes[random() % std::size(sizes)];
+        auto is_uniform = random() % 2 == 0;
+        if (random() % 2){
+            test_random_rule<int64_t>(checker, random, num, is_uniform);
+        }else{
+            test_random_rule<double>(checker, random, num, is_uniform);
+        }
+    }
+    return checker.result() ? 1 : 0;
+}
+
+//============================================================================================
+// Microbenchmark
+//============================================================================================
+template <typename T>
+static Breakpoints<T> make_curve(size_t num, bool is_uniform){
+    // response curve of an axis whose range is about 0 - 65535,
+    // the range is rounded so that integer breakpoints can be equally spaced
+    auto range = static_cast<double>(65535 / (num - 1) * (num - 1));
+    Breakpoints<T> points;
+    for (size_t i = 0; i < num; i++){
+        auto position = static_cast<double>(i) / (num - 1);
+        if (!is_uniform && i > 0 && i < num - 1){
+            position += (i % 3 == 1 ? 0.2 : -0.2) / (num - 1);
+        }
+        points.push_back({static_cast<T>(std::round(position * range)), static_cast<T>(std::pow(position, 1.8) * range)});
+    }
+    return points;
+}
+
+template <typename T>
+static void print_result(const char* title, double elapsed, size_t samples, T checksum){
+    std::cout << "    " << std::left << std::setw(15) << title << ": " << std::right
+              << std::fixed << std::setprecision(2) << elapsed * 1e9 / samples << " ns/sample"
+              << "  (checksum: " << std::setprecision(0) << static_cast<double>(checksum) << ")" << std::endl;
+}
+
+template <typename T>
+static void bench_curve(size_t num, const std::vector<T>& samples){
+    std::cout << num << " points, " << (std::is_integral_v<T> ? "integer" : "floating point") << std::endl;
+    std::vector<T> results(samples.size());
+
+    // results are summed so that translations are not removed by the optimizer
+    auto measure = [&](const char* title, auto&& translate){
+        auto start = bench_clock::now();
+        T checksum = 0;
+        for (auto value : samples){
+            checksum += translate(value);
+        }
+        print_result(title, std::chrono::duration<double>(bench_clock::now() - start).count(), samples.size(), checksum);
+    };
+    auto measure_batch = [&](const char* title, const PiecewiseLinear<T>& f){
+        auto start = bench_clock::now();
+        f(samples.data(), results.data(), samples.size());
+        T checksum = 0;
+        for (auto value : results){
+            checksum += value;
+        }
+        print_result(title, std::chrono::duration<double>(bench_clock::now() - start).count(), samples.size(), checksum);
+    };
+
+    auto irregular = make_curve<T>(num, false);
+    auto regular = make_curve<T>(num, true);
+    PiecewiseLinear<T> f_irregular{irregular};
+    PiecewiseLinear<T> f_regular{regular};
+    measure("linear scan", [&](T value){return reference_translate(irregular, value);});
+    measure("binary search", [&](T value){return f_irregular(value);});
+    measure_batch("batch search", f_irregular);
+    if (f_regular.uniform()){
+        measure("direct index", [&](T value){return f_regular(value);});
+        measure_batch("batch index", f_regular);
+    }
+}
+
+static int run_bench(int points, int num_samples){
+    std::mt19937 random(1);
+    std::vector<int64_t> int_samples(num_samples);
+    std::vector<double> double_samples(num_samples);
+    for (auto i = 0; i < num_samples; i++){
+        int_samples[i] = random() % 65536;
+        double_samples[i] = static_cast<double>(random() % 65536000) / 1000;
+    }
+    std::vector<int> sizes;
+    if (points > 0){
+        sizes.push_back(points);
+    }else{
+        sizes = {16, 64, 256};
+    }
+    std::cout << num_samples << " samples" << std::endl;
+    for (auto num : sizes){
+        bench_curve<int64_t>(num, int_samples);
+        bench_curve<double>(num, double_samples);
+    }
+    return 0;
+}
+
+//============================================================================================
+// Entry point
+//============================================================================================
+int main(int argc, char** argv){
+    std::string mode = argc > 1 ? argv[1] : "";
+    auto rounds = 2000;
+    auto seed = 1;
+    auto points = 0;
+    auto samples = 1000000;
+    auto is_valid = mode == "test" || mode == "bench";
+    for (auto i = 2; is_valid && i < argc; i += 2){
+        std::string option{argv[i]};
+        auto value = i + 1 < argc ? std::atoi(argv[i + 1]) : 0;
+        if (mode == "test" && option == "--rounds" && value > 0){
+            rounds = value;
+        }else if (mode == "test" && option == "--seed" && i + 1 < argc){
+            seed = value;
+        }else if (mode == "bench" && option == "--points" && value >= 2){
+            points = value;
+        }else if (mode == "bench" && option == "--samples" && value > 0){
+            samples = value;
+        }else{
+            is_valid = false;
+        }
+    }
+    if (!is_valid){
+        std::cerr << "usage: " << argv[0] << " test [--rounds N] [--seed N]" << std::endl;
+        std::cerr << "       " << argv[0] << " bench [--points N] [--samples N]" << std::endl;
+        return 1;
+    }
+
+    return mode == "test" ? run_test(rounds, seed) : run_bench(points, samples);
+}
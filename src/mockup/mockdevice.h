@@ -0,0 +1,175 @@
+//
+// mockdevice.h
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+//  in-process device plugin for headless benchmarks and tests of devices and device modifiers
+//    MockDeviceHost opens devices of the plugin "mock" without running a script. Units of a
+//    device are given when it is opened, and unit values are raised through the plugin API
+//    as a real plugin does. Events sent by device modifiers are taken from the event queue
+//    of the engine instead of being dispatched to actions.
+//
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <optional>
+#include <thread>
+#include <chrono>
+#include <sol/sol.hpp>
+#include "engine.h"
+#include "device.h"
+#include "mapperplugin.h"
+
+//============================================================================================
+// Engine whose event queue is drained by a host
+//============================================================================================
+class MockEngine : public MapperEngine{
+public:
+    MockEngine() : MapperEngine([](MAPPER_EVENT, int64_t){}, [](MCONSOLE_MESSAGE_TYPE, const std::string&){}){}
+
+    std::optional<Event> receiveEvent(){
+        return event.queue.pop();
+    }
+};
+
+//============================================================================================
+// Device plugin "mock"
+//    Unit definitions are passed through the context of the device plugin, and the handles
+//    to raise unit values are captured when the device starts.
+//============================================================================================
+class MockDevice{
+protected:
+    std::vector<std::string> unit_names;
+    std::vector<FSMDEVUNITDEF> units;
+    FSMAPPER_HANDLE mapper = nullptr;
+    FSMDEVICE handle = nullptr;
+    std::shared_ptr<Device> device;
+
+    friend class MockDeviceHost;
+
+public:
+    struct Unit{
+        std::string name;
+        FSMDEVUNIT_VALTYPE type;
+        int min_value;
+        int max_value;
+    };
+
+    explicit MockDevice(const std::vector<Unit>& units){
+        unit_names.reserve(units.size());
+        for (const auto& unit : units){
+            unit_names.push_back(unit.name);
+            this->units.push_back({nullptr, FSMDU_DIR_INPUT, unit.type, unit.max_value, unit.min_value});
+        }
+        for (size_t i = 0; i < this->units.size(); i++){
+            this->units[i].name = unit_names[i].c_str();
+        }
+    }
+
+    size_t getUnitNum() const{return units.size();}
+
+    void raise(int index, int value){
+        fsmapper_raiseEvent(mapper, handle, index, value);
+    }
+
+    void raise(const FSMDEVUNITVALUE* values, size_t num){
+        fsmapper_raiseEvents(mapper, handle, values, num);
+    }
+
+    void close(){
+        if (device){
+            device->close();
+            device = nullptr;
+        }
+    }
+
+    static const MAPPER_PLUGIN_DEVICE_OPS_V2* getPluginOps(){
+        static MAPPER_PLUGIN_DEVICE_OPS_V2 ops = {
+            MAPPER_PLUGIN_DEVICE_OPS_VERSION_2,
+            "mock",
+            "Mock device for benchmarks and tests",
+            [](FSMAPPER_HANDLE mapper){return true;},
+            [](FSMAPPER_HANDLE mapper){return true;},
+            [](FSMAPPER_HANDLE mapper, FSMDEVICE device, LUAVALUE identifier, LUAVALUE options){
+                fsmapper_setContextForDevice(mapper, device, opening);
+                return true;
+            },
+            [](FSMAPPER_HANDLE mapper, FSMDEVICE device){
+                auto self = context(mapper, device);
+                self->mapper = mapper;
+                self->handle = device;
+                return true;
+            },
+            [](FSMAPPER_HANDLE mapper, FSMDEVICE device){return true;},
+            [](FSMAPPER_HANDLE mapper, FSMDEVICE device){
+                return context(mapper, device)->units.size();
+            },
+            [](FSMAPPER_HANDLE mapper, FSMDEVICE device, size_t index, FSMDEVUNITDEF* def){
+                *def = context(mapper, device)->units.at(index);
+                return true;
+            },
+            [](FSMAPPER_HANDLE mapper, FSMDEVICE device, const FSMDEVUNITVALUE* value){return true;},
+        };
+        return &ops;
+    }
+
+protected:
+    // the device being opened, plugin operations are called on the thread opening a device
+    static inline thread_local MockDevice* opening = nullptr;
+
+    static MockDevice* context(FSMAPPER_HANDLE mapper, FSMDEVICE device){
+        return reinterpret_cast<MockDevice*>(fsmapper_getContextForDevice(mapper, device));
+    }
+};
+
+//============================================================================================
+// Host of mock devices
+//============================================================================================
+class MockDeviceHost{
+protected:
+    sol::state lua;
+    MockEngine engine;
+    DeviceManager device_manager{engine};
+    DeviceModifierManager modifier_manager{engine};
+    DeviceClass device_class{engine, device_manager, PluginDeviceOps{*MockDevice::getPluginOps()}};
+
+public:
+    MockDeviceHost(){
+        lua.open_libraries(sol::lib::base);
+    }
+
+    MapperEngine& getEngine(){return engine;}
+
+    // modifiers is a Lua expression as same as "modifiers" parameter of mapper.device()
+    void open(MockDevice& device, const char* name, const char* modifiers){
+        sol::object definition = lua.script(std::string("return ") + (modifiers ? modifiers : "nil"));
+        DeviceModifierRule rule;
+        modifier_manager.makeRule(definition, rule);
+        std::string device_name{name};
+        MockDevice::opening = &device;
+        device.device = std::make_shared<Device>(engine, device_class, device_name, rule, sol::object(), sol::object());
+        MockDevice::opening = nullptr;
+    }
+
+    std::optional<Event> receiveEvent(){
+        return engine.receiveEvent();
+    }
+
+    // events are collected until no event is sent for the quiet period
+    std::vector<std::string> receiveEventNames(std::chrono::milliseconds quiet = std::chrono::milliseconds(50)){
+        std::vector<std::string> names;
+        auto deadline = std::chrono::steady_clock::now() + quiet;
+        while (std::chrono::steady_clock::now() < deadline){
+            if (auto ev = engine.receiveEvent()){
+                auto name = engine.getEventName(ev->getId());
+                names.push_back(name ? name : "");
+                deadline = std::chrono::steady_clock::now() + quiet;
+            }else{
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        return names;
+    }
+};
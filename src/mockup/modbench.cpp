@@ -0,0 +1,248 @@
+//
+// modbench.cpp
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+//  benchmark of device modifier processing
+//  usage: modbench jitter [options]
+//  options:
+//      --workers N       number of modifier worker threads (default: 1)
+//      --rate N          events per second sent by a flooding encoder (default: 20000)
+//      --cost N          processing time of an encoder event in microseconds (default: 30)
+//      --burst N         encoder events are sent in a burst every N milliseconds (default: 10)
+//      --interval N      long press and double click interval in milliseconds (default: 20)
+//      --trials N        number of button operations (default: 200)
+//
+//  jitter: A button modifier detecting long press and double click shares a worker with an
+//          encoder flooding events. Button operations alternate between a short hold and a
+//          long hold, and each timing observed by the modifier is compared with the timing
+//          of the operation.
+//
+
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+#include "engine.h"
+#include "devicemodifier.h"
+
+using MICROSEC = std::chrono::microseconds;
+
+struct BenchOptions{
+    int workers = 1;
+    int rate = 20000;
+    int cost = 30;
+    int burst = 10;
+    int interval = 20;
+    int trials = 200;
+
+    bool parse(int argc, char** argv){
+        for (auto i = 0; i < argc; i++){
+            std::string option{argv[i]};
+            if (i + 1 >= argc){
+                return false;
+            }
+            auto value = std::atoi(argv[++i]);
+            if (option == "--workers"){
+                workers = value;
+            }else if (option == "--rate"){
+                rate = value;
+            }else if (option == "--cost"){
+                cost = value;
+            }else if (option == "--burst"){
+                burst = std::max(value, 1);
+            }else if (option == "--interval"){
+                interval = std::max(value, 1);
+            }else if (option == "--trials"){
+                trials = value;
+            }else{
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+static double to_ms(DEVICEMOD_CLOCK::duration duration){
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+//============================================================================================
+// Modifiers to measure the worker
+//    Unit values are delegated to the worker as real modifiers do, and the modifiers record
+//    what they observe instead of sending events to the engine.
+//============================================================================================
+class ProbeModifier : public DeviceModifier{
+public:
+    ProbeModifier(DeviceModifierManager& manager) : DeviceModifier(manager){};
+
+    virtual std::shared_ptr<DeviceModifier> makeInstanceFitsToUnit(
+        const char* devname, const FSMDEVUNITDEF& unit, DeviceModifierEventRegistry& registry) const{return nullptr;}
+    virtual size_t getEventNum() const{return 0;}
+    virtual Event getEvent(size_t index) const{return {0, nullptr};}
+    virtual void processUnitValueChangeEvent(int value){
+        manager.delegateEventProcessing(*this, value);
+    }
+};
+
+class EncoderProbe : public ProbeModifier{
+protected:
+    MICROSEC cost;
+
+public:
+    EncoderProbe(DeviceModifierManager& manager, int cost) : ProbeModifier(manager), cost(cost){};
+
+    virtual void processUnitValueChangeEvent(int value, DEVICEMOD_TIME now){
+        auto until = DEVICEMOD_CLOCK::now() + cost;
+        while (DEVICEMOD_CLOCK::now() < until);
+    }
+};
+
+class ButtonProbe : public ProbeModifier{
+protected:
+    DEVICEMOD_CLOCK::duration interval;
+    std::optional<DEVICEMOD_TIMER> timer;
+    DEVICEMOD_TIME pressed_at;
+    std::optional<DEVICEMOD_TIME> clicked_at;
+
+public:
+    std::vector<DEVICEMOD_TIME> observed;
+    std::vector<bool> long_pressed;
+    std::vector<bool> double_clicked;
+    std::vector<double> timer_lateness;
+
+    ButtonProbe(DeviceModifierManager& manager, int interval) :
+        ProbeModifier(manager), interval(std::chrono::milliseconds(interval)){};
+
+    virtual void processUnitValueChangeEvent(int value, DEVICEMOD_TIME now){
+        observed.push_back(now);
+        if (value){
+            pressed_at = now;
+            double_clicked.push_back(clicked_at && now - *clicked_at < interval);
+            timer = manager.addTimer(*this, now + interval);
+        }else if (timer){
+            manager.cancelTimer(*timer);
+            timer = std::nullopt;
+            long_pressed.push_back(false);
+            clicked_at = now;
+        }else{
+            clicked_at = std::nullopt;
+        }
+    }
+
+    virtual void processTimerEvent(DEVICEMOD_TIMER timer, DEVICEMOD_TIME timer_time){
+        timer_lateness.push_back(to_ms(DEVICEMOD_CLOCK::now() - timer_time));
+        this->timer = std::nullopt;
+        long_pressed.push_back(true);
+    }
+};
+
+//============================================================================================
+// Driver
+//============================================================================================
+static void print_distribution(const char* title, std::vector<double> values){
+    if (values.empty()){
+        return;
+    }
+    std::sort(values.begin(), values.end());
+    auto percentile = [&values](double p){
+        return values[std::min(values.size() - 1, static_cast<size_t>(values.size() * p / 100.))];
+    };
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "    " << title << ": p50 " << percentile(50) << ", p99 " << percentile(99)
+              << ", max " << values.back() << " ms" << std::endl;
+}
+
+static int run_jitter(const BenchOptions& options){
+    MapperEngine engine{[](MAPPER_EVENT, int64_t){}, [](MCONSOLE_MESSAGE_TYPE, const std::string&){}};
+    engine.setOption(MOPT_MODIFIER_WORKER_NUM, static_cast<int64_t>(options.workers));
+    auto manager = std::make_unique<DeviceModifierManager>(engine);
+    EncoderProbe encoder{*manager, options.cost};
+    ButtonProbe button{*manager, options.interval};
+
+    std::atomic<bool> should_stop{false};
+    std::thread flood([&](){
+        auto burst = static_cast<int>(static_cast<int64_t>(options.rate) * options.burst / 1000);
+        auto next = DEVICEMOD_CLOCK::now();
+        while (!should_stop){
+            for (auto i = 0; i < burst; i++){
+                manager->delegateEventProcessing(encoder, 1);
+            }
+            next += std::chrono::milliseconds(options.burst);
+            std::this_thread::sleep_until(next);
+        }
+    });
+
+    // short holds and long holds alternate, and a short hold follows a short release so that
+    // a long hold begins with a double click
+    std::vector<DEVICEMOD_TIME> operated;
+    std::vector<bool> expected_long;
+    std::vector<bool> expected_double;
+    auto interval = std::chrono::milliseconds(options.interval);
+    auto short_time = interval * 3 / 4;
+    auto long_time = interval * 5 / 4;
+    auto last_click = std::optional<DEVICEMOD_TIME>();
+    for (auto i = 0; i < options.trials; i++){
+        auto is_long = i % 2 == 1;
+        auto now = DEVICEMOD_CLOCK::now();
+        expected_double.push_back(last_click && now - *last_click < interval);
+        operated.push_back(now);
+        manager->delegateEventProcessing(button, 1);
+        std::this_thread::sleep_for(is_long ? long_time : short_time);
+        now = DEVICEMOD_CLOCK::now();
+        operated.push_back(now);
+        manager->delegateEventProcessing(button, 0);
+        // sleep may overrun, so the expectation is decided by the actual hold time
+        auto is_held_long = now - operated[operated.size() - 2] >= interval;
+        expected_long.push_back(is_held_long);
+        last_click = is_held_long ? std::nullopt : std::optional<DEVICEMOD_TIME>(now);
+        std::this_thread::sleep_for(is_long ? interval * 2 : short_time / 2);
+    }
+    should_stop = true;
+    flood.join();
+    std::this_thread::sleep_for(interval * 2);
+    manager.reset();
+
+    std::vector<double> errors;
+    for (size_t i = 0; i < std::min(operated.size(), button.observed.size()); i++){
+        errors.push_back(std::abs(to_ms(button.observed[i] - operated[i])));
+    }
+    std::vector<double> hold_errors;
+    for (size_t i = 0; i + 1 < std::min(operated.size(), button.observed.size()); i += 2){
+        auto hold = button.observed[i + 1] - button.observed[i];
+        hold_errors.push_back(std::abs(to_ms(hold - (operated[i + 1] - operated[i]))));
+    }
+    auto count_mismatches = [](const std::vector<bool>& expected, const std::vector<bool>& detected){
+        size_t mismatches = 0;
+        for (size_t i = 0; i < expected.size(); i++){
+            mismatches += i >= detected.size() || expected[i] != detected[i] ? 1 : 0;
+        }
+        return mismatches;
+    };
+
+    std::cout << "button operations under an encoder flood of " << options.rate << " events/sec ("
+              << options.cost << " us/event, " << options.workers << " worker(s))" << std::endl;
+    print_distribution("timing error   ", errors);
+    print_distribution("hold time error", hold_errors);
+    print_distribution("timer lateness ", button.timer_lateness);
+    std::cout << "    long press     : " << count_mismatches(expected_long, button.long_pressed)
+              << " misdetected in " << expected_long.size() << " holds" << std::endl;
+    std::cout << "    double click   : " << count_mismatches(expected_double, button.double_clicked)
+              << " misdetected in " << expected_double.size() << " presses" << std::endl;
+    return 0;
+}
+
+int main(int argc, char** argv){
+    BenchOptions options;
+    std::string mode = argc > 1 ? argv[1] : "";
+    if (mode != "jitter" || !options.parse(argc - 2, argv + 2)){
+        std::cerr << "usage: " << argv[0] << " jitter [--workers N] [--rate N] [--cost N] [--burst N] [--interval N] [--trials N]" << std::endl;
+        return 1;
+    }
+    return run_jitter(options);
+}
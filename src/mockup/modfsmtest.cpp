@@ -0,0 +1,788 @@
+//
+// modfsmtest.cpp
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+//  tests of the state machines of button, incdec and quantized_stick modifiers
+//  usage: modfsmtest [--rounds N] [--seed N]
+//
+//  Random modifier definitions are driven by random unit values with a simulated clock.
+//  Each sequence is replayed through the state machine compiled into transition tables and
+//  through the reference implementation which the modifier used before, then traces of sent
+//  events are compared. Timers are held by TimerQueue as the modifier worker does, and
+//  timers which expire by the time of a unit value are fired before it.
+//  (default: 2000 rounds for each type of modifier)
+//
+
+#include <iostream>
+#include <sstream>
+#include <random>
+#include <vector>
+#include <string>
+#include <optional>
+#include <algorithm>
+#include <cstdlib>
+#include "timerqueue.h"
+#include "devicemodifierfsm.h"
+
+using CLOCK = devicemodifier_fsm::CLOCK;
+using TIME = devicemodifier_fsm::TIME;
+using MILLISEC = devicemodifier_fsm::MILLISEC;
+
+//============================================================================================
+// Test driver
+//============================================================================================
+class Checker{
+protected:
+    int failed = 0;
+    int passed = 0;
+    int reported = 0;
+
+public:
+    void check(bool condition, const std::string& description){
+        if (condition){
+            passed++;
+        }else{
+            failed++;
+            // a broken implementation fails on many inputs, so only the first ones are shown
+            if (reported++ < 10){
+                std::cout << "    FAILED: " << description << std::endl;
+            }
+        }
+    }
+
+    int result(){
+        std::cout << "    " << passed << " passed, " << failed << " failed" << std::endl;
+        return failed;
+    }
+};
+
+//============================================================================================
+// Simulated environment of a modifier
+//    Sent events are recorded as a trace with the simulated time. Timer handles are issued
+//    by TimerQueue, so they are never 0 as DeviceModifierManager issues.
+//============================================================================================
+struct Record{
+    int64_t time;
+    size_t kind;
+    std::optional<int64_t> value;
+
+    bool operator == (const Record& rhs) const{
+        return time == rhs.time && kind == rhs.kind && value == rhs.value;
+    }
+};
+
+class Environment{
+protected:
+    TimerQueue<TIME, int> timers;
+    TIME base;
+    TIME current;
+
+public:
+    std::vector<Record> trace;
+
+    explicit Environment(TIME base) : base(base), current(base){}
+
+    void send(size_t kind, std::optional<int64_t> value = std::nullopt){
+        trace.push_back({std::chrono::duration_cast<MILLISEC>(current - base).count(), kind, value});
+    }
+    uint64_t addTimer(TIME at){return timers.add(at, 0);}
+    void cancelTimer(uint64_t timer){timers.cancel(timer);}
+
+    // MODEL provides processTimer(timer, timer_time)
+    template <typename MODEL>
+    void advance(MODEL& model, TIME now){
+        while (auto timer = timers.pop_expired(now)){
+            current = timer->deadline;
+            model.processTimer(timer->handle, timer->deadline);
+        }
+        current = now;
+    }
+};
+
+// context of a state machine, timers of each kind are kept as the modifier does
+template <size_t TIMER_NUM>
+class Context{
+protected:
+    Environment& environment;
+    uint64_t timers[TIMER_NUM] = {};
+
+public:
+    explicit Context(Environment& environment) : environment(environment){}
+
+    void sendEvent(size_t kind){environment.send(kind);}
+    void sendEvent(size_t kind, int64_t value){environment.send(kind, value);}
+    void startTimer(size_t kind, TIME at){
+        if (timers[kind]){
+            environment.cancelTimer(timers[kind]);
+        }
+        timers[kind] = environment.addTimer(at);
+    }
+    void cancelTimer(size_t kind){
+        if (timers[kind]){
+            environment.cancelTimer(timers[kind]);
+            timers[kind] = 0;
+        }
+    }
+    bool isTimerRunning(size_t kind){return timers[kind] != 0;}
+
+    size_t expireTimer(uint64_t timer){
+        for (size_t kind = 0; kind < TIMER_NUM; kind++){
+            if (timers[kind] == timer){
+                timers[kind] = 0;
+                return kind;
+            }
+        }
+        return TIMER_NUM;
+    }
+};
+
+struct Step{
+    TIME time;
+    int value;
+};
+
+//============================================================================================
+// Button modifier
+//============================================================================================
+// implementation of ButtonModifier before transitions were compiled into a table
+class ReferenceButton{
+protected:
+    using FSM = ButtonStateMachine;
+    enum class Status{
+        off,
+        on,
+        maybedouble_up_off,
+        maybedouble_up_on,
+        maybedouble_down_on,
+        maybedouble_down_off,
+    };
+    Environment& environment;
+    const FSM::Definition& def;
+    Status status = Status::off;
+    int lastvalue = 0;
+    int threshold_max;
+    int threshold_min;
+    TIME starttime;
+    std::optional<uint64_t> longpress_timer;
+    std::optional<uint64_t> doubleclick_timer;
+    std::optional<uint64_t> repeat_timer;
+    std::optional<uint64_t> following_down_timer;
+    std::optional<uint64_t> following_up_timer;
+
+    enum class CoockedEvent{
+        none,
+        down,
+        up,
+    };
+
+    CoockedEvent coockEvent(int value){
+        auto lastvalue = this->lastvalue;
+        this->lastvalue = value;
+        if (lastvalue < threshold_max && value >= threshold_max){
+            return def.negative_polarity ? CoockedEvent::up : CoockedEvent::down;
+        }else if (lastvalue > threshold_min && value <= threshold_min){
+            return def.negative_polarity ? CoockedEvent::down : CoockedEvent::up;
+        }else{
+            return CoockedEvent::none;
+        }
+    }
+
+    void cancel(std::optional<uint64_t>& timer){
+        if (timer.has_value()){
+            environment.cancelTimer(timer.value());
+            timer = std::nullopt;
+        }
+    }
+
+public:
+    ReferenceButton(Environment& environment, const FSM::Definition& def, int threshold_max, int threshold_min) :
+        environment(environment), def(def), threshold_max(threshold_max), threshold_min(threshold_min){}
+
+    void processValue(int value){
+        auto event = coockEvent(value);
+        if (event == CoockedEvent::down){
+            environment.send(FSM::EVENT_DOWN);
+        }else if (event == CoockedEvent::up){
+            environment.send(FSM::EVENT_UP);
+        }
+    }
+
+    void processValue(int value, TIME now){
+        auto event = coockEvent(value);
+        if (event == CoockedEvent::none){
+            return;
+        }
+        if (def.repeat_interval.has_value()){
+            if (event == CoockedEvent::down){
+                auto delay = def.repeat_delay ? *def.repeat_delay : 500;
+                repeat_timer = environment.addTimer(now + MILLISEC(delay));
+            }else{
+                cancel(repeat_timer);
+            }
+        }
+        if (def.follow_down && event == CoockedEvent::down && !following_down_timer){
+            following_down_timer = environment.addTimer(now + MILLISEC(*def.follow_down));
+        }
+        if (def.follow_up && event == CoockedEvent::up && !following_up_timer){
+            following_up_timer = environment.addTimer(now + MILLISEC(*def.follow_up));
+        }
+
+        if (status == Status::off && event == CoockedEvent::down){
+            starttime = now;
+            environment.send(FSM::EVENT_DOWN);
+            if (def.longpress.has_value()){
+                longpress_timer = environment.addTimer(starttime + MILLISEC(def.longpress.value()));
+            }
+            if (def.doubleclick.has_value() && !def.click_on_up){
+                status = Status::maybedouble_down_on;
+                doubleclick_timer = environment.addTimer(starttime + MILLISEC(def.doubleclick.value()));
+            }else{
+                status = Status::on;
+            }
+        }else if (status == Status::on && event == CoockedEvent::up){
+            environment.send(FSM::EVENT_UP);
+            cancel(longpress_timer);
+            if (def.doubleclick.has_value() && def.click_on_up){
+                if (now < starttime + MILLISEC(def.doubleclick.value())){
+                    status = Status::maybedouble_up_off;
+                    doubleclick_timer = environment.addTimer(starttime + MILLISEC(def.doubleclick.value()));
+                }else{
+                    environment.send(FSM::EVENT_SINGLECLICK);
+                    status = Status::off;
+                }
+            }else{
+                status = Status::off;
+            }
+        }else if (status == Status::maybedouble_up_off && event == CoockedEvent::down){
+            environment.send(FSM::EVENT_DOWN);
+            if (def.longpress.has_value()){
+                longpress_timer = environment.addTimer(starttime + MILLISEC(def.longpress.value()));
+            }
+            status = Status::maybedouble_up_on;
+        }else if (status == Status::maybedouble_up_on && event == CoockedEvent::up){
+            environment.send(FSM::EVENT_UP);
+            environment.send(FSM::EVENT_DOUBLECLICK);
+            cancel(doubleclick_timer);
+            cancel(longpress_timer);
+            status = Status::off;
+        }else if (status == Status::maybedouble_down_on && event == CoockedEvent::up){
+            environment.send(FSM::EVENT_UP);
+            cancel(longpress_timer);
+            status = Status::maybedouble_down_off;
+        }else if (status == Status::maybedouble_down_off && event == CoockedEvent::down){
+            environment.send(FSM::EVENT_DOWN);
+            environment.send(FSM::EVENT_DOUBLECLICK);
+            cancel(doubleclick_timer);
+            starttime = now;
+            status = Status::on;
+            if (def.longpress.has_value()){
+                longpress_timer = environment.addTimer(starttime + MILLISEC(def.longpress.value()));
+            }
+        }
+    }
+
+    void processTimer(uint64_t timer, TIME timer_time){
+        if (doubleclick_timer.has_value() && timer == doubleclick_timer.value()){
+            environment.send(FSM::EVENT_SINGLECLICK);
+            doubleclick_timer = std::nullopt;
+            if (status == Status::maybedouble_down_off || status == Status::maybedouble_up_off){
+                status = Status::off;
+            }else if (status == Status::maybedouble_down_on || status == Status::maybedouble_up_on){
+                status = Status::on;
+            }
+        }else if (longpress_timer.has_value() && timer == longpress_timer.value()){
+            environment.send(FSM::EVENT_LONGPRESSED);
+            longpress_timer = std::nullopt;
+            status = Status::off;
+        }else if (repeat_timer.has_value() && timer == repeat_timer.value()){
+            environment.send(FSM::EVENT_DOWN);
+            repeat_timer = environment.addTimer(timer_time + MILLISEC(def.repeat_interval.value()));
+        }else if (following_down_timer.has_value() && timer == following_down_timer.value()){
+            environment.send(FSM::EVENT_FOLLOWING_DOWN);
+            following_down_timer = std::nullopt;
+        }else if (following_up_timer.has_value() && timer == following_up_timer.value()){
+            environment.send(FSM::EVENT_FOLLOWING_UP);
+            following_up_timer = std::nullopt;
+        }
+    }
+};
+
+class CompiledButton{
+protected:
+    using FSM = ButtonStateMachine;
+    const FSM::Definition& def;
+    Context<FSM::TIMER_KIND_NUM> context;
+    FSM fsm;
+
+public:
+    CompiledButton(Environment& environment, const FSM::Definition& def, int threshold_max, int threshold_min) :
+        def(def), context(environment){
+        fsm.setThresholds(threshold_max, threshold_min);
+    }
+
+    void processValue(int value){fsm.processValue(def, context, value);}
+    void processValue(int value, TIME now){fsm.processValue(def, context, value, now);}
+    void processTimer(uint64_t timer, TIME timer_time){
+        auto kind = context.expireTimer(timer);
+        if (kind < FSM::TIMER_KIND_NUM){
+            fsm.processTimer(def, context, static_cast<FSM::TimerKind>(kind), timer_time);
+        }
+    }
+};
+
+//============================================================================================
+// Increment / decrement modifier
+//============================================================================================
+// implementation of IncDecModifier before transitions were compiled into a table
+class ReferenceIncDec{
+protected:
+    using FSM = IncDecStateMachine;
+    enum class Status{
+        init,
+        down,
+        up,
+    };
+    Environment& environment;
+    const FSM::Definition& def;
+    bool is_absolute;
+    int last_value;
+    Status status{Status::init};
+    std::optional<uint64_t> hold_timer;
+    TIME last_event_time{CLOCK::now()};
+    int hold_top = 0;
+    int hold_bottom = 0;
+    static constexpr auto hold_buffer_mask{0xf};
+    bool hold_buffer[16];
+
+public:
+    ReferenceIncDec(Environment& environment, const FSM::Definition& def, bool is_absolute, int initial_value) :
+        environment(environment), def(def), is_absolute(is_absolute), last_value(initial_value){}
+
+    void processValue(int value){
+        auto delta = is_absolute ? value - last_value : value;
+        last_value = value;
+        if (delta > 0){
+            environment.send(FSM::EVENT_INCREMENT, delta);
+        }else if (delta < 0){
+            environment.send(FSM::EVENT_DECREMENT, -delta);
+        }
+    }
+
+    void processValue(int value, TIME now){
+        auto delta = is_absolute ? value - last_value : value;
+        last_value = value;
+        if (hold_bottom - hold_top < def.max_hold_num){
+            hold_buffer[hold_bottom & hold_buffer_mask] = delta > 0;
+            hold_bottom++;
+            if (status == Status::init){
+                if (now >= last_event_time + MILLISEC(def.pulse_interval)){
+                    environment.send(delta > 0 ? FSM::EVENT_INCREMENT : FSM::EVENT_DECREMENT, 1);
+                    status = Status::down;
+                    hold_timer = environment.addTimer(now + MILLISEC(def.pulse_duration));
+                }else{
+                    status = Status::up;
+                    hold_timer = environment.addTimer(last_event_time + MILLISEC(def.pulse_interval));
+                }
+            }
+        }
+    }
+
+    void processTimer(uint64_t timer, TIME timer_time){
+        if (timer != hold_timer){
+            return;
+        }
+        hold_timer = std::nullopt;
+        last_event_time = timer_time;
+        auto kind = [this](){return hold_buffer[hold_top & hold_buffer_mask] ? FSM::EVENT_INCREMENT : FSM::EVENT_DECREMENT;};
+        if (status == Status::down){
+            environment.send(kind(), 0);
+            hold_top++;
+            if (hold_bottom - hold_top == 0){
+                status = Status::init;
+            }else{
+                status = Status::up;
+                hold_timer = environment.addTimer(last_event_time + MILLISEC(def.pulse_interval));
+            }
+        }else if (status == Status::up){
+            if (hold_bottom - hold_top > 0){
+                environment.send(kind(), 1);
+                status = Status::down;
+                hold_timer = environment.addTimer(last_event_time + MILLISEC(def.pulse_duration));
+            }else{
+                status = Status::init;
+            }
+        }
+    }
+};
+
+class CompiledIncDec{
+protected:
+    using FSM = IncDecStateMachine;
+    const FSM::Definition& def;
+    Context<FSM::TIMER_KIND_NUM> context;
+    FSM fsm;
+
+public:
+    CompiledIncDec(Environment& environment, const FSM::Definition& def, bool is_absolute, int initial_value) :
+        def(def), context(environment){
+        fsm.fitToUnit(is_absolute, initial_value);
+    }
+
+    void processValue(int value){fsm.processValue(def, context, value);}
+    void processValue(int value, TIME now){fsm.processValue(def, context, value, now);}
+    void processTimer(uint64_t timer, TIME timer_time){
+        if (context.expireTimer(timer) == FSM::TIMER_HOLD){
+            fsm.processTimer(def, context, timer_time);
+        }
+    }
+};
+
+//============================================================================================
+// Quantized stick modifier
+//============================================================================================
+// implementation of QuantizedStickModifier before transitions were compiled into a table
+class ReferenceQuantizedStick{
+protected:
+    using FSM = QuantizedStickStateMachine;
+    enum class Status{
+        center,
+        positive,
+        negative,
+    };
+    Environment& environment;
+    const FSM::Definition& def;
+    Status status{Status::center};
+    uint64_t repeat_timer = 0;
+
+    void cancel(){
+        if (repeat_timer){
+            environment.cancelTimer(repeat_timer);
+            repeat_timer = 0;
+        }
+    }
+
+public:
+    ReferenceQuantizedStick(Environment& environment, const FSM::Definition& def) : environment(environment), def(def){}
+
+    void processValue(int value){
+        switch (status){
+            case Status::center:
+                if (value >= def.threshold_center_to_positive){
+                    status = Status::positive;
+                    environment.send(FSM::EVENT_POSITIVE);
+                }else if (value <= def.threshold_center_to_negative){
+                    status = Status::negative;
+                    environment.send(FSM::EVENT_NEGATIVE);
+                }
+                break;
+            case Status::negative:
+                if (value > def.threshold_negative_to_center){
+                    status = Status::center;
+                }
+                break;
+            case Status::positive:
+                if (value < def.threshold_positive_to_center){
+                    status = Status::center;
+                }
+                break;
+        }
+    }
+
+    void processValue(int value, TIME now){
+        switch (status){
+            case Status::center:
+                if (value >= def.threshold_center_to_positive){
+                    status = Status::positive;
+                    environment.send(FSM::EVENT_POSITIVE);
+                    repeat_timer = environment.addTimer(now + MILLISEC(def.repeat_delay));
+                }else if (value <= def.threshold_center_to_negative){
+                    status = Status::negative;
+                    environment.send(FSM::EVENT_NEGATIVE);
+                    repeat_timer = environment.addTimer(now + MILLISEC(def.repeat_delay));
+                }
+                break;
+            case Status::negative:
+                if (value > def.threshold_negative_to_center){
+                    status = Status::center;
+                    cancel();
+                }
+                break;
+            case Status::positive:
+                if (value < def.threshold_positive_to_center){
+                    status = Status::center;
+                    cancel();
+                }
+                break;
+        }
+    }
+
+    void processTimer(uint64_t timer, TIME timer_time){
+        if (timer == repeat_timer){
+            switch (status){
+                case Status::center:
+                    repeat_timer = 0;
+                    break;
+                case Status::positive:
+                    environment.send(FSM::EVENT_POSITIVE);
+                    repeat_timer = environment.addTimer(timer_time + MILLISEC(def.repeat_interval));
+                    break;
+                case Status::negative:
+                    environment.send(FSM::EVENT_NEGATIVE);
+                    repeat_timer = environment.addTimer(timer_time + MILLISEC(def.repeat_interval));
+                    break;
+            }
+        }
+    }
+};
+
+class CompiledQuantizedStick{
+protected:
+    using FSM = QuantizedStickStateMachine;
+    const FSM::Definition& def;
+    Context<FSM::TIMER_KIND_NUM> context;
+    FSM fsm;
+
+public:
+    CompiledQuantizedStick(Environment& environment, const FSM::Definition& def) : def(def), context(environment){}
+
+    void processValue(int value){fsm.processValue(def, context, value);}
+    void processValue(int value, TIME now){fsm.processValue(def, context, value, now);}
+    void processTimer(uint64_t timer, TIME timer_time){
+        if (context.expireTimer(timer) == FSM::TIMER_REPEAT){
+            fsm.processTimer(def, context, timer_time);
+        }
+    }
+};
+
+//============================================================================================
+// Replay
+//    Unit values are processed at their time when the modifier uses timers, otherwise they
+//    are processed immediately as device threads do. Timers keep expiring for a while after
+//    the last value so that pending pulses and repeats appear in the trace.
+//============================================================================================
+template <typename MODEL>
+static std::vector<Record> replay(Environment& environment, MODEL& model, const std::vector<Step>& steps, bool use_timer){
+    for (const auto& step : steps){
+        environment.advance(model, step.time);
+        if (use_timer){
+            model.processValue(step.value, step.time);
+        }else{
+            model.processValue(step.value);
+        }
+    }
+    environment.advance(model, steps.back().time + MILLISEC(3000));
+    return std::move(environment.trace);
+}
+
+static std::string describe(const std::string& definition, const std::vector<Step>& steps,
+                            const std::vector<Record>& expected, const std::vector<Record>& actual){
+    std::ostringstream os;
+    os << definition << ", " << steps.size() << " values: ";
+    auto mismatch = std::mismatch(expected.begin(), expected.end(), actual.begin(), actual.end());
+    auto index = mismatch.first - expected.begin();
+    os << "trace differs at record " << index << " of " << expected.size() << " / " << actual.size();
+    auto print = [&os](const char* label, std::vector<Record>::const_iterator i, std::vector<Record>::const_iterator end){
+        os << ", " << label << " ";
+        if (i == end){
+            os << "(end)";
+        }else{
+            os << "{" << i->time << " ms, kind " << i->kind;
+            if (i->value){
+                os << ", value " << *i->value;
+            }
+            os << "}";
+        }
+    };
+    print("expected", mismatch.first, expected.end());
+    print("actual", mismatch.second, actual.end());
+    return os.str();
+}
+
+template <typename REFERENCE, typename COMPILED, typename... ARGS>
+static void compare(Checker& checker, const std::string& definition, const std::vector<Step>& steps,
+                    bool use_timer, TIME base, const ARGS&... args){
+    Environment reference_environment{base};
+    REFERENCE reference{reference_environment, args...};
+    auto expected = replay(reference_environment, reference, steps, use_timer);
+    Environment compiled_environment{base};
+    COMPILED compiled{compiled_environment, args...};
+    auto actual = replay(compiled_environment, compiled, steps, use_timer);
+    checker.check(expected == actual, describe(definition, steps, expected, actual));
+}
+
+//============================================================================================
+// Random definitions and values
+//============================================================================================
+class Generator{
+protected:
+    std::mt19937 engine;
+
+public:
+    explicit Generator(int seed) : engine(seed){}
+
+    int range(int min, int max){
+        return std::uniform_int_distribution<int>(min, max)(engine);
+    }
+    bool chance(int percent){
+        return range(0, 99) < percent;
+    }
+    std::optional<int> maybe(int percent, int min, int max){
+        return chance(percent) ? std::optional<int>(range(min, max)) : std::nullopt;
+    }
+
+    // intervals are mostly shorter than timers of definitions so that operations overlap
+    std::vector<Step> steps(TIME base, int max_interval, const std::vector<int>& pool, int min, int max){
+        std::vector<Step> steps;
+        auto now = base;
+        auto num = range(1, 60);
+        for (auto i = 0; i < num; i++){
+            auto gap = chance(10) ? 0 : range(0, chance(20) ? max_interval * 2 : max_interval / 2);
+            now += MILLISEC(gap);
+            auto value = chance(70) ? pool[range(0, static_cast<int>(pool.size()) - 1)] : range(min, max);
+            steps.push_back({now, value});
+        }
+        return steps;
+    }
+};
+
+static std::string describe(const ButtonStateMachine::Definition& def){
+    std::ostringstream os;
+    auto print = [&os](const char* name, const std::optional<int>& value){
+        if (value){
+            os << " " << name << "=" << *value;
+        }
+    };
+    os << "button{" << (def.negative_polarity ? "negative" : "positive");
+    print("max_threshold", def.threshold_max);
+    print("min_threshold", def.threshold_min);
+    print("longpress", def.longpress);
+    print("doubleclick", def.doubleclick);
+    print("repeat_interval", def.repeat_interval);
+    print("repeat_delay", def.repeat_delay);
+    print("follow_down", def.follow_down);
+    print("follow_up", def.follow_up);
+    os << " click_timing=" << (def.click_on_up ? "up" : "down") << "}";
+    return os.str();
+}
+
+static void test_button(Checker& checker, Generator& generator, int rounds, TIME base){
+    std::cout << "button" << std::endl;
+    for (auto round = 0; round < rounds; round++){
+        ButtonStateMachine::Definition def;
+        def.negative_polarity = generator.chance(30);
+        if (generator.chance(30)){
+            def.threshold_max = generator.range(55, 95);
+            def.threshold_min = generator.range(5, *def.threshold_max - 1);
+        }
+        def.doubleclick = generator.maybe(60, 50, 400);
+        def.longpress = generator.maybe(60, def.doubleclick ? *def.doubleclick + 1 : 50, 1000);
+        def.click_on_up = generator.chance(50);
+        def.repeat_interval = generator.maybe(25, 20, 300);
+        def.repeat_delay = generator.maybe(50, 50, 600);
+        def.follow_down = generator.maybe(25, 10, 500);
+        def.follow_up = generator.maybe(25, 10, 500);
+        def.need_timer = def.doubleclick || def.longpress || def.repeat_interval || def.follow_down || def.follow_up;
+        def.compile();
+
+        // thresholds for a unit from 0 to 100 as ButtonModifier decides
+        auto threshold_min = def.threshold_min ? *def.threshold_min : 50;
+        auto threshold_max = def.threshold_max ? *def.threshold_max : threshold_min + 1;
+        auto steps = generator.steps(base, 600, {0, 100, threshold_min, threshold_max}, 0, 100);
+        compare<ReferenceButton, CompiledButton>(
+            checker, describe(def), steps, def.need_timer, base, def, threshold_max, threshold_min);
+    }
+}
+
+static void test_incdec(Checker& checker, Generator& generator, int rounds, TIME base){
+    std::cout << "incdec" << std::endl;
+    for (auto round = 0; round < rounds; round++){
+        IncDecStateMachine::Definition def;
+        def.pulse_mode = generator.chance(80);
+        def.pulse_duration = generator.range(1, 100);
+        def.pulse_interval = generator.range(1, 100);
+        def.max_hold_num = generator.range(1, static_cast<int>(IncDecStateMachine::HOLD_BUFFER_LEN));
+        auto is_absolute = generator.chance(50);
+        auto initial_value = is_absolute ? 50 : 0;
+
+        std::ostringstream os;
+        os << "incdec{pulse_mode=" << def.pulse_mode << " pulse_duration=" << def.pulse_duration
+           << " pulse_interval=" << def.pulse_interval << " max_hold_num=" << def.max_hold_num
+           << (is_absolute ? " absolute" : " relative") << "}";
+        auto steps = is_absolute ? generator.steps(base, 200, {0, 50, 100}, 0, 100) :
+                                   generator.steps(base, 200, {-1, 1}, -3, 3);
+        compare<ReferenceIncDec, CompiledIncDec>(
+            checker, os.str(), steps, def.pulse_mode, base, def, is_absolute, initial_value);
+    }
+}
+
+static void test_quantized_stick(Checker& checker, Generator& generator, int rounds, TIME base){
+    std::cout << "quantized_stick" << std::endl;
+    for (auto round = 0; round < rounds; round++){
+        QuantizedStickStateMachine::Definition def;
+        def.repeat_mode = generator.chance(70);
+        def.repeat_delay = generator.range(1, 600);
+        def.repeat_interval = generator.range(1, 600);
+        if (generator.chance(70)){
+            auto activate = generator.range(0, 50000);
+            def.threshold_center_to_positive = activate;
+            def.threshold_center_to_negative = -activate;
+        }
+        if (generator.chance(70)){
+            // the release threshold may be greater than the activate threshold
+            auto release = generator.range(0, 50000);
+            def.threshold_positive_to_center = release;
+            def.threshold_negative_to_center = -release;
+        }
+        def.compile();
+
+        std::ostringstream os;
+        os << "quantized_stick{repeat_mode=" << def.repeat_mode << " repeat_delay=" << def.repeat_delay
+           << " repeat_interval=" << def.repeat_interval << " activate=" << def.threshold_center_to_positive
+           << " release=" << def.threshold_positive_to_center << "}";
+        std::vector<int> pool{
+            0, 50000, -50000,
+            def.threshold_center_to_positive, def.threshold_positive_to_center,
+            def.threshold_center_to_negative, def.threshold_negative_to_center,
+            def.threshold_positive_to_center - 1, def.threshold_negative_to_center + 1,
+        };
+        auto steps = generator.steps(base, 600, pool, -50000, 50000);
+        compare<ReferenceQuantizedStick, CompiledQuantizedStick>(
+            checker, os.str(), steps, def.repeat_mode, base, def);
+    }
+}
+
+static int run_test(int rounds, int seed){
+    Checker checker;
+    Generator generator{seed};
+
+    // initial time of the last pulse of incdec is the time when a modifier is created,
+    // so the simulated clock starts later than that
+    auto base = CLOCK::now() + std::chrono::hours(1);
+    test_button(checker, generator, rounds, base);
+    test_incdec(checker, generator, rounds, base);
+    test_quantized_stick(checker, generator, rounds, base);
+    return checker.result() ? 1 : 0;
+}
+
+int main(int argc, char** argv){
+    auto rounds = 2000;
+    auto seed = 1;
+    auto is_valid = true;
+    for (auto i = 1; is_valid && i < argc; i += 2){
+        std::string option{argv[i]};
+        auto value = i + 1 < argc ? std::atoi(argv[i + 1]) : 0;
+        if (option == "--rounds" && value > 0){
+            rounds = value;
+        }else if (option == "--seed" && i + 1 < argc){
+            seed = value;
+        }else{
+            is_valid = false;
+        }
+    }
+    if (!is_valid){
+        std::cerr << "usage: " << argv[0] << " [--rounds N] [--seed N]" << std::endl;
+        return 1;
+    }
+
+    return run_test(rounds, seed);
+}
@@ -0,0 +1,137 @@
+//
+// modtest.cpp
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+//  tests of the chord modifier and the sequence modifier with the mock device plugin
+//  usage: modtest
+//
+
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include "mockdevice.h"
+
+using MILLISEC = std::chrono::milliseconds;
+
+//============================================================================================
+// Test driver
+//============================================================================================
+class Checker{
+protected:
+    int failed = 0;
+    int passed = 0;
+
+public:
+    void check(bool condition, const char* description){
+        if (condition){
+            passed++;
+        }else{
+            failed++;
+            std::cout << "    FAILED: " << description << std::endl;
+        }
+    }
+
+    int result(){
+        std::cout << "    " << passed << " passed, " << failed << " failed" << std::endl;
+        return failed;
+    }
+};
+
+class Pad{
+protected:
+    MockDeviceHost& host;
+    MockDevice device{{
+        {"b1", FSMDU_TYPE_BINARY, 0, 1},
+        {"b2", FSMDU_TYPE_BINARY, 0, 1},
+        {"b3", FSMDU_TYPE_BINARY, 0, 1},
+        {"b4", FSMDU_TYPE_BINARY, 0, 1},
+    }};
+
+public:
+    Pad(MockDeviceHost& host, const char* modifiers) : host(host){
+        host.open(device, "pad", modifiers);
+    }
+
+    // operations are written as "b1+", "b1-" or "wait 100"
+    Pad& operate(const std::vector<std::string>& operations){
+        for (const auto& operation : operations){
+            if (operation.compare(0, 5, "wait ") == 0){
+                std::this_thread::sleep_for(MILLISEC(std::stoi(operation.substr(5))));
+            }else{
+                auto index = operation[1] - '1';
+                device.raise(index, operation.back() == '+' ? 1 : 0);
+            }
+        }
+        return *this;
+    }
+
+    Pad& operateAtOnce(const std::vector<std::pair<int, int>>& values){
+        std::vector<FSMDEVUNITVALUE> unit_values;
+        for (const auto& value : values){
+            FSMDEVUNITVALUE unit_value;
+            unit_value.index = value.first;
+            unit_value.type = FSMDU_VALUE_INT;
+            unit_value.value.intValue = value.second;
+            unit_values.push_back(unit_value);
+        }
+        device.raise(unit_values.data(), unit_values.size());
+        return *this;
+    }
+
+    // number of detections of a combination since the last call
+    size_t detected(const char* combination){
+        auto names = host.receiveEventNames();
+        auto name = std::string("pad:") + combination + ":detected";
+        return std::count(names.begin(), names.end(), name);
+    }
+};
+
+//============================================================================================
+// Test cases
+//============================================================================================
+static void test_chord(MockDeviceHost& host, Checker& checker){
+    std::cout << "chord modifier" << std::endl;
+    Pad pad{host, "{{name = 'chord', modtype = 'chord', modparam = {units = {'b1', 'b2'}}}}"};
+    checker.check(pad.operate({"b1+", "b2+"}).detected("chord") == 1, "detected when all units turn on");
+    checker.check(pad.operate({"b2-", "b2+"}).detected("chord") == 1, "detected again after a unit turns off");
+    checker.check(pad.operate({"b1-", "b2-"}).detected("chord") == 0, "not detected when units turn off");
+    checker.check(pad.operate({"b2+", "b1+"}).detected("chord") == 1, "detected regardless of order");
+    checker.check(pad.operate({"b1-", "b2-", "b3+", "b3-"}).detected("chord") == 0, "not detected by other units");
+    pad.operateAtOnce({{0, 1}, {1, 1}});
+    checker.check(pad.detected("chord") == 1, "detected when units turn on in a frame");
+    pad.operateAtOnce({{0, 0}, {1, 0}});
+}
+
+static void test_ordered_chord(MockDeviceHost& host, Checker& checker){
+    std::cout << "ordered chord modifier with window" << std::endl;
+    Pad pad{host, "{{name = 'shift', modtype = 'chord', modparam = {units = {'b1', 'b2'}, ordered = true, window = 100}}}"};
+    checker.check(pad.operate({"b1+", "b2+"}).detected("shift") == 1, "detected in order");
+    checker.check(pad.operate({"b1-", "b2-", "b2+", "b1+"}).detected("shift") == 0, "not detected out of order");
+    checker.check(pad.operate({"b1-", "b2-", "b1+", "wait 200", "b2+"}).detected("shift") == 0, "not detected out of window");
+    pad.operate({"b1-", "b2-"});
+}
+
+static void test_sequence(MockDeviceHost& host, Checker& checker){
+    std::cout << "sequence modifier" << std::endl;
+    Pad pad{host, "{{name = 'triple', modtype = 'sequence', modparam = {units = {'b3', 'b3', 'b4'}, interval = 100}}}"};
+    checker.check(pad.operate({"b3+", "b3-", "b3+", "b3-", "b4+", "b4-"}).detected("triple") == 1, "detected in order");
+    checker.check(pad.operate({"b3+", "b3-", "b4+", "b4-"}).detected("triple") == 0, "not detected with a missing step");
+    checker.check(pad.operate({"b3+", "b3-", "b3+", "b3-", "b3+", "b3-", "b4+", "b4-"}).detected("triple") == 1,
+                  "detected after an extra repetition");
+    checker.check(pad.operate({"b3+", "b3-", "b3+", "b3-", "wait 200", "b4+", "b4-"}).detected("triple") == 0,
+                  "not detected when interval expires");
+    checker.check(pad.operate({"b3+", "b3-", "b3+", "b3-", "b1+", "b1-", "b4+", "b4-"}).detected("triple") == 1,
+                  "not interrupted by units out of the sequence");
+}
+
+int main(int argc, char** argv){
+    MockDeviceHost host;
+    Checker checker;
+    test_chord(host, checker);
+    test_ordered_chord(host, checker);
+    test_sequence(host, checker);
+    return checker.result() ? 1 : 0;
+}
@@ -0,0 +1,500 @@
+//
+// observertest.cpp
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+//  tests and microbenchmark of the observer set of the DCS exporter
+//  usage: observertest test [--rounds N] [--seed N]
+//         observertest bench [--observers N] [--frames N]
+//
+//  test:  Behaviors of the observer set are checked with a stub value source which stands
+//         for DCS World. Then random operations to add, replace, remove, enable and filter
+//         observers are applied to the observer set and to a reference model which keeps
+//         each observer in a map, and entries packed in each frame are compared.
+//         (default: 200 rounds)
+//  bench: Argument observers are polled in each frame while 10% of arguments change. The time
+//         includes random value generation for changed arguments.
+//         (default: 1000 observers, 20000 frames)
+//
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <map>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <functional>
+#include <cstring>
+#include <cstdlib>
+#include "../dcs-exporter/observer_core.hpp"
+
+using bench_clock = std::chrono::steady_clock;
+using observer_core::observer_set;
+using observer_core::observer_type;
+using observer_core::observed_value;
+
+//============================================================================================
+// Test driver
+//============================================================================================
+class Checker{
+protected:
+    int failed = 0;
+    int passed = 0;
+    int reported = 0;
+
+public:
+    void check(bool condition, const std::string& description){
+        if (condition){
+            passed++;
+        }else{
+            failed++;
+            // a broken implementation fails on many inputs, so only the first ones are shown
+            if (reported++ < 10){
+                std::cout << "    FAILED: " << description << std::endl;
+            }
+        }
+    }
+
+    int result(){
+        std::cout << "    " << passed << " passed, " << failed << " failed" << std::endl;
+        return failed;
+    }
+};
+
+//============================================================================================
+// Stub of DCS World
+//    Arguments and indications which are not set are nil as a missing device.
+//============================================================================================
+struct StubSource{
+    std::map<uint32_t, float> arguments;
+    std::map<uint32_t, std::string> indications;
+    std::map<uint32_t, std::function<void (observed_value&)>> function_filters;
+    uint64_t fetched = 0;
+
+    void get_value(observer_type type, uint32_t source, observed_value& value){
+        fetched++;
+        if (type == observer_type::argument){
+            auto found = arguments.find(source);
+            if (found != arguments.end()){
+                value.set_number(found->second);
+            }
+        }else{
+            auto found = indications.find(source);
+            if (found != indications.end()){
+                value.set_string(found->second);
+            }
+        }
+    }
+
+    void apply_function_filter(uint32_t id, observed_value& value){
+        auto found = function_filters.find(id);
+        if (found != function_filters.end()){
+            found->second(value);
+        }
+    }
+};
+
+// entries of a 'B' frame keyed by observer id, numbers are prefixed by "N" and strings by "S"
+using Entries = std::map<uint32_t, std::string>;
+
+static std::optional<Entries> decode_entries(const std::string& buffer, size_t count){
+    Entries entries;
+    size_t position = 0;
+    for (size_t i = 0; i < count; i++){
+        if (position + 4 > buffer.size()){
+            return std::nullopt;
+        }
+        uint32_t id = 0;
+        memcpy(&id, buffer.data() + position + 1, 3);
+        auto kind = buffer[position];
+        position += 4;
+        if (kind == 'N' && position + sizeof(float) <= buffer.size()){
+            float number;
+            memcpy(&number, buffer.data() + position, sizeof(number));
+            position += sizeof(number);
+            entries[id] = "N" + std::to_string(number);
+        }else if (kind == 'S' && position + sizeof(uint16_t) <= buffer.size()){
+            uint16_t length;
+            memcpy(&length, buffer.data() + position, sizeof(length));
+            position += sizeof(length);
+            if (position + length > buffer.size()){
+                return std::nullopt;
+            }
+            entries[id] = "S" + buffer.substr(position, length);
+            position += length;
+        }else{
+            return std::nullopt;
+        }
+    }
+    if (position != buffer.size()){
+        return std::nullopt;
+    }
+    return entries;
+}
+
+static std::optional<Entries> poll(observer_set& observers, StubSource& source){
+    std::string buffer;
+    auto count = observers.poll(source, buffer);
+    return decode_entries(buffer, count);
+}
+
+//============================================================================================
+// Test cases
+//============================================================================================
+static void test_basic(Checker& checker){
+    std::cout << "polling" << std::endl;
+    StubSource source;
+    observer_set observers;
+    observers.add(1, observer_type::argument, 10, 0.1f);
+    observers.add(2, observer_type::indication, 20, 0.f);
+    source.arguments[10] = 0.5f;
+    source.indications[20] = "TEXT";
+
+    auto entries = poll(observers, source);
+    checker.check(entries && entries->empty() && source.fetched == 0, "observers are not polled until enabled");
+    checker.check(!observers.enable(3), "an unknown observer cannot be enabled");
+    observers.enable(1);
+    observers.enable(2);
+    entries = poll(observers, source);
+    checker.check(entries && *entries == Entries{{1, "N" + std::to_string(0.5f)}, {2, "STEXT"}}, "initial values are notified");
+    entries = poll(observers, source);
+    checker.check(entries && entries->empty(), "unchanged values are not notified");
+
+    source.arguments[10] = 0.55f;
+    entries = poll(observers, source);
+    checker.check(entries && entries->empty(), "a change within epsilon is not notified");
+    source.arguments[10] = 0.65f;
+    entries = poll(observers, source);
+    checker.check(entries && entries->count(1) == 1, "a change over epsilon is notified");
+    source.indications[20] = "OTHER";
+    entries = poll(observers, source);
+    checker.check(entries && entries->count(2) == 1 && entries->at(2) == "SOTHER", "a changed string is notified");
+
+    source.arguments.erase(10);
+    entries = poll(observers, source);
+    checker.check(entries && entries->empty(), "a nil value is not notified");
+    source.arguments[10] = 0.65f;
+    entries = poll(observers, source);
+    checker.check(entries && entries->empty(), "the last value is kept while the value is nil");
+    observers.enable(1);
+    entries = poll(observers, source);
+    checker.check(entries && entries->count(1) == 1, "enabling again notifies the current value");
+
+    observers.add(1, observer_type::indication, 20, 0.f);
+    observers.enable(1);
+    entries = poll(observers, source);
+    checker.check(entries && entries->count(1) == 1 && entries->at(1) == "SOTHER", "an observer is replaced by the same id");
+    checker.check(observers.size() == 2, "replacing an observer does not add a slot");
+
+    std::string long_text(70000, 'x');
+    source.indications[20] = long_text;
+    entries = poll(observers, source);
+    checker.check(entries && entries->count(2) == 1 && entries->at(2).size() == 1 + UINT16_MAX,
+                  "a long string is truncated to the maximum length");
+}
+
+static void test_filters(Checker& checker){
+    std::cout << "filters" << std::endl;
+    StubSource source;
+    observer_set observers;
+    observers.add(1, observer_type::argument, 10, 0.f);
+    observers.add(2, observer_type::indication, 20, 0.f);
+    observers.add(3, observer_type::argument, 30, 0.f);
+    observers.add_numeric_filter(1, 0.f);
+    observers.add_numeric_filter(1, 1.f);
+    observers.add_string_filter(2, "ON");
+    source.function_filters[3] = [](observed_value& value){value.set_number(value.number * 2);};
+    observers.set_function_filter(3, true);
+    checker.check(!observers.add_numeric_filter(4, 0.f) && !observers.add_string_filter(4, "") &&
+                  !observers.set_function_filter(4, true), "filters cannot be added to an unknown observer");
+    for (auto id : {1, 2, 3}){
+        observers.enable(id);
+    }
+
+    source.arguments[10] = 0.5f;
+    source.indications[20] = "OFF";
+    source.arguments[30] = 0.25f;
+    auto entries = poll(observers, source);
+    checker.check(entries && *entries == Entries{{3, "N" + std::to_string(0.5f)}}, "values out of filters are ignored");
+    source.arguments[10] = 1.f;
+    source.indications[20] = "ON";
+    entries = poll(observers, source);
+    checker.check(entries && entries->count(1) == 1 && entries->count(2) == 1, "values in filters are notified");
+
+    observers.set_function_filter(3, false);
+    observers.enable(3);
+    entries = poll(observers, source);
+    checker.check(entries && entries->count(3) == 1 && entries->at(3) == "N" + std::to_string(0.25f),
+                  "disabled function filter is not applied");
+}
+
+static void test_remove(Checker& checker){
+    std::cout << "removal" << std::endl;
+    StubSource source;
+    observer_set observers;
+    for (uint32_t id = 1; id <= 4; id++){
+        observers.add(id, observer_type::argument, id, 0.f);
+        source.arguments[id] = static_cast<float>(id);
+        observers.enable(id);
+    }
+    observers.add_numeric_filter(4, 4.f);
+    poll(observers, source);
+
+    checker.check(observers.remove(2) && !observers.remove(2), "an observer is removed once");
+    checker.check(!observers.contains(2) && observers.contains(4) && observers.size() == 3, "other observers remain");
+    auto entries = poll(observers, source);
+    checker.check(entries && entries->empty(), "states of moved observers are kept");
+    source.arguments[4] = 5.f;
+    entries = poll(observers, source);
+    checker.check(entries && entries->empty(), "filters of moved observers are kept");
+    observers.clear();
+    checker.check(observers.size() == 0 && !observers.contains(1), "all observers are cleared");
+}
+
+//--------------------------------------------------------------------------------------------
+// random operations compared with a reference model
+//--------------------------------------------------------------------------------------------
+class ReferenceModel{
+protected:
+    struct Observer{
+        observer_type type;
+        uint32_t source;
+        float epsilon;
+        bool is_enabled = false;
+        bool is_dirty = true;
+        bool has_function_filter = false;
+        std::vector<float> numeric_filter = {};
+        std::vector<std::string> string_filter = {};
+        std::optional<float> number = {};
+        std::optional<std::string> string = {};
+    };
+    std::map<uint32_t, Observer> observers;
+
+public:
+    void add(uint32_t id, observer_type type, uint32_t source, float epsilon){
+        observers.erase(id);
+        observers.emplace(id, Observer{type, source, epsilon});
+    }
+    void remove(uint32_t id){observers.erase(id);}
+    void enable(uint32_t id){
+        if (observers.count(id)){
+            observers.at(id).is_enabled = true;
+            observers.at(id).is_dirty = true;
+        }
+    }
+    void add_numeric_filter(uint32_t id, float value){
+        if (observers.count(id)){
+            observers.at(id).numeric_filter.push_back(value);
+        }
+    }
+    void add_string_filter(uint32_t id, const std::string& value){
+        if (observers.count(id)){
+            observers.at(id).string_filter.push_back(value);
+        }
+    }
+    void set_function_filter(uint32_t id, bool enable){
+        if (observers.count(id)){
+            observers.at(id).has_function_filter = enable;
+        }
+    }
+
+    Entries poll(StubSource& source){
+        Entries entries;
+        for (auto& [id, observer] : observers){
+            if (!observer.is_enabled){
+                continue;
+            }
+            observed_value value;
+            source.get_value(observer.type, observer.source, value);
+            if (value.value_type != observed_value::type::nil){
+                if (observer.has_function_filter){
+                    source.apply_function_filter(id, value);
+                }else if (!observer.numeric_filter.empty() || !observer.string_filter.empty()){
+                    auto& numbers = observer.numeric_filter;
+                    auto& strings = observer.string_filter;
+                    auto is_passed = value.value_type == observed_value::type::number ?
+                        std::find(numbers.begin(), numbers.end(), value.number) != numbers.end() :
+                        std::find(strings.begin(), strings.end(), value.string) != strings.end();
+                    if (!is_passed){
+                        value.set_nil();
+                    }
+                }
+            }
+            if (value.value_type == observed_value::type::number){
+                if (!observer.number || std::fabs(*observer.number - value.number) > observer.epsilon || observer.is_dirty){
+                    observer.number = value.number;
+                    observer.string.reset();
+                    observer.is_dirty = true;
+                }
+            }else if (value.value_type == observed_value::type::string){
+                if (!observer.string || *observer.string != value.string || observer.is_dirty){
+                    observer.string = std::string(value.string);
+                    observer.number.reset();
+                    observer.is_dirty = true;
+                }
+            }
+            if (observer.is_dirty && (observer.number || observer.string)){
+                observer.is_dirty = false;
+                entries[id] = observer.number ? "N" + std::to_string(*observer.number) : "S" + *observer.string;
+            }
+        }
+        return entries;
+    }
+};
+
+static void test_random(Checker& checker, int rounds, int seed){
+    std::cout << "random operations" << std::endl;
+    std::mt19937 random(seed);
+    static const char* texts[] = {"", "ON", "OFF", "1234"};
+    for (auto round = 0; round < rounds; round++){
+        StubSource source;
+        observer_set observers;
+        ReferenceModel reference;
+        for (uint32_t id = 1; id <= 16; id++){
+            source.function_filters[id] = [](observed_value& value){
+                if (value.value_type == observed_value::type::number){
+                    value.set_number(value.number > 0.5f ? 1.f : 0.f);
+                }else{
+                    value.set_nil();
+                }
+            };
+        }
+        for (auto frame = 0; frame < 100; frame++){
+            for (auto i = random() % 4; i > 0; i--){
+                auto id = static_cast<uint32_t>(1 + random() % 16);
+                auto operation = random() % 8;
+                if (operation < 2){
+                    auto type = random() % 3 ? observer_type::argument : observer_type::indication;
+                    auto source_id = static_cast<uint32_t>(random() % 8);
+                    auto epsilon = static_cast<float>(random() % 3) / 8;
+                    observers.add(id, type, source_id, epsilon);
+                    reference.add(id, type, source_id, epsilon);
+                }else if (operation == 2){
+                    observers.remove(id);
+                    reference.remove(id);
+                }else if (operation < 6){
+                    observers.enable(id);
+                    reference.enable(id);
+                }else if (operation == 6){
+                    auto value = static_cast<float>(random() % 9) / 8;
+                    auto text = texts[random() % std::size(texts)];
+                    observers.add_numeric_filter(id, value);
+                    reference.add_numeric_filter(id, value);
+                    observers.add_string_filter(id, text);
+                    reference.add_string_filter(id, text);
+                }else{
+                    auto enable = random() % 2 == 0;
+                    observers.set_function_filter(id, enable);
+                    reference.set_function_filter(id, enable);
+                }
+            }
+            for (uint32_t source_id = 0; source_id < 8; source_id++){
+                if (random() % 4 == 0){
+                    if (random() % 8){
+                        source.arguments[source_id] = static_cast<float>(random() % 9) / 8;
+                    }else{
+                        source.arguments.erase(source_id);
+                    }
+                }
+                if (random() % 4 == 0){
+                    source.indications[source_id] = texts[random() % std::size(texts)];
+                }
+            }
+            auto entries = poll(observers, source);
+            auto expected = reference.poll(source);
+            checker.check(entries && *entries == expected, "round " + std::to_string(round) + ", frame " + std::to_string(frame) +
+                          ": " + std::to_string(entries ? entries->size() : 0) + " entries are packed while " +
+                          std::to_string(expected.size()) + " entries are expected");
+        }
+    }
+}
+
+static int run_test(int rounds, int seed){
+    Checker checker;
+    test_basic(checker);
+    test_filters(checker);
+    test_remove(checker);
+    test_random(checker, rounds, seed);
+    return checker.result() ? 1 : 0;
+}
+
+//============================================================================================
+// Microbenchmark
+//============================================================================================
+// arguments are held in an array so that the cost of the stub is negligible
+struct ArraySource{
+    std::vector<float> arguments;
+
+    void get_value(observer_type, uint32_t source, observed_value& value){
+        value.set_number(arguments[source]);
+    }
+
+    void apply_function_filter(uint32_t, observed_value&){}
+};
+
+static int run_bench(int num_observers, int frames){
+    ArraySource source;
+    observer_set observers;
+    source.arguments.resize(num_observers);
+    for (auto id = 0; id < num_observers; id++){
+        observers.add(id, observer_type::argument, id, 0.001f);
+        observers.enable(id);
+    }
+
+    std::mt19937 random(1);
+    std::string buffer;
+    uint64_t entries = 0;
+    auto start = bench_clock::now();
+    for (auto frame = 0; frame < frames; frame++){
+        for (auto i = 0; i < num_observers / 10; i++){
+            source.arguments[random() % num_observers] = static_cast<float>(random() % 1000) / 1000;
+        }
+        buffer.clear();
+        entries += observers.poll(source, buffer);
+    }
+    auto elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+
+    std::cout << num_observers << " observers, " << frames << " frames" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "    poll           : " << elapsed * 1e6 / frames << " us/frame, "
+              << elapsed * 1e9 / frames / num_observers << " ns/observer" << std::endl;
+    std::cout << std::setprecision(1);
+    std::cout << "    entries        : " << static_cast<double>(entries) / frames << " per frame" << std::endl;
+    return 0;
+}
+
+//============================================================================================
+// Entry point
+//============================================================================================
+int main(int argc, char** argv){
+    std::string mode = argc > 1 ? argv[1] : "";
+    auto rounds = 200;
+    auto seed = 1;
+    auto observers = 1000;
+    auto frames = 20000;
+    auto is_valid = mode == "test" || mode == "bench";
+    for (auto i = 2; is_valid && i < argc; i += 2){
+        std::string option{argv[i]};
+        auto value = i + 1 < argc ? std::atoi(argv[i + 1]) : 0;
+        if (mode == "test" && option == "--rounds" && value > 0){
+            rounds = value;
+        }else if (mode == "test" && option == "--seed" && i + 1 < argc){
+            seed = value;
+        }else if (mode == "bench" && option == "--observers" && value > 0){
+            observers = value;
+        }else if (mode == "bench" && option == "--frames" && value > 0){
+            frames = value;
+        }else{
+            is_valid = false;
+        }
+    }
+    if (!is_valid){
+        std::cerr << "usage: " << argv[0] << " test [--rounds N] [--seed N]" << std::endl;
+        std::cerr << "       " << argv[0] << " bench [--observers N] [--frames N]" << std::endl;
+        return 1;
+    }
+
+    return mode == "test" ? run_test(rounds, seed) : run_bench(observers, frames);
+}
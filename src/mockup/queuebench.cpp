@@ -0,0 +1,240 @@
+//
+// queuebench.cpp
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+//  stress benchmark of the event queue between event producers and the event-action mapping loop
+//  usage: queuebench [options]
+//  options:
+//      --producers N     number of producer threads (default: 4)
+//      --events N        number of events sent by each producer (default: 200000)
+//      --rate N          events per second sent by each producer, 0 means unlimited (default: 20000)
+//      --frame N         number of events sent at once as a frame (default: 1)
+//
+//  Both the queue used before MpscQueue (std::queue of heap allocated events guarded by the
+//  engine mutex) and MpscQueue with the same wake-up protocol as MapperEngine are measured.
+//  Latency is the time from a producer's send to the moment the consumer takes the event.
+//
+
+#include <iostream>
+#include <iomanip>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <queue>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <string>
+#include <cstdlib>
+#include "event.h"
+#include "eventqueue.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+struct BenchOptions{
+    int producers = 4;
+    int events = 200000;
+    int rate = 20000;
+    int frame = 1;
+
+    bool parse(int argc, char** argv){
+        for (auto i = 1; i < argc; i++){
+            std::string option{argv[i]};
+            if (i + 1 >= argc){
+                return false;
+            }
+            auto value = std::atoi(argv[++i]);
+            if (option == "--producers"){
+                producers = value;
+            }else if (option == "--events"){
+                events = value;
+            }else if (option == "--rate"){
+                rate = value;
+            }else if (option == "--frame"){
+                frame = std::max(value, 1);
+            }else{
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+static int64_t now_in_ns(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(bench_clock::now().time_since_epoch()).count();
+}
+
+//============================================================================================
+// Queue implementations to compare
+//============================================================================================
+class LockedQueue{
+protected:
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::queue<std::unique_ptr<Event>> queue;
+
+public:
+    static constexpr auto name = "std::queue with mutex";
+
+    void send(Event* events, size_t num){
+        std::lock_guard lock(mutex);
+        for (size_t i = 0; i < num; i++){
+            queue.push(std::make_unique<Event>(std::move(events[i])));
+        }
+        cv.notify_all();
+    }
+
+    template <typename HANDLER>
+    void receive(HANDLER&& handler, const std::atomic<bool>& should_stop){
+        std::unique_lock lock(mutex);
+        while (true){
+            cv.wait(lock, [this, &should_stop]{return !queue.empty() || should_stop;});
+            if (queue.empty()){
+                return;
+            }
+            auto ev = std::move(queue.front());
+            queue.pop();
+            lock.unlock();
+            handler(*ev);
+            lock.lock();
+        }
+    }
+
+    void stop(){
+        std::lock_guard lock(mutex);
+        cv.notify_all();
+    }
+};
+
+class LockFreeQueue{
+protected:
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::atomic<bool> loop_is_waiting{false};
+    MpscQueue<Event, 1024> queue;
+
+public:
+    static constexpr auto name = "MpscQueue";
+
+    void send(Event* events, size_t num){
+        if (num == 1){
+            queue.push(std::move(events[0]));
+        }else{
+            for (size_t i = 0; i < num; i++){
+                events[i].setContinuedInFrame(i + 1 < num);
+            }
+            queue.push_bulk(events, num);
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (loop_is_waiting.load(std::memory_order_relaxed)){
+            std::lock_guard lock(mutex);
+            cv.notify_all();
+        }
+    }
+
+    template <typename HANDLER>
+    void receive(HANDLER&& handler, const std::atomic<bool>& should_stop){
+        std::unique_lock lock(mutex);
+        while (true){
+            auto ev = queue.pop();
+            if (ev){
+                lock.unlock();
+                handler(*ev);
+                lock.lock();
+                continue;
+            }
+            loop_is_waiting.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            cv.wait(lock, [this, &should_stop]{return !queue.empty() || should_stop;});
+            loop_is_waiting.store(false, std::memory_order_relaxed);
+            if (queue.empty()){
+                return;
+            }
+        }
+    }
+
+    void stop(){
+        std::lock_guard lock(mutex);
+        cv.notify_all();
+    }
+};
+
+//============================================================================================
+// Driver
+//============================================================================================
+template <typename QUEUE>
+static void run_bench(const BenchOptions& options){
+    QUEUE queue;
+    std::atomic<bool> should_stop{false};
+    std::vector<int64_t> latencies;
+    latencies.reserve(static_cast<size_t>(options.producers) * options.events);
+    uint64_t split_frames = 0;
+
+    std::thread consumer([&](){
+        int64_t frame_id = -1;
+        queue.receive([&](Event& ev){
+            latencies.push_back(now_in_ns() - static_cast<int64_t>(ev));
+            if (frame_id >= 0 && static_cast<int64_t>(ev.getId()) != frame_id){
+                split_frames++;
+            }
+            frame_id = ev.isContinuedInFrame() ? static_cast<int64_t>(ev.getId()) : -1;
+        }, should_stop);
+    });
+
+    auto start = bench_clock::now();
+    std::vector<std::thread> producers;
+    for (auto i = 0; i < options.producers; i++){
+        producers.emplace_back([&, i](){
+            std::vector<Event> frame;
+            auto interval = options.rate > 0 ? std::chrono::nanoseconds(1000000000LL * options.frame / options.rate)
+                                             : std::chrono::nanoseconds(0);
+            auto next = bench_clock::now();
+            for (auto sent = 0; sent < options.events; sent += options.frame){
+                frame.clear();
+                auto stamp = now_in_ns();
+                for (auto j = 0; j < options.frame; j++){
+                    // event id identifies the frame, event value is the time when it was sent
+                    frame.emplace_back(static_cast<uint64_t>(i) << 32 | sent, stamp);
+                }
+                queue.send(frame.data(), frame.size());
+                if (options.rate > 0){
+                    next += interval;
+                    std::this_thread::sleep_until(next);
+                }
+            }
+        });
+    }
+    for (auto& producer : producers){
+        producer.join();
+    }
+    should_stop = true;
+    queue.stop();
+    consumer.join();
+    auto elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p){
+        auto index = std::min(latencies.size() - 1, static_cast<size_t>(latencies.size() * p / 100.));
+        return latencies[index] / 1000.;
+    };
+    std::cout << QUEUE::name << std::endl;
+    std::cout << std::fixed << std::setprecision(0);
+    std::cout << "    events         : " << latencies.size() << " (" << latencies.size() / elapsed << " events/sec)" << std::endl;
+    std::cout << std::setprecision(1);
+    std::cout << "    latency [us]   : p50 " << percentile(50) << ", p90 " << percentile(90) << ", p99 " << percentile(99)
+              << ", p99.9 " << percentile(99.9) << ", max " << latencies.back() / 1000. << std::endl;
+    std::cout << "    split frames   : " << split_frames << std::endl;
+}
+
+int main(int argc, char** argv){
+    BenchOptions options;
+    if (!options.parse(argc, argv)){
+        std::cerr << "usage: " << argv[0] << " [--producers N] [--events N] [--rate N] [--frame N]" << std::endl;
+        return 1;
+    }
+    run_bench<LockedQueue>(options);
+    run_bench<LockFreeQueue>(options);
+    return 0;
+}
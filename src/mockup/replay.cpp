@@ -0,0 +1,148 @@
+//
+// replay.cpp
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+//  headless driver to replay an event trace recorded by the option MOPT_EVENT_TRACE_FILE
+//  usage: replay [--fast] script-path trace-path
+//
+
+#include <iostream>
+#include <iomanip>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <cstring>
+#include "mappercore.h"
+
+class ReplayDriver{
+protected:
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool is_started = false;
+    bool is_stopped = false;
+    MapperHandle mapper = nullptr;
+
+public:
+    ReplayDriver(){
+        mapper = mapper_init(&ReplayDriver::event_handler, &ReplayDriver::console_handler, this);
+        mapper_set_option_boolean(mapper, MOPT_ASYNC_MESSAGE_PUMPING, true);
+    }
+
+    ~ReplayDriver(){
+        mapper_terminate(mapper);
+    }
+
+    int run(const char* script_path, const char* trace_path, bool realtime){
+        std::thread runner([this, script_path](){
+            mapper_run(mapper, script_path);
+            std::lock_guard lock(mutex);
+            is_stopped = true;
+            cv.notify_all();
+        });
+
+        {
+            std::unique_lock lock(mutex);
+            cv.wait(lock, [this](){return is_started || is_stopped;});
+            if (is_stopped){
+                lock.unlock();
+                runner.join();
+                std::cerr << "failed to start the script" << std::endl;
+                return 1;
+            }
+        }
+
+        auto stat_before = mapper_getMappingsStat(mapper);
+        auto start = std::chrono::steady_clock::now();
+        auto rc = mapper_replayEventTrace(mapper, trace_path, realtime);
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        auto stat_after = mapper_getMappingsStat(mapper);
+
+        if (rc){
+            auto num_events = stat_after.num_batched_events - stat_before.num_batched_events;
+            std::cout << "replayed " << num_events << " events in " << std::fixed << std::setprecision(3)
+                      << elapsed << " sec (" << std::setprecision(0) << (elapsed > 0 ? num_events / elapsed : 0)
+                      << " events/sec)" << std::endl << std::endl;
+            print_latencies();
+        }else{
+            std::cerr << "failed to replay the event trace" << std::endl;
+        }
+
+        mapper_stop(mapper);
+        runner.join();
+        return rc ? 0 : 1;
+    }
+
+protected:
+    static bool event_handler(MapperHandle mapper, MAPPER_EVENT ev, int64_t data){
+        auto self = reinterpret_cast<ReplayDriver*>(mapper_getHostContext(mapper));
+        if (ev == MEV_START_MAPPING){
+            std::lock_guard lock(self->mutex);
+            self->is_started = true;
+            self->cv.notify_all();
+        }
+        return true;
+    }
+
+    static bool console_handler(MapperHandle mapper, MCONSOLE_MESSAGE_TYPE type, const char *msg, size_t len){
+        if (type == MCONSOLE_ERROR || type == MCONSOLE_WARNING){
+            auto self = reinterpret_cast<ReplayDriver*>(mapper_getHostContext(mapper));
+            std::lock_guard lock(self->mutex);
+            std::cerr.write(msg, len);
+            std::cerr << std::endl;
+        }
+        return true;
+    }
+
+    static uint64_t percentile(const ACTION_LATENCY* latency, double ratio){
+        // upper bound of the bucket which contains the percentile
+        auto threshold = static_cast<uint64_t>(latency->count * ratio);
+        uint64_t accumulated = 0;
+        for (size_t i = 0; i < latency->num_buckets; i++){
+            accumulated += latency->buckets[i];
+            if (accumulated > threshold){
+                return (2ull << i) - 1;
+            }
+        }
+        return latency->max_ns;
+    }
+
+    static bool print_latency(MapperHandle mapper, void* context, const ACTION_LATENCY* latency){
+        auto mean = latency->count ? latency->total_ns / latency->count : 0;
+        std::cout << latency->event_name << " -> " << latency->action_name << std::endl;
+        std::cout << "    count: " << latency->count
+                  << ", mean: " << mean << " ns"
+                  << ", p50: <" << percentile(latency, 0.5) << " ns"
+                  << ", p99: <" << percentile(latency, 0.99) << " ns"
+                  << ", max: " << latency->max_ns << " ns" << std::endl;
+        for (size_t i = 0; i < latency->num_buckets; i++){
+            if (latency->buckets[i]){
+                std::cout << "    [" << std::setw(12) << (i == 0 ? 0ull : 1ull << i) << ", "
+                          << std::setw(12) << (2ull << i) << ") ns: " << latency->buckets[i] << std::endl;
+            }
+        }
+        return true;
+    }
+
+    void print_latencies(){
+        std::cout << "latency of actions:" << std::endl;
+        mapper_enumActionLatencies(mapper, &ReplayDriver::print_latency, nullptr);
+    }
+};
+
+int main(int argc, char* argv[]){
+    auto realtime = true;
+    int argi = 1;
+    if (argi < argc && strcmp(argv[argi], "--fast") == 0){
+        realtime = false;
+        argi++;
+    }
+    if (argc - argi < 2){
+        std::cerr << "usage: " << argv[0] << " [--fast] script-path trace-path" << std::endl;
+        return 1;
+    }
+
+    ReplayDriver driver;
+    return driver.run(argv[argi], argv[argi + 1], realtime);
+}
@@ -0,0 +1,408 @@
+//
+// serialbench.cpp
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+//  benchmark of PosixSerial against a pseudo terminal
+//  usage: serialbench write [--units N] [--events N]
+//         serialbench devices [--devices N] [--rate N] [--messages N]
+//
+//  write: Each event updates all output units of a panel twice as a script updating
+//         annunciator LEDs does, then a command is written as raw data. Unit values are
+//         written one by one as a message, then written to be coalesced. The other side of
+//         the pseudo terminal checks that the latest values of all units arrive before the
+//         command which follows them. (default: 40 units, 20000 events)
+//  devices: Devices echo back messages which are sent to them at a fixed rate, and the round
+//         trip time is measured. Serial ports of all devices share a reactor, then each
+//         serial port has its own reactor as a thread per device did. Context switches of
+//         the thread playing devices are included in both cases.
+//         (default: 16 devices, 500 messages/sec per device, 2000 messages per device)
+//
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <string>
+#include <charconv>
+#include <stdexcept>
+#include <cstdlib>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#if defined(__linux__)
+#   include <sys/syscall.h>
+#endif
+#include "builtinDevices/posixserial.h"
+#include "builtinDevices/serialreactor.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+//============================================================================================
+// Counting write(2) issued to the serial port
+//    The executable wraps write(2) on Linux, so that the calls from PosixSerial in the core
+//    library are counted.
+//============================================================================================
+static std::atomic<int> counted_fd{-1};
+static std::atomic<uint64_t> write_calls{0};
+
+#if defined(__linux__)
+extern "C" ssize_t write(int fd, const void* buf, size_t len){
+    if (fd == counted_fd){
+        write_calls++;
+    }
+    return syscall(SYS_write, fd, buf, len);
+}
+#endif
+
+static uint64_t context_switches(){
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+//============================================================================================
+// Pseudo terminal which plays a SimHID device
+//============================================================================================
+class PseudoTerminal{
+protected:
+    int fd_master;
+    std::string slave_path;
+
+public:
+    PseudoTerminal(){
+        fd_master = posix_openpt(O_RDWR | O_NOCTTY);
+        if (fd_master < 0 || grantpt(fd_master) != 0 || unlockpt(fd_master) != 0){
+            throw std::runtime_error("cannot open a pseudo terminal");
+        }
+        termios tio;
+        tcgetattr(fd_master, &tio);
+        cfmakeraw(&tio);
+        tcsetattr(fd_master, TCSANOW, &tio);
+        slave_path = ptsname(fd_master);
+    }
+    PseudoTerminal(const PseudoTerminal&) = delete;
+    ~PseudoTerminal(){close(fd_master);}
+
+    int getFd() const{return fd_master;}
+    const char* getSlavePath() const{return slave_path.c_str();}
+};
+
+// lines sent to the device are "S u<index> <value>" for unit values and "M <event>" for commands
+static void encode_unit_values(const SimhidUnitValue* values, size_t num, std::string& buf){
+    for (size_t i = 0; i < num; i++){
+        char number[16];
+        auto result = std::to_chars(number, number + sizeof(number), values[i].value);
+        buf.append("S u").append(std::to_string(values[i].index)).append(" ").append(number, result.ptr).append("\r\n");
+    }
+}
+
+static int unit_value(int event, int unit){
+    return event * 7 + unit;
+}
+
+class Receiver{
+protected:
+    const PseudoTerminal& pty;
+    std::vector<int> latest;
+    std::string line;
+    std::thread thread;
+    std::atomic<bool> should_stop{false};
+
+public:
+    std::atomic<int> received_event{-1};
+    uint64_t bytes = 0;
+    uint64_t violations = 0;
+
+    Receiver(const PseudoTerminal& pty, int units) : pty(pty), latest(units, -1){
+        thread = std::thread([this]{run();});
+    }
+    ~Receiver(){
+        should_stop = true;
+        thread.join();
+    }
+
+protected:
+    void run(){
+        char buf[4096];
+        pollfd pfd{pty.getFd(), POLLIN, 0};
+        while (!should_stop){
+            if (poll(&pfd, 1, 10) <= 0){
+                continue;
+            }
+            auto len = read(pty.getFd(), buf, sizeof(buf));
+            for (auto i = 0; i < len; i++){
+                if (buf[i] == '\n'){
+                    processLine();
+                    line.clear();
+                }else if (buf[i] != '\r'){
+                    line.push_back(buf[i]);
+                }
+            }
+            bytes += len > 0 ? len : 0;
+        }
+    }
+
+    void processLine(){
+        if (line.compare(0, 3, "S u") == 0){
+            auto separator = line.find(' ', 3);
+            auto unit = std::atoi(line.c_str() + 3);
+            latest.at(unit) = std::atoi(line.c_str() + separator + 1);
+        }else if (line.compare(0, 2, "M ") == 0){
+            auto event = std::atoi(line.c_str() + 2);
+            for (size_t unit = 0; unit < latest.size(); unit++){
+                violations += latest[unit] != unit_value(event, static_cast<int>(unit)) ? 1 : 0;
+            }
+            received_event = event;
+        }
+    }
+};
+
+//============================================================================================
+// Writing unit values and commands
+//============================================================================================
+struct BenchOptions{
+    int units = 40;
+    int events = 20000;
+    int devices = 16;
+    int rate = 500;
+    int messages = 2000;
+};
+
+static void run_write(const BenchOptions& options){
+    // events written ahead of the device, PosixSerial buffers them while the pty is full
+    constexpr auto WINDOW = 64;
+
+    std::cout << options.units << " units, " << options.events << " events" << std::endl;
+    for (auto is_coalesced : {false, true}){
+        SerialReactor reactor;
+        PseudoTerminal pty;
+        Receiver receiver{pty, options.units};
+        std::atomic<bool> is_closed{false};
+        PosixSerial serial{reactor, pty.getSlavePath()};
+        serial.setUnitValueEncoder(encode_unit_values);
+        serial.start([](const char*, int){}, [&is_closed](std::exception_ptr){is_closed = true;});
+        counted_fd = serial.getFd();
+        write_calls = 0;
+        auto switches = context_switches();
+
+        auto start = bench_clock::now();
+        for (auto event = 0; event < options.events; event++){
+            while (receiver.received_event < event - WINDOW){
+                std::this_thread::yield();
+            }
+            for (auto pass = 0; pass < 2; pass++){
+                for (auto unit = 0; unit < options.units; unit++){
+                    auto value = pass == 0 ? -unit_value(event, unit) : unit_value(event, unit);
+                    if (is_coalesced){
+                        serial.writeUnitValue(unit, value);
+                    }else{
+                        serial.SimHIDConnection::SerialComm::writeUnitValue(unit, value);
+                    }
+                }
+            }
+            serial.write("M " + std::to_string(event) + "\r\n");
+        }
+        while (receiver.received_event < options.events - 1){
+            std::this_thread::yield();
+        }
+        auto elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+        switches = context_switches() - switches;
+        counted_fd = -1;
+        serial.stop();
+        while (!is_closed){
+            std::this_thread::yield();
+        }
+
+        std::cout << (is_coalesced ? "coalesced unit values" : "a message per unit value") << std::endl;
+        std::cout << std::fixed << std::setprecision(0);
+        std::cout << "    throughput     : " << receiver.bytes / elapsed << " bytes/sec, "
+                  << options.events / elapsed << " events/sec" << std::endl;
+#if defined(__linux__)
+        std::cout << "    write(2)       : " << write_calls / elapsed << " calls/sec, "
+                  << std::setprecision(1) << static_cast<double>(receiver.bytes) / write_calls << " bytes/call" << std::endl;
+#endif
+        std::cout << std::setprecision(1);
+        std::cout << "    context switch : " << switches / elapsed << " /sec" << std::endl;
+        std::cout << "    out of order   : " << receiver.violations << " unit values" << std::endl;
+    }
+}
+
+//============================================================================================
+// Round trip through devices
+//============================================================================================
+class EchoDevices{
+protected:
+    std::vector<std::unique_ptr<PseudoTerminal>>& ptys;
+    std::thread thread;
+    std::atomic<bool> should_stop{false};
+
+public:
+    EchoDevices(std::vector<std::unique_ptr<PseudoTerminal>>& ptys) : ptys(ptys){
+        thread = std::thread([this]{run();});
+    }
+    ~EchoDevices(){
+        should_stop = true;
+        thread.join();
+    }
+
+protected:
+    void run(){
+        std::vector<pollfd> pfds;
+        for (auto& pty : ptys){
+            pfds.push_back({pty->getFd(), POLLIN, 0});
+        }
+        char buf[4096];
+        while (!should_stop){
+            if (poll(pfds.data(), pfds.size(), 10) <= 0){
+                continue;
+            }
+            for (auto& pfd : pfds){
+                if (pfd.revents & POLLIN){
+                    auto len = read(pfd.fd, buf, sizeof(buf));
+                    if (len > 0){
+                        [[maybe_unused]] auto rc = ::write(pfd.fd, buf, len);
+                    }
+                }
+            }
+        }
+    }
+};
+
+struct DeviceSession{
+    std::unique_ptr<PosixSerial> serial;
+    std::vector<bench_clock::time_point> sent;
+    std::vector<double> latencies;
+    std::string line;
+    std::atomic<bool> is_closed{false};
+
+    // called on the reactor thread
+    void onReceive(const char* data, int len){
+        auto now = bench_clock::now();
+        for (auto i = 0; i < len; i++){
+            if (data[i] == '\n'){
+                auto seq = std::atoi(line.c_str() + 2);
+                latencies.push_back(std::chrono::duration<double, std::micro>(now - sent.at(seq)).count());
+                line.clear();
+            }else if (data[i] != '\r'){
+                line.push_back(data[i]);
+            }
+        }
+    }
+};
+
+static void run_devices(const BenchOptions& options){
+    std::cout << options.devices << " devices, " << options.rate << " messages/sec per device, "
+              << options.messages << " messages per device" << std::endl;
+    for (auto is_shared : {true, false}){
+        std::vector<std::unique_ptr<PseudoTerminal>> ptys;
+        for (auto i = 0; i < options.devices; i++){
+            ptys.push_back(std::make_unique<PseudoTerminal>());
+        }
+        EchoDevices echo{ptys};
+        std::vector<std::unique_ptr<SerialReactor>> reactors;
+        for (auto i = 0; i < (is_shared ? 1 : options.devices); i++){
+            reactors.push_back(std::make_unique<SerialReactor>());
+        }
+        std::vector<std::unique_ptr<DeviceSession>> sessions;
+        for (auto i = 0; i < options.devices; i++){
+            auto session = std::make_unique<DeviceSession>();
+            auto raw = session.get();
+            session->serial = std::make_unique<PosixSerial>(*reactors[i % reactors.size()], ptys[i]->getSlavePath());
+            session->sent.resize(options.messages);
+            session->latencies.reserve(options.messages);
+            session->serial->start(
+                [raw](const char* data, int len){raw->onReceive(data, len);},
+                [raw](std::exception_ptr){raw->is_closed = true;});
+            sessions.push_back(std::move(session));
+        }
+
+        // messages are sent to devices in turn, so that each device receives them at the rate
+        auto interval = std::chrono::duration_cast<bench_clock::duration>(
+            std::chrono::duration<double>(1.0 / options.rate / options.devices));
+        auto switches = context_switches();
+        auto start = bench_clock::now();
+        auto next = start;
+        for (auto seq = 0; seq < options.messages; seq++){
+            for (auto& session : sessions){
+                std::this_thread::sleep_until(next);
+                next += interval;
+                session->sent[seq] = bench_clock::now();
+                session->serial->write("P " + std::to_string(seq) + "\r\n");
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        auto elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+        switches = context_switches() - switches;
+
+        std::vector<double> latencies;
+        for (auto& session : sessions){
+            session->serial->stop();
+            while (!session->is_closed){
+                std::this_thread::yield();
+            }
+            latencies.insert(latencies.end(), session->latencies.begin(), session->latencies.end());
+        }
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&latencies](double p){
+            return latencies.empty() ? 0. : latencies[std::min(latencies.size() - 1, static_cast<size_t>(latencies.size() * p / 100.))];
+        };
+        auto messages = static_cast<double>(options.messages) * options.devices;
+
+        std::cout << (is_shared ? "a reactor shared by all devices" : "a reactor per device") << std::endl;
+        std::cout << std::fixed << std::setprecision(1);
+        std::cout << "    round trip     : p50 " << percentile(50) << ", p99 " << percentile(99)
+                  << ", max " << (latencies.empty() ? 0. : latencies.back()) << " us" << std::endl;
+        std::cout << "    received       : " << latencies.size() << " in " << static_cast<size_t>(messages) << " messages" << std::endl;
+        std::cout << "    context switch : " << switches / elapsed << " /sec, "
+                  << std::setprecision(2) << switches / messages << " /message" << std::endl;
+    }
+}
+
+int main(int argc, char** argv){
+    std::string mode = argc > 1 ? argv[1] : "";
+    BenchOptions options;
+    auto is_valid = mode == "write" || mode == "devices";
+    for (auto i = 2; is_valid && i < argc; i += 2){
+        std::string option{argv[i]};
+        auto value = i + 1 < argc ? std::atoi(argv[i + 1]) : 0;
+        if (mode == "write" && option == "--units" && value > 0){
+            options.units = value;
+        }else if (mode == "write" && option == "--events" && value > 0){
+            options.events = value;
+        }else if (mode == "devices" && option == "--devices" && value > 0){
+            options.devices = value;
+        }else if (mode == "devices" && option == "--rate" && value > 0){
+            options.rate = value;
+        }else if (mode == "devices" && option == "--messages" && value > 0){
+            options.messages = value;
+        }else{
+            is_valid = false;
+        }
+    }
+    if (!is_valid){
+        std::cerr << "usage: " << argv[0] << " write [--units N] [--events N]" << std::endl;
+        std::cerr << "       " << argv[0] << " devices [--devices N] [--rate N] [--messages N]" << std::endl;
+        return 1;
+    }
+
+    try{
+        if (mode == "write"){
+            run_write(options);
+        }else{
+            run_devices(options);
+        }
+    }catch (const SimHIDConnection::Exception& e){
+        std::cerr << e.getMessage() << std::endl;
+        return 1;
+    }catch (const std::exception& e){
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,913 @@
+//
+// simhidtest.cpp
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+//  tests of the SimHID protocol implementation
+//  usage: simhidtest fuzz [--rounds N] [--seed N]
+//         simhidtest loopback [--units N] [--reports N]
+//
+//  fuzz:     Random streams are parsed by the bulk parser with random read sizes, and the
+//            result of each line is compared with the byte-wise parser. The unit name table
+//            built from random unit definitions is compared with std::map. Streams of binary
+//            frames with noise are parsed in the same way, and the result is compared with a
+//            reference decoder. (default: 2000 rounds)
+//  loopback: A device on a pseudo terminal streams unit value updates of all units as a
+//            report, and they are received by PosixSerial, parsed by the bulk parser and
+//            resolved by the unit name table as SimHIDConnection does. The byte-wise parser
+//            and std::map which were used before are measured as a baseline, then the binary
+//            protocol is measured. After that, unit values are written to the device with
+//            PosixSerial::writeUnitValue() in both protocols.
+//            (default: 128 units, 20000 reports)
+//
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <map>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <stdexcept>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include "builtinDevices/simhidparser.h"
+#include "builtinDevices/simhidconnection.h"
+#include "builtinDevices/posixserial.h"
+#include "builtinDevices/serialreactor.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+// the line buffer length of SimHIDConnection
+static constexpr int LINE_BUF_LEN = 256;
+
+//============================================================================================
+// Test driver
+//============================================================================================
+class Checker{
+protected:
+    int failed = 0;
+    int passed = 0;
+    int reported = 0;
+
+public:
+    void check(bool condition, const std::string& description){
+        if (condition){
+            passed++;
+        }else{
+            failed++;
+            // a broken implementation fails on many inputs, so only the first ones are shown
+            if (reported++ < 10){
+                std::cout << "    FAILED: " << description << std::endl;
+            }
+        }
+    }
+
+    int result(){
+        std::cout << "    " << passed << " passed, " << failed << " failed" << std::endl;
+        return failed;
+    }
+};
+
+static std::string printable(std::string_view data){
+    std::string result;
+    for (auto c : data){
+        if (c == '\r'){
+            result += "\\r";
+        }else if (c == '\n'){
+            result += "\\n";
+        }else if (c == '\t'){
+            result += "\\t";
+        }else if (static_cast<unsigned char>(c) < 0x20 || static_cast<unsigned char>(c) >= 0x7f){
+            char hex[8];
+            snprintf(hex, sizeof(hex), "\\x%02x", static_cast<unsigned char>(c));
+            result += hex;
+        }else{
+            result.push_back(c);
+        }
+    }
+    return result;
+}
+
+//============================================================================================
+// Exposing the unit name table of SimHIDConnection
+//============================================================================================
+class SimHIDConnectionProbe : public SimHIDConnection{
+public:
+    using SimHIDConnection::UnitDef;
+    using SimHIDConnection::UnitNameTable;
+};
+using UnitDef = SimHIDConnectionProbe::UnitDef;
+using UnitNameTable = SimHIDConnectionProbe::UnitNameTable;
+
+static std::vector<UnitDef> make_unit_defs(const std::vector<std::string>& names){
+    std::vector<UnitDef> defs;
+    for (auto name : names){
+        defs.emplace_back(defs.size(), name, FSMDU_DIR_INPUT, FSMDU_TYPE_ABSOLUTE, 0, 1023);
+    }
+    return defs;
+}
+
+//============================================================================================
+// Differential fuzzing of the text parser
+//============================================================================================
+struct ParsedLine{
+    bool is_error;
+    bool is_too_long;
+    int command;
+    std::vector<std::string> params;
+    std::vector<std::optional<int>> numbers;
+
+    explicit ParsedLine(const SimhidParserCtx& ctx) :
+        is_error(ctx.err != nullptr), is_too_long(ctx.err && std::strcmp(ctx.err, "too long line") == 0),
+        command(ctx.command){
+        if (is_error){
+            return;
+        }
+        for (auto i = 0; i < ctx.paramnum; i++){
+            const auto& param = ctx.params[i];
+            params.emplace_back(param.strvalue, param.len);
+            numbers.push_back(param.isNumber ? std::optional<int>(param.numvalue) : std::nullopt);
+        }
+    }
+
+    std::string describe() const{
+        if (is_error){
+            return is_too_long ? "[too long]" : "[error]";
+        }
+        std::string result = command > 0 ? std::string(1, static_cast<char>(command)) : "[empty]";
+        for (size_t i = 0; i < params.size(); i++){
+            result += " " + printable(params[i]) + (numbers[i] ? "(" + std::to_string(*numbers[i]) + ")" : "");
+        }
+        return result;
+    }
+
+    bool operator == (const ParsedLine& rhs) const{
+        // a line may have several errors, and the error which is detected first differs since
+        // the byte-wise parser tokenizes a line before reaching the end
+        if (is_error || rhs.is_error){
+            return is_error == rhs.is_error;
+        }
+        return command == rhs.command && params == rhs.params && numbers == rhs.numbers;
+    }
+};
+
+class LineGenerator{
+protected:
+    std::mt19937& random;
+
+public:
+    LineGenerator(std::mt19937& random) : random(random){}
+
+    // lines are always terminated by CR LF, since the byte-wise parser does not recover from a
+    // bare LF or CR in the same way as the bulk parser
+    std::string generate(){
+        auto kind = random() % 20;
+        std::string line;
+        if (kind == 0){
+            // empty line
+        }else if (kind == 1){
+            // garbage
+            auto len = random() % 40;
+            for (size_t i = 0; i < len; i++){
+                char c;
+                do{
+                    c = static_cast<char>(random());
+                }while (c == '\r' || c == '\n');
+                line.push_back(c);
+            }
+        }else if (kind == 2){
+            // longer than the line buffer
+            line = "S " + std::string(LINE_BUF_LEN - 8 + random() % 16, 'x') + " 1";
+        }else{
+            line += separators(random() % 4 == 0 ? 1 : 0);
+            line.push_back("SIDBsidbXZ"[random() % 10]);
+            auto num = random() % 10 == 0 ? COMMAND_MAX_PARAM - 1 + random() % 3 : random() % 5;
+            for (size_t i = 0; i < num; i++){
+                line += separators(1);
+                line += token();
+            }
+            line += separators(random() % 4 == 0 ? 1 : 0);
+        }
+        return line + "\r\n";
+    }
+
+protected:
+    std::string separators(int min){
+        std::string result;
+        auto num = min + random() % 3;
+        for (size_t i = 0; i < num; i++){
+            result.push_back(random() % 4 == 0 ? '\t' : ' ');
+        }
+        return result;
+    }
+
+    std::string token(){
+        // a string token begins with a letter, since both parsers do not detect overflow of
+        // a number
+        static const char letters[] = "abcxyzABCXYZ";
+        static const char chars[] = "abcxyzABCXYZ_:.-0123456789";
+        auto kind = random() % 4;
+        std::string result;
+        if (kind < 2){
+            // number, which may have a sign or leading zeros
+            if (random() % 3 == 0){
+                result.push_back('-');
+            }
+            auto digits = 1 + random() % 9;
+            for (size_t i = 0; i < digits; i++){
+                result.push_back(static_cast<char>('0' + random() % 10));
+            }
+        }else{
+            result.push_back(letters[random() % (sizeof(letters) - 1)]);
+            auto len = random() % 12;
+            for (size_t i = 0; i < len; i++){
+                result.push_back(chars[random() % (sizeof(chars) - 1)]);
+            }
+        }
+        return result;
+    }
+};
+
+static std::vector<ParsedLine> parse_bytewise(const std::string& stream){
+    char buf[LINE_BUF_LEN];
+    SimhidParserCtx ctx;
+    simhid_parser_init(&ctx, buf, sizeof(buf));
+    std::vector<ParsedLine> lines;
+    for (auto c : stream){
+        if (simhid_parser_parse(&ctx, c)){
+            lines.emplace_back(ctx);
+        }
+    }
+    return lines;
+}
+
+struct BulkParseResult{
+    std::vector<ParsedLine> lines;
+    // pairs of the number of parsed lines and the returned length when parsing is stopped
+    std::vector<std::pair<size_t, size_t>> stops;
+};
+
+static BulkParseResult parse_bulk(const std::string& stream, std::mt19937& random){
+    struct Context{
+        BulkParseResult result;
+        std::mt19937& random;
+        bool is_stopped;
+    } context{{}, random, false};
+    char buf[LINE_BUF_LEN];
+    SimhidParserCtx ctx;
+    simhid_parser_init(&ctx, buf, sizeof(buf));
+    auto handler = [](SimhidParserCtx* ctx, void* context){
+        auto self = reinterpret_cast<Context*>(context);
+        self->result.lines.emplace_back(*ctx);
+        // parsing is stopped sometimes as SimHIDConnection does when it switches to binary mode
+        self->is_stopped = self->random() % 8 == 0;
+        return !self->is_stopped;
+    };
+    size_t offset = 0;
+    while (offset < stream.size()){
+        auto len = std::min<size_t>(stream.size() - offset, 1 + context.random() % 300);
+        auto chunk_end = offset + len;
+        while (offset < chunk_end){
+            context.is_stopped = false;
+            offset += simhid_parser_parse_bulk(&ctx, stream.data() + offset, static_cast<int>(chunk_end - offset), handler, &context);
+            if (context.is_stopped){
+                context.result.stops.emplace_back(context.result.lines.size(), offset);
+            }
+        }
+    }
+    return context.result;
+}
+
+static void fuzz_text_parser(std::mt19937& random, int rounds, Checker& checker){
+    std::cout << "text parser" << std::endl;
+    LineGenerator generator{random};
+    for (auto round = 0; round < rounds; round++){
+        std::string stream;
+        std::vector<std::string> lines;
+        std::vector<size_t> line_ends;
+        auto num = 1 + random() % 50;
+        for (size_t i = 0; i < num; i++){
+            lines.push_back(generator.generate());
+            stream += lines.back();
+            line_ends.push_back(stream.size());
+        }
+
+        auto reference = parse_bytewise(stream);
+        auto bulk = parse_bulk(stream, random);
+        checker.check(bulk.lines.size() == lines.size(), "bulk parser reports every line");
+        checker.check(reference.size() == lines.size(), "byte-wise parser reports every line");
+        if (bulk.lines.size() != lines.size() || reference.size() != lines.size()){
+            continue;
+        }
+        for (size_t i = 0; i < lines.size(); i++){
+            auto description = "line \"" + printable(lines[i]) + "\"";
+            checker.check(bulk.lines[i] == reference[i], "same result as byte-wise parser for " + description +
+                          ": " + bulk.lines[i].describe() + " <> " + reference[i].describe());
+            if (static_cast<int>(lines[i].size()) - 1 > LINE_BUF_LEN){
+                checker.check(bulk.lines[i].is_too_long, "too long " + description);
+            }
+        }
+        for (const auto& [parsed, offset] : bulk.stops){
+            checker.check(offset == line_ends[parsed - 1], "bulk parser stops at the end of a line");
+        }
+    }
+}
+
+//============================================================================================
+// Differential fuzzing of the unit name table
+//============================================================================================
+static void fuzz_unit_name_table(std::mt19937& random, int rounds, Checker& checker){
+    std::cout << "unit name table" << std::endl;
+    auto random_name = [&random](){
+        static const char chars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_";
+        std::string name;
+        auto len = 1 + random() % 12;
+        for (size_t i = 0; i < len; i++){
+            name.push_back(chars[random() % (sizeof(chars) - 1)]);
+        }
+        return name;
+    };
+    for (auto round = 0; round < rounds; round++){
+        // names of real devices tend to differ only in a number, and duplicated names are allowed
+        std::vector<std::string> names;
+        auto num = random() % 300;
+        for (size_t i = 0; i < num; i++){
+            auto kind = random() % 4;
+            if (kind == 0 && !names.empty()){
+                names.push_back(names[random() % names.size()]);
+            }else if (kind == 1){
+                names.push_back("SW" + std::to_string(i));
+            }else{
+                names.push_back(random_name());
+            }
+        }
+        std::map<std::string, size_t> reference;
+        for (size_t i = 0; i < names.size(); i++){
+            reference[names[i]] = i;
+        }
+        UnitNameTable table;
+        table.build(make_unit_defs(names));
+
+        auto is_matched = true;
+        for (const auto& [name, index] : reference){
+            auto found = table.find(name);
+            is_matched = is_matched && found && *found == index;
+        }
+        checker.check(is_matched, "all of " + std::to_string(reference.size()) + " names are resolved");
+        auto is_rejected = true;
+        for (auto i = 0; i < 100; i++){
+            auto name = random_name() + (random() % 2 ? "" : "#");
+            is_rejected = is_rejected && (reference.count(name) > 0 || !table.find(name));
+        }
+        checker.check(is_rejected, "unknown names are rejected");
+    }
+    UnitNameTable empty;
+    checker.check(!empty.find("SW1"), "an empty table rejects any names");
+}
+
+//============================================================================================
+// Differential fuzzing of the binary frame codec
+//    The reference decoder follows the frame definition in simhidparser.h with the whole
+//    stream at hand.
+//============================================================================================
+struct DecodedFrame{
+    bool is_error;
+    std::vector<std::pair<int, int>> values;
+    size_t end;
+
+    bool operator == (const DecodedFrame& rhs) const{
+        return is_error == rhs.is_error && values == rhs.values;
+    }
+};
+
+static std::vector<DecodedFrame> decode_frames_reference(const std::string& stream){
+    std::vector<DecodedFrame> frames;
+    auto byte = [&stream](size_t position){return static_cast<unsigned char>(stream[position]);};
+    size_t position = 0;
+    while (position < stream.size()){
+        if (byte(position++) != SIMHID_FRAME_SOF){
+            continue;
+        }
+        if (position + 2 > stream.size()){
+            break;
+        }
+        int length = byte(position) | (byte(position + 1) << 8);
+        unsigned sum = byte(position) + byte(position + 1);
+        position += 2;
+        if (length > SIMHID_FRAME_MAX_PAYLOAD || length % SIMHID_FRAME_PAIR_LEN != 0){
+            frames.push_back({true, {}, position});
+            continue;
+        }
+        if (position + length + SIMHID_FRAME_TRAILER_LEN > stream.size()){
+            break;
+        }
+        DecodedFrame frame{false, {}, 0};
+        for (auto i = 0; i < length; i++){
+            sum += byte(position + i);
+        }
+        for (auto i = 0; i < length; i += SIMHID_FRAME_PAIR_LEN){
+            auto pair = position + i;
+            int index = byte(pair) | (byte(pair + 1) << 8);
+            uint32_t value = byte(pair + 2) | (byte(pair + 3) << 8) | (byte(pair + 4) << 16) |
+                             (static_cast<uint32_t>(byte(pair + 5)) << 24);
+            frame.values.emplace_back(index, static_cast<int>(value));
+        }
+        sum += byte(position + length);
+        position += length + SIMHID_FRAME_TRAILER_LEN;
+        if (sum & 0xff){
+            frame.is_error = true;
+            frame.values.clear();
+        }
+        frame.end = position;
+        frames.push_back(std::move(frame));
+    }
+    return frames;
+}
+
+struct FrameParseResult{
+    std::vector<DecodedFrame> frames;
+    std::vector<std::pair<size_t, size_t>> stops;
+};
+
+static FrameParseResult parse_frames(const std::string& stream, std::mt19937& random){
+    struct Context{
+        FrameParseResult result;
+        std::mt19937& random;
+        bool is_stopped;
+    } context{{}, random, false};
+    SimhidFrameParserCtx ctx;
+    simhid_frame_parser_init(&ctx);
+    auto handler = [](SimhidFrameParserCtx* ctx, const SimhidUnitValue* values, int num, void* context){
+        auto self = reinterpret_cast<Context*>(context);
+        DecodedFrame frame{ctx->err != nullptr, {}, 0};
+        for (auto i = 0; i < num; i++){
+            frame.values.emplace_back(values[i].index, values[i].value);
+        }
+        self->result.frames.push_back(std::move(frame));
+        self->is_stopped = self->random() % 8 == 0;
+        return !self->is_stopped;
+    };
+    size_t offset = 0;
+    while (offset < stream.size()){
+        auto len = std::min<size_t>(stream.size() - offset, 1 + context.random() % 500);
+        auto chunk_end = offset + len;
+        while (offset < chunk_end){
+            context.is_stopped = false;
+            offset += simhid_frame_parse_bulk(&ctx, stream.data() + offset, static_cast<int>(chunk_end - offset), handler, &context);
+            if (context.is_stopped){
+                context.result.stops.emplace_back(context.result.frames.size(), offset);
+            }
+        }
+    }
+    return context.result;
+}
+
+static void fuzz_frame_codec(std::mt19937& random, int rounds, Checker& checker){
+    std::cout << "binary frame codec" << std::endl;
+    for (auto round = 0; round < rounds; round++){
+        // frames are mixed with garbage, headers with invalid length and corrupted bytes
+        std::string stream;
+        std::vector<std::vector<std::pair<int, int>>> encoded;
+        auto has_noise = random() % 2 == 0;
+        auto num = 1 + random() % 30;
+        for (size_t i = 0; i < num; i++){
+            auto kind = has_noise ? random() % 8 : 0;
+            if (kind == 0 || kind > 2){
+                std::vector<SimhidUnitValue> values(random() % (SIMHID_FRAME_MAX_PAIRS + 1));
+                std::vector<std::pair<int, int>> pairs;
+                for (auto& value : values){
+                    value.index = random() % 0x10000;
+                    value.value = static_cast<int>(random());
+                    pairs.emplace_back(value.index, value.value);
+                }
+                char buf[SIMHID_FRAME_MAX_LEN];
+                auto length = simhid_frame_encode(buf, sizeof(buf), values.data(), static_cast<int>(values.size()));
+                checker.check(length == SIMHID_FRAME_HEADER_LEN + SIMHID_FRAME_PAIR_LEN * static_cast<int>(values.size()) +
+                                        SIMHID_FRAME_TRAILER_LEN, "length of an encoded frame");
+                stream.append(buf, length);
+                encoded.push_back(std::move(pairs));
+            }else if (kind == 1){
+                auto len = random() % 20;
+                for (size_t j = 0; j < len; j++){
+                    stream.push_back(static_cast<char>(random()));
+                }
+            }else{
+                auto length = random() % 2 ? SIMHID_FRAME_MAX_PAYLOAD + SIMHID_FRAME_PAIR_LEN : 1 + random() % 5;
+                stream.push_back(static_cast<char>(SIMHID_FRAME_SOF));
+                stream.push_back(static_cast<char>(length & 0xff));
+                stream.push_back(static_cast<char>(length >> 8));
+            }
+        }
+        if (has_noise && !stream.empty()){
+            auto corruptions = random() % 4;
+            for (size_t i = 0; i < corruptions; i++){
+                stream[random() % stream.size()] ^= static_cast<char>(1 + random() % 255);
+            }
+        }
+
+        auto reference = decode_frames_reference(stream);
+        auto result = parse_frames(stream, random);
+        checker.check(result.frames == reference, "same frames as reference decoder in a stream of " +
+                      std::to_string(stream.size()) + " bytes");
+        for (const auto& [parsed, offset] : result.stops){
+            checker.check(parsed <= reference.size() && offset == reference[parsed - 1].end,
+                          "frame parser stops at the end of a frame");
+        }
+        if (!has_noise){
+            auto is_matched = reference.size() == encoded.size();
+            for (size_t i = 0; is_matched && i < encoded.size(); i++){
+                is_matched = !reference[i].is_error && reference[i].values == encoded[i];
+            }
+            checker.check(is_matched, "encoded frames are decoded as they are");
+        }
+    }
+
+    char buf[SIMHID_FRAME_MAX_LEN];
+    SimhidUnitValue values[SIMHID_FRAME_MAX_PAIRS + 1] = {};
+    checker.check(simhid_frame_encode(buf, sizeof(buf), values, SIMHID_FRAME_MAX_PAIRS + 1) < 0, "too many pairs are rejected");
+    checker.check(simhid_frame_encode(buf, SIMHID_FRAME_MAX_LEN - 1, values, SIMHID_FRAME_MAX_PAIRS) < 0, "short buffer is rejected");
+}
+
+static int run_fuzz(int rounds, int seed){
+    Checker checker;
+    std::mt19937 random(seed);
+    fuzz_text_parser(random, rounds, checker);
+    fuzz_unit_name_table(random, rounds / 10 + 1, checker);
+    fuzz_frame_codec(random, rounds, checker);
+    return checker.result() ? 1 : 0;
+}
+
+//============================================================================================
+// Loopback through a pseudo terminal
+//============================================================================================
+class PseudoTerminal{
+protected:
+    int fd_master;
+    std::string slave_path;
+
+public:
+    PseudoTerminal(){
+        fd_master = posix_openpt(O_RDWR | O_NOCTTY);
+        if (fd_master < 0 || grantpt(fd_master) != 0 || unlockpt(fd_master) != 0){
+            throw std::runtime_error("cannot open a pseudo terminal");
+        }
+        termios tio;
+        tcgetattr(fd_master, &tio);
+        cfmakeraw(&tio);
+        tcsetattr(fd_master, TCSANOW, &tio);
+        slave_path = ptsname(fd_master);
+    }
+    PseudoTerminal(const PseudoTerminal&) = delete;
+    ~PseudoTerminal(){close(fd_master);}
+
+    int getFd() const{return fd_master;}
+    const char* getSlavePath() const{return slave_path.c_str();}
+
+    void writeAll(const std::string& data){
+        for (size_t offset = 0; offset < data.size();){
+            auto result = ::write(fd_master, data.data() + offset, data.size() - offset);
+            if (result < 0 && errno != EINTR && errno != EAGAIN){
+                throw std::runtime_error("cannot write to a pseudo terminal");
+            }
+            offset += result > 0 ? result : 0;
+        }
+    }
+};
+
+struct LoopbackOptions{
+    int units = 128;
+    int reports = 20000;
+};
+
+static int unit_value(int report, int unit){
+    return report * 31 - unit;
+}
+
+// receiving side which decodes unit values as SimHIDConnection or a SimHID device does
+class LoopbackReceiver{
+public:
+    enum class Method{
+        bytewise,
+        bulk,
+        binary,
+    };
+
+protected:
+    Method method;
+    UnitNameTable table;
+    std::map<std::string, size_t> names;
+    SimhidParserCtx parser;
+    char line_buf[LINE_BUF_LEN];
+    SimhidFrameParserCtx frame_parser;
+    std::vector<int> latest_reports;
+
+public:
+    std::atomic<uint64_t> updates{0};
+    // the latest report of the last unit
+    std::atomic<int> progress{-1};
+    uint64_t bytes = 0;
+    uint64_t mismatches = 0;
+    uint64_t errors = 0;
+
+    LoopbackReceiver(Method method, const std::vector<std::string>& names) :
+        method(method), latest_reports(names.size(), -1){
+        table.build(make_unit_defs(names));
+        for (size_t i = 0; i < names.size(); i++){
+            this->names[names[i]] = i;
+        }
+        simhid_parser_init(&parser, line_buf, sizeof(line_buf));
+        simhid_frame_parser_init(&frame_parser);
+    }
+
+    static const char* getMethodName(Method method){
+        if (method == Method::bytewise){
+            return "text protocol with byte-wise parser and std::map";
+        }else if (method == Method::bulk){
+            return "text protocol with bulk parser and unit name table";
+        }else{
+            return "binary protocol";
+        }
+    }
+
+    void receive(const char* data, int len){
+        bytes += len;
+        if (method == Method::bytewise){
+            for (auto i = 0; i < len; i++){
+                if (simhid_parser_parse(&parser, data[i])){
+                    processLine(&parser, this);
+                }
+            }
+        }else if (method == Method::bulk){
+            for (auto offset = 0; offset < len;){
+                offset += simhid_parser_parse_bulk(&parser, data + offset, len - offset, &LoopbackReceiver::processLine, this);
+            }
+        }else{
+            simhid_frame_parse_bulk(&frame_parser, data, len, &LoopbackReceiver::processFrame, this);
+        }
+    }
+
+    bool isLatest(int report) const{
+        for (auto latest : latest_reports){
+            if (latest != report){
+                return false;
+            }
+        }
+        return true;
+    }
+
+protected:
+    static bool processLine(SimhidParserCtx* ctx, void* context){
+        auto self = reinterpret_cast<LoopbackReceiver*>(context);
+        if (ctx->err || ctx->command != 'S' || ctx->paramnum != 2 || !ctx->params[1].isNumber){
+            self->errors++;
+            return true;
+        }
+        std::optional<size_t> index;
+        if (self->method == Method::bytewise){
+            auto entry = self->names.find(std::string(ctx->params[0].strvalue, ctx->params[0].len));
+            index = entry != self->names.end() ? std::optional<size_t>(entry->second) : std::nullopt;
+        }else{
+            index = self->table.find({ctx->params[0].strvalue, static_cast<size_t>(ctx->params[0].len)});
+        }
+        if (!index){
+            self->errors++;
+            return true;
+        }
+        self->update(static_cast<int>(*index), ctx->params[1].numvalue);
+        return true;
+    }
+
+    static bool processFrame(SimhidFrameParserCtx* ctx, const SimhidUnitValue* values, int num, void* context){
+        auto self = reinterpret_cast<LoopbackReceiver*>(context);
+        if (ctx->err){
+            self->errors++;
+            return true;
+        }
+        for (auto i = 0; i < num; i++){
+            if (values[i].index < 0 || static_cast<size_t>(values[i].index) >= self->latest_reports.size()){
+                self->errors++;
+                continue;
+            }
+            self->update(values[i].index, values[i].value);
+        }
+        return true;
+    }
+
+    void update(int index, int value){
+        // values of a unit must arrive in order, superseded values may be dropped by a sender
+        auto report = (value + index) / 31;
+        if ((value + index) % 31 != 0 || report <= latest_reports[index]){
+            mismatches++;
+            return;
+        }
+        latest_reports[index] = report;
+        updates++;
+        if (static_cast<size_t>(index) == latest_reports.size() - 1){
+            progress = report;
+        }
+    }
+};
+
+static void encode_text(const std::vector<std::string>& names, const SimhidUnitValue* values, size_t num, std::string& buf){
+    for (size_t i = 0; i < num; i++){
+        buf.append("S ").append(names[values[i].index]).append(" ").append(std::to_string(values[i].value)).append("\r\n");
+    }
+}
+
+static void encode_binary(const SimhidUnitValue* values, size_t num, std::string& buf){
+    for (size_t i = 0; i < num; i += SIMHID_FRAME_MAX_PAIRS){
+        auto pairs = std::min<size_t>(num - i, SIMHID_FRAME_MAX_PAIRS);
+        auto offset = buf.size();
+        buf.resize(offset + SIMHID_FRAME_MAX_LEN);
+        auto length = simhid_frame_encode(buf.data() + offset, SIMHID_FRAME_MAX_LEN, values + i, static_cast<int>(pairs));
+        buf.resize(offset + length);
+    }
+}
+
+static void print_loopback_result(const char* title, const LoopbackReceiver& receiver, uint64_t expected, double elapsed){
+    std::cout << title << std::endl;
+    std::cout << std::fixed << std::setprecision(0);
+    std::cout << "    throughput     : " << receiver.updates / elapsed << " updates/sec, "
+              << receiver.bytes / elapsed << " bytes/sec" << std::endl;
+    std::cout << "    received       : " << receiver.updates << " in " << expected << " updates" << std::endl;
+    std::cout << "    wrong values   : " << receiver.mismatches << std::endl;
+    std::cout << "    broken data    : " << receiver.errors << std::endl;
+}
+
+// device to host, every update must be received
+static int run_inbound(const LoopbackOptions& options, const std::vector<std::string>& names){
+    auto failed = 0;
+    auto expected = static_cast<uint64_t>(options.units) * options.reports;
+    for (auto method : {LoopbackReceiver::Method::bytewise, LoopbackReceiver::Method::bulk, LoopbackReceiver::Method::binary}){
+        // reports are encoded in advance so that the device side is not a bottleneck
+        std::vector<std::string> reports;
+        std::vector<SimhidUnitValue> values(options.units);
+        for (auto report = 0; report < options.reports; report++){
+            for (auto unit = 0; unit < options.units; unit++){
+                values[unit] = {unit, unit_value(report, unit)};
+            }
+            std::string data;
+            if (method == LoopbackReceiver::Method::binary){
+                encode_binary(values.data(), values.size(), data);
+            }else{
+                encode_text(names, values.data(), values.size(), data);
+            }
+            reports.push_back(std::move(data));
+        }
+
+        SerialReactor reactor;
+        PseudoTerminal pty;
+        LoopbackReceiver host{method, names};
+        std::atomic<bool> is_closed{false};
+        PosixSerial serial{reactor, pty.getSlavePath()};
+        serial.start([&host](const char* data, int len){host.receive(data, len);},
+                     [&is_closed](std::exception_ptr){is_closed = true;});
+
+        auto start = bench_clock::now();
+        for (const auto& report : reports){
+            pty.writeAll(report);
+        }
+        auto deadline = bench_clock::now() + std::chrono::seconds(5);
+        while (host.updates < expected && bench_clock::now() < deadline){
+            std::this_thread::yield();
+        }
+        auto elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+        serial.stop();
+        while (!is_closed){
+            std::this_thread::yield();
+        }
+
+        print_loopback_result((std::string("inbound: ") + LoopbackReceiver::getMethodName(method)).c_str(), host, expected, elapsed);
+        failed += host.updates == expected && host.mismatches == 0 && host.errors == 0 ? 0 : 1;
+    }
+    return failed;
+}
+
+// host to device, superseded values may be dropped by PosixSerial, but the latest values must
+// be received
+static int run_outbound(const LoopbackOptions& options, const std::vector<std::string>& names){
+    // reports written ahead of the device, PosixSerial coalesces them while the pty is full
+    constexpr auto WINDOW = 16;
+
+    auto failed = 0;
+    auto expected = static_cast<uint64_t>(options.units) * options.reports;
+    for (auto method : {LoopbackReceiver::Method::bulk, LoopbackReceiver::Method::binary}){
+        SerialReactor reactor;
+        PseudoTerminal pty;
+        LoopbackReceiver device{method, names};
+        std::atomic<bool> is_closed{false};
+        PosixSerial serial{reactor, pty.getSlavePath()};
+        if (method == LoopbackReceiver::Method::binary){
+            serial.setUnitValueEncoder(encode_binary);
+        }else{
+            serial.setUnitValueEncoder([&names](const SimhidUnitValue* values, size_t num, std::string& buf){
+                encode_text(names, values, num, buf);
+            });
+        }
+        serial.start([](const char*, int){}, [&is_closed](std::exception_ptr){is_closed = true;});
+
+        std::atomic<bool> should_stop{false};
+        std::thread reader([&](){
+            char buf[4096];
+            pollfd pfd{pty.getFd(), POLLIN, 0};
+            while (!should_stop){
+                if (poll(&pfd, 1, 10) > 0){
+                    auto len = read(pty.getFd(), buf, sizeof(buf));
+                    if (len > 0){
+                        device.receive(buf, static_cast<int>(len));
+                    }
+                }
+            }
+        });
+
+        auto start = bench_clock::now();
+        for (auto report = 0; report < options.reports; report++){
+            while (device.progress < report - WINDOW){
+                std::this_thread::yield();
+            }
+            for (auto unit = 0; unit < options.units; unit++){
+                serial.writeUnitValue(unit, unit_value(report, unit));
+            }
+        }
+        auto deadline = bench_clock::now() + std::chrono::seconds(5);
+        while (device.progress < options.reports - 1 && bench_clock::now() < deadline){
+            std::this_thread::yield();
+        }
+        auto elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+        should_stop = true;
+        reader.join();
+        serial.stop();
+        while (!is_closed){
+            std::this_thread::yield();
+        }
+
+        print_loopback_result((std::string("outbound: ") + LoopbackReceiver::getMethodName(method)).c_str(), device, expected, elapsed);
+        std::cout << std::fixed << std::setprecision(0);
+        std::cout << "    written        : " << expected / elapsed << " updates/sec" << std::endl;
+        auto is_latest = device.isLatest(options.reports - 1);
+        std::cout << "    latest values  : " << (is_latest ? "received" : "NOT received") << std::endl;
+        failed += is_latest && device.mismatches == 0 && device.errors == 0 ? 0 : 1;
+    }
+    return failed;
+}
+
+static int run_loopback(const LoopbackOptions& options){
+    std::vector<std::string> names;
+    for (auto i = 0; i < options.units; i++){
+        names.push_back("SW" + std::to_string(i));
+    }
+    std::cout << options.units << " units, " << options.reports << " reports" << std::endl;
+    auto failed = run_inbound(options, names);
+    failed += run_outbound(options, names);
+    return failed ? 1 : 0;
+}
+
+//============================================================================================
+// Entry point
+//============================================================================================
+int main(int argc, char** argv){
+    std::string mode = argc > 1 ? argv[1] : "";
+    auto rounds = 2000;
+    auto seed = 1;
+    LoopbackOptions loopback;
+    auto is_valid = mode == "fuzz" || mode == "loopback";
+    for (auto i = 2; is_valid && i < argc; i += 2){
+        std::string option{argv[i]};
+        auto value = i + 1 < argc ? std::atoi(argv[i + 1]) : 0;
+        if (mode == "fuzz" && option == "--rounds" && value > 0){
+            rounds = value;
+        }else if (mode == "fuzz" && option == "--seed" && i + 1 < argc){
+            seed = value;
+        }else if (mode == "loopback" && option == "--units" && value > 0){
+            loopback.units = value;
+        }else if (mode == "loopback" && option == "--reports" && value > 0){
+            loopback.reports = value;
+        }else{
+            is_valid = false;
+        }
+    }
+    if (!is_valid){
+        std::cerr << "usage: " << argv[0] << " fuzz [--rounds N] [--seed N]" << std::endl;
+        std::cerr << "       " << argv[0] << " loopback [--units N] [--reports N]" << std::endl;
+        return 1;
+    }
+
+    try{
+        return mode == "fuzz" ? run_fuzz(rounds, seed) : run_loopback(loopback);
+    }catch (const SimHIDConnection::Exception& e){
+        std::cerr << e.getMessage() << std::endl;
+    }catch (const std::exception& e){
+        std::cerr << e.what() << std::endl;
+    }
+    return 1;
+}
@@ -0,0 +1,194 @@
+//
+// timerbench.cpp
+//  Author: Hiroshi Murayama <opiopan@gmail.com>
+//
+//  benchmark of the timer queue shared by deferred actions and device modifiers
+//  usage: timerbench [--timers N] [--spread N] [--rounds N]
+//      --timers N     number of concurrent timers (default: 10000)
+//      --spread N     deadlines are distributed in N milliseconds (default: 100)
+//      --rounds N     number of expirations in the churn phase (default: 20000)
+//
+//  TimerQueue is compared with std::map keyed by deadline, which was used before TimerQueue.
+//  A map cannot hold timers of a same deadline, so a colliding timer was moved 1 ms later
+//  until a free deadline was found.
+//
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <map>
+#include <vector>
+#include <random>
+#include <string>
+#include <cstdlib>
+#include "timerqueue.h"
+
+using bench_clock = std::chrono::steady_clock;
+using TIME_POINT = std::chrono::steady_clock::time_point;
+using MILLISEC = std::chrono::milliseconds;
+
+struct Payload{
+    uint64_t id;
+    TIME_POINT requested;
+    char body[32] = {};
+};
+
+//============================================================================================
+// Timer containers to compare
+//============================================================================================
+class LegacyTimers{
+protected:
+    std::map<TIME_POINT, Payload> timers;
+
+public:
+    using Handle = TIME_POINT;
+    static constexpr auto name = "std::map with 1 ms probing";
+
+    Handle add(TIME_POINT deadline, const Payload& payload){
+        while (timers.count(deadline)){
+            deadline += MILLISEC(1);
+        }
+        timers.emplace(deadline, payload);
+        return deadline;
+    }
+
+    void cancel(Handle handle){
+        timers.erase(handle);
+    }
+
+    template <typename HANDLER>
+    bool pop(HANDLER&& handler){
+        if (timers.empty()){
+            return false;
+        }
+        auto top = timers.begin();
+        handler(top->first, top->second);
+        timers.erase(top);
+        return true;
+    }
+};
+
+class HeapTimers{
+protected:
+    TimerQueue<TIME_POINT, Payload> timers;
+
+public:
+    using Handle = TimerQueue<TIME_POINT, Payload>::Handle;
+    static constexpr auto name = "TimerQueue";
+
+    Handle add(TIME_POINT deadline, const Payload& payload){
+        return timers.add(deadline, payload);
+    }
+
+    void cancel(Handle handle){
+        timers.cancel(handle);
+    }
+
+    template <typename HANDLER>
+    bool pop(HANDLER&& handler){
+        auto timer = timers.pop_expired(TIME_POINT::max());
+        if (!timer){
+            return false;
+        }
+        handler(timer->deadline, timer->payload);
+        return true;
+    }
+};
+
+//============================================================================================
+// Driver
+//============================================================================================
+struct BenchOptions{
+    int timers = 10000;
+    int spread = 100;
+    int rounds = 20000;
+};
+
+template <typename TIMERS>
+static void run_bench(const BenchOptions& options){
+    TIMERS timers;
+    std::mt19937 random(1);
+    auto base = TIME_POINT{} + std::chrono::hours(1);
+    auto random_deadline = [&](){return base + MILLISEC(random() % options.spread);};
+    uint64_t shifted = 0;
+    int64_t max_shift = 0;
+    uint64_t order_errors = 0;
+    auto check = [&](TIME_POINT deadline, const Payload& payload){
+        auto shift = std::chrono::duration_cast<MILLISEC>(deadline - payload.requested).count();
+        if (shift){
+            shifted++;
+            max_shift = std::max(max_shift, shift);
+        }
+    };
+    auto elapsed = [](bench_clock::time_point start, int num){
+        return std::chrono::duration<double, std::nano>(bench_clock::now() - start).count() / num;
+    };
+
+    // phase 1: arm all timers, many of them share a same deadline
+    std::vector<typename TIMERS::Handle> handles;
+    handles.reserve(options.timers);
+    auto start = bench_clock::now();
+    for (auto i = 0; i < options.timers; i++){
+        auto deadline = random_deadline();
+        handles.push_back(timers.add(deadline, Payload{static_cast<uint64_t>(i), deadline}));
+    }
+    auto add_ns = elapsed(start, options.timers);
+
+    // phase 2: cancel a half of timers
+    start = bench_clock::now();
+    for (auto i = 0; i < options.timers; i += 2){
+        timers.cancel(handles[i]);
+    }
+    auto cancel_ns = elapsed(start, options.timers / 2);
+    for (auto i = 0; i < options.timers; i += 2){
+        auto deadline = random_deadline();
+        timers.add(deadline, Payload{static_cast<uint64_t>(i), deadline});
+    }
+
+    // phase 3: expire a timer and re-arm it as auto-repeat does, keeping timers concurrent
+    auto last = TIME_POINT::min();
+    start = bench_clock::now();
+    for (auto i = 0; i < options.rounds; i++){
+        timers.pop([&](TIME_POINT deadline, const Payload& payload){
+            check(deadline, payload);
+            if (deadline < last){
+                order_errors++;
+            }
+            last = deadline;
+            auto next = deadline + MILLISEC(1 + random() % options.spread);
+            timers.add(next, Payload{payload.id, next});
+        });
+    }
+    auto churn_ns = elapsed(start, options.rounds);
+
+    std::cout << TIMERS::name << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "    add            : " << add_ns << " ns/timer" << std::endl;
+    std::cout << "    cancel         : " << cancel_ns << " ns/timer" << std::endl;
+    std::cout << "    expire + re-arm: " << churn_ns << " ns/timer" << std::endl;
+    std::cout << "    shifted        : " << shifted << " timers (max " << max_shift << " ms)" << std::endl;
+    std::cout << "    order errors   : " << order_errors << std::endl;
+}
+
+int main(int argc, char** argv){
+    BenchOptions options;
+    for (auto i = 1; i < argc; i += 2){
+        std::string option{argv[i]};
+        auto value = i + 1 < argc ? std::atoi(argv[i + 1]) : 0;
+        if (option == "--timers" && value > 0){
+            options.timers = value;
+        }else if (option == "--spread" && value > 0){
+            options.spread = value;
+        }else if (option == "--rounds" && value > 0){
+            options.rounds = value;
+        }else{
+            std::cerr << "usage: " << argv[0] << " [--timers N] [--spread N] [--rounds N]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << options.timers << " concurrent timers within " << options.spread << " ms" << std::endl;
+    run_bench<LegacyTimers>(options);
+    run_bench<HeapTimers>(options);
+    return 0;
+}